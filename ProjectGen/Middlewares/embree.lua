@@ -13,4 +13,7 @@ elseif platform == "osx" then
     table.insert(middlewareLibraries, "libembree3")
     -- table.insert(postBuildCopies, "embree-3.2.0-osx/lib/libembree3.dylib $(TargetDir)libembree3.dylib")
     -- table.insert(postBuildCopies, "embree-3.2.0-osx/lib/libtbb.dylib $(TargetDir)libtbb.dylib")
+elseif platform == "linux" then
+    -- Uses the system install
+    table.insert(middlewareLibraries, "embree3")
 end
\ No newline at end of file
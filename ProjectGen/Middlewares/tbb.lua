@@ -8,4 +8,6 @@ if platform == "Win64" then
     table.insert(postBuildCopies, "tbb\\bin\\tbb.dll $(TargetDir)tbb.dll")
     table.insert(postBuildCopies, "tbb\\bin\\tbb_debug.dll $(TargetDir)tbb_debug.dll")
     table.insert(postBuildCopies, "tbb\\bin\\tbbmalloc.dll $(TargetDir)tbbmalloc.dll")
+elseif platform == "linux" then
+    table.insert(middlewareLibraries, "tbb")
 end
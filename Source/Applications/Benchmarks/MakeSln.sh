@@ -0,0 +1,2 @@
+echo "Creating Benchmarks Project"
+../../../Middleware/Premake/premake5 xcode4 osx
\ No newline at end of file
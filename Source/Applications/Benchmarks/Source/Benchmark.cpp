@@ -0,0 +1,181 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "UtilityLib/QuickSort.h"
+#include "StringLib/StringUtil.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static double ElapsedSeconds(std::chrono::high_resolution_clock::time_point since)
+    {
+        std::chrono::duration<double> elapsed = SystemTime::Now() - since;
+        return elapsed.count();
+    }
+
+    //=============================================================================================================================
+    static void WriteJsonNumber(FILE* file, cpointer format, double value)
+    {
+        // -- JSON has no representation for nan or infinity
+        if(isfinite(value)) {
+            fprintf(file, format, value);
+        }
+        else {
+            fprintf(file, "null");
+        }
+    }
+
+    //=============================================================================================================================
+    void Benchmark_DefaultSettings(BenchmarkSettings* settings)
+    {
+        settings->filter         = nullptr;
+        settings->minSeconds     = 0.5f;
+        settings->minRepetitions = 5;
+        settings->maxRepetitions = 1000;
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Initialize(BenchmarkRunner* runner, const BenchmarkSettings& settings)
+    {
+        runner->settings = settings;
+        runner->results.Clear();
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Shutdown(BenchmarkRunner* runner)
+    {
+        runner->results.Shutdown();
+    }
+
+    //=============================================================================================================================
+    bool Benchmark_Enabled(const BenchmarkRunner* runner, cpointer name)
+    {
+        if(runner->settings.filter == nullptr) {
+            return true;
+        }
+
+        return StringUtil::FindSubString(name, runner->settings.filter) != nullptr;
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Run(BenchmarkRunner* runner, cpointer name, cpointer unit, uint64 itemCount, BenchmarkFunction function,
+                       BenchmarkPrepareFunction prepare, void* userData)
+    {
+        if(Benchmark_Enabled(runner, name) == false) {
+            return;
+        }
+
+        const BenchmarkSettings& settings = runner->settings;
+
+        // -- Warms caches and branch predictors and fixes the checksum every repetition is compared against
+        if(prepare) {
+            prepare(userData);
+        }
+        double checksum = function(userData);
+        bool deterministic = true;
+
+        CArray<double> repetitionSeconds;
+        repetitionSeconds.Reserve(settings.minRepetitions);
+
+        double totalSeconds = 0.0;
+        while(repetitionSeconds.Count() < settings.maxRepetitions) {
+            if(repetitionSeconds.Count() >= settings.minRepetitions && totalSeconds >= settings.minSeconds) {
+                break;
+            }
+
+            if(prepare) {
+                prepare(userData);
+            }
+
+            auto start = SystemTime::Now();
+            double repetitionChecksum = function(userData);
+            double seconds = ElapsedSeconds(start);
+
+            // -- Compared bitwise so a nan checksum still counts as repeatable
+            if(Memory::Compare(&repetitionChecksum, &checksum, sizeof(double)) != 0) {
+                deterministic = false;
+            }
+
+            repetitionSeconds.Add(seconds);
+            totalSeconds += seconds;
+        }
+
+        uint64 count = repetitionSeconds.Count();
+        QuickSort(repetitionSeconds.DataPointer(), count);
+
+        BenchmarkResult& result = runner->results.Add();
+        result.name.Copy(name);
+        result.unit.Copy(unit);
+        result.itemCount     = itemCount;
+        result.repetitions   = count;
+        result.minSeconds    = repetitionSeconds[0];
+        result.maxSeconds    = repetitionSeconds[count - 1];
+        result.medianSeconds = (count & 1) ? repetitionSeconds[count / 2]
+                                           : 0.5 * (repetitionSeconds[count / 2 - 1] + repetitionSeconds[count / 2]);
+        result.checksum      = checksum;
+        result.deterministic = deterministic;
+
+        WriteDebugInfo_("%-40s %12.2f ns/%s (median of %llu)%s", name, 1e9 * result.medianSeconds / itemCount, unit, count,
+                        deterministic ? "" : " - checksum changed between repetitions");
+    }
+
+    //=============================================================================================================================
+    Error Benchmark_WriteJson(const BenchmarkRunner* runner, cpointer filepath)
+    {
+        FILE* file = fopen(filepath, "w");
+        if(file == nullptr) {
+            return Error_("Failed to open benchmark output file %s", filepath);
+        }
+
+        fprintf(file, "{\n");
+        fprintf(file, "    \"version\": 1,\n");
+        fprintf(file, "    \"benchmarks\": [");
+
+        for(uint scan = 0, count = runner->results.Count(); scan < count; ++scan) {
+            const BenchmarkResult& result = runner->results[scan];
+
+            double nsPerItem = 1e9 * result.medianSeconds / result.itemCount;
+            double itemsPerSecond = result.itemCount / result.medianSeconds;
+
+            fprintf(file, "%s\n        {\n", scan > 0 ? "," : "");
+            fprintf(file, "            \"name\": \"%s\",\n", result.name.Ascii());
+            fprintf(file, "            \"unit\": \"%s\",\n", result.unit.Ascii());
+            fprintf(file, "            \"items\": %llu,\n", result.itemCount);
+            fprintf(file, "            \"repetitions\": %llu,\n", result.repetitions);
+            fprintf(file, "            \"medianSeconds\": ");
+            WriteJsonNumber(file, "%.9f", result.medianSeconds);
+            fprintf(file, ",\n            \"minSeconds\": ");
+            WriteJsonNumber(file, "%.9f", result.minSeconds);
+            fprintf(file, ",\n            \"maxSeconds\": ");
+            WriteJsonNumber(file, "%.9f", result.maxSeconds);
+            fprintf(file, ",\n            \"nsPerItem\": ");
+            WriteJsonNumber(file, "%.3f", nsPerItem);
+            fprintf(file, ",\n            \"itemsPerSecond\": ");
+            WriteJsonNumber(file, "%.1f", itemsPerSecond);
+            fprintf(file, ",\n            \"checksum\": ");
+            WriteJsonNumber(file, "%.17g", result.checksum);
+            fprintf(file, ",\n            \"deterministic\": %s\n", result.deterministic ? "true" : "false");
+            fprintf(file, "        }");
+        }
+
+        fprintf(file, "\n    ]\n}\n");
+
+        bool writeFailed = ferror(file) != 0;
+        fclose(file);
+        if(writeFailed) {
+            return Error_("Failed to write benchmark results to %s", filepath);
+        }
+
+        return Success_;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "StringLib/FixedString.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Runs one repetition of a benchmark and returns a value computed from its results. The value is reported as the
+    // -- benchmark's checksum so the work can't be optimized away and so changes in results show up next to changes in speed.
+    typedef double(*BenchmarkFunction)(void* userData);
+    typedef void(*BenchmarkPrepareFunction)(void* userData);
+
+    struct BenchmarkSettings
+    {
+        // -- Only benchmarks whose names contain the filter are run. Null runs everything.
+        cpointer filter;
+        // -- Repetitions continue until both minimums are met or maxRepetitions is reached
+        float minSeconds;
+        uint  minRepetitions;
+        uint  maxRepetitions;
+    };
+
+    struct BenchmarkResult
+    {
+        FixedString64 name;
+        FixedString32 unit;
+        uint64 itemCount;
+        uint64 repetitions;
+        double medianSeconds;
+        double minSeconds;
+        double maxSeconds;
+        double checksum;
+        // -- False when a repetition's checksum differed from the warm up's
+        bool deterministic;
+    };
+
+    struct BenchmarkRunner
+    {
+        BenchmarkSettings settings;
+        CArray<BenchmarkResult> results;
+    };
+
+    void Benchmark_DefaultSettings(BenchmarkSettings* settings);
+    void Benchmark_Initialize(BenchmarkRunner* runner, const BenchmarkSettings& settings);
+    void Benchmark_Shutdown(BenchmarkRunner* runner);
+
+    // -- Lets a group skip building fixtures that none of its enabled benchmarks use
+    bool Benchmark_Enabled(const BenchmarkRunner* runner, cpointer name);
+
+    // -- Times repetitions of function, each of which processes itemCount items, on the calling thread. When given, prepare is
+    // -- called untimed before every repetition to restore state the previous one consumed. One untimed warm up repetition runs
+    // -- first and every timed repetition is expected to return the same checksum as it.
+    void Benchmark_Run(BenchmarkRunner* runner, cpointer name, cpointer unit, uint64 itemCount, BenchmarkFunction function,
+                       BenchmarkPrepareFunction prepare, void* userData);
+
+    // -- Results are written in the order they were run with a fixed layout and precision so runs can be diffed
+    Error Benchmark_WriteJson(const BenchmarkRunner* runner, cpointer filepath);
+}
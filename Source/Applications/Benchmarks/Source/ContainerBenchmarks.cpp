@@ -0,0 +1,574 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ContainerBenchmarks.h"
+#include "Benchmark.h"
+
+#include "ThreadingLib/Thread.h"
+#include "MathLib/Sampler.h"
+#include "ContainersLib/CSet.h"
+#include "ContainersLib/CArray.h"
+#include "ContainersLib/MpmcQueue.h"
+#include "ContainersLib/WorkStealingDeque.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/BasicTypes.h"
+
+#include <map>
+
+#define MpmcProducerCount_          4
+#define MpmcConsumerCount_          4
+#define MpmcItemsPerProducer_       (1 << 18)
+#define MpmcItemCount_              (MpmcProducerCount_ * MpmcItemsPerProducer_)
+#define DequeWorkerCount_           4
+#define DequeTasksPerWorker_        (1 << 18)
+#define DequeTaskCount_             (DequeWorkerCount_ * DequeTasksPerWorker_)
+#define SpinsBeforeYield_           64
+#define SetEntryCount_              (1 << 18)
+#define LinearSetEntryCount_        (1 << 14)
+#define BenchmarkSeed_              0x5E1A5
+
+namespace Selas
+{
+    namespace ContainerBenchmarks
+    {
+        //=========================================================================================================================
+        struct MpmcStressData
+        {
+            MpmcQueue<uint64> queue;
+            volatile int64 consumedCount;
+            volatile int64 failureCount;
+            // -- How many times each item was popped. Anything other than exactly once is a failure.
+            volatile int32* popCounts;
+        };
+
+        //=========================================================================================================================
+        struct MpmcStressWorker
+        {
+            MpmcStressData* data;
+            uint32 index;
+            uint64 itemSum;
+        };
+
+        //=========================================================================================================================
+        static void Backoff(uint32& spins)
+        {
+            // -- Gives the other side a chance to run when there are more stress threads than cores.
+            if(++spins == SpinsBeforeYield_) {
+                spins = 0;
+                Sleep(0);
+            }
+        }
+
+        //=========================================================================================================================
+        static void MpmcProducer(void* userData)
+        {
+            MpmcStressWorker* worker = (MpmcStressWorker*)userData;
+            MpmcStressData* data = worker->data;
+
+            uint32 spins = 0;
+            for(uint64 sequence = 0; sequence < MpmcItemsPerProducer_; ++sequence) {
+                uint64 item = ((uint64)worker->index << 32) | sequence;
+                while(data->queue.TryPush(item) == false) {
+                    Backoff(spins);
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static void MpmcConsumer(void* userData)
+        {
+            MpmcStressWorker* worker = (MpmcStressWorker*)userData;
+            MpmcStressData* data = worker->data;
+
+            // -- The queue is FIFO so each consumer has to see any one producer's items in increasing order.
+            int64 lastSequence[MpmcProducerCount_];
+            for(uint scan = 0; scan < MpmcProducerCount_; ++scan) {
+                lastSequence[scan] = -1;
+            }
+
+            worker->itemSum = 0;
+
+            uint32 spins = 0;
+            while(data->consumedCount < MpmcItemCount_) {
+                uint64 item;
+                if(data->queue.TryPop(item) == false) {
+                    Backoff(spins);
+                    continue;
+                }
+
+                uint32 producer = (uint32)(item >> 32);
+                int64 sequence = (int64)(item & 0xFFFFFFFF);
+                if(producer >= MpmcProducerCount_ || sequence >= MpmcItemsPerProducer_ || sequence <= lastSequence[producer]) {
+                    Atomic::Increment64(&data->failureCount);
+                }
+                else {
+                    lastSequence[producer] = sequence;
+                    Atomic::Increment32(&data->popCounts[producer * MpmcItemsPerProducer_ + sequence]);
+                }
+
+                worker->itemSum += item;
+                Atomic::Increment64(&data->consumedCount);
+            }
+        }
+
+        //=========================================================================================================================
+        static void PrepareMpmcStress(void* userData)
+        {
+            MpmcStressData* data = (MpmcStressData*)userData;
+            data->consumedCount = 0;
+            Memory::Zero((void*)data->popCounts, MpmcItemCount_ * sizeof(int32));
+        }
+
+        //=========================================================================================================================
+        static double MpmcStress(void* userData)
+        {
+            MpmcStressData* data = (MpmcStressData*)userData;
+
+            MpmcStressWorker workers[MpmcProducerCount_ + MpmcConsumerCount_];
+            ThreadHandle threadHandles[MpmcProducerCount_ + MpmcConsumerCount_];
+
+            for(uint32 scan = 0; scan < MpmcProducerCount_ + MpmcConsumerCount_; ++scan) {
+                workers[scan].data = data;
+                workers[scan].index = scan < MpmcProducerCount_ ? scan : scan - MpmcProducerCount_;
+                workers[scan].itemSum = 0;
+
+                ThreadFunction function = scan < MpmcProducerCount_ ? MpmcProducer : MpmcConsumer;
+                threadHandles[scan] = CreateThread(function, &workers[scan], "MpmcStress", NoThreadAffinity_);
+            }
+
+            for(uint32 scan = 0; scan < MpmcProducerCount_ + MpmcConsumerCount_; ++scan) {
+                ShutdownThread(threadHandles[scan]);
+            }
+
+            for(uint scan = 0; scan < MpmcItemCount_; ++scan) {
+                if(data->popCounts[scan] != 1) {
+                    Atomic::Increment64(&data->failureCount);
+                }
+            }
+
+            // -- Independent of which consumer popped what so it is identical across repetitions when nothing went wrong.
+            uint64 itemSum = 0;
+            for(uint32 scan = MpmcProducerCount_; scan < MpmcProducerCount_ + MpmcConsumerCount_; ++scan) {
+                itemSum += workers[scan].itemSum;
+            }
+
+            return (double)itemSum;
+        }
+
+        //=========================================================================================================================
+        static Error RunMpmcStress(BenchmarkRunner* runner, cpointer name, uint32 queueCapacity)
+        {
+            if(Benchmark_Enabled(runner, name) == false) {
+                return Success_;
+            }
+
+            MpmcStressData data;
+            data.queue.Initialize(queueCapacity);
+            data.consumedCount = 0;
+            data.failureCount = 0;
+            data.popCounts = AllocArray_(int32, MpmcItemCount_);
+
+            Benchmark_Run(runner, name, "item", MpmcItemCount_, MpmcStress, PrepareMpmcStress, &data);
+
+            int64 failureCount = data.failureCount;
+            Free_((void*)data.popCounts);
+            data.queue.Shutdown();
+
+            if(failureCount != 0) {
+                return Error_("%s: %lld items were lost, duplicated or reordered", name, failureCount);
+            }
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        struct DequeStressData
+        {
+            WorkStealingDeque<uint64> deques[DequeWorkerCount_];
+            volatile int64 executedCount;
+            volatile int64 failureCount;
+            // -- How many times each task was run. Anything other than exactly once is a failure.
+            volatile int32* runCounts;
+        };
+
+        //=========================================================================================================================
+        struct DequeStressWorker
+        {
+            DequeStressData* data;
+            uint32 index;
+            uint64 taskSum;
+            uint64 stolenCount;
+        };
+
+        //=========================================================================================================================
+        static void RunDequeTask(DequeStressWorker* worker, uint64 task)
+        {
+            DequeStressData* data = worker->data;
+
+            uint32 owner = (uint32)(task >> 32);
+            uint64 sequence = task & 0xFFFFFFFF;
+            if(owner >= DequeWorkerCount_ || sequence >= DequeTasksPerWorker_) {
+                Atomic::Increment64(&data->failureCount);
+            }
+            else {
+                Atomic::Increment32(&data->runCounts[owner * DequeTasksPerWorker_ + sequence]);
+            }
+
+            worker->taskSum += task;
+            Atomic::Increment64(&data->executedCount);
+        }
+
+        //=========================================================================================================================
+        static bool StealDequeTask(DequeStressWorker* worker, uint32 victimOffset)
+        {
+            DequeStressData* data = worker->data;
+
+            uint32 victim = (worker->index + victimOffset) % DequeWorkerCount_;
+            if(victim == worker->index) {
+                return false;
+            }
+
+            uint64 task;
+            if(data->deques[victim].Steal(task) == false) {
+                return false;
+            }
+
+            ++worker->stolenCount;
+            RunDequeTask(worker, task);
+            return true;
+        }
+
+        //=========================================================================================================================
+        static void DequeWorker(void* userData)
+        {
+            DequeStressWorker* worker = (DequeStressWorker*)userData;
+            DequeStressData* data = worker->data;
+            WorkStealingDeque<uint64>& deque = data->deques[worker->index];
+
+            worker->taskSum = 0;
+            worker->stolenCount = 0;
+
+            // -- The owner pushes its tasks and pops one back after every other push so pops and steals keep meeting at the
+            // -- last item. A full deque makes the owner run a task before pushing again.
+            uint64 task;
+            for(uint64 sequence = 0; sequence < DequeTasksPerWorker_; ++sequence) {
+                uint64 item = ((uint64)worker->index << 32) | sequence;
+                while(deque.Push(item) == false) {
+                    if(deque.Pop(task)) {
+                        RunDequeTask(worker, task);
+                    }
+                }
+
+                if((sequence & 1) && deque.Pop(task)) {
+                    RunDequeTask(worker, task);
+                }
+            }
+
+            while(deque.Pop(task)) {
+                RunDequeTask(worker, task);
+            }
+
+            // -- Then help the others until every task has run
+            uint32 spins = 0;
+            uint32 victimOffset = 1;
+            while(data->executedCount < DequeTaskCount_) {
+                if(StealDequeTask(worker, victimOffset) == false) {
+                    victimOffset = victimOffset % (DequeWorkerCount_ - 1) + 1;
+                    Backoff(spins);
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static void PrepareDequeStress(void* userData)
+        {
+            DequeStressData* data = (DequeStressData*)userData;
+            data->executedCount = 0;
+            Memory::Zero((void*)data->runCounts, DequeTaskCount_ * sizeof(int32));
+        }
+
+        //=========================================================================================================================
+        static double DequeStress(void* userData)
+        {
+            DequeStressData* data = (DequeStressData*)userData;
+
+            DequeStressWorker workers[DequeWorkerCount_];
+            ThreadHandle threadHandles[DequeWorkerCount_];
+
+            for(uint32 scan = 0; scan < DequeWorkerCount_; ++scan) {
+                workers[scan].data = data;
+                workers[scan].index = scan;
+                threadHandles[scan] = CreateThread(DequeWorker, &workers[scan], "DequeStress", NoThreadAffinity_);
+            }
+
+            for(uint32 scan = 0; scan < DequeWorkerCount_; ++scan) {
+                ShutdownThread(threadHandles[scan]);
+            }
+
+            for(uint scan = 0; scan < DequeTaskCount_; ++scan) {
+                if(data->runCounts[scan] != 1) {
+                    Atomic::Increment64(&data->failureCount);
+                }
+            }
+
+            // -- Independent of which worker ran what so it is identical across repetitions when nothing went wrong. How many
+            // -- tasks were stolen varies from run to run so it is left out.
+            uint64 taskSum = 0;
+            for(uint32 scan = 0; scan < DequeWorkerCount_; ++scan) {
+                taskSum += workers[scan].taskSum;
+            }
+
+            return (double)taskSum;
+        }
+
+        //=========================================================================================================================
+        static Error RunDequeStress(BenchmarkRunner* runner, cpointer name, uint32 dequeCapacity)
+        {
+            if(Benchmark_Enabled(runner, name) == false) {
+                return Success_;
+            }
+
+            DequeStressData data;
+            for(uint32 scan = 0; scan < DequeWorkerCount_; ++scan) {
+                data.deques[scan].Initialize(dequeCapacity);
+            }
+            data.executedCount = 0;
+            data.failureCount = 0;
+            data.runCounts = AllocArray_(int32, DequeTaskCount_);
+
+            Benchmark_Run(runner, name, "task", DequeTaskCount_, DequeStress, PrepareDequeStress, &data);
+
+            int64 failureCount = data.failureCount;
+            Free_((void*)data.runCounts);
+            for(uint32 scan = 0; scan < DequeWorkerCount_; ++scan) {
+                data.deques[scan].Shutdown();
+            }
+
+            if(failureCount != 0) {
+                return Error_("%s: %lld tasks were lost or run more than once", name, failureCount);
+            }
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        struct SetData
+        {
+            CArray<uint32> keys;
+            CSet<uint32> set;
+            std::map<uint32, uint64> map;
+            // -- How CSet behaved before it had a hash index: a linear scan per Add over an array that grows additively.
+            CArray<uint32> linearSet;
+        };
+
+        //=========================================================================================================================
+        static void InitializeSetData(SetData* data)
+        {
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+
+            data->keys.Resize(SetEntryCount_);
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                data->keys[scan] = sampler.UniformUInt32();
+            }
+
+            sampler.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static void FillCSet(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+            data->set.Shutdown();
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                data->set.Add(data->keys[scan]);
+            }
+        }
+
+        //=========================================================================================================================
+        static void FillStdMap(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+            data->map.clear();
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                data->map.insert(std::pair<uint32, uint64>(data->keys[scan], data->map.size()));
+            }
+        }
+
+        //=========================================================================================================================
+        static void ClearCSet(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+            data->set.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static void ClearStdMap(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+            data->map.clear();
+        }
+
+        //=========================================================================================================================
+        static void ClearLinearSet(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+            data->linearSet.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static double CSetAdd(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 indexSum = 0;
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                indexSum += data->set.Add(data->keys[scan]);
+            }
+            return (double)indexSum;
+        }
+
+        //=========================================================================================================================
+        static double StdMapAdd(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 indexSum = 0;
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                auto inserted = data->map.insert(std::pair<uint32, uint64>(data->keys[scan], data->map.size()));
+                indexSum += inserted.first->second;
+            }
+            return (double)indexSum;
+        }
+
+        //=========================================================================================================================
+        static double LinearSetAdd(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 indexSum = 0;
+            for(uint scan = 0; scan < LinearSetEntryCount_; ++scan) {
+                uint32 key = data->keys[scan];
+
+                uint64 index = 0;
+                uint64 count = data->linearSet.Count();
+                while(index < count && data->linearSet[index] != key) {
+                    ++index;
+                }
+                if(index == count) {
+                    data->linearSet.Add(key);
+                }
+
+                indexSum += index;
+            }
+            return (double)indexSum;
+        }
+
+        //=========================================================================================================================
+        static double CSetFind(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 indexSum = 0;
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                indexSum += data->set.Find(data->keys[scan]);
+            }
+            return (double)indexSum;
+        }
+
+        //=========================================================================================================================
+        static double StdMapFind(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 indexSum = 0;
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                indexSum += data->map.find(data->keys[scan])->second;
+            }
+            return (double)indexSum;
+        }
+
+        //=========================================================================================================================
+        static double CSetRemoveFast(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 indexSum = 0;
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                uint64 index = data->set.Find(data->keys[scan]);
+                if(index != InvalidIndex64) {
+                    data->set.RemoveFast((uint)index);
+                    indexSum += index;
+                }
+            }
+            return (double)(indexSum + data->set.Count());
+        }
+
+        //=========================================================================================================================
+        static double StdMapRemove(void* userData)
+        {
+            SetData* data = (SetData*)userData;
+
+            uint64 removedCount = 0;
+            for(uint scan = 0; scan < SetEntryCount_; ++scan) {
+                removedCount += data->map.erase(data->keys[scan]);
+            }
+            return (double)(removedCount + data->map.size());
+        }
+
+        //=========================================================================================================================
+        static void RunSetBenchmarks(BenchmarkRunner* runner)
+        {
+            bool enabled = Benchmark_Enabled(runner, "set.add.cset")
+                           || Benchmark_Enabled(runner, "set.add.stdmap")
+                           || Benchmark_Enabled(runner, "set.add.linearset")
+                           || Benchmark_Enabled(runner, "set.find.cset")
+                           || Benchmark_Enabled(runner, "set.find.stdmap")
+                           || Benchmark_Enabled(runner, "set.removefast.cset")
+                           || Benchmark_Enabled(runner, "set.remove.stdmap");
+            if(enabled == false) {
+                return;
+            }
+
+            SetData data;
+            InitializeSetData(&data);
+
+            Benchmark_Run(runner, "set.add.cset", "entry", SetEntryCount_, CSetAdd, ClearCSet, &data);
+            Benchmark_Run(runner, "set.add.stdmap", "entry", SetEntryCount_, StdMapAdd, ClearStdMap, &data);
+            // -- Quadratic so it is only run on the first few thousand keys
+            Benchmark_Run(runner, "set.add.linearset", "entry", LinearSetEntryCount_, LinearSetAdd, ClearLinearSet, &data);
+
+            FillCSet(&data);
+            FillStdMap(&data);
+            Benchmark_Run(runner, "set.find.cset", "lookup", SetEntryCount_, CSetFind, nullptr, &data);
+            Benchmark_Run(runner, "set.find.stdmap", "lookup", SetEntryCount_, StdMapFind, nullptr, &data);
+
+            Benchmark_Run(runner, "set.removefast.cset", "entry", SetEntryCount_, CSetRemoveFast, FillCSet, &data);
+            Benchmark_Run(runner, "set.remove.stdmap", "entry", SetEntryCount_, StdMapRemove, FillStdMap, &data);
+
+            data.set.Shutdown();
+            data.map.clear();
+            data.linearSet.Shutdown();
+            data.keys.Shutdown();
+        }
+
+        //=========================================================================================================================
+        Error Run(BenchmarkRunner* runner)
+        {
+            RunSetBenchmarks(runner);
+
+            // -- A tiny queue keeps producers and consumers colliding on full and empty cells; a large one measures throughput.
+            ReturnError_(RunMpmcStress(runner, "queue.mpmc.stress.capacity64", 64));
+            ReturnError_(RunMpmcStress(runner, "queue.mpmc.stress.capacity4096", 4096));
+            ReturnError_(RunDequeStress(runner, "deque.worksteal.stress.capacity64", 64));
+            ReturnError_(RunDequeStress(runner, "deque.worksteal.stress.capacity4096", 4096));
+
+            return Success_;
+        }
+    }
+}
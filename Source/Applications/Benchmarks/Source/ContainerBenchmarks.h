@@ -0,0 +1,19 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+
+namespace Selas
+{
+    struct BenchmarkRunner;
+
+    namespace ContainerBenchmarks
+    {
+        // -- CSet against std::map and the linear scan CSet used to do, and multi-threaded stress runs of the lock-free
+        // -- containers. The stress runs check every repetition and fail if an item was lost, duplicated or reordered.
+        Error Run(BenchmarkRunner* runner);
+    }
+}
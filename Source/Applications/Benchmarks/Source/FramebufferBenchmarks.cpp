@@ -0,0 +1,295 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "FramebufferBenchmarks.h"
+#include "Benchmark.h"
+
+#include "TextureLib/Framebuffer.h"
+#include "ThreadingLib/Thread.h"
+#include "StringLib/FixedString.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Sampler.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/CountOf.h"
+#include "SystemLib/BasicTypes.h"
+
+// -- About the size of a render so the tile count matches what the path tracers write into
+#define FrameWidth_                 1024
+#define FrameHeight_                432
+#define FrameLayerCount_            4
+#define MaxWriterThreadCount_       16
+#define WritesPerThread_            (1 << 18)
+#define FrameLockCapacity_          4096
+#define FrameLockSoftCapacity_      3840
+#define ChecksumWeightModulus_      97
+#define BenchmarkSeed_              0x5E1A5
+
+namespace Selas
+{
+    namespace FramebufferBenchmarks
+    {
+        //=========================================================================================================================
+        struct FlushBenchmarkData
+        {
+            Framebuffer frame;
+            // -- Only used by the frame lock writer
+            void* frameLock;
+            ThreadFunction writerFunction;
+            uint32 threadCount;
+        };
+
+        //=========================================================================================================================
+        struct WriterThreadData
+        {
+            FlushBenchmarkData* data;
+            uint32 index;
+        };
+
+        //=========================================================================================================================
+        static void FillSamples(float3* samples)
+        {
+            // -- Small integers so sums are exact in whatever order the threads merge them
+            for(uint32 layer = 0; layer < FrameLayerCount_; ++layer) {
+                samples[layer] = float3(1.0f, (float)(layer + 1), 2.0f);
+            }
+        }
+
+        //=========================================================================================================================
+        static uint32 NextPixel(CSampler* sampler)
+        {
+            return sampler->UniformUInt32() % (FrameWidth_ * FrameHeight_);
+        }
+
+        //=========================================================================================================================
+        static double PixelWeight(uint32 index)
+        {
+            // -- Weighted by position so a sample added to the wrong pixel changes the checksum
+            return (double)(index % ChecksumWeightModulus_ + 1);
+        }
+
+        //=========================================================================================================================
+        static double ExpectedChecksum(uint32 threadCount)
+        {
+            float3 samples[FrameLayerCount_];
+            FillSamples(samples);
+
+            double sampleSum = 0.0;
+            for(uint32 layer = 0; layer < FrameLayerCount_; ++layer) {
+                sampleSum += (double)samples[layer].x + (double)samples[layer].y + (double)samples[layer].z;
+            }
+
+            double checksum = 0.0;
+            for(uint32 thread = 0; thread < threadCount; ++thread) {
+                CSampler sampler;
+                sampler.Initialize(BenchmarkSeed_ + thread);
+                for(uint scan = 0; scan < WritesPerThread_; ++scan) {
+                    checksum += sampleSum * PixelWeight(NextPixel(&sampler));
+                }
+                sampler.Shutdown();
+            }
+
+            return checksum;
+        }
+
+        //=========================================================================================================================
+        static double FrameChecksum(const Framebuffer* frame)
+        {
+            double checksum = 0.0;
+            for(uint32 layer = 0; layer < frame->layerCount; ++layer) {
+                for(uint32 index = 0; index < frame->width * frame->height; ++index) {
+                    const float3& value = frame->buffers[layer][index];
+                    checksum += ((double)value.x + (double)value.y + (double)value.z) * PixelWeight(index);
+                }
+            }
+            return checksum;
+        }
+
+        //=========================================================================================================================
+        static void FrameLockFlush(Framebuffer* frame, const uint32* indices, const float3* samples, uint32 count)
+        {
+            for(uint32 scan = 0; scan < count; ++scan) {
+                for(uint32 layer = 0; layer < FrameLayerCount_; ++layer) {
+                    frame->buffers[layer][indices[scan]] += samples[scan * FrameLayerCount_ + layer];
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static void FrameLockWriter(void* userData)
+        {
+            // -- The original FramebufferWriter: samples are queued and flushed under one lock for the whole frame. Past the
+            // -- soft capacity it flushes whenever the lock happens to be free.
+            WriterThreadData* thread = (WriterThreadData*)userData;
+            FlushBenchmarkData* data = thread->data;
+
+            uint32* indices = AllocArray_(uint32, FrameLockCapacity_);
+            float3* queued = AllocArray_(float3, FrameLockCapacity_ * FrameLayerCount_);
+            uint32 count = 0;
+
+            float3 samples[FrameLayerCount_];
+            FillSamples(samples);
+
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_ + thread->index);
+
+            for(uint scan = 0; scan < WritesPerThread_; ++scan) {
+                if(count == FrameLockCapacity_) {
+                    EnterSpinLock(data->frameLock);
+                    FrameLockFlush(&data->frame, indices, queued, count);
+                    LeaveSpinLock(data->frameLock);
+                    count = 0;
+                }
+
+                indices[count] = NextPixel(&sampler);
+                for(uint32 layer = 0; layer < FrameLayerCount_; ++layer) {
+                    queued[count * FrameLayerCount_ + layer] = samples[layer];
+                }
+                ++count;
+
+                if(count > FrameLockSoftCapacity_ && TryEnterSpinLock(data->frameLock)) {
+                    FrameLockFlush(&data->frame, indices, queued, count);
+                    LeaveSpinLock(data->frameLock);
+                    count = 0;
+                }
+            }
+
+            EnterSpinLock(data->frameLock);
+            FrameLockFlush(&data->frame, indices, queued, count);
+            LeaveSpinLock(data->frameLock);
+
+            sampler.Shutdown();
+            Free_(queued);
+            Free_(indices);
+        }
+
+        //=========================================================================================================================
+        static void PrivateTileWriter(void* userData)
+        {
+            WriterThreadData* thread = (WriterThreadData*)userData;
+            FlushBenchmarkData* data = thread->data;
+
+            FramebufferWriter writer;
+            FramebufferWriter_Initialize(&writer, &data->frame);
+
+            float3 samples[FrameLayerCount_];
+            FillSamples(samples);
+
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_ + thread->index);
+
+            for(uint scan = 0; scan < WritesPerThread_; ++scan) {
+                FramebufferWriter_Write(&writer, samples, FrameLayerCount_, NextPixel(&sampler));
+            }
+
+            sampler.Shutdown();
+            FramebufferWriter_Shutdown(&writer);
+        }
+
+        //=========================================================================================================================
+        static void PrepareFlushBenchmark(void* userData)
+        {
+            FlushBenchmarkData* data = (FlushBenchmarkData*)userData;
+            for(uint32 layer = 0; layer < data->frame.layerCount; ++layer) {
+                Memory::Zero(data->frame.buffers[layer], sizeof(float3) * data->frame.width * data->frame.height);
+            }
+        }
+
+        //=========================================================================================================================
+        static double FlushBenchmark(void* userData)
+        {
+            FlushBenchmarkData* data = (FlushBenchmarkData*)userData;
+
+            WriterThreadData threads[MaxWriterThreadCount_];
+            ThreadHandle threadHandles[MaxWriterThreadCount_];
+
+            for(uint32 scan = 0; scan < data->threadCount; ++scan) {
+                threads[scan].data = data;
+                threads[scan].index = scan;
+                threadHandles[scan] = CreateThread(data->writerFunction, &threads[scan], "FramebufferWriter", NoThreadAffinity_);
+            }
+
+            for(uint32 scan = 0; scan < data->threadCount; ++scan) {
+                ShutdownThread(threadHandles[scan]);
+            }
+
+            // -- Only the private tile writers leave anything to reduce. It is part of their cost so it is timed.
+            FrameBuffer_Reduce(&data->frame, data->threadCount);
+
+            return FrameChecksum(&data->frame);
+        }
+
+        //=========================================================================================================================
+        static void BenchmarkName(FixedString64& name, cpointer writerName, uint32 threadCount)
+        {
+            FixedStringSprintf(name, "framebuffer.write.%s.%ut", writerName, threadCount);
+        }
+
+        //=========================================================================================================================
+        static Error RunFlushBenchmark(BenchmarkRunner* runner, FlushBenchmarkData* data, cpointer writerName,
+                                       ThreadFunction writer, uint32 threadCount)
+        {
+            FixedString64 name;
+            BenchmarkName(name, writerName, threadCount);
+            if(Benchmark_Enabled(runner, name.Ascii()) == false) {
+                return Success_;
+            }
+
+            data->writerFunction = writer;
+            data->threadCount = threadCount;
+            Benchmark_Run(runner, name.Ascii(), "sample", threadCount * WritesPerThread_, FlushBenchmark, PrepareFlushBenchmark,
+                          data);
+
+            // -- The last repetition's frame is still there to check
+            double checksum = FrameChecksum(&data->frame);
+            double expectedChecksum = ExpectedChecksum(threadCount);
+            if(checksum != expectedChecksum) {
+                return Error_("%s: frame checksum %f doesn't match the expected %f", name.Ascii(), checksum, expectedChecksum);
+            }
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        Error Run(BenchmarkRunner* runner)
+        {
+            static cpointer writerNames[] = { "framelock", "privatetiles" };
+            static const ThreadFunction writers[] = { FrameLockWriter, PrivateTileWriter };
+            static const uint32 threadCounts[] = { 4, MaxWriterThreadCount_ };
+
+            bool enabled = false;
+            for(uint32 threads = 0; threads < CountOf_(threadCounts); ++threads) {
+                for(uint32 writer = 0; writer < CountOf_(writers); ++writer) {
+                    FixedString64 name;
+                    BenchmarkName(name, writerNames[writer], threadCounts[threads]);
+                    enabled = enabled || Benchmark_Enabled(runner, name.Ascii());
+                }
+            }
+            if(enabled == false) {
+                return Success_;
+            }
+
+            FlushBenchmarkData data;
+            FrameBuffer_Initialize(&data.frame, FrameWidth_, FrameHeight_, FrameLayerCount_);
+            data.frameLock = CreateSpinLock();
+            data.writerFunction = nullptr;
+            data.threadCount = 0;
+
+            // -- Every thread writes the same scattered pixels with each writer so the frames they produce are identical.
+            Error err = Success_;
+            for(uint32 threads = 0; threads < CountOf_(threadCounts) && Successful_(err); ++threads) {
+                for(uint32 writer = 0; writer < CountOf_(writers) && Successful_(err); ++writer) {
+                    err = RunFlushBenchmark(runner, &data, writerNames[writer], writers[writer], threadCounts[threads]);
+                }
+            }
+
+            CloseSpinlock(data.frameLock);
+            FrameBuffer_Shutdown(&data.frame);
+
+            return err;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+
+namespace Selas
+{
+    struct BenchmarkRunner;
+
+    namespace FramebufferBenchmarks
+    {
+        // -- Several threads writing scattered samples into one frame through FramebufferWriter and through a copy of the frame
+        // -- lock writer it replaced, at a few thread counts. Every run is checked against the expected frame and fails if a
+        // -- sample was lost or misplaced.
+        Error Run(BenchmarkRunner* runner);
+    }
+}
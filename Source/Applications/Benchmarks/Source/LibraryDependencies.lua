@@ -0,0 +1,4 @@
+
+local platform = ...
+
+loadfile(RootDirectory .. "ProjectGen\\Middlewares\\embree.lua")(platform)
\ No newline at end of file
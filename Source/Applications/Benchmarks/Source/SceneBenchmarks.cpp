@@ -0,0 +1,548 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SceneBenchmarks.h"
+#include "Benchmark.h"
+
+#include "Shading/IntegratorContexts.h"
+#include "Shading/SurfaceParameters.h"
+#include "SceneLib/ProceduralScene.h"
+#include "SceneLib/SceneResource.h"
+#include "SceneLib/GeometryCache.h"
+#include "TextureLib/TextureCache.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Sampler.h"
+#include "MathLib/Trigonometric.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/BasicTypes.h"
+
+#include "embree3/rtcore.h"
+#include "embree3/rtcore_ray.h"
+
+#define TerrainResolution_      256
+#define SubsceneGridSize_       8
+#define RayCount_               (1 << 16)
+#define SurfaceHitCount_        (1 << 16)
+#define PacketSize_             8
+#define TraceDistance_          1000.0f
+#define BenchmarkSeed_          0x5E1A5
+
+#define CacheSize_              (512 Mb_)
+
+static cpointer subsceneName = "Benchmarks~Terrain";
+static cpointer textureName  = "Benchmarks~TerrainColor";
+static cpointer materialName = "Terrain";
+
+namespace Selas
+{
+    namespace SceneBenchmarks
+    {
+        //=========================================================================================================================
+        struct RaySet
+        {
+            CArray<float3> origins;
+            CArray<float3> directions;
+            // -- Shadow ray lengths; closest hit rays all trace to TraceDistance_
+            CArray<float> distances;
+        };
+
+        //=========================================================================================================================
+        struct TraversalData
+        {
+            RTCScene rtcScene;
+            const RaySet* rays;
+        };
+
+        //=========================================================================================================================
+        struct SurfaceData
+        {
+            GIIntegratorContext context;
+            CArray<HitParameters> hits;
+        };
+
+        //=========================================================================================================================
+        static float TerrainHeight(float x, float z, float& dhdx, float& dhdz)
+        {
+            dhdx = 0.08f * 6.0f * Math::Cosf(6.0f * x) * Math::Cosf(5.0f * z)
+                 + 0.02f * 23.0f * Math::Cosf(23.0f * x + 11.0f * z);
+            dhdz = -0.08f * 5.0f * Math::Sinf(6.0f * x) * Math::Sinf(5.0f * z)
+                 + 0.02f * 11.0f * Math::Cosf(23.0f * x + 11.0f * z);
+
+            return 0.08f * Math::Sinf(6.0f * x) * Math::Cosf(5.0f * z) + 0.02f * Math::Sinf(23.0f * x + 11.0f * z);
+        }
+
+        //=========================================================================================================================
+        static void BuildTerrainMesh(ProceduralMesh* mesh)
+        {
+            // -- A rolling heightfield over [-1, 1] in x and z with every vertex attribute CalculateSurfaceParams reads
+            const uint32 vertexRow = TerrainResolution_ + 1;
+
+            for(uint32 z = 0; z < vertexRow; ++z) {
+                for(uint32 x = 0; x < vertexRow; ++x) {
+                    float u = (float)x / TerrainResolution_;
+                    float v = (float)z / TerrainResolution_;
+                    float px = 2.0f * u - 1.0f;
+                    float pz = 2.0f * v - 1.0f;
+
+                    float dhdx;
+                    float dhdz;
+                    float height = TerrainHeight(px, pz, dhdx, dhdz);
+
+                    mesh->positions.Add(float3(px, height, pz));
+                    mesh->normals.Add(Normalize(float3(-dhdx, 1.0f, -dhdz)));
+                    float3 tangent = Normalize(float3(1.0f, dhdx, 0.0f));
+                    mesh->tangents.Add(float4(tangent.x, tangent.y, tangent.z, 1.0f));
+                    mesh->uvs.Add(float2(4.0f * u, 4.0f * v));
+                }
+            }
+
+            for(uint32 z = 0; z < TerrainResolution_; ++z) {
+                for(uint32 x = 0; x < TerrainResolution_; ++x) {
+                    uint32 i0 = z * vertexRow + x;
+                    uint32 i1 = i0 + 1;
+                    uint32 i2 = i0 + vertexRow;
+                    uint32 i3 = i2 + 1;
+
+                    mesh->triindices.Add(i0);
+                    mesh->triindices.Add(i2);
+                    mesh->triindices.Add(i1);
+                    mesh->triindices.Add(i1);
+                    mesh->triindices.Add(i2);
+                    mesh->triindices.Add(i3);
+                }
+            }
+
+            mesh->materialHash = ProceduralMaterialHash(materialName);
+            mesh->name.Copy("Terrain");
+        }
+
+        //=========================================================================================================================
+        static RTCScene CreateTriangleScene(RTCDevice rtcDevice, const ProceduralMesh* mesh)
+        {
+            // -- Buffers are allocated by Embree so they get the padding its vector loads read past the last vertex
+            uint64 vertexCount = mesh->positions.Count();
+            uint64 triangleCount = mesh->triindices.Count() / 3;
+
+            RTCGeometry geometry = rtcNewGeometry(rtcDevice, RTC_GEOMETRY_TYPE_TRIANGLE);
+            float3* positions = (float3*)rtcSetNewGeometryBuffer(geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+                                                                 sizeof(float3), vertexCount);
+            uint32* indices = (uint32*)rtcSetNewGeometryBuffer(geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+                                                               3 * sizeof(uint32), triangleCount);
+            Memory::Copy(positions, mesh->positions.DataPointer(), mesh->positions.DataSize());
+            Memory::Copy(indices, mesh->triindices.DataPointer(), mesh->triindices.DataSize());
+            rtcCommitGeometry(geometry);
+
+            RTCScene rtcScene = rtcNewScene(rtcDevice);
+            rtcAttachGeometry(rtcScene, geometry);
+            rtcReleaseGeometry(geometry);
+            rtcCommitScene(rtcScene);
+
+            return rtcScene;
+        }
+
+        //=========================================================================================================================
+        static void BuildTerrainTexture(ProceduralTexture* texture)
+        {
+            const uint32 size = 256;
+
+            texture->name.Copy(textureName);
+            texture->format = TextureResourceData::Float3;
+            texture->width = size;
+            texture->height = size;
+
+            for(uint32 y = 0; y < size; ++y) {
+                for(uint32 x = 0; x < size; ++x) {
+                    float checker = (((x >> 3) ^ (y >> 3)) & 1) ? 0.3f : 0.0f;
+                    texture->texels.Add(0.2f + checker);
+                    texture->texels.Add(0.4f + 0.5f * (float)x / size);
+                    texture->texels.Add(0.1f + 0.5f * (float)y / size);
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static Error CreateInstancedScene(RTCDevice rtcDevice, TextureCache* textureCache, GeometryCache* geometryCache,
+                                          SceneResource* scene)
+        {
+            ProceduralMesh mesh;
+            BuildTerrainMesh(&mesh);
+
+            MaterialResourceData material;
+            material.baseColorTexture.Copy(textureName);
+            material.shader = eDisneySolid;
+            material.baseColor = float3(0.5f, 0.5f, 0.5f);
+            material.scalarAttributeValues[eRoughness] = 0.6f;
+            material.scalarAttributeValues[eSheen] = 0.2f;
+            material.scalarAttributeValues[eIor] = 1.5f;
+
+            ProceduralModel model;
+            model.name.Copy("Benchmarks~TerrainModel");
+            model.meshes.Add(&mesh);
+            model.materialHashes.Add(ProceduralMaterialHash(materialName));
+            model.materials.Add(material);
+
+            // -- Each subscene tiles four half scale copies of the terrain over [-1, 1] and the scene tiles the subscene in a
+            // -- grid so rays cross both the model and subscene instance levels.
+            ProceduralSubscene subscene;
+            subscene.name.Copy(subsceneName);
+            subscene.lightSetIndex = 0;
+            subscene.models.Add(&model);
+            for(uint scan = 0; scan < 4; ++scan) {
+                Instance& instance = subscene.modelInstances.Add();
+                instance.index = 0;
+                instance.localToWorld = Matrix4x4::ScaleTranslate(0.5f, (scan & 1) ? 0.5f : -0.5f, 0.0f,
+                                                                  (scan & 2) ? 0.5f : -0.5f);
+            }
+
+            ProceduralTexture texture;
+            BuildTerrainTexture(&texture);
+
+            ProceduralScene description;
+            description.name.Copy("Benchmarks~InstancedTerrain");
+            description.uniformIblRadiance = float3::Zero_;
+            description.iblSunDirection = float3::YAxis_;
+            description.iblSunRadiance = float3::Zero_;
+            description.iblSunAngleDegrees = 0.0f;
+            description.backgroundIntensity = float4(1.0f, 1.0f, 1.0f, 1.0f);
+            description.textures.Add(&texture);
+            description.subscenes.Add(&subscene);
+            for(uint z = 0; z < SubsceneGridSize_; ++z) {
+                for(uint x = 0; x < SubsceneGridSize_; ++x) {
+                    Instance& instance = description.subsceneInstances.Add();
+                    instance.index = 0;
+                    instance.localToWorld = Matrix4x4::ScaleTranslate(1.0f, 2.0f * x - SubsceneGridSize_ + 1.0f,
+                                                                      0.05f * ((x + z) & 3), 2.0f * z - SubsceneGridSize_ + 1.0f);
+                }
+            }
+
+            ReturnError_(CreateProceduralSceneResource(&description, scene, textureCache, geometryCache, rtcDevice));
+
+            // -- Loaded up front so traversal never pays for it
+            geometryCache->RegisterSubscenes(scene->subscenes, scene->data->subsceneNames.Count());
+            geometryCache->PreloadSubscene(subsceneName);
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        static void GenerateRays(float extent, RaySet* rays)
+        {
+            // -- Incoherent rays like the ones secondary bounces trace. They start above the surface and head down so nearly
+            // -- all of them hit something.
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+
+            rays->origins.Resize(RayCount_);
+            rays->directions.Resize(RayCount_);
+            rays->distances.Resize(RayCount_);
+            for(uint scan = 0; scan < RayCount_; ++scan) {
+                float3 origin;
+                origin.x = extent * (2.0f * sampler.UniformFloat() - 1.0f);
+                origin.y = Lerp(0.3f, 1.5f, sampler.UniformFloat());
+                origin.z = extent * (2.0f * sampler.UniformFloat() - 1.0f);
+
+                float3 direction = sampler.UniformSphere();
+                direction.y = -Math::Absf(direction.y);
+
+                rays->origins[scan] = origin;
+                rays->directions[scan] = direction;
+                rays->distances[scan] = Lerp(0.05f, 2.0f, sampler.UniformFloat());
+            }
+
+            sampler.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static void ShutdownRays(RaySet* rays)
+        {
+            rays->origins.Shutdown();
+            rays->directions.Shutdown();
+            rays->distances.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static void InitializeRayHit(const RaySet* rays, uint index, RTCRayHit& rayhit)
+        {
+            rayhit.ray.org_x = rays->origins[index].x;
+            rayhit.ray.org_y = rays->origins[index].y;
+            rayhit.ray.org_z = rays->origins[index].z;
+            rayhit.ray.dir_x = rays->directions[index].x;
+            rayhit.ray.dir_y = rays->directions[index].y;
+            rayhit.ray.dir_z = rays->directions[index].z;
+            rayhit.ray.tnear = 0.0f;
+            rayhit.ray.tfar = TraceDistance_;
+            rayhit.ray.mask = 0xFFFFFFFF;
+            rayhit.ray.time = 0.0f;
+            rayhit.ray.flags = 0;
+
+            rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+            rayhit.hit.primID = RTC_INVALID_GEOMETRY_ID;
+            rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+            rayhit.hit.instID[1] = RTC_INVALID_GEOMETRY_ID;
+        }
+
+        //=========================================================================================================================
+        static double Intersect1Benchmark(void* userData)
+        {
+            TraversalData* data = (TraversalData*)userData;
+
+            RTCIntersectContext context;
+            rtcInitIntersectContext(&context);
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < RayCount_; ++scan) {
+                Align_(16) RTCRayHit rayhit;
+                InitializeRayHit(data->rays, scan, rayhit);
+
+                rtcIntersect1(data->rtcScene, &context, &rayhit);
+
+                if(rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID) {
+                    sum += 1.0 + rayhit.ray.tfar;
+                }
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double Intersect8Benchmark(void* userData)
+        {
+            TraversalData* data = (TraversalData*)userData;
+            const RaySet* rays = data->rays;
+
+            RTCIntersectContext context;
+            rtcInitIntersectContext(&context);
+
+            double sum = 0.0;
+            for(uint packet = 0; packet < RayCount_; packet += PacketSize_) {
+                Align_(64) int32 valid[PacketSize_];
+                Align_(64) RTCRayHit8 rayhit;
+                for(uint scan = 0; scan < PacketSize_; ++scan) {
+                    rayhit.ray.org_x[scan] = rays->origins[packet + scan].x;
+                    rayhit.ray.org_y[scan] = rays->origins[packet + scan].y;
+                    rayhit.ray.org_z[scan] = rays->origins[packet + scan].z;
+                    rayhit.ray.dir_x[scan] = rays->directions[packet + scan].x;
+                    rayhit.ray.dir_y[scan] = rays->directions[packet + scan].y;
+                    rayhit.ray.dir_z[scan] = rays->directions[packet + scan].z;
+                    rayhit.ray.tnear[scan] = 0.0f;
+                    rayhit.ray.tfar[scan] = TraceDistance_;
+                    rayhit.ray.mask[scan] = 0xFFFFFFFF;
+                    rayhit.ray.time[scan] = 0.0f;
+                    rayhit.ray.flags[scan] = 0;
+
+                    rayhit.hit.geomID[scan] = RTC_INVALID_GEOMETRY_ID;
+                    rayhit.hit.primID[scan] = RTC_INVALID_GEOMETRY_ID;
+                    rayhit.hit.instID[0][scan] = RTC_INVALID_GEOMETRY_ID;
+                    rayhit.hit.instID[1][scan] = RTC_INVALID_GEOMETRY_ID;
+                    valid[scan] = -1;
+                }
+
+                rtcIntersect8(valid, data->rtcScene, &context, &rayhit);
+
+                for(uint scan = 0; scan < PacketSize_; ++scan) {
+                    if(rayhit.hit.geomID[scan] != RTC_INVALID_GEOMETRY_ID) {
+                        sum += 1.0 + rayhit.ray.tfar[scan];
+                    }
+                }
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double Occluded8Benchmark(void* userData)
+        {
+            TraversalData* data = (TraversalData*)userData;
+            const RaySet* rays = data->rays;
+
+            RTCIntersectContext context;
+            rtcInitIntersectContext(&context);
+
+            double occludedCount = 0.0;
+            for(uint packet = 0; packet < RayCount_; packet += PacketSize_) {
+                Align_(64) int32 valid[PacketSize_];
+                Align_(64) RTCRay8 ray;
+                for(uint scan = 0; scan < PacketSize_; ++scan) {
+                    ray.org_x[scan] = rays->origins[packet + scan].x;
+                    ray.org_y[scan] = rays->origins[packet + scan].y;
+                    ray.org_z[scan] = rays->origins[packet + scan].z;
+                    ray.dir_x[scan] = rays->directions[packet + scan].x;
+                    ray.dir_y[scan] = rays->directions[packet + scan].y;
+                    ray.dir_z[scan] = rays->directions[packet + scan].z;
+                    ray.tnear[scan] = 0.0f;
+                    ray.tfar[scan] = rays->distances[packet + scan];
+                    ray.mask[scan] = 0xFFFFFFFF;
+                    ray.time[scan] = 0.0f;
+                    ray.flags[scan] = 0;
+                    valid[scan] = -1;
+                }
+
+                rtcOccluded8(valid, data->rtcScene, &context, &ray);
+
+                // -- tfar == -inf when the ray is blocked
+                for(uint scan = 0; scan < PacketSize_; ++scan) {
+                    if(ray.tfar[scan] < 0.0f) {
+                        occludedCount += 1.0;
+                    }
+                }
+            }
+            return occludedCount;
+        }
+
+        //=========================================================================================================================
+        static void RunTraversal(BenchmarkRunner* runner, cpointer sceneLabel, RTCScene rtcScene, const RaySet* rays)
+        {
+            TraversalData data;
+            data.rtcScene = rtcScene;
+            data.rays = rays;
+
+            FixedString64 name;
+            FixedStringSprintf(name, "traversal.%s.intersect1", sceneLabel);
+            Benchmark_Run(runner, name.Ascii(), "ray", RayCount_, Intersect1Benchmark, nullptr, &data);
+            FixedStringSprintf(name, "traversal.%s.intersect8", sceneLabel);
+            Benchmark_Run(runner, name.Ascii(), "ray", RayCount_, Intersect8Benchmark, nullptr, &data);
+            FixedStringSprintf(name, "traversal.%s.occluded8", sceneLabel);
+            Benchmark_Run(runner, name.Ascii(), "ray", RayCount_, Occluded8Benchmark, nullptr, &data);
+        }
+
+        //=========================================================================================================================
+        static void CollectSurfaceHits(RTCScene rtcScene, const RaySet* rays, CArray<HitParameters>& hits)
+        {
+            // -- Filled in the same way the path tracers fill in their hits
+            RTCIntersectContext context;
+            rtcInitIntersectContext(&context);
+
+            hits.Reserve(SurfaceHitCount_);
+            for(uint scan = 0; scan < RayCount_ && hits.Count() < SurfaceHitCount_; ++scan) {
+                Align_(16) RTCRayHit rayhit;
+                InitializeRayHit(rays, scan, rayhit);
+
+                rtcIntersect1(rtcScene, &context, &rayhit);
+                if(rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID) {
+                    continue;
+                }
+
+                float3 direction = rays->directions[scan];
+
+                HitParameters& hit = hits.Add();
+                Memory::Zero(&hit, sizeof(hit));
+                hit.position = rays->origins[scan] + rayhit.ray.tfar * direction;
+                hit.normal = float3(rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z);
+                hit.view = -direction;
+                hit.throughput = float3::One_;
+                hit.baryCoords = float2(rayhit.hit.u, rayhit.hit.v);
+                hit.geomId = rayhit.hit.geomID;
+                hit.primId = rayhit.hit.primID;
+                hit.instId[0] = rayhit.hit.instID[0];
+                hit.instId[1] = rayhit.hit.instID[1];
+                hit.index = (uint32)scan;
+
+                const float kErr = 32.0f * 1.19209e-07f;
+                hit.error = kErr * Max(Max(Math::Absf(hit.position.x), Math::Absf(hit.position.y)),
+                                       Max(Math::Absf(hit.position.z), rayhit.ray.tfar));
+            }
+        }
+
+        //=========================================================================================================================
+        static double SurfaceParamsBenchmark(void* userData)
+        {
+            SurfaceData* data = (SurfaceData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0, count = data->hits.Count(); scan < count; ++scan) {
+                SurfaceParameters surface;
+                if(CalculateSurfaceParams(&data->context, &data->hits[scan], surface)) {
+                    sum += surface.baseColor.x + surface.baseColor.y + surface.roughness + surface.worldToTangent.r1.y;
+                }
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        Error Run(BenchmarkRunner* runner)
+        {
+            bool triangles = Benchmark_Enabled(runner, "traversal.triangles.intersect1")
+                             || Benchmark_Enabled(runner, "traversal.triangles.intersect8")
+                             || Benchmark_Enabled(runner, "traversal.triangles.occluded8");
+            bool instances = Benchmark_Enabled(runner, "traversal.instances.intersect1")
+                             || Benchmark_Enabled(runner, "traversal.instances.intersect8")
+                             || Benchmark_Enabled(runner, "traversal.instances.occluded8");
+            bool surfaces = Benchmark_Enabled(runner, "shading.calculatesurfaceparams");
+            if(triangles == false && instances == false && surfaces == false) {
+                return Success_;
+            }
+
+            // -- Embree allocates its BVHs itself so it is told the huge page policy separately, the same way the renderer does
+            RTCDevice rtcDevice = rtcNewDevice(GetHugePagePolicy() != eHugePagesDisabled ? "hugepages=1" : "hugepages=0");
+
+            if(triangles) {
+                ProceduralMesh mesh;
+                BuildTerrainMesh(&mesh);
+                RTCScene rtcScene = CreateTriangleScene(rtcDevice, &mesh);
+
+                RaySet rays;
+                GenerateRays(1.0f, &rays);
+                RunTraversal(runner, "triangles", rtcScene, &rays);
+                ShutdownRays(&rays);
+
+                rtcReleaseScene(rtcScene);
+            }
+
+            if(instances || surfaces) {
+                TextureCache textureCache;
+                GeometryCache geometryCache;
+                textureCache.Initialize(CacheSize_, CacheSize_);
+                geometryCache.Initialize(CacheSize_);
+
+                SceneResource scene;
+                Error err = CreateInstancedScene(rtcDevice, &textureCache, &geometryCache, &scene);
+
+                if(Successful_(err)) {
+                    RTCScene rtcScene = SceneRtcSceneForNode(&scene, 0);
+
+                    RaySet rays;
+                    GenerateRays((float)SubsceneGridSize_, &rays);
+                    RunTraversal(runner, "instances", rtcScene, &rays);
+
+                    if(surfaces) {
+                        SurfaceData* surfaceData = New_(SurfaceData);
+                        surfaceData->context.rtcScene      = rtcScene;
+                        surfaceData->context.scene         = &scene;
+                        surfaceData->context.geometryCache = &geometryCache;
+                        surfaceData->context.textureCache  = &textureCache;
+                        surfaceData->context.camera        = nullptr;
+                        surfaceData->context.maxPathLength = 0;
+                        surfaceData->context.sampler.Initialize(BenchmarkSeed_);
+                        CollectSurfaceHits(rtcScene, &rays, surfaceData->hits);
+
+                        Benchmark_Run(runner, "shading.calculatesurfaceparams", "hit", surfaceData->hits.Count(),
+                                      SurfaceParamsBenchmark, nullptr, surfaceData);
+
+                        surfaceData->context.sampler.Shutdown();
+                        Delete_(surfaceData);
+                    }
+
+                    ShutdownRays(&rays);
+                }
+
+                if(scene.data != nullptr) {
+                    ShutdownSceneResource(&scene, &textureCache);
+                }
+                geometryCache.Shutdown();
+                textureCache.Shutdown();
+
+                if(Failed_(err)) {
+                    rtcReleaseDevice(rtcDevice);
+                    return err;
+                }
+            }
+
+            rtcReleaseDevice(rtcDevice);
+
+            return Success_;
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+
+namespace Selas
+{
+    struct BenchmarkRunner;
+
+    namespace SceneBenchmarks
+    {
+        // -- Ray traversal of a single triangle mesh and of a procedural scene that instances it through both levels of the scene
+        // -- hierarchy, and CalculateSurfaceParams on the hits found in the latter.
+        Error Run(BenchmarkRunner* runner);
+    }
+}
@@ -0,0 +1,404 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ShadingBenchmarks.h"
+#include "Benchmark.h"
+
+#include "BuildCommon/BuildImageBasedLight.h"
+#include "BuildCommon/BuildTexture.h"
+#include "Shading/Disney.h"
+#include "Shading/Scattering.h"
+#include "Shading/SurfaceParameters.h"
+#include "SceneLib/ImageBasedLightResource.h"
+#include "TextureLib/TextureFiltering.h"
+#include "TextureLib/TextureResource.h"
+#include "GeometryLib/CoordinateSystem.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Projection.h"
+#include "MathLib/Sampler.h"
+#include "MathLib/Trigonometric.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/BasicTypes.h"
+
+#define SurfaceCount_       64
+#define BsdfQueryCount_     (1 << 16)
+#define TextureSize_        1024
+#define TextureQueryCount_  (1 << 18)
+#define IblWidth_           1024
+#define IblHeight_          512
+#define IblQueryCount_      (1 << 18)
+#define BenchmarkSeed_      0x5E1A5
+
+namespace Selas
+{
+    namespace ShadingBenchmarks
+    {
+        //=========================================================================================================================
+        struct BsdfData
+        {
+            SurfaceParameters surfaces[SurfaceCount_];
+            CArray<float3> views;
+            CArray<float3> lights;
+            CSampler sampler;
+        };
+
+        //=========================================================================================================================
+        struct TextureData
+        {
+            TextureResourceData texture;
+            CArray<float2> sts;
+            CArray<float2> dst0s;
+            CArray<float2> dst1s;
+        };
+
+        //=========================================================================================================================
+        struct IblData
+        {
+            ImageBasedLightResourceData ibl;
+            CArray<float2> randoms;
+            CArray<float3> directions;
+        };
+
+        //=========================================================================================================================
+        static float3 RandomColor(CSampler* sampler)
+        {
+            return float3(sampler->UniformFloat(), sampler->UniformFloat(), sampler->UniformFloat());
+        }
+
+        //=========================================================================================================================
+        static void InitializeBsdfData(BsdfData* data)
+        {
+            data->sampler.Initialize(BenchmarkSeed_);
+            CSampler* sampler = &data->sampler;
+
+            // -- Every lobe gets exercised with half of the surfaces thin and the other half solid
+            for(uint scan = 0; scan < SurfaceCount_; ++scan) {
+                SurfaceParameters& surface = data->surfaces[scan];
+                Memory::Zero(&surface, sizeof(surface));
+
+                float3 n = sampler->UniformSphere();
+                float3 t, b;
+                MakeOrthogonalCoordinateSystem(n, &t, &b);
+                surface.worldToTangent = MatrixTranspose(MakeFloat3x3(t, n, b));
+
+                surface.baseColor          = RandomColor(sampler);
+                surface.transmittanceColor = RandomColor(sampler);
+                surface.sheen              = sampler->UniformFloat();
+                surface.sheenTint          = sampler->UniformFloat();
+                surface.clearcoat          = sampler->UniformFloat();
+                surface.clearcoatGloss     = sampler->UniformFloat();
+                surface.metallic           = (scan & 3) == 0 ? 1.0f : sampler->UniformFloat() * 0.5f;
+                surface.specTrans          = (scan & 3) == 1 ? sampler->UniformFloat() : 0.0f;
+                surface.diffTrans          = (scan & 3) == 2 ? sampler->UniformFloat() : 0.0f;
+                surface.flatness           = sampler->UniformFloat();
+                surface.anisotropic        = sampler->UniformFloat();
+                surface.specularTint       = sampler->UniformFloat();
+                surface.roughness          = Lerp(0.05f, 1.0f, sampler->UniformFloat());
+                surface.ior                = 1.5f;
+                surface.relativeIOR        = 1.0f / surface.ior;
+                surface.shader             = (scan & 1) ? eDisneySolid : eDisneyThin;
+            }
+
+            // -- Views are kept above the surface while lights cover the whole sphere so transmission is evaluated too
+            data->views.Resize(BsdfQueryCount_);
+            data->lights.Resize(BsdfQueryCount_);
+            for(uint scan = 0; scan < BsdfQueryCount_; ++scan) {
+                const SurfaceParameters& surface = data->surfaces[scan % SurfaceCount_];
+                float3 n = GeometricNormal(surface);
+
+                float3 v = sampler->UniformSphere();
+                data->views[scan] = Dot(v, n) < 0.0f ? -v : v;
+                data->lights[scan] = sampler->UniformSphere();
+            }
+        }
+
+        //=========================================================================================================================
+        static void ShutdownBsdfData(BsdfData* data)
+        {
+            data->sampler.Shutdown();
+            data->views.Shutdown();
+            data->lights.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static double EvaluateDisneyBenchmark(void* userData)
+        {
+            BsdfData* data = (BsdfData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < BsdfQueryCount_; ++scan) {
+                const SurfaceParameters& surface = data->surfaces[scan % SurfaceCount_];
+
+                float forwardPdf;
+                float reversePdf;
+                float3 reflectance = EvaluateDisney(surface, data->views[scan], data->lights[scan], surface.shader == eDisneyThin,
+                                                    forwardPdf, reversePdf);
+                sum += reflectance.x + reflectance.y + reflectance.z + forwardPdf + reversePdf;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double SampleDisneyBenchmark(void* userData)
+        {
+            BsdfData* data = (BsdfData*)userData;
+            data->sampler.Reseed(BenchmarkSeed_);
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < BsdfQueryCount_; ++scan) {
+                const SurfaceParameters& surface = data->surfaces[scan % SurfaceCount_];
+
+                BsdfSample sample;
+                if(SampleDisney(&data->sampler, surface, data->views[scan], surface.shader == eDisneyThin, sample)) {
+                    sum += sample.reflectance.x + sample.reflectance.y + sample.reflectance.z + sample.forwardPdfW
+                         + sample.wi.x;
+                }
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static Error InitializeTextureData(TextureData* data)
+        {
+            // -- Smooth bands with a checker on top so neighboring texels and mips differ
+            CArray<float3> texels;
+            texels.Resize(TextureSize_ * TextureSize_);
+            for(uint y = 0; y < TextureSize_; ++y) {
+                for(uint x = 0; x < TextureSize_; ++x) {
+                    float s = (float)x / TextureSize_;
+                    float t = (float)y / TextureSize_;
+                    float checker = (((x >> 4) ^ (y >> 4)) & 1) ? 0.25f : 0.0f;
+                    texels[y * TextureSize_ + x] = float3(0.5f + 0.5f * Math::Sinf(Math::TwoPi_ * 3.0f * s) + checker,
+                                                          0.5f + 0.5f * Math::Cosf(Math::TwoPi_ * 5.0f * t),
+                                                          checker + s * t);
+                }
+            }
+
+            Memory::Zero(&data->texture, sizeof(data->texture));
+            ReturnError_(BuildFloat3Texture(Box, texels.DataPointer(), TextureSize_, TextureSize_, &data->texture));
+
+            // -- Footprints range from a fraction of a texel to a sixteenth of the texture and are up to 8:1 anisotropic
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+
+            data->sts.Resize(TextureQueryCount_);
+            data->dst0s.Resize(TextureQueryCount_);
+            data->dst1s.Resize(TextureQueryCount_);
+            for(uint scan = 0; scan < TextureQueryCount_; ++scan) {
+                float major = Math::Powf(2.0f, Lerp(-11.0f, -4.0f, sampler.UniformFloat()));
+                float minor = major * Lerp(0.125f, 1.0f, sampler.UniformFloat());
+                float angle = Math::TwoPi_ * sampler.UniformFloat();
+                float c = Math::Cosf(angle);
+                float s = Math::Sinf(angle);
+
+                data->sts[scan]   = float2(sampler.UniformFloat(), sampler.UniformFloat());
+                data->dst0s[scan] = float2(c * major, s * major);
+                data->dst1s[scan] = float2(-s * minor, c * minor);
+            }
+
+            sampler.Shutdown();
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        static void ShutdownTextureData(TextureData* data)
+        {
+            Free_(data->texture.texture);
+            data->sts.Shutdown();
+            data->dst0s.Shutdown();
+            data->dst1s.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static double TexturePointBenchmark(void* userData)
+        {
+            TextureData* data = (TextureData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < TextureQueryCount_; ++scan) {
+                float3 sample;
+                TextureFiltering::Point(&data->texture, data->sts[scan], sample);
+                sum += sample.x + sample.y + sample.z;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double TextureBilinearBenchmark(void* userData)
+        {
+            TextureData* data = (TextureData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < TextureQueryCount_; ++scan) {
+                float3 sample;
+                TextureFiltering::Triangle(&data->texture, 0, data->sts[scan], sample);
+                sum += sample.x + sample.y + sample.z;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double TextureTrilinearBenchmark(void* userData)
+        {
+            TextureData* data = (TextureData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < TextureQueryCount_; ++scan) {
+                float3 sample;
+                TextureFiltering::Trilinear(&data->texture, data->sts[scan], data->dst0s[scan], data->dst1s[scan], sample);
+                sum += sample.x + sample.y + sample.z;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double TextureEwaBenchmark(void* userData)
+        {
+            TextureData* data = (TextureData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < TextureQueryCount_; ++scan) {
+                float3 sample;
+                TextureFiltering::EWA(&data->texture, data->sts[scan], data->dst0s[scan], data->dst1s[scan], sample);
+                sum += sample.x + sample.y + sample.z;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static void InitializeIblData(IblData* data)
+        {
+            // -- A dim sky with a small, very bright sun so the sampling functions are as peaked as they are for real skies
+            float3 sun = Math::SphericalToCartesian(0.3f * Math::Pi_, 1.1f);
+
+            float3* lightData = AllocArray_(float3, IblWidth_ * IblHeight_);
+            for(uint y = 0; y < IblHeight_; ++y) {
+                float theta = (y + 0.5f) * Math::Pi_ / IblHeight_;
+                for(uint x = 0; x < IblWidth_; ++x) {
+                    float phi = (x + 0.5f) * Math::TwoPi_ / IblWidth_ - Math::Pi_;
+                    float3 direction = Math::SphericalToCartesian(theta, phi);
+
+                    float sky = 0.2f + 0.8f * Math::Absf(Math::Cosf(theta));
+                    float sunIntensity = Dot(direction, sun) > 0.9995f ? 50000.0f : 0.0f;
+                    lightData[y * IblWidth_ + x] = float3(0.4f, 0.6f, 1.0f) * sky + float3(sunIntensity);
+                }
+            }
+
+            data->ibl.lightData       = lightData;
+            data->ibl.missData        = nullptr;
+            data->ibl.missWidth       = 0;
+            data->ibl.missHeight      = 0;
+            data->ibl.rotationRadians = 0.0f;
+            data->ibl.exposureScale   = 1.0f;
+            BuildIblDensityFunctions(IblWidth_, IblHeight_, lightData, &data->ibl.densityfunctions);
+
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+
+            data->randoms.Resize(IblQueryCount_);
+            data->directions.Resize(IblQueryCount_);
+            for(uint scan = 0; scan < IblQueryCount_; ++scan) {
+                data->randoms[scan] = float2(sampler.UniformFloat(), sampler.UniformFloat());
+                data->directions[scan] = sampler.UniformSphere();
+            }
+
+            sampler.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static void ShutdownIblData(IblData* data)
+        {
+            ShutdownDensityFunctions(&data->ibl.densityfunctions);
+            Free_(data->ibl.lightData);
+            data->randoms.Shutdown();
+            data->directions.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static double IblSampleBenchmark(void* userData)
+        {
+            IblData* data = (IblData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < IblQueryCount_; ++scan) {
+                float theta;
+                float phi;
+                uint x;
+                uint y;
+                float pdf;
+                Ibl(&data->ibl, data->randoms[scan].x, data->randoms[scan].y, theta, phi, x, y, pdf);
+                float3 radiance = SampleIbl(&data->ibl, x, y);
+
+                sum += theta + phi + pdf + radiance.x;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double IblEvaluateBenchmark(void* userData)
+        {
+            IblData* data = (IblData*)userData;
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < IblQueryCount_; ++scan) {
+                float pdf;
+                float3 radiance = SampleIbl(&data->ibl, data->directions[scan], pdf);
+
+                sum += pdf + radiance.x;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        Error Run(BenchmarkRunner* runner)
+        {
+            bool bsdfs = Benchmark_Enabled(runner, "bsdf.disney.evaluate") || Benchmark_Enabled(runner, "bsdf.disney.sample");
+            if(bsdfs) {
+                BsdfData* bsdfData = New_(BsdfData);
+                InitializeBsdfData(bsdfData);
+
+                Benchmark_Run(runner, "bsdf.disney.evaluate", "evaluation", BsdfQueryCount_, EvaluateDisneyBenchmark, nullptr,
+                              bsdfData);
+                Benchmark_Run(runner, "bsdf.disney.sample", "sample", BsdfQueryCount_, SampleDisneyBenchmark, nullptr, bsdfData);
+
+                ShutdownBsdfData(bsdfData);
+                Delete_(bsdfData);
+            }
+
+            bool textures = Benchmark_Enabled(runner, "texture.point") || Benchmark_Enabled(runner, "texture.bilinear")
+                            || Benchmark_Enabled(runner, "texture.trilinear") || Benchmark_Enabled(runner, "texture.ewa");
+            if(textures) {
+                TextureData textureData;
+                ReturnError_(InitializeTextureData(&textureData));
+
+                Benchmark_Run(runner, "texture.point", "lookup", TextureQueryCount_, TexturePointBenchmark, nullptr,
+                              &textureData);
+                Benchmark_Run(runner, "texture.bilinear", "lookup", TextureQueryCount_, TextureBilinearBenchmark, nullptr,
+                              &textureData);
+                Benchmark_Run(runner, "texture.trilinear", "lookup", TextureQueryCount_, TextureTrilinearBenchmark, nullptr,
+                              &textureData);
+                Benchmark_Run(runner, "texture.ewa", "lookup", TextureQueryCount_, TextureEwaBenchmark, nullptr, &textureData);
+
+                ShutdownTextureData(&textureData);
+            }
+
+            bool ibls = Benchmark_Enabled(runner, "ibl.sample") || Benchmark_Enabled(runner, "ibl.evaluate");
+            if(ibls) {
+                IblData iblData;
+                InitializeIblData(&iblData);
+
+                Benchmark_Run(runner, "ibl.sample", "sample", IblQueryCount_, IblSampleBenchmark, nullptr, &iblData);
+                Benchmark_Run(runner, "ibl.evaluate", "evaluation", IblQueryCount_, IblEvaluateBenchmark, nullptr, &iblData);
+
+                ShutdownIblData(&iblData);
+            }
+
+            return Success_;
+        }
+    }
+}
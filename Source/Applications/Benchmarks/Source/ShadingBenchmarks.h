@@ -0,0 +1,18 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+
+namespace Selas
+{
+    struct BenchmarkRunner;
+
+    namespace ShadingBenchmarks
+    {
+        // -- Disney BSDF evaluation and sampling, texture filtering and image based light sampling against procedural inputs
+        Error Run(BenchmarkRunner* runner);
+    }
+}
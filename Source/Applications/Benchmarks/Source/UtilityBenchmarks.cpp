@@ -0,0 +1,257 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "UtilityBenchmarks.h"
+#include "Benchmark.h"
+
+#include "UtilityLib/QuickSort.h"
+#include "UtilityLib/RadixSort.h"
+#include "MathLib/Sampler.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/BasicTypes.h"
+
+#define SortElementCount_   (1 << 20)
+#define SamplerDrawCount_   (1 << 22)
+#define RadixSortThreads_   8
+// -- 256MB, far more pages than a TLB covers at 4KB but only 128 at 2MB
+#define ChaseElementCount_  (1 << 26)
+#define ChaseReadCount_     (1 << 22)
+#define BenchmarkSeed_      0x5E1A5
+
+namespace Selas
+{
+    namespace UtilityBenchmarks
+    {
+        //=========================================================================================================================
+        struct SortData
+        {
+            CArray<uint32> sourceKeys;
+            CArray<float>  sourceFloatKeys;
+            CArray<uint32> keys;
+            CArray<float>  floatKeys;
+            CArray<uint32> values;
+        };
+
+        //=========================================================================================================================
+        static void InitializeSortData(SortData* data)
+        {
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+
+            data->sourceKeys.Resize(SortElementCount_);
+            data->sourceFloatKeys.Resize(SortElementCount_);
+            for(uint scan = 0; scan < SortElementCount_; ++scan) {
+                data->sourceKeys[scan] = sampler.UniformUInt32();
+                data->sourceFloatKeys[scan] = sampler.UniformFloat();
+            }
+
+            data->keys.Resize(SortElementCount_);
+            data->floatKeys.Resize(SortElementCount_);
+            data->values.Resize(SortElementCount_);
+
+            sampler.Shutdown();
+        }
+
+        //=========================================================================================================================
+        static double SortChecksum(const uint32* values)
+        {
+            // -- Position weighted so a wrong order changes the result
+            double checksum = 0.0;
+            for(uint scan = 0; scan < SortElementCount_; scan += 1024) {
+                checksum += (double)values[scan] * (scan + 1);
+            }
+            return checksum;
+        }
+
+        //=========================================================================================================================
+        static void PrepareQuickSort(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            Memory::Copy(data->keys.DataPointer(), data->sourceKeys.DataPointer(), data->sourceKeys.DataSize());
+        }
+
+        //=========================================================================================================================
+        static double QuickSortUInt32(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            QuickSort(data->keys.DataPointer(), data->keys.Count());
+            return SortChecksum(data->keys.DataPointer());
+        }
+
+        //=========================================================================================================================
+        static void PrepareQuickSortMatchingArrays(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            Memory::Copy(data->floatKeys.DataPointer(), data->sourceFloatKeys.DataPointer(), data->sourceFloatKeys.DataSize());
+            for(uint32 scan = 0; scan < SortElementCount_; ++scan) {
+                data->values[scan] = scan;
+            }
+        }
+
+        //=========================================================================================================================
+        static double QuickSortMatchingArraysFloat(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            QuickSortMatchingArrays(data->floatKeys.DataPointer(), data->values.DataPointer(), data->floatKeys.Count());
+            return SortChecksum(data->values.DataPointer());
+        }
+
+        //=========================================================================================================================
+        static double RadixSortUInt32(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            RadixSort(data->keys.DataPointer(), nullptr, data->keys.Count(), 1);
+            return SortChecksum(data->keys.DataPointer());
+        }
+
+        //=========================================================================================================================
+        static double RadixSortUInt32Threaded(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            RadixSort(data->keys.DataPointer(), nullptr, data->keys.Count(), RadixSortThreads_);
+            return SortChecksum(data->keys.DataPointer());
+        }
+
+        //=========================================================================================================================
+        static void PrepareRadixSortMatchingArrays(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            for(uint32 scan = 0; scan < SortElementCount_; ++scan) {
+                data->keys[scan] = RadixSortableFloat(data->sourceFloatKeys[scan]);
+                data->values[scan] = scan;
+            }
+        }
+
+        //=========================================================================================================================
+        static double RadixSortMatchingArraysFloat(void* userData)
+        {
+            SortData* data = (SortData*)userData;
+            RadixSort(data->keys.DataPointer(), data->values.DataPointer(), data->keys.Count(), 1);
+            return SortChecksum(data->values.DataPointer());
+        }
+
+        //=========================================================================================================================
+        static uint32* CreateRandomCycle(uint32 count)
+        {
+            // -- Sattolo's shuffle gives a single cycle through every element so a chase never settles into a short loop
+            uint32* next = AllocArray_(uint32, count);
+            for(uint32 scan = 0; scan < count; ++scan) {
+                next[scan] = scan;
+            }
+
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+            for(uint32 scan = count - 1; scan > 0; --scan) {
+                uint32 other = sampler.UniformUInt32() % scan;
+                uint32 swap = next[scan];
+                next[scan] = next[other];
+                next[other] = swap;
+            }
+            sampler.Shutdown();
+
+            return next;
+        }
+
+        //=========================================================================================================================
+        static double MemoryRandomRead(void* userData)
+        {
+            // -- Each read depends on the last so this measures load latency, which is dominated by TLB misses without huge
+            // -- pages. It stands in for BVH and texture fetches when huge page policies are compared.
+            const uint32* next = (const uint32*)userData;
+
+            uint32 index = 0;
+            uint64 sum = 0;
+            for(uint scan = 0; scan < ChaseReadCount_; ++scan) {
+                index = next[index];
+                sum += index;
+            }
+            return (double)sum;
+        }
+
+        //=========================================================================================================================
+        static double SamplerUniformFloat(void* userData)
+        {
+            CSampler* sampler = (CSampler*)userData;
+            sampler->Reseed(BenchmarkSeed_);
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < SamplerDrawCount_; ++scan) {
+                sum += sampler->UniformFloat();
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        static double SamplerUniformUInt32(void* userData)
+        {
+            CSampler* sampler = (CSampler*)userData;
+            sampler->Reseed(BenchmarkSeed_);
+
+            uint64 sum = 0;
+            for(uint scan = 0; scan < SamplerDrawCount_; ++scan) {
+                sum += sampler->UniformUInt32();
+            }
+            return (double)sum;
+        }
+
+        //=========================================================================================================================
+        static double SamplerUniformSphere(void* userData)
+        {
+            CSampler* sampler = (CSampler*)userData;
+            sampler->Reseed(BenchmarkSeed_);
+
+            double sum = 0.0;
+            for(uint scan = 0; scan < SamplerDrawCount_; ++scan) {
+                float3 direction = sampler->UniformSphere();
+                sum += direction.x + 2.0 * direction.y + 3.0 * direction.z;
+            }
+            return sum;
+        }
+
+        //=========================================================================================================================
+        void Run(BenchmarkRunner* runner)
+        {
+            bool sorting = Benchmark_Enabled(runner, "sort.quicksort.uint32")
+                           || Benchmark_Enabled(runner, "sort.quicksortmatchingarrays.float")
+                           || Benchmark_Enabled(runner, "sort.radixsort.uint32")
+                           || Benchmark_Enabled(runner, "sort.radixsort.uint32.threaded")
+                           || Benchmark_Enabled(runner, "sort.radixsortmatchingarrays.float");
+            if(sorting) {
+                SortData sortData;
+                InitializeSortData(&sortData);
+
+                Benchmark_Run(runner, "sort.quicksort.uint32", "element", SortElementCount_, QuickSortUInt32,
+                              PrepareQuickSort, &sortData);
+                Benchmark_Run(runner, "sort.quicksortmatchingarrays.float", "element", SortElementCount_,
+                              QuickSortMatchingArraysFloat, PrepareQuickSortMatchingArrays, &sortData);
+
+                // -- Same inputs as the QuickSort runs so the key checksums match theirs
+                Benchmark_Run(runner, "sort.radixsort.uint32", "element", SortElementCount_, RadixSortUInt32, PrepareQuickSort,
+                              &sortData);
+                Benchmark_Run(runner, "sort.radixsort.uint32.threaded", "element", SortElementCount_, RadixSortUInt32Threaded,
+                              PrepareQuickSort, &sortData);
+                Benchmark_Run(runner, "sort.radixsortmatchingarrays.float", "element", SortElementCount_,
+                              RadixSortMatchingArraysFloat, PrepareRadixSortMatchingArrays, &sortData);
+            }
+
+            if(Benchmark_Enabled(runner, "memory.randomread")) {
+                uint32* next = CreateRandomCycle(ChaseElementCount_);
+                Benchmark_Run(runner, "memory.randomread", "read", ChaseReadCount_, MemoryRandomRead, nullptr, next);
+                Free_(next);
+            }
+
+            CSampler sampler;
+            sampler.Initialize(BenchmarkSeed_);
+
+            Benchmark_Run(runner, "sampler.uniformfloat", "sample", SamplerDrawCount_, SamplerUniformFloat, nullptr, &sampler);
+            Benchmark_Run(runner, "sampler.uniformuint32", "sample", SamplerDrawCount_, SamplerUniformUInt32, nullptr, &sampler);
+            Benchmark_Run(runner, "sampler.uniformsphere", "sample", SamplerDrawCount_, SamplerUniformSphere, nullptr, &sampler);
+
+            sampler.Shutdown();
+        }
+    }
+}
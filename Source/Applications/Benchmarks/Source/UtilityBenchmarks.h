@@ -0,0 +1,17 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+namespace Selas
+{
+    struct BenchmarkRunner;
+
+    namespace UtilityBenchmarks
+    {
+        // -- QuickSort against RadixSort on the same inputs, random read latency over a buffer far larger than the TLB covers,
+        // -- and CSampler throughput
+        void Run(BenchmarkRunner* runner);
+    }
+}
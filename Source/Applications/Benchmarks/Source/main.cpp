@@ -0,0 +1,135 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+#include "ContainerBenchmarks.h"
+#include "FramebufferBenchmarks.h"
+#include "SceneBenchmarks.h"
+#include "ShadingBenchmarks.h"
+#include "UtilityBenchmarks.h"
+
+#include "TextureLib/TextureFiltering.h"
+#include "IoLib/Environment.h"
+#include "StringLib/StringTable.h"
+#include "StringLib/StringUtil.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/BasicTypes.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Logging.h"
+
+#include "xmmintrin.h"
+#include "pmmintrin.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Selas;
+
+//=================================================================================================================================
+static cpointer FindArgumentValue(int argc, char *argv[], cpointer name)
+{
+    for(int scan = 1; scan + 1 < argc; ++scan) {
+        if(StringUtil::EqualsIgnoreCase(argv[scan], name)) {
+            return argv[scan + 1];
+        }
+    }
+
+    return nullptr;
+}
+
+//=================================================================================================================================
+static void FindBenchmarkSettings(int argc, char *argv[], BenchmarkSettings& settings)
+{
+    Benchmark_DefaultSettings(&settings);
+
+    // -- -filter <text>. Only runs benchmarks with the text in their name.
+    settings.filter = FindArgumentValue(argc, argv, "-filter");
+
+    // -- -mintime <seconds>. Minimum time spent timing each benchmark.
+    cpointer value = FindArgumentValue(argc, argv, "-mintime");
+    if(value != nullptr && atof(value) > 0.0) {
+        settings.minSeconds = (float)atof(value);
+    }
+
+    // -- -repetitions <count>. Minimum number of timed repetitions of each benchmark.
+    value = FindArgumentValue(argc, argv, "-repetitions");
+    if(value != nullptr && atoi(value) > 0) {
+        settings.minRepetitions = (Selas::uint)atoi(value);
+        settings.maxRepetitions = Max<Selas::uint>(settings.maxRepetitions, settings.minRepetitions);
+    }
+}
+
+//=================================================================================================================================
+static bool FindHugePagePolicy(int argc, char *argv[], HugePagePolicy& policy)
+{
+    // -- -hugepages off|transparent|explicit. Run the benchmarks once with each to compare traversal and shading throughput.
+    policy = GetHugePagePolicy();
+
+    cpointer value = FindArgumentValue(argc, argv, "-hugepages");
+    if(value == nullptr) {
+        return true;
+    }
+
+    if(StringUtil::EqualsIgnoreCase(value, "off")) {
+        policy = eHugePagesDisabled;
+        return true;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "transparent")) {
+        policy = eHugePagesTransparent;
+        return true;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "explicit")) {
+        policy = eHugePagesExplicit;
+        return true;
+    }
+
+    printf("Unknown -hugepages value '%s'. Expected off, transparent or explicit.\n", value);
+    return false;
+}
+
+//=================================================================================================================================
+int main(int argc, char *argv[])
+{
+    // -- Matches the renderer so shading runs down the same paths
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+    // -- Set before anything large is allocated so every fixture picks it up
+    HugePagePolicy hugePagePolicy;
+    if(FindHugePagePolicy(argc, argv, hugePagePolicy) == false) {
+        return -1;
+    }
+    SetHugePagePolicy(hugePagePolicy);
+
+    Environment_Initialize(ProjectRootName_, argv[0]);
+    PathStringTable_Initialize();
+    TextureFiltering::InitializeEWAFilterWeights();
+
+    BenchmarkSettings settings;
+    FindBenchmarkSettings(argc, argv, settings);
+
+    // -- -output <file.json>
+    cpointer outputFilepath = FindArgumentValue(argc, argv, "-output");
+    if(outputFilepath == nullptr) {
+        outputFilepath = "Benchmarks.json";
+    }
+
+    BenchmarkRunner runner;
+    Benchmark_Initialize(&runner, settings);
+
+    UtilityBenchmarks::Run(&runner);
+    ExitMainOnError_(ContainerBenchmarks::Run(&runner));
+    ExitMainOnError_(FramebufferBenchmarks::Run(&runner));
+    ExitMainOnError_(ShadingBenchmarks::Run(&runner));
+    ExitMainOnError_(SceneBenchmarks::Run(&runner));
+
+    ExitMainOnError_(Benchmark_WriteJson(&runner, outputFilepath));
+    WriteDebugInfo_("Wrote %llu benchmark results to %s", runner.results.Count(), outputFilepath);
+
+    Benchmark_Shutdown(&runner);
+    PathStringTable_Shutdown();
+
+    return 0;
+}
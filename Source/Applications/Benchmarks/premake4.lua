@@ -0,0 +1,19 @@
+
+dofile("../../../ProjectGen/common.lua")
+
+local SolutionName = "Benchmarks"
+local Architecture = "x64"
+local ExtraLibraries = { "SceneLib", "TextureLib", "GeometryLib", "Shading", "BuildCore", "BuildCommon" }
+
+if _ARGS[1] == "osx" then
+	ExtraDefines = { "IsOsx_=1" }
+	Platform = "osx"
+elseif _ARGS[1] == "linux" then
+	ExtraDefines = { "IsLinux_=1" }
+	Platform = "linux"
+else
+	ExtraDefines = { "IsWindows_=1" }
+	Platform = "Win64"
+end
+
+SetupConsoleApplication(SolutionName, Architecture, Platform, ExtraDefines, ExtraLibraries)
\ No newline at end of file
@@ -12,6 +12,10 @@
 #include "Shading/IntegratorContexts.h"
 #include "Shading/AreaLighting.h"
 #include "Shading/PathTracingBatcher.h"
+#include "TextureLib/Framebuffer.h"
+#include "TextureLib/AovImage.h"
+#include "TextureLib/AovDenoiser.h"
+#include "TextureLib/FramebufferPreview.h"
 #include "GeometryLib/Camera.h"
 #include "GeometryLib/Ray.h"
 #include "MathLib/FloatFuncs.h"
@@ -21,25 +25,31 @@
 #include "MathLib/Random.h"
 #include "ThreadingLib/Thread.h"
 #include "SystemLib/OSThreading.h"
+#include "SystemLib/ArenaAllocator.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/MemoryGovernor.h"
+#include "SystemLib/PerfCounters.h"
+#include "SystemLib/NumaTopology.h"
 #include "SystemLib/Memory.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/MinMax.h"
 #include "SystemLib/SystemTime.h"
 #include "SystemLib/Logging.h"
+#include "SystemLib/Profiling.h"
 #include "SystemLib/CountOf.h"
 
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
 
-#define RayBatchSize_         1 Mb_
-#define HitBatchSize_         512 Kb_
+#define RayBatchSize_          1 Mb_
+#define HitBatchSize_          512 Kb_
 
-#define WorkerThreadCount_    15
-#define SamplesPerPixelX_     2
-#define SamplesPerPixelY_     2
-#define OutputLayers_         1
+#define WorkerThreadCount_     15
+#define OutputPixelType_       eExrPixelHalf
+#define DenoiseOutput_         1
+#define PreviewExposure_       1.0f
+#define PreviewDenoiseThreads_ 1
 
 namespace Selas
 {
@@ -49,14 +59,63 @@ namespace Selas
         {
             const RayCastCameraSettings* camera;
             PathTracingBatcher*          ptBatcher;
+            // -- The frame covers the image region starting at regionX, regionY; the whole image unless rendering tiles.
             Framebuffer*                 frame;
+            uint32                       regionX;
+            uint32                       regionY;
             volatile int64               kernelCounter;
             volatile int64               pixelIndex;
             const SceneResource*         scene;
             GeometryCache*               geometryCache;
             TextureCache*                textureCache;
+            uint32                       samplesPerPixelX;
+            uint32                       samplesPerPixelY;
+
+            void*                        statsLock;
+            float                        transientAllocationUs;
+            uint64                       transientHighWaterMark;
+            uint64                       transientFallbackCount;
+
+            // -- Throughput per phase so allocator and page size changes can be compared. Deferred rays include shading of the
+            // -- hits they find.
+            float                        occlusionUs;
+            float                        deferredUs;
+            float                        shadingUs;
+            uint64                       occlusionRayCount;
+            uint64                       deferredRayCount;
+            uint64                       shadedHitCount;
+
+            // -- Private framebuffer tiles the workers allocated. Each is added into the frame once after the workers join.
+            uint64                       framebufferPrivateTileCount;
+
+            // -- Wall clock time spent in RenderFrame and how the workers were spread over NUMA nodes, so runs with and
+            // -- without scene replication can be compared.
+            float                        renderMs;
+            uint64                       numaNodeWorkerCounts[MaxNumaNodes_];
+
+            // -- Summed over the workers; only filled in when the counters are enabled
+            PerfPhaseCounters            perfCounters;
         };
 
+        struct KernelPhaseTimers
+        {
+            std::chrono::duration<float, std::micro> occlusion;
+            std::chrono::duration<float, std::micro> deferred;
+            std::chrono::duration<float, std::micro> shading;
+            uint64 occlusionRayCount;
+            uint64 deferredRayCount;
+            uint64 shadedHitCount;
+        };
+
+        //=========================================================================================================================
+        static void WriteRadiance(GIIntegratorContext* __restrict context, float3 radiance, uint32 index, uint32 oddSample)
+        {
+            FramebufferWriter_WriteLayer(&context->frameWriter, radiance, eAovLayerBeauty, index);
+            if(oddSample) {
+                FramebufferWriter_WriteLayer(&context->frameWriter, radiance, eAovLayerBeautyOdd, index);
+            }
+        }
+
         //=========================================================================================================================
         static void ShadeHitPosition(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
                                      const HitParameters& hit)
@@ -66,6 +125,11 @@ namespace Selas
                 return;
             }
 
+            if(hit.trackedBounces == 0) {
+                FramebufferWriter_WriteLayer(&context->frameWriter, surface.baseColor, eAovLayerAlbedo, hit.index);
+                FramebufferWriter_WriteLayer(&context->frameWriter, GeometricNormal(surface), eAovLayerNormal, hit.index);
+            }
+
             // -- choose a light and sample the light source
             LightDirectSample lightSample;
             NextEventEstimation(context, surface.lightSetIndex, hit.position, GeometricNormal(surface), lightSample);
@@ -85,6 +149,7 @@ namespace Selas
                     occlusionRay.ray = MakeRay(offset, lightSample.direction);
                     occlusionRay.distance = lightSample.distance;
                     occlusionRay.index = hit.index;
+                    occlusionRay.oddSample = hit.oddSample;
                     occlusionRay.value = sample * hit.throughput;
                     ptBatcher->AddUnsortedOcclusionRay(occlusionRay);
                 }
@@ -107,6 +172,7 @@ namespace Selas
                     occlusionRay.ray = MakeRay(offset, skySample.direction);
                     occlusionRay.distance = skySample.distance;
                     occlusionRay.index = hit.index;
+                    occlusionRay.oddSample = hit.oddSample;
                     occlusionRay.value = sample * hit.throughput;
                     ptBatcher->AddUnsortedOcclusionRay(occlusionRay);
                 }
@@ -142,6 +208,7 @@ namespace Selas
                 DeferredRay bounceRay;
                 bounceRay.error = hit.error;
                 bounceRay.index = hit.index;
+                bounceRay.oddSample = hit.oddSample;
                 bounceRay.diracScatterOnly = hit.diracScatterOnly && bsdfSample.flags & SurfaceEventFlags::eDiracEvent;
                 bounceRay.ray = MakeRay(offsetOrigin, bsdfSample.wi);
                 bounceRay.throughput = throughput;
@@ -154,6 +221,8 @@ namespace Selas
         static void TraceRayBatch(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
                                   DeferredRay* rays, uint rayCount)
         {
+            ProfileEventMarker_(0, "TraceRayBatch");
+
             #define BatchSize_ 8
             uint batchCount = (rayCount + BatchSize_ - 1) / BatchSize_;
 
@@ -190,12 +259,12 @@ namespace Selas
                     valid[scan] = 0;
                 }
 
-                rtcIntersect8(valid, context->rtcScene, &rtcContext, &rayhit);
+                {
+                    PerfPhaseScope_(ePerfPhaseTraversal);
+                    rtcIntersect8(valid, context->rtcScene, &rtcContext, &rayhit);
+                }
 
                 for(uint scan = 0; scan < BatchSize_; ++scan) {
-                    float3 Ld[OutputLayers_];
-                    Memory::Zero(Ld, sizeof(Ld));
-
                     if(valid[scan] == 0 || rayhit.hit.geomID[scan] == RTC_INVALID_GEOMETRY_ID) {
 
                         float3 sample;
@@ -204,11 +273,16 @@ namespace Selas
                         else
                             sample = EvaluateBackground(context, startRay[scan].ray.direction);
 
-                        Ld[0] += sample * startRay[scan].throughput;
-                        FramebufferWriter_Write(&context->frameWriter, Ld, OutputLayers_, startRay[scan].index);
+                        WriteRadiance(context, sample * startRay[scan].throughput, startRay[scan].index,
+                                      startRay[scan].oddSample);
                         continue;
                     }
 
+                    if(startRay[scan].trackedBounces == 0) {
+                        float3 depth = float3(rayhit.ray.tfar[scan], 1.0f, 0.0f);
+                        FramebufferWriter_WriteLayer(&context->frameWriter, depth, eAovLayerDepth, startRay[scan].index);
+                    }
+
                     HitParameters hit;
                     hit.position.x       = rayhit.ray.org_x[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_x[scan];
                     hit.position.y       = rayhit.ray.org_y[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_y[scan];
@@ -224,10 +298,12 @@ namespace Selas
                     hit.instId[1]        = rayhit.hit.instID[1][scan];
                     hit.index            = startRay[scan].index;
                     hit.diracScatterOnly = startRay[scan].diracScatterOnly;
+                    hit.oddSample        = startRay[scan].oddSample;
                     hit.trackedBounces   = startRay[scan].trackedBounces;
                     hit.throughput       = startRay[scan].throughput;
 
                     //ptBatcher->AddUnsortedHit(hit);
+                    PerfPhaseScope_(ePerfPhaseShading);
                     ShadeHitPosition(context, ptBatcher, hit);
                 }
             }
@@ -236,6 +312,8 @@ namespace Selas
         //=========================================================================================================================
         static void TraceOcclusionBatch(GIIntegratorContext* __restrict context, OcclusionRay* rays, uint rayCount)
         {
+            ProfileEventMarker_(0, "TraceOcclusionBatch");
+
             #define BatchSize_ 8
             uint batchCount = (rayCount + BatchSize_ - 1) / BatchSize_;
 
@@ -266,16 +344,14 @@ namespace Selas
                     valid[scan] = 0;
                 }
 
-                rtcOccluded8(valid, context->rtcScene, &rtcContext, &ray);
+                {
+                    PerfPhaseScope_(ePerfPhaseTraversal);
+                    rtcOccluded8(valid, context->rtcScene, &rtcContext, &ray);
+                }
 
                 for(uint scan = 0; scan < BatchSize_; ++scan) {
                     if(valid[scan] == -1 && ray.tfar[scan] >= 0.0f) {
-
-                        float3 Ld[OutputLayers_];
-                        Memory::Zero(Ld, sizeof(Ld));
-
-                        Ld[0] = startRay[scan].value;
-                        FramebufferWriter_Write(&context->frameWriter, Ld, OutputLayers_, startRay[scan].index);
+                        WriteRadiance(context, startRay[scan].value, startRay[scan].index, startRay[scan].oddSample);
                     }
                 }
             }
@@ -285,16 +361,22 @@ namespace Selas
         static void ShadeHitBatch(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
                                   HitParameters* hits, uint hitCount)
         {
+            ProfileEventMarker_(0, "ShadeHitBatch");
+            PerfPhaseScope_(ePerfPhaseShading);
+
             for(uint scan = 0; scan < hitCount; ++scan) {
                 ShadeHitPosition(context, ptBatcher, hits[scan]);
             }
         }
 
         //=========================================================================================================================
-        static void GeneratePrimaryRays(CSampler* sampler, KernelData* __restrict kernelData)
+        static void GeneratePrimaryRays(GIIntegratorContext* __restrict context, KernelData* __restrict kernelData)
         {
-            uint width = kernelData->camera->width;
-            uint height = kernelData->camera->height;
+            ProfileEventMarker_(0, "GeneratePrimaryRays");
+
+            uint imageWidth = kernelData->camera->width;
+            uint width = kernelData->frame->width;
+            uint height = kernelData->frame->height;
 
             int64 endIndex = width * height;
 
@@ -307,18 +389,27 @@ namespace Selas
                 uint y = index / width;
                 uint x = index - (y * width);
 
-                uint sampleCount = SamplesPerPixelX_ * SamplesPerPixelY_;
+                // -- Camera rays are seeded by image pixel so tiled and untiled renders take the same samples.
+                uint imageX = kernelData->regionX + x;
+                uint imageY = kernelData->regionY + y;
+                uint imageIndex = imageY * imageWidth + imageX;
+
+                uint sampleCount = kernelData->samplesPerPixelX * kernelData->samplesPerPixelY;
+                FramebufferWriter_WriteLayer(&context->frameWriter, float3((float)sampleCount, 0.0f, 0.0f),
+                                             eAovLayerSampleCount, (uint32)index);
 
                 for(uint scan = 0; scan < sampleCount; ++scan) {
 
                     DeferredRay dr;
-                    dr.ray              = JitteredCameraRay(kernelData->camera, (int32)x, (int32)y, (int32)scan,
-                                                            SamplesPerPixelX_, SamplesPerPixelY_, (int32)index);
+                    dr.ray              = JitteredCameraRay(kernelData->camera, (int32)imageX, (int32)imageY, (int32)scan,
+                                                            (int32)kernelData->samplesPerPixelX,
+                                                            (int32)kernelData->samplesPerPixelY, (int32)imageIndex);
                     dr.error            = 0.0f;
-                    dr.index            = (uint32)(y * width + x);
+                    dr.index            = (uint32)index;
                     dr.diracScatterOnly = 1;
                     dr.throughput       = float3::One_;
                     dr.trackedBounces   = 0;
+                    dr.oddSample        = scan & 1;
                     kernelData->ptBatcher->AddUnsortedDeferredRay(dr);
                 }
             }
@@ -329,19 +420,39 @@ namespace Selas
         {
             KernelData* __restrict kernelData = (KernelData*)userData;
             
+            // -- The main thread runs a kernel too and has counted everything since the counters were enabled, scene loading
+            // -- included, so only what happens from here on is harvested.
+            PerfCounters_ResetThread();
+
             int64 kernelIndex = Atomic::Increment64(&kernelData->kernelCounter);
 
+            uint32 numaNode;
+
             GIIntegratorContext context;
             context.geometryCache = kernelData->geometryCache;
             context.textureCache  = kernelData->textureCache;
-            context.rtcScene      = kernelData->scene->rtcScene;
+            context.rtcScene      = BindWorkerToSceneNumaNode(kernelData->scene, (uint32)kernelIndex, numaNode);
             context.scene         = kernelData->scene;
             context.camera        = kernelData->camera;
             context.sampler.Initialize((uint32)kernelIndex);
             context.maxPathLength = 1;
             FramebufferWriter_Initialize(&context.frameWriter, kernelData->frame);
 
-            GeneratePrimaryRays(&context.sampler, kernelData);
+            ArenaAllocator transientArena;
+            {
+                MemoryTagScope_(eMemoryTagBatches);
+                ArenaAllocator_Initialize(&transientArena, kernelData->ptBatcher->TransientBatchSize());
+            }
+
+            KernelPhaseTimers phaseTimers;
+            phaseTimers.occlusion = std::chrono::duration<float, std::micro>::zero();
+            phaseTimers.deferred = std::chrono::duration<float, std::micro>::zero();
+            phaseTimers.shading = std::chrono::duration<float, std::micro>::zero();
+            phaseTimers.occlusionRayCount = 0;
+            phaseTimers.deferredRayCount = 0;
+            phaseTimers.shadedHitCount = 0;
+
+            GeneratePrimaryRays(&context, kernelData);
 
             // JSTODO -- Change stop condition to be that this is empty and that all worker kernels report as idle
             //        -- so no threads exit when they could be useful later.
@@ -353,57 +464,135 @@ namespace Selas
                 uint rayCount;
                 uint hitCount;
 
-                if(kernelData->ptBatcher->GetSortedHits(hitParams, hitCount)) {
-                    ShadeHitBatch(&context, kernelData->ptBatcher, hitParams, hitCount);
-                    kernelData->ptBatcher->FreeHits(hitParams);
+                if(kernelData->ptBatcher->GetSortedHits(&transientArena, hitParams, hitCount)) {
+                    {
+                        CScopedTimeAccumulator<std::micro> timer(&phaseTimers.shading);
+                        ShadeHitBatch(&context, kernelData->ptBatcher, hitParams, hitCount);
+                    }
+                    phaseTimers.shadedHitCount += hitCount;
+                    kernelData->ptBatcher->FreeHits(&transientArena, hitParams);
                 }
-                else if(kernelData->ptBatcher->GetSortedBatch(occlusionRays, rayCount)) {
-                    TraceOcclusionBatch(&context, occlusionRays, rayCount);
-                    kernelData->ptBatcher->FreeRays(occlusionRays);
+                else if(kernelData->ptBatcher->GetSortedBatch(&transientArena, occlusionRays, rayCount)) {
+                    {
+                        CScopedTimeAccumulator<std::micro> timer(&phaseTimers.occlusion);
+                        TraceOcclusionBatch(&context, occlusionRays, rayCount);
+                    }
+                    phaseTimers.occlusionRayCount += rayCount;
+                    kernelData->ptBatcher->FreeRays(&transientArena, occlusionRays);
                 }
-                else if(kernelData->ptBatcher->GetSortedBatch(deferredRays, rayCount)) {
-                    TraceRayBatch(&context, kernelData->ptBatcher, deferredRays, rayCount);
-                    kernelData->ptBatcher->FreeRays(deferredRays);
+                else if(kernelData->ptBatcher->GetSortedBatch(&transientArena, deferredRays, rayCount)) {
+                    {
+                        CScopedTimeAccumulator<std::micro> timer(&phaseTimers.deferred);
+                        TraceRayBatch(&context, kernelData->ptBatcher, deferredRays, rayCount);
+                    }
+                    phaseTimers.deferredRayCount += rayCount;
+                    kernelData->ptBatcher->FreeRays(&transientArena, deferredRays);
                 }
                 else {
                     kernelData->ptBatcher->Flush();
                 }
+
+                ArenaAllocator_Reset(&transientArena);
+                MemoryGovernor_Update();
             }
 
+            EnterSpinLock(kernelData->statsLock);
+            kernelData->transientAllocationUs += transientArena.allocationTime.count();
+            kernelData->transientHighWaterMark = Max(kernelData->transientHighWaterMark, transientArena.highWaterMark);
+            kernelData->transientFallbackCount += transientArena.fallbackCount;
+            kernelData->occlusionUs += phaseTimers.occlusion.count();
+            kernelData->deferredUs += phaseTimers.deferred.count();
+            kernelData->shadingUs += phaseTimers.shading.count();
+            kernelData->occlusionRayCount += phaseTimers.occlusionRayCount;
+            kernelData->deferredRayCount += phaseTimers.deferredRayCount;
+            kernelData->shadedHitCount += phaseTimers.shadedHitCount;
+            kernelData->framebufferPrivateTileCount += context.frameWriter.privateTileCount;
+            kernelData->numaNodeWorkerCounts[numaNode] += 1;
+            PerfCounters_HarvestThread(&kernelData->perfCounters);
+            LeaveSpinLock(kernelData->statsLock);
+
+            UnbindWorkerFromSceneNumaNode(kernelData->scene);
+
+            ArenaAllocator_Shutdown(&transientArena);
             context.sampler.Shutdown();
             FramebufferWriter_Shutdown(&context.frameWriter);
         }
 
         //=========================================================================================================================
-        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName)
+        static void LogPhaseThroughput(cpointer phase, uint64 count, float threadUs)
         {
-            PathTracingBatcher ptBatcher;
-            ptBatcher.Initialize(RayBatchSize_, HitBatchSize_);
+            // -- Times are summed across all threads so this is the per thread rate.
+            float mraysPerSecond = threadUs > 0.0f ? count / threadUs : 0.0f;
+            WriteDebugInfo_("%s: %llu in %fms thread time - %fM/s per thread", phase, count, threadUs / 1000.0f,
+                            mraysPerSecond);
+        }
 
-            Framebuffer frame;
-            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, OutputLayers_);
+        //=========================================================================================================================
+        static uint64 RayBatchSize()
+        {
+            // -- Every thread keeps a transient arena big enough for one batch so the batch sizes come from the governor's
+            // -- reservation for them.
+            uint64 rayBatchSize = RayBatchSize_;
+            uint64 batchBudget = MemoryGovernor_Budget(eMemoryTagBatches);
+            if(batchBudget > 0) {
+                uint64 perThreadBudget = batchBudget / (WorkerThreadCount_ + 1);
+                uint64 raySize = Max<uint64>(Max<uint64>(sizeof(DeferredRay), sizeof(OcclusionRay)), sizeof(HitParameters));
+                rayBatchSize = Clamp<uint64>(perThreadBudget / raySize, 64 Kb_, RayBatchSize_);
+            }
 
-            KernelData kernelData;
+            return rayBatchSize;
+        }
+
+        //=========================================================================================================================
+        static void InitializeKernelData(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                                         const RayCastCameraSettings& camera, uint samplesPerPixelX, uint samplesPerPixelY,
+                                         PathTracingBatcher* ptBatcher, KernelData& kernelData)
+        {
             kernelData.camera = &camera;
             kernelData.kernelCounter = 0;
             kernelData.pixelIndex = 0;
-            kernelData.ptBatcher = &ptBatcher;
-            kernelData.frame = &frame;
+            kernelData.ptBatcher = ptBatcher;
+            kernelData.frame = nullptr;
+            kernelData.regionX = 0;
+            kernelData.regionY = 0;
             kernelData.geometryCache = geometryCache;
             kernelData.textureCache = textureCache;
             kernelData.scene = scene;
+            kernelData.samplesPerPixelX = (uint32)samplesPerPixelX;
+            kernelData.samplesPerPixelY = (uint32)samplesPerPixelY;
+            kernelData.statsLock = CreateSpinLock();
+            kernelData.transientAllocationUs = 0.0f;
+            kernelData.transientHighWaterMark = 0;
+            kernelData.transientFallbackCount = 0;
+            kernelData.occlusionUs = 0.0f;
+            kernelData.deferredUs = 0.0f;
+            kernelData.shadingUs = 0.0f;
+            kernelData.occlusionRayCount = 0;
+            kernelData.deferredRayCount = 0;
+            kernelData.shadedHitCount = 0;
+            kernelData.framebufferPrivateTileCount = 0;
+            kernelData.renderMs = 0.0f;
+            Memory::Zero(kernelData.numaNodeWorkerCounts, sizeof(kernelData.numaNodeWorkerCounts));
+            PerfCounters_Clear(&kernelData.perfCounters);
+        }
+
+        //=========================================================================================================================
+        static void RenderFrame(KernelData* kernelData)
+        {
+            auto renderStart = SystemTime::Now();
+            kernelData->pixelIndex = 0;
 
             #if WorkerThreadCount_ > 0
                 ThreadHandle threadHandles[WorkerThreadCount_];
 
                 // -- fork threads
                 for(uint scan = 0; scan < WorkerThreadCount_; ++scan) {
-                    threadHandles[scan] = CreateThread(DeferredPathTracerKernel, &kernelData);
+                    threadHandles[scan] = CreateThread(DeferredPathTracerKernel, kernelData, "PathTracer",
+                                                       WorkerThreadCore((uint32)(scan + 1)));
                 }
             #endif
 
-            DeferredPathTracerKernel(&kernelData);
+            DeferredPathTracerKernel(kernelData);
 
             #if WorkerThreadCount_ > 0
                 for(uint scan = 0; scan < WorkerThreadCount_; ++scan) {
@@ -411,11 +600,142 @@ namespace Selas
                 }
             #endif
 
-            FrameBuffer_Scale(&frame, (1.0f / (SamplesPerPixelX_ * SamplesPerPixelY_)));
-            FrameBuffer_Save(&frame, imageName);
+            FrameBuffer_Reduce(kernelData->frame, WorkerThreadCount_ + 1);
+
+            kernelData->renderMs += SystemTime::ElapsedMillisecondsF(renderStart);
+        }
+
+        //=========================================================================================================================
+        static void ShutdownKernelData(KernelData& kernelData)
+        {
+            WriteDebugInfo_("Transient allocation time %fms - high water mark %llu bytes - %llu heap fallbacks",
+                            kernelData.transientAllocationUs / 1000.0f, kernelData.transientHighWaterMark,
+                            kernelData.transientFallbackCount);
+            LogPhaseThroughput("Occlusion rays", kernelData.occlusionRayCount, kernelData.occlusionUs);
+            LogPhaseThroughput("Deferred rays", kernelData.deferredRayCount, kernelData.deferredUs);
+            LogPhaseThroughput("Hit shading", kernelData.shadedHitCount, kernelData.shadingUs);
+            WriteDebugInfo_("Framebuffer private tiles: %llu", kernelData.framebufferPrivateTileCount);
+
+            uint64 rayCount = kernelData.occlusionRayCount + kernelData.deferredRayCount;
+            float mraysPerSecond = kernelData.renderMs > 0.0f ? rayCount / (kernelData.renderMs * 1000.0f) : 0.0f;
+            WriteDebugInfo_("Traced %llu rays in %fms wall time - %fM/s", rayCount, kernelData.renderMs, mraysPerSecond);
+            for(uint32 node = 0; node < kernelData.scene->numaReplicaCount; ++node) {
+                WriteDebugInfo_("NUMA node %u: %llu worker runs", node, kernelData.numaNodeWorkerCounts[node]);
+            }
+            PerfCounters_Log(kernelData.perfCounters);
+            CloseSpinlock(kernelData.statsLock);
+        }
+
+        //=========================================================================================================================
+        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                           const RayCastCameraSettings& camera, uint samplesPerPixelX, uint samplesPerPixelY,
+                           cpointer imageName, uint previewIntervalMs)
+        {
+            uint64 rayBatchSize = RayBatchSize();
+
+            PathTracingBatcher ptBatcher;
+            ptBatcher.Initialize(rayBatchSize, rayBatchSize * HitBatchSize_ / RayBatchSize_);
+
+            Framebuffer frame;
+            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, eAovLayerCount);
+
+            KernelData kernelData;
+            InitializeKernelData(geometryCache, textureCache, scene, camera, samplesPerPixelX, samplesPerPixelY, &ptBatcher,
+                                 kernelData);
+            kernelData.frame = &frame;
+
+            FramebufferPreview preview;
+            if(previewIntervalMs > 0) {
+                #if DenoiseOutput_
+                    // -- A single denoiser thread so previews don't take cores away from the workers.
+                    AovDenoiserSettings previewDenoiseSettings;
+                    AovDenoiser_DefaultSettings(previewDenoiseSettings);
+                    previewDenoiseSettings.threadCount = PreviewDenoiseThreads_;
+                    FramebufferPreview_Start(&preview, &frame, imageName, (uint32)previewIntervalMs, PreviewExposure_,
+                                             &previewDenoiseSettings);
+                #else
+                    FramebufferPreview_Start(&preview, &frame, imageName, (uint32)previewIntervalMs, PreviewExposure_,
+                                             nullptr);
+                #endif
+            }
+
+            RenderFrame(&kernelData);
+
+            if(previewIntervalMs > 0) {
+                FramebufferPreview_Stop(&preview);
+                WriteDebugInfo_("Wrote %u previews", preview.writtenCount);
+            }
+
+            ShutdownKernelData(kernelData);
+
+            // -- Resolving copies the layers out so the frame can be released while the EXR is written in the background.
+            AovImage aovImage;
+            AovImage_Resolve(&frame, &aovImage);
+            #if DenoiseOutput_
+                AovDenoiserSettings denoiseSettings;
+                AovDenoiser_DefaultSettings(denoiseSettings);
+                AovImage_SaveExrAsync(&aovImage, imageName, OutputPixelType_, &denoiseSettings);
+            #else
+                AovImage_SaveExrAsync(&aovImage, imageName, OutputPixelType_);
+            #endif
             FrameBuffer_Shutdown(&frame);
 
             ptBatcher.Shutdown();
         }
+
+        //=========================================================================================================================
+        Error GenerateImageTiled(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                                 const RayCastCameraSettings& camera, uint samplesPerPixelX, uint samplesPerPixelY,
+                                 cpointer imageName, uint tileSize)
+        {
+            uint32 width = (uint32)camera.viewportWidth;
+            uint32 height = (uint32)camera.viewportHeight;
+            uint32 tileCountX = (width + (uint32)tileSize - 1) / (uint32)tileSize;
+            uint32 tileCountY = (height + (uint32)tileSize - 1) / (uint32)tileSize;
+
+            AovTiledExr output;
+            ReturnError_(AovTiledExr_Open(&output, imageName, width, height, (uint32)tileSize, OutputPixelType_));
+
+            uint64 rayBatchSize = RayBatchSize();
+
+            PathTracingBatcher ptBatcher;
+            ptBatcher.Initialize(rayBatchSize, rayBatchSize * HitBatchSize_ / RayBatchSize_);
+
+            // -- The kernel counter keeps counting across tiles so every tile's workers get fresh sampler seeds.
+            KernelData kernelData;
+            InitializeKernelData(geometryCache, textureCache, scene, camera, samplesPerPixelX, samplesPerPixelY, &ptBatcher,
+                                 kernelData);
+
+            Error err = Success_;
+            for(uint32 tileY = 0; tileY < tileCountY && Successful_(err); ++tileY) {
+                for(uint32 tileX = 0; tileX < tileCountX && Successful_(err); ++tileX) {
+                    uint32 regionX = tileX * (uint32)tileSize;
+                    uint32 regionY = tileY * (uint32)tileSize;
+
+                    Framebuffer frame;
+                    FrameBuffer_Initialize(&frame, Min<uint32>((uint32)tileSize, width - regionX),
+                                           Min<uint32>((uint32)tileSize, height - regionY), eAovLayerCount);
+
+                    kernelData.frame = &frame;
+                    kernelData.regionX = regionX;
+                    kernelData.regionY = regionY;
+                    RenderFrame(&kernelData);
+
+                    // -- The denoiser needs neighbours across tile edges so tiled output is left noisy.
+                    AovImage tile;
+                    AovImage_Resolve(&frame, &tile);
+                    err = AovTiledExr_WriteTileAsync(&output, &tile, tileX, tileY);
+
+                    FrameBuffer_Shutdown(&frame);
+                }
+            }
+
+            ShutdownKernelData(kernelData);
+            ptBatcher.Shutdown();
+
+            Error closeErr = AovTiledExr_Close(&output);
+            ReturnError_(err);
+            return closeErr;
+        }
     }
 }
@@ -6,6 +6,7 @@
 
 #include "UtilityLib/Color.h"
 #include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
@@ -18,6 +19,13 @@ namespace Selas
     namespace DeferredPathTracer
     {
         void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName);
+                           const RayCastCameraSettings& camera, uint samplesPerPixelX, uint samplesPerPixelY,
+                           cpointer imageName, uint previewIntervalMs = 0);
+
+        // -- Renders tileSize square regions one after another, streaming each into a tiled EXR as it completes, so the
+        // -- framebuffer only ever holds one tile. Previews and denoising are not available in this mode.
+        Error GenerateImageTiled(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                                 const RayCastCameraSettings& camera, uint samplesPerPixelX, uint samplesPerPixelY,
+                                 cpointer imageName, uint tileSize);
     }
 }
\ No newline at end of file
@@ -115,7 +115,7 @@ namespace Selas
 
             rtcIntersect1(rtcScene, &context, &rayhit);
 
-            if(rayhit.hit.geomID == -1)
+            if(rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID)
                 return false;
 
             hit.position.x = rayhit.ray.org_x + rayhit.ray.tfar * ray.direction.x;
@@ -185,7 +185,7 @@ namespace Selas
                                                           reversePdfW);
                         if(Dot(reflectance, float3::One_) > 0) {
 
-                            if(OcclusionRay(context->scene->rtcScene, surface, lightSample.direction, lightSample.distance)) {
+                            if(OcclusionRay(context->rtcScene, surface, lightSample.direction, lightSample.distance)) {
 
                                 float3 sample = reflectance * lightSample.radiance * (1.0f / lightSample.pdfW);
                                 Ld[1] += sample * throughput;
@@ -269,10 +269,12 @@ namespace Selas
             uint height = integratorContext->camera.height;
             uint64 totalPixelCount = width * height;
 
+            uint32 numaNode;
+
             GIIntegratorContext context;
             context.geometryCache    = integratorContext->geometryCache;
             context.textureCache     = integratorContext->textureCache;
-            context.rtcScene         = integratorContext->scene->rtcScene;
+            context.rtcScene         = BindWorkerToSceneNumaNode(integratorContext->scene, (uint32)kernelIndex, numaNode);
             context.scene            = integratorContext->scene;
             context.camera           = &integratorContext->camera;
             context.sampler.Initialize((uint32)kernelIndex);
@@ -294,15 +296,15 @@ namespace Selas
             context.sampler.Shutdown();
 
             FramebufferWriter_Shutdown(&context.frameWriter);
+            UnbindWorkerFromSceneNumaNode(integratorContext->scene);
             Atomic::Increment64(integratorContext->completedThreads);
         }
 
         //=========================================================================================================================
-        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName)
+        void GenerateFrame(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                           const RayCastCameraSettings& camera, uint pathsPerPixel, Framebuffer* frame)
         {
-            Framebuffer frame;
-            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, LayerCount_);
+            FrameBuffer_Initialize(frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, LayerCount_);
 
             int64 completedThreads = 0;
             int64 kernelIndex = 0;
@@ -315,12 +317,12 @@ namespace Selas
             integratorContext.scene                  = scene;
             integratorContext.camera                 = camera;
             integratorContext.maxBounceCount         = MaxBounceCount_;
-            integratorContext.pathsPerPixel          = PathsPerPixel_;
+            integratorContext.pathsPerPixel          = pathsPerPixel;
             integratorContext.integrationStartTime   = SystemTime::Now();
             integratorContext.pixelIndex             = &pixelIndex;
             integratorContext.completedThreads       = &completedThreads;
             integratorContext.kernelIndices          = &kernelIndex;
-            integratorContext.frame                  = &frame;
+            integratorContext.frame                  = frame;
 
             #if AdditionalThreadCount_ > 0
                 ThreadHandle threadHandles[AdditionalThreadCount_];
@@ -343,7 +345,16 @@ namespace Selas
                 }
             #endif
 
-            FrameBuffer_Scale(&frame, (1.0f / PathsPerPixel_));
+            FrameBuffer_Reduce(frame, AdditionalThreadCount_ + 1);
+            FrameBuffer_Scale(frame, (1.0f / pathsPerPixel));
+        }
+
+        //=========================================================================================================================
+        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                           const RayCastCameraSettings& camera, cpointer imageName)
+        {
+            Framebuffer frame;
+            GenerateFrame(geometryCache, textureCache, scene, camera, PathsPerPixel_, &frame);
 
             FrameBuffer_Save(&frame, imageName);
             FrameBuffer_Shutdown(&frame);
@@ -14,9 +14,13 @@ namespace Selas
     class TextureCache;
     struct SceneResource;
     struct RayCastCameraSettings;
+    struct Framebuffer;
 
     namespace PathTracer
     {
+        // -- The frame is initialized here and shut down by the caller
+        void GenerateFrame(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                           const RayCastCameraSettings& camera, uint pathsPerPixel, Framebuffer* frame);
         void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
                            const RayCastCameraSettings& camera, cpointer imageName);
     }
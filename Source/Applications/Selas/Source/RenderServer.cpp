@@ -0,0 +1,229 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "RenderServer.h"
+#include "DeferredPathTracer.h"
+
+#include "SceneLib/SceneResource.h"
+#include "TextureLib/AovImage.h"
+#include "GeometryLib/Camera.h"
+#include "UtilityLib/JsonUtilities.h"
+#include "StringLib/FixedString.h"
+#include "StringLib/StringUtil.h"
+#include "IoLib/Directory.h"
+#include "IoLib/File.h"
+#include "ContainersLib/CArray.h"
+#include "MathLib/FloatFuncs.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/BasicTypes.h"
+
+#define JobPollIntervalMs_    250
+#define DefaultWidth_         1024
+#define DefaultHeight_        429
+#define DefaultSamples_       4
+
+namespace Selas
+{
+    namespace RenderServer
+    {
+        struct RenderJob
+        {
+            uint cameraIndex;
+            uint width;
+            uint height;
+            uint samplesPerPixelX;
+            uint samplesPerPixelY;
+            uint previewIntervalMs;
+            uint tileSize;
+            FilePathString output;
+            bool shutdown;
+        };
+
+        //=========================================================================================================================
+        static void StratifySamples(uint sampleCount, uint& samplesX, uint& samplesY)
+        {
+            // -- Pick the most square grid that exactly covers the requested sample count so stratification still applies.
+            samplesX = 1;
+            for(uint scan = 1; scan * scan <= sampleCount; ++scan) {
+                if(sampleCount % scan == 0) {
+                    samplesX = scan;
+                }
+            }
+            samplesY = sampleCount / samplesX;
+        }
+
+        //=========================================================================================================================
+        static Error FindCamera(const SceneResource* scene, const rapidjson::Value& element, uint& cameraIndex)
+        {
+            cameraIndex = 0;
+            if(element.HasMember("camera") == false) {
+                return Success_;
+            }
+
+            const rapidjson::Value& camera = element["camera"];
+            if(camera.IsInt()) {
+                int32 index = camera.GetInt();
+                if(index < 0 || (uint)index >= scene->data->cameras.Count()) {
+                    return Error_("Camera index %d is out of range", index);
+                }
+                cameraIndex = (uint)index;
+                return Success_;
+            }
+
+            if(camera.IsString()) {
+                for(uint scan = 0, count = scene->data->cameras.Count(); scan < count; ++scan) {
+                    if(StringUtil::EqualsIgnoreCase(scene->data->cameras[scan].name.Ascii(), camera.GetString())) {
+                        cameraIndex = scan;
+                        return Success_;
+                    }
+                }
+                return Error_("Scene has no camera named %s", camera.GetString());
+            }
+
+            return Error_("Camera must be a name or an index");
+        }
+
+        //=========================================================================================================================
+        static Error ReadRenderJob(const SceneResource* scene, cpointer filepath, RenderJob& job)
+        {
+            rapidjson::Document document;
+            ReturnError_(Json::OpenJsonDocument(filepath, document));
+
+            Json::ReadBool(document, "shutdown", job.shutdown, false);
+            if(job.shutdown) {
+                return Success_;
+            }
+
+            int32 width;
+            int32 height;
+            int32 samples;
+            Json::ReadInt32(document, "width", width, DefaultWidth_);
+            Json::ReadInt32(document, "height", height, DefaultHeight_);
+            Json::ReadInt32(document, "spp", samples, DefaultSamples_);
+            if(width <= 0 || height <= 0 || samples <= 0) {
+                return Error_("Job %s has an invalid resolution or sample count", filepath);
+            }
+
+            if(Json::ReadFixedString(document, "output", job.output) == false || job.output.Length() == 0) {
+                return Error_("Job %s does not have an output name", filepath);
+            }
+
+            ReturnError_(FindCamera(scene, document, job.cameraIndex));
+
+            float previewSeconds;
+            Json::ReadFloat(document, "previewSeconds", previewSeconds, 0.0f);
+            job.previewIntervalMs = previewSeconds > 0.0f ? (uint)(previewSeconds * 1000.0f) : 0;
+
+            int32 tileSize;
+            Json::ReadInt32(document, "tileSize", tileSize, 0);
+            job.tileSize = tileSize > 0 ? (uint)tileSize : 0;
+
+            job.width = (uint)width;
+            job.height = (uint)height;
+            StratifySamples((uint)samples, job.samplesPerPixelX, job.samplesPerPixelY);
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        static void RenderJobImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                                   const RenderJob& job)
+        {
+            RayCastCameraSettings camera;
+            SetupSceneCamera(scene, job.cameraIndex, job.width, job.height, camera);
+
+            auto timer = SystemTime::Now();
+            if(job.tileSize > 0) {
+                // -- A failed tiled render only loses this job's output so the server keeps going.
+                Error err = DeferredPathTracer::GenerateImageTiled(geometryCache, textureCache, scene, camera,
+                                                                   job.samplesPerPixelX, job.samplesPerPixelY,
+                                                                   job.output.Ascii(), job.tileSize);
+                if(Failed_(err)) {
+                    WriteDebugInfo_("Job %s failed: %s", job.output.Ascii(), err.Message());
+                }
+            }
+            else {
+                DeferredPathTracer::GenerateImage(geometryCache, textureCache, scene, camera, job.samplesPerPixelX,
+                                                  job.samplesPerPixelY, job.output.Ascii(), job.previewIntervalMs);
+            }
+            float elapsedMs = SystemTime::ElapsedMillisecondsF(timer);
+            WriteDebugInfo_("Job %s render time %fms", job.output.Ascii(), elapsedMs);
+        }
+
+        //=========================================================================================================================
+        static bool IsUndeletableJob(const CArray<FilePathString>& undeletableJobFiles, cpointer filepath)
+        {
+            for(uint scan = 0, count = undeletableJobFiles.Count(); scan < count; ++scan) {
+                if(StringUtil::Equals(undeletableJobFiles[scan].Ascii(), filepath)) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        //=========================================================================================================================
+        Error Run(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene, cpointer jobDirectory)
+        {
+            Directory::EnsureDirectoryExists(jobDirectory);
+            WriteDebugInfo_("Render server waiting for jobs in %s", jobDirectory);
+
+            CArray<FilePathString> jobFiles;
+            CArray<FilePathString> undeletableJobFiles;
+
+            bool shutdown = false;
+            while(shutdown == false) {
+                jobFiles.Clear();
+                Directory::GetFiles(jobDirectory, ".json", jobFiles);
+
+                uint pendingCount = 0;
+                for(uint scan = 0, count = jobFiles.Count(); scan < count; ++scan) {
+                    if(IsUndeletableJob(undeletableJobFiles, jobFiles[scan].Ascii()) == false) {
+                        jobFiles[pendingCount++] = jobFiles[scan];
+                    }
+                }
+                jobFiles.Resize(pendingCount);
+
+                if(jobFiles.Count() == 0) {
+                    Sleep(JobPollIntervalMs_);
+                    continue;
+                }
+
+                for(uint scan = 0, count = jobFiles.Count(); scan < count && shutdown == false; ++scan) {
+                    cpointer filepath = jobFiles[scan].Ascii();
+
+                    // -- Jobs are consumed even when they fail so a malformed job cannot stall the server.
+                    RenderJob job;
+                    Error err = ReadRenderJob(scene, filepath, job);
+
+                    // -- A job file that cannot be removed is remembered instead so it is not rendered again on every poll.
+                    Error deleteErr = File::Delete(filepath);
+                    if(Failed_(deleteErr)) {
+                        WriteDebugInfo_("Failed to delete job %s: %s", filepath, deleteErr.Message());
+                        undeletableJobFiles.Add(jobFiles[scan]);
+                    }
+
+                    if(Failed_(err)) {
+                        WriteDebugInfo_("Skipping job %s: %s", filepath, err.Message());
+                        continue;
+                    }
+
+                    if(job.shutdown) {
+                        shutdown = true;
+                        continue;
+                    }
+
+                    RenderJobImage(geometryCache, textureCache, scene, job);
+                }
+            }
+
+            AovImage_WaitForPendingSaves();
+
+            WriteDebugInfo_("Render server shutting down");
+            return Success_;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    class GeometryCache;
+    class TextureCache;
+    struct SceneResource;
+
+    namespace RenderServer
+    {
+        // -- Keeps the scene and caches resident and renders jobs dropped into the job directory as json files until a job with
+        // -- "shutdown" set to true arrives. A job file is deleted as soon as it has been read, before it renders, so a job
+        // -- that fails or brings the server down is never picked up again. Watch for the output rather than for the job file
+        // -- to disappear; outputs only appear under their final name once completely written. Write jobs under another
+        // -- extension and rename them to .json once complete so the server never reads a partial file.
+        //
+        // -- {
+        // --     "camera"         : "shot01",   (or the camera index, defaults to 0)
+        // --     "width"          : 1024,
+        // --     "height"         : 429,
+        // --     "spp"            : 4,
+        // --     "output"         : "shot01_preview",
+        // --     "previewSeconds" : 2.0,        (optional, off by default)
+        // --     "tileSize"       : 256         (optional, off by default)
+        // -- }
+        //
+        // -- previewSeconds writes a tone mapped PNG of the image in progress at that interval. tileSize renders and streams
+        // -- the image to a tiled EXR in square tiles of that many pixels. The image is then never whole in memory so
+        // -- previewSeconds is ignored.
+        Error Run(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene, cpointer jobDirectory);
+    }
+}
@@ -1,20 +1,41 @@
-//#pragma once
-//
-////=================================================================================================================================
-//// Joe Schutte
-////=================================================================================================================================
-//
-//#include "UtilityLib/Color.h"
-//#include "MathLib/FloatStructs.h"
-//#include "SystemLib/BasicTypes.h"
-//
-//namespace Selas
-//{
-//    struct RayCastCameraSettings;
-//    struct SceneResource;
-//
-//    namespace VCM
-//    {
-//        void GenerateImage(SceneResource* scene, const RayCastCameraSettings& camera, cpointer imageName);
-//    }
-//}
\ No newline at end of file
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "UtilityLib/Color.h"
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    class GeometryCache;
+    class TextureCache;
+    struct RayCastCameraSettings;
+    struct SceneResource;
+    struct Framebuffer;
+
+    struct VCMSettings
+    {
+        // -- Initial merge radius as a fraction of the scene's bounding sphere radius
+        float radiusFactor;
+        // -- Rate the merge radius shrinks between iterations. 1 keeps it fixed.
+        float radiusAlpha;
+        float integrationSeconds;
+        uint  maxPathLength;
+    };
+
+    namespace VCM
+    {
+        void DefaultSettings(VCMSettings* settings);
+
+        // -- Only the scene's image based light is sampled so scenes without one are rejected. The frame is initialized here
+        // -- and shut down by the caller once GenerateFrame succeeds.
+        Error GenerateFrame(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const VCMSettings& settings, Framebuffer* frame);
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const VCMSettings& settings, cpointer imageName);
+    }
+}
@@ -12,6 +12,7 @@
 #include "TextureLib/Framebuffer.h"
 #include "GeometryLib/Camera.h"
 #include "GeometryLib/Ray.h"
+#include "MathLib/Packing.h"
 #include "ThreadingLib/Thread.h"
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/Atomic.h"
@@ -31,6 +32,10 @@
 
 namespace Selas
 {
+    #if VCMPackLightVertices_
+    static_assert(sizeof(VCMVertex) == 64, "Light vertices are expected to fill exactly one cache line");
+    #endif
+
     namespace VCMCommon
     {
         //=========================================================================================================================
@@ -87,6 +92,134 @@ namespace Selas
             Assert_(state.index < (1 << PathStateIndexBitCount_));
         }
 
+        #if VCMPackLightVertices_
+        //=========================================================================================================================
+        void PackLightVertex(const PathState& state, const HitParameters& hit, float continuationProb, VCMVertex& vertex)
+        {
+            vertex.position         = hit.position;
+            vertex.error            = hit.error;
+            vertex.dVCM             = state.dVCM;
+            vertex.dVC              = state.dVC;
+            vertex.dVM              = state.dVM;
+            vertex.throughput       = Math::PackRgbe(state.throughput);
+            vertex.normal           = Math::PackOctahedral(hit.normal);
+            vertex.view             = Math::PackOctahedral(hit.view);
+            vertex.baryCoords       = Math::PackUnorm16(hit.baryCoords.x) | ((uint32)Math::PackUnorm16(hit.baryCoords.y) << 16);
+            vertex.continuationProb = Math::PackUnorm16(continuationProb);
+            vertex.pathLength       = state.pathLength;
+            vertex.unused           = 0;
+            vertex.geomId           = hit.geomId;
+            vertex.primId           = hit.primId;
+            for(uint scan = 0; scan < MaxInstanceLevelCount_; ++scan) {
+                vertex.instId[scan] = hit.instId[scan];
+            }
+        }
+
+        //=========================================================================================================================
+        void UnpackHitParameters(const VCMVertex& vertex, HitParameters& hit)
+        {
+            // -- Only what CalculateSurfaceParams reads is stored. The geometric normal comes back unit length but only its
+            // -- direction is used.
+            hit.position         = vertex.position;
+            hit.normal           = Math::UnpackOctahedral(vertex.normal);
+            hit.view             = Math::UnpackOctahedral(vertex.view);
+            hit.throughput       = float3::Zero_;
+            hit.error            = vertex.error;
+            hit.geomId           = vertex.geomId;
+            hit.primId           = vertex.primId;
+            for(uint scan = 0; scan < MaxInstanceLevelCount_; ++scan) {
+                hit.instId[scan] = vertex.instId[scan];
+            }
+            hit.index            = 0;
+            hit.trackedBounces   = 0;
+            hit.diracScatterOnly = 0;
+            hit.oddSample        = 0;
+            hit.unused           = 0;
+            hit.baryCoords.x     = Math::UnpackUnorm16((uint16)(vertex.baryCoords & 0xFFFF));
+            hit.baryCoords.y     = Math::UnpackUnorm16((uint16)(vertex.baryCoords >> 16));
+        }
+
+        //=========================================================================================================================
+        float3 LightVertexThroughput(const VCMVertex& vertex)
+        {
+            return Math::UnpackRgbe(vertex.throughput);
+        }
+
+        //=========================================================================================================================
+        float3 LightVertexView(const VCMVertex& vertex)
+        {
+            return Math::UnpackOctahedral(vertex.view);
+        }
+
+        //=========================================================================================================================
+        float LightVertexContinuationProb(const VCMVertex& vertex)
+        {
+            return Math::UnpackUnorm16((uint16)vertex.continuationProb);
+        }
+
+        #else
+        //=========================================================================================================================
+        void PackLightVertex(const PathState& state, const HitParameters& hit, float continuationProb, VCMVertex& vertex)
+        {
+            vertex.position         = hit.position;
+            vertex.error            = hit.error;
+            vertex.dVCM             = state.dVCM;
+            vertex.dVC              = state.dVC;
+            vertex.dVM              = state.dVM;
+            vertex.throughput       = state.throughput;
+            vertex.normal           = hit.normal;
+            vertex.view             = hit.view;
+            vertex.baryCoords       = hit.baryCoords;
+            vertex.continuationProb = continuationProb;
+            vertex.pathLength       = state.pathLength;
+            vertex.geomId           = hit.geomId;
+            vertex.primId           = hit.primId;
+            for(uint scan = 0; scan < MaxInstanceLevelCount_; ++scan) {
+                vertex.instId[scan] = hit.instId[scan];
+            }
+        }
+
+        //=========================================================================================================================
+        void UnpackHitParameters(const VCMVertex& vertex, HitParameters& hit)
+        {
+            hit.position         = vertex.position;
+            hit.normal           = vertex.normal;
+            hit.view             = vertex.view;
+            hit.throughput       = float3::Zero_;
+            hit.error            = vertex.error;
+            hit.geomId           = vertex.geomId;
+            hit.primId           = vertex.primId;
+            for(uint scan = 0; scan < MaxInstanceLevelCount_; ++scan) {
+                hit.instId[scan] = vertex.instId[scan];
+            }
+            hit.index            = 0;
+            hit.trackedBounces   = 0;
+            hit.diracScatterOnly = 0;
+            hit.oddSample        = 0;
+            hit.unused           = 0;
+            hit.baryCoords       = vertex.baryCoords;
+        }
+
+        //=========================================================================================================================
+        float3 LightVertexThroughput(const VCMVertex& vertex)
+        {
+            return vertex.throughput;
+        }
+
+        //=========================================================================================================================
+        float3 LightVertexView(const VCMVertex& vertex)
+        {
+            return vertex.view;
+        }
+
+        //=========================================================================================================================
+        float LightVertexContinuationProb(const VCMVertex& vertex)
+        {
+            return vertex.continuationProb;
+        }
+
+        #endif
+
         //=========================================================================================================================
         float SearchRadius(float baseRadius, float radiusAlpha, float iterationIndex)
         {
@@ -18,6 +18,10 @@
 #define PathStatePathLengthBitCount_    5
 #define PathStateIsAreaMeasureBitCount_ 1
 
+// -- Set to 0 to store light vertices at full precision. Kept until renders with packed vertices are shown to match; run
+// -- -validate vcm with each setting and compare the reported errors.
+#define VCMPackLightVertices_ 1
+
 namespace Selas
 {
     struct GIIntegratorContext;
@@ -33,17 +37,51 @@ namespace Selas
         float vcWeight;
     };
 
+    #if VCMPackLightVertices_
+    // -- Light vertices are compressed to exactly one cache line so more of them stay cached while merging. The MIS quantities
+    // -- span too many orders of magnitude for 16 bit floats so they are kept at full precision.
+    struct VCMVertex
+    {
+        float3 position;
+        float  error;
+        float  dVCM;
+        float  dVC;
+        float  dVM;
+        // -- Math::PackRgbe
+        uint32 throughput;
+        // -- Math::PackOctahedral
+        uint32 normal;
+        uint32 view;
+        // -- Two 16 bit unorms
+        uint32 baryCoords;
+        // -- Russian roulette probability at the vertex as a 16 bit unorm so merges don't have to rebuild its surface to weight
+        // -- the reverse pdf
+        uint32 continuationProb : 16;
+        uint32 pathLength       : PathStatePathLengthBitCount_;
+        uint32 unused           : 11;
+        int32  geomId;
+        int32  primId;
+        int32  instId[MaxInstanceLevelCount_];
+    };
+    #else
     struct VCMVertex
     {
+        float3 position;
+        float  error;
+        float  dVCM;
+        float  dVC;
+        float  dVM;
         float3 throughput;
-        uint32 index      : PathStateIndexBitCount_;
-        uint32 pathLength : PathStatePathLengthBitCount_;
-        float dVCM;
-        float dVC;
-        float dVM;
-
-        HitParameters hit;
+        float3 normal;
+        float3 view;
+        float2 baryCoords;
+        float  continuationProb;
+        uint32 pathLength;
+        int32  geomId;
+        int32  primId;
+        int32  instId[MaxInstanceLevelCount_];
     };
+    #endif
 
     struct PathState
     {
@@ -75,6 +113,12 @@ namespace Selas
         void GenerateLightSample(GIIntegratorContext* context, float vcWeight, uint index, PathState& state);
         void GenerateCameraSample(GIIntegratorContext* context, uint x, uint y, float lightPathCount, PathState& state);
 
+        void PackLightVertex(const PathState& state, const HitParameters& hit, float continuationProb, VCMVertex& vertex);
+        void UnpackHitParameters(const VCMVertex& vertex, HitParameters& hit);
+        float3 LightVertexThroughput(const VCMVertex& vertex);
+        float3 LightVertexView(const VCMVertex& vertex);
+        float LightVertexContinuationProb(const VCMVertex& vertex);
+
         float SearchRadius(float baseRadius, float radiusAlpha, float iterationIndex);
         VCMIterationConstants CalculateIterationConstants(uint vmCount, uint vcCount, float baseRadius, float radiusAlpha,
                                                           float iterationIndex);
@@ -4,25 +4,51 @@
 
 #include "VCMHashGrid.h"
 #include "VCMCommon.h"
+#include "UtilityLib/RadixSort.h"
 #include "MathLib/IntStructs.h"
 #include "MathLib/FloatFuncs.h"
 #include "MathLib/Trigonometric.h"
+#include "ThreadingLib/Thread.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
 #include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/JsAssert.h"
+
+#include <xmmintrin.h>
+
+#define MaxHashGridThreads_     32
+// -- Below this waking threads costs more than the build.
+#define MinParallelPointCount_  (64 * 1024)
+#define BarrierSpinCount_       4096
+#define MortonBitsPerAxis_      21
+#define MinCellTableSize_       16
 
 namespace Selas
 {
     //=============================================================================================================================
-    static uint CalculateCellIndex(int3 xyz, uint cellCount)
+    static uint64 SpreadMortonBits(uint64 value)
     {
-        uint x = uint(xyz.x);
-        uint y = uint(xyz.y);
-        uint z = uint(xyz.z);
+        value &= (1ull << MortonBitsPerAxis_) - 1;
+        value = (value | (value << 32)) & 0x001F00000000FFFFull;
+        value = (value | (value << 16)) & 0x001F0000FF0000FFull;
+        value = (value | (value <<  8)) & 0x100F00F00F00F00Full;
+        value = (value | (value <<  4)) & 0x10C30C30C30C30C3ull;
+        value = (value | (value <<  2)) & 0x1249249249249249ull;
+        return value;
+    }
 
-        return int(((x * 73856093) ^ (y * 19349663) ^ (z * 83492791)) % cellCount);
+    //=============================================================================================================================
+    static uint64 CalculateCellKey(int3 xyz)
+    {
+        // -- Coordinates past the Morton range alias other cells. That only costs extra radius tests since every candidate
+        // -- is tested against the radius anyway.
+        return SpreadMortonBits((uint64)xyz.x) | (SpreadMortonBits((uint64)xyz.y) << 1) | (SpreadMortonBits((uint64)xyz.z) << 2);
     }
 
     //=============================================================================================================================
-    static uint CalculateCellIndex(const VCMHashGrid* __restrict hashGrid, float3 point)
+    static uint64 CalculateCellKey(const VCMHashGrid* __restrict hashGrid, float3 point)
     {
         float3 fromCorner = point - hashGrid->aaBox.min;
 
@@ -31,22 +57,226 @@ namespace Selas
         xyz.y = (int32)Math::Floor(hashGrid->inverseCellSize * fromCorner.y);
         xyz.z = (int32)Math::Floor(hashGrid->inverseCellSize * fromCorner.z);
 
-        return CalculateCellIndex(xyz, hashGrid->cellCount);
+        return CalculateCellKey(xyz);
+    }
+
+    //=============================================================================================================================
+    static uint CellTableSlot(const VCMHashGrid* __restrict hashGrid, uint64 key)
+    {
+        uint64 hash = key * 0x9E3779B97F4A7C15ull;
+        return (uint)(hash ^ (hash >> 32)) & hashGrid->cellTableMask;
+    }
+
+    //=============================================================================================================================
+    static void InsertCell(VCMHashGrid* __restrict hashGrid, uint64 key, uint32 start, uint32 end)
+    {
+        // -- Each cell is a single run of the sorted keys so every key is inserted exactly once.
+        uint slot = CellTableSlot(hashGrid, key);
+        while(true) {
+            VCMHashGridCell& cell = hashGrid->cells[slot];
+            if(Atomic::CompareExchange64((volatile int64*)&cell.key, (int64)key, (int64)InvalidIndex64)) {
+                cell.start = start;
+                cell.end = end;
+                return;
+            }
+            slot = (slot + 1) & hashGrid->cellTableMask;
+        }
+    }
+
+    //=============================================================================================================================
+    static const VCMHashGridCell* FindCell(const VCMHashGrid* __restrict hashGrid, uint64 key)
+    {
+        uint slot = CellTableSlot(hashGrid, key);
+        while(true) {
+            const VCMHashGridCell& cell = hashGrid->cells[slot];
+            if(cell.key == key) {
+                return &cell;
+            }
+            if(cell.key == InvalidIndex64) {
+                return nullptr;
+            }
+            slot = (slot + 1) & hashGrid->cellTableMask;
+        }
+    }
+
+    //=============================================================================================================================
+    struct HashGridBuildData
+    {
+        VCMHashGrid* hashGrid;
+        const VCMVertex* points;
+        uint pointCount;
+        uint threadCount;
+
+        volatile int64 threadCounter;
+        volatile int64 barrierCount;
+        volatile int64 barrierGeneration;
+
+        AxisAlignedBox threadBounds[MaxHashGridThreads_];
+        uint threadCellCounts[MaxHashGridThreads_];
+    };
+
+    //=============================================================================================================================
+    static void HashGridBuildBarrier(HashGridBuildData* data)
+    {
+        if(data->threadCount == 1) {
+            return;
+        }
+
+        int64 generation = Atomic::LoadAcquire64(&data->barrierGeneration);
+        if(Atomic::Increment64(&data->barrierCount) + 1 == (int64)data->threadCount) {
+            data->barrierCount = 0;
+            Atomic::Increment64(&data->barrierGeneration);
+            return;
+        }
+
+        // -- Back off to the scheduler when waiting long so an oversubscribed machine doesn't spin away whole time slices.
+        uint spinCount = 0;
+        while(Atomic::LoadAcquire64(&data->barrierGeneration) == generation) {
+            if(spinCount < BarrierSpinCount_) {
+                _mm_pause();
+                ++spinCount;
+            }
+            else {
+                Sleep(0);
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void RunHashGridBuildKernel(ThreadFunction kernel, HashGridBuildData* data)
+    {
+        data->threadCounter = 0;
+
+        ThreadHandle threadHandles[MaxHashGridThreads_];
+        for(uint scan = 1; scan < data->threadCount; ++scan) {
+            threadHandles[scan] = CreateThread(kernel, data, "HashGridBuild", NoThreadAffinity_);
+            Assert_(threadHandles[scan] != InvalidThreadHandle);
+        }
+
+        kernel(data);
+
+        for(uint scan = 1; scan < data->threadCount; ++scan) {
+            ShutdownThread(threadHandles[scan]);
+        }
+    }
+
+    //=============================================================================================================================
+    static void HashPointsKernel(void* userData)
+    {
+        HashGridBuildData* data = (HashGridBuildData*)userData;
+        VCMHashGrid* hashGrid = data->hashGrid;
+
+        uint threadIndex = (uint)Atomic::Increment64(&data->threadCounter);
+        uint begin = data->pointCount * threadIndex / data->threadCount;
+        uint end = data->pointCount * (threadIndex + 1) / data->threadCount;
+
+        AxisAlignedBox& bounds = data->threadBounds[threadIndex];
+        MakeInvalid(&bounds);
+        for(uint scan = begin; scan < end; ++scan) {
+            IncludePosition(&bounds, data->points[scan].position);
+        }
+
+        HashGridBuildBarrier(data);
+
+        if(threadIndex == 0) {
+            MakeInvalid(&hashGrid->aaBox);
+            for(uint scan = 0; scan < data->threadCount; ++scan) {
+                IncludeBox(&hashGrid->aaBox, data->threadBounds[scan]);
+            }
+        }
+
+        HashGridBuildBarrier(data);
+
+        uint64* cellKeys = hashGrid->cellKeys.DataPointer();
+        uint32* vertexIndices = hashGrid->vertexIndices.DataPointer();
+        for(uint scan = begin; scan < end; ++scan) {
+            cellKeys[scan] = CalculateCellKey(hashGrid, data->points[scan].position);
+            vertexIndices[scan] = (uint32)scan;
+        }
     }
 
     //=============================================================================================================================
-    static int2 GetCellRange(const VCMHashGrid* __restrict hashGrid, uint cellIndex)
+    static void BuildCellsKernel(void* userData)
     {
-        if(cellIndex == 0) {
-            return int2(0, hashGrid->cellRangeEnds[0]);
+        HashGridBuildData* data = (HashGridBuildData*)userData;
+        VCMHashGrid* hashGrid = data->hashGrid;
+
+        uint threadIndex = (uint)Atomic::Increment64(&data->threadCounter);
+        uint begin = data->pointCount * threadIndex / data->threadCount;
+        uint end = data->pointCount * (threadIndex + 1) / data->threadCount;
+
+        const uint64* cellKeys = hashGrid->cellKeys.DataPointer();
+
+        uint runCount = 0;
+        for(uint scan = begin; scan < end; ++scan) {
+            if(scan == 0 || cellKeys[scan - 1] != cellKeys[scan]) {
+                ++runCount;
+            }
+        }
+        data->threadCellCounts[threadIndex] = runCount;
+
+        HashGridBuildBarrier(data);
+
+        if(threadIndex == 0) {
+            uint cellCount = 0;
+            for(uint scan = 0; scan < data->threadCount; ++scan) {
+                cellCount += data->threadCellCounts[scan];
+            }
+
+            // -- Keep the table at most half full so probe sequences stay short.
+            uint tableSize = MinCellTableSize_;
+            while(tableSize < 2 * cellCount) {
+                tableSize *= 2;
+            }
+            hashGrid->cells.Resize((uint32)tableSize);
+            hashGrid->cellTableMask = tableSize - 1;
+        }
+
+        HashGridBuildBarrier(data);
+
+        uint tableSize = hashGrid->cellTableMask + 1;
+        uint slotBegin = tableSize * threadIndex / data->threadCount;
+        uint slotEnd = tableSize * (threadIndex + 1) / data->threadCount;
+        for(uint scan = slotBegin; scan < slotEnd; ++scan) {
+            hashGrid->cells[scan].key = InvalidIndex64;
         }
 
-        return int2(hashGrid->cellRangeEnds[cellIndex - 1], hashGrid->cellRangeEnds[cellIndex]);
+        // -- Gather the positions into sorted order. This is the only random access into the vertices; everything after
+        // -- reads the sorted arrays.
+        const uint32* vertexIndices = hashGrid->vertexIndices.DataPointer();
+        float* positionsX = hashGrid->positionsX.DataPointer();
+        float* positionsY = hashGrid->positionsY.DataPointer();
+        float* positionsZ = hashGrid->positionsZ.DataPointer();
+        for(uint scan = begin; scan < end; ++scan) {
+            float3 position = data->points[vertexIndices[scan]].position;
+            positionsX[scan] = position.x;
+            positionsY[scan] = position.y;
+            positionsZ[scan] = position.z;
+        }
+
+        HashGridBuildBarrier(data);
+
+        // -- The keys are sorted so each cell is one run. Whichever thread owns the start of a run inserts it even when the
+        // -- run continues into the next thread's points.
+        for(uint scan = begin; scan < end; ++scan) {
+            uint64 key = cellKeys[scan];
+            if(scan > 0 && cellKeys[scan - 1] == key) {
+                continue;
+            }
+
+            uint runEnd = scan + 1;
+            while(runEnd < data->pointCount && cellKeys[runEnd] == key) {
+                ++runEnd;
+            }
+            InsertCell(hashGrid, key, (uint32)scan, (uint32)runEnd);
+        }
     }
 
     //=============================================================================================================================
-    void BuildHashGrid(VCMHashGrid* __restrict hashGrid, uint cellCount, float radius, const CArray<VCMVertex>& points)
+    void BuildHashGrid(VCMHashGrid* __restrict hashGrid, float radius, const CArray<VCMVertex>& points, uint threadCount)
     {
+        ProfileEventMarker_(0, "BuildHashGrid");
+
         float radiusSquare    = radius * radius;
         float cellSize        = 2.0f * radius;
         float inverseCellSize = 1.0f / cellSize;
@@ -54,72 +284,66 @@ namespace Selas
         hashGrid->radius          = radius;
         hashGrid->radiusSquare    = radiusSquare;
         hashGrid->inverseCellSize = inverseCellSize;
-        hashGrid->cellCount       = cellCount;
 
         uint pointCount = points.Count();
 
-        hashGrid->cellRangeEnds.Resize((uint32)cellCount);
-        hashGrid->cellIndices.Resize((uint32)pointCount);
-        Memory::Zero(hashGrid->cellRangeEnds.DataPointer(), hashGrid->cellRangeEnds.DataSize());
+        hashGrid->positionsX.Resize((uint32)pointCount);
+        hashGrid->positionsY.Resize((uint32)pointCount);
+        hashGrid->positionsZ.Resize((uint32)pointCount);
+        hashGrid->vertexIndices.Resize((uint32)pointCount);
+        hashGrid->cellKeys.Resize((uint32)pointCount);
 
-        // -- Prep the AABox
-        MakeInvalid(&hashGrid->aaBox);
-        for(uint scan = 0; scan < pointCount; ++scan) {
-            IncludePosition(&hashGrid->aaBox, points[scan].hit.position);
+        threadCount = Clamp<uint>(threadCount, 1, MaxHashGridThreads_);
+        if(pointCount < MinParallelPointCount_) {
+            threadCount = 1;
         }
-        // JSTODO - Verify this. Seems like a bug in the original author's implementation to not do this.
-        //hashGrid->aaBox.min = hashGrid->aaBox.min - radius;
-        //hashGrid->aaBox.max = hashGrid->aaBox.max + radius;
 
-        // -- Count the number of particles that will be in each cell
-        for(uint scan = 0; scan < pointCount; ++scan) {
-            uint cellIndex = CalculateCellIndex(hashGrid, points[scan].hit.position);
-            ++hashGrid->cellRangeEnds[cellIndex];
-        }
+        HashGridBuildData data;
+        data.hashGrid          = hashGrid;
+        data.points            = points.DataPointer();
+        data.pointCount        = pointCount;
+        data.threadCount       = threadCount;
+        data.barrierCount      = 0;
+        data.barrierGeneration = 0;
 
-        // -- prefix sum of the contents of cellRangeEnds (which is currently the count of particles per cell).
-        // -- This sets each cellRangeEnds[x] to the cell's start index.
-        uint32 sum = 0;
-        for(uint scan = 0; scan < cellCount; ++scan) {
-            uint32 rangeCount = hashGrid->cellRangeEnds[scan];
-            hashGrid->cellRangeEnds[scan] = sum;
-            sum += rangeCount;
-        }
+        RunHashGridBuildKernel(HashPointsKernel, &data);
 
-        // -- Assign each point to an index. This sums up each cell such that each cellRangeEnds[x] will now
-        // -- be the exclusive end index of that cell's range
-        for(uint scan = 0; scan < pointCount; ++scan) {
-            uint cellIndex = CalculateCellIndex(hashGrid, points[scan].hit.position);
+        RadixSort(hashGrid->cellKeys.DataPointer(), hashGrid->vertexIndices.DataPointer(), pointCount, threadCount);
 
-            uint32 targetIndex = hashGrid->cellRangeEnds[cellIndex]++;
-            hashGrid->cellIndices[targetIndex] = (uint32)scan;
-        }
+        RunHashGridBuildKernel(BuildCellsKernel, &data);
     }
 
     //=============================================================================================================================
     void ShutdownHashGrid(VCMHashGrid* hashGrid)
     {
-        hashGrid->cellIndices.Shutdown();
-        hashGrid->cellRangeEnds.Shutdown();
+        hashGrid->positionsX.Shutdown();
+        hashGrid->positionsY.Shutdown();
+        hashGrid->positionsZ.Shutdown();
+        hashGrid->vertexIndices.Shutdown();
+        hashGrid->cells.Shutdown();
+        hashGrid->cellKeys.Shutdown();
     }
 
     //=============================================================================================================================
     void SearchHashGrid(const VCMHashGrid* __restrict hashGrid, const CArray<VCMVertex>& vertices, float3 position, void* userData,
                         HashGridCallbackFunction callback)
     {
-        // -- Verify the given position is within the range
-        float3 deltaMin = position - hashGrid->aaBox.min;
-        float3 deltaMax = hashGrid->aaBox.max - position;
-        if(deltaMin.x < 0.0f || deltaMin.y < 0.0f || deltaMin.z < 0.0f) return;
-        if(deltaMax.x < 0.0f || deltaMax.y < 0.0f || deltaMax.z < 0.0f) return;
-
-        // -- calculate xyz coordinate start indices
-        float3 cellPoint = hashGrid->inverseCellSize * deltaMin;
+        if(hashGrid->vertexIndices.Count() == 0) {
+            return;
+        }
+
+        // -- Queries up to a cell outside of the bounds can still reach vertices near the boundary so the search is not
+        // -- limited to the bounds themselves. Queries further out than that can't reach anything.
+        float3 cellPoint = hashGrid->inverseCellSize * (position - hashGrid->aaBox.min);
         float3 coordsF;
         coordsF.x = Math::Floor(cellPoint.x);
         coordsF.y = Math::Floor(cellPoint.y);
         coordsF.z = Math::Floor(cellPoint.z);
 
+        float3 cellExtents = hashGrid->inverseCellSize * (hashGrid->aaBox.max - hashGrid->aaBox.min);
+        if(coordsF.x < -1.0f || coordsF.y < -1.0f || coordsF.z < -1.0f) return;
+        if(coordsF.x > cellExtents.x + 1.0f || coordsF.y > cellExtents.y + 1.0f || coordsF.z > cellExtents.z + 1.0f) return;
+
         float3 fractional = cellPoint - coordsF;
 
         int3 xyzMin;
@@ -134,23 +358,58 @@ namespace Selas
         if(fractional.z < 0.5f)
             --xyzMin.z;
 
+        const float* __restrict positionsX = hashGrid->positionsX.DataPointer();
+        const float* __restrict positionsY = hashGrid->positionsY.DataPointer();
+        const float* __restrict positionsZ = hashGrid->positionsZ.DataPointer();
+        const uint32* __restrict vertexIndices = hashGrid->vertexIndices.DataPointer();
+
+        __m128 queryX = _mm_set1_ps(position.x);
+        __m128 queryY = _mm_set1_ps(position.y);
+        __m128 queryZ = _mm_set1_ps(position.z);
+        __m128 radiusSquare = _mm_set1_ps(hashGrid->radiusSquare);
+
         for(int32 z = 0; z <= 1; ++z) {
             for(int32 y = 0; y <= 1; ++y) {
                 for(int32 x = 0; x <= 1; ++x) {
-                    uint cellIndex = CalculateCellIndex(int3(xyzMin.x + x, xyzMin.y + y, xyzMin.z + z), hashGrid->cellCount);
-                    int2 cellRange = GetCellRange(hashGrid, cellIndex);
+                    int3 xyz = int3(xyzMin.x + x, xyzMin.y + y, xyzMin.z + z);
+                    if(xyz.x < 0 || xyz.y < 0 || xyz.z < 0) {
+                        continue;
+                    }
+
+                    const VCMHashGridCell* cell = FindCell(hashGrid, CalculateCellKey(xyz));
+                    if(cell == nullptr) {
+                        continue;
+                    }
+
+                    uint scan = cell->start;
+                    for(; scan + 4 <= cell->end; scan += 4) {
+                        __m128 dx = _mm_sub_ps(_mm_loadu_ps(positionsX + scan), queryX);
+                        __m128 dy = _mm_sub_ps(_mm_loadu_ps(positionsY + scan), queryY);
+                        __m128 dz = _mm_sub_ps(_mm_loadu_ps(positionsZ + scan), queryZ);
+                        __m128 distSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+                        int32 inside = _mm_movemask_ps(_mm_cmple_ps(distSquared, radiusSquare));
+                        if(inside == 0) {
+                            continue;
+                        }
 
-                    for(uint scan = cellRange.x; scan < cellRange.y; ++scan) {
-                        uint particleIndex = hashGrid->cellIndices[scan];
-                        const VCMVertex& vertex = vertices[particleIndex];
+                        for(uint lane = 0; lane < 4; ++lane) {
+                            if(inside & (1 << lane)) {
+                                callback(vertices[vertexIndices[scan + lane]], userData);
+                            }
+                        }
+                    }
 
-                        float distSquared = LengthSquared(position - vertex.hit.position);
-                        if(distSquared <= hashGrid->radiusSquare) {
-                            callback(vertex, userData);
+                    for(; scan < cell->end; ++scan) {
+                        float dx = positionsX[scan] - position.x;
+                        float dy = positionsY[scan] - position.y;
+                        float dz = positionsZ[scan] - position.z;
+                        if(dx * dx + dy * dy + dz * dz <= hashGrid->radiusSquare) {
+                            callback(vertices[vertexIndices[scan]], userData);
                         }
                     }
                 }
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -13,13 +13,30 @@ namespace Selas
 {
     struct VCMVertex;
 
+    struct VCMHashGridCell
+    {
+        // -- Morton code of the cell's coordinates or InvalidIndex64 for an empty slot
+        uint64 key;
+        uint32 start;
+        uint32 end;
+    };
+
     struct VCMHashGrid
     {
-        CArray<uint32> cellIndices;
-        CArray<uint32> cellRangeEnds;
+        // -- Vertex positions sorted into Morton order of their cells and stored as separate arrays so a cell's radius tests
+        // -- read contiguous memory four vertices at a time.
+        CArray<float>  positionsX;
+        CArray<float>  positionsY;
+        CArray<float>  positionsZ;
+        // -- Index into the vertex array of each sorted position
+        CArray<uint32> vertexIndices;
+        // -- Open addressed table of the occupied cells
+        CArray<VCMHashGridCell> cells;
+        // -- Scratch space for the sort kept around so rebuilding every iteration doesn't reallocate
+        CArray<uint64> cellKeys;
         AxisAlignedBox aaBox;
 
-        uint  cellCount;
+        uint  cellTableMask;
         float radius;
         float radiusSquare;
         float inverseCellSize;
@@ -27,9 +44,12 @@ namespace Selas
 
     typedef void(*HashGridCallbackFunction)(const VCMVertex& vertex, void* userData);
 
-    void BuildHashGrid(VCMHashGrid* hashGrid, uint cellCount, float radius, const CArray<VCMVertex>& points);
+    // -- Computes every point's cell, radix sorts the points by the Morton code of their cell and then records each cell's range
+    // -- in the cell table. Up to threadCount threads are used including the calling thread; small inputs are built on the
+    // -- calling thread.
+    void BuildHashGrid(VCMHashGrid* hashGrid, float radius, const CArray<VCMVertex>& points, uint threadCount);
     void ShutdownHashGrid(VCMHashGrid* hashGrid);
 
     void SearchHashGrid(const VCMHashGrid* hashGrid, const CArray<VCMVertex>& vertices, float3 position, void* userData,
                         HashGridCallbackFunction callback);
-}
\ No newline at end of file
+}
@@ -0,0 +1,305 @@
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "VCMValidation.h"
+#include "PathTracer.h"
+#include "VCM.h"
+#include "VCMCommon.h"
+
+#include "SceneLib/ProceduralScene.h"
+#include "SceneLib/SceneResource.h"
+#include "SceneLib/GeometryCache.h"
+#include "TextureLib/TextureCache.h"
+#include "TextureLib/Framebuffer.h"
+#include "GeometryLib/Camera.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/BasicTypes.h"
+#include "SystemLib/Logging.h"
+
+#define ValidationWidth_            128
+#define ValidationHeight_           64
+#define ValidationPathsPerPixel_    4096
+#define ValidationMaxPathLength_    24
+#define ValidationBlockSize_        8
+// -- Relative error allowed in the mean of the whole image and in the rms of the 8x8 block means
+#define MeanTolerance_              0.02f
+#define BlockTolerance_             0.05f
+#define SphereRingCount_            32
+#define SphereSegmentCount_         64
+#define SunAngleDegrees_            3.0f
+
+static cpointer subsceneName  = "Validation~Subscene";
+static cpointer floorMaterial = "Floor";
+static cpointer glassMaterial = "Glass";
+
+// -- Named by light vertex format so the images from a packed and a full precision build can sit side by side
+#if VCMPackLightVertices_
+    static cpointer vertexFormat = "packed";
+    static cpointer vcmImageName = "VCMValidation_VCM_Packed";
+#else
+    static cpointer vertexFormat = "full precision";
+    static cpointer vcmImageName = "VCMValidation_VCM_FullPrecision";
+#endif
+
+namespace Selas
+{
+    namespace VCMValidation
+    {
+        //=========================================================================================================================
+        static void AddQuad(ProceduralMesh* mesh, float3 p0, float3 p1, float3 p2, float3 p3)
+        {
+            // -- Corners are counter clockwise when seen from the side the quad faces
+            float3 normal = Normalize(Cross(p1 - p0, p3 - p0));
+            float3 tangent = Normalize(p1 - p0);
+            uint32 base = (uint32)mesh->positions.Count();
+
+            mesh->positions.Add(p0);
+            mesh->positions.Add(p1);
+            mesh->positions.Add(p2);
+            mesh->positions.Add(p3);
+            for(uint scan = 0; scan < 4; ++scan) {
+                mesh->normals.Add(normal);
+                mesh->tangents.Add(float4(tangent.x, tangent.y, tangent.z, 1.0f));
+            }
+            mesh->uvs.Add(float2(0.0f, 0.0f));
+            mesh->uvs.Add(float2(1.0f, 0.0f));
+            mesh->uvs.Add(float2(1.0f, 1.0f));
+            mesh->uvs.Add(float2(0.0f, 1.0f));
+
+            mesh->triindices.Add(base + 0);
+            mesh->triindices.Add(base + 1);
+            mesh->triindices.Add(base + 2);
+            mesh->triindices.Add(base + 0);
+            mesh->triindices.Add(base + 2);
+            mesh->triindices.Add(base + 3);
+        }
+
+        //=========================================================================================================================
+        static void BuildSphereMesh(ProceduralMesh* mesh, float3 center, float radius)
+        {
+            // -- Rings run from the top pole to the bottom one. Normals point out of the sphere so the dielectric can tell
+            // -- rays entering it from rays leaving it.
+            for(uint32 ring = 0; ring <= SphereRingCount_; ++ring) {
+                float theta = ring * Math::Pi_ / SphereRingCount_;
+                for(uint32 segment = 0; segment <= SphereSegmentCount_; ++segment) {
+                    float phi = segment * Math::TwoPi_ / SphereSegmentCount_;
+                    float3 normal = float3(Math::Sinf(theta) * Math::Cosf(phi), Math::Cosf(theta),
+                                           Math::Sinf(theta) * Math::Sinf(phi));
+
+                    mesh->positions.Add(center + radius * normal);
+                    mesh->normals.Add(normal);
+                    mesh->tangents.Add(float4(-Math::Sinf(phi), 0.0f, Math::Cosf(phi), 1.0f));
+                    mesh->uvs.Add(float2((float)segment / SphereSegmentCount_, (float)ring / SphereRingCount_));
+                }
+            }
+
+            uint32 rowStride = SphereSegmentCount_ + 1;
+            for(uint32 ring = 0; ring < SphereRingCount_; ++ring) {
+                for(uint32 segment = 0; segment < SphereSegmentCount_; ++segment) {
+                    uint32 p0 = ring * rowStride + segment;
+                    uint32 p1 = p0 + 1;
+                    uint32 p2 = p1 + rowStride;
+                    uint32 p3 = p0 + rowStride;
+
+                    // -- The triangle that would collapse onto a pole is left out
+                    if(ring != 0) {
+                        mesh->triindices.Add(p0);
+                        mesh->triindices.Add(p1);
+                        mesh->triindices.Add(p2);
+                    }
+                    if(ring != SphereRingCount_ - 1) {
+                        mesh->triindices.Add(p0);
+                        mesh->triindices.Add(p2);
+                        mesh->triindices.Add(p3);
+                    }
+                }
+            }
+
+            mesh->materialHash = ProceduralMaterialHash(glassMaterial);
+            mesh->name.Copy("GlassSphere");
+        }
+
+        //=========================================================================================================================
+        static Error CreateValidationScene(RTCDevice rtcDevice, TextureCache* textureCache, GeometryCache* geometryCache,
+                                           SceneResource* scene)
+        {
+            // -- A smooth glass ball focusing a small sun onto a diffuse floor. Almost everything under the ball is caustic:
+            // -- light reaches it only through specular refraction, which is what the vertex merging half of VCM is for and
+            // -- what a path tracer can only find by chance, so the two disagree there first if either is wrong.
+            ProceduralMesh floor;
+            AddQuad(&floor, float3(-4.0f, 0.0f, -4.0f), float3(-4.0f, 0.0f, 4.0f), float3(4.0f, 0.0f, 4.0f),
+                    float3(4.0f, 0.0f, -4.0f));
+            floor.materialHash = ProceduralMaterialHash(floorMaterial);
+            floor.name.Copy("Floor");
+
+            // -- A ball lens of index 1.5 focuses about half a radius beyond its far side which puts the focus on the floor
+            ProceduralMesh sphere;
+            BuildSphereMesh(&sphere, float3(0.0f, 0.75f, 0.0f), 0.5f);
+
+            MaterialResourceData floorData;
+            floorData.shader = eDisneySolid;
+            floorData.baseColor = float3(0.5f, 0.5f, 0.5f);
+            floorData.scalarAttributeValues[eRoughness] = 1.0f;
+            floorData.scalarAttributeValues[eIor] = 1.5f;
+
+            MaterialResourceData glassData;
+            glassData.shader = eDiracTransparent;
+            glassData.baseColor = float3(1.0f, 1.0f, 1.0f);
+            glassData.scalarAttributeValues[eIor] = 1.5f;
+
+            ProceduralModel model;
+            model.name.Copy("Validation~Model");
+            model.meshes.Add(&floor);
+            model.meshes.Add(&sphere);
+            model.materialHashes.Add(ProceduralMaterialHash(floorMaterial));
+            model.materialHashes.Add(ProceduralMaterialHash(glassMaterial));
+            model.materials.Add(floorData);
+            model.materials.Add(glassData);
+
+            ProceduralSubscene subscene;
+            subscene.name.Copy(subsceneName);
+            subscene.lightSetIndex = 0;
+            subscene.models.Add(&model);
+            Instance& modelInstance = subscene.modelInstances.Add();
+            modelInstance.index = 0;
+
+            CameraSettings camera;
+            camera.name.Copy("Validation");
+            camera.position   = float3(2.5f, 2.0f, 3.0f);
+            camera.lookAt     = float3(0.0f, 0.4f, 0.0f);
+            camera.up         = float3(0.0f, 1.0f, 0.0f);
+            camera.fovDegrees = 40.0f;
+            camera.znear      = 0.1f;
+            camera.zfar       = 100.0f;
+
+            ProceduralScene description;
+            description.name.Copy("Validation~Scene");
+            // -- A dim sky keeps the shadowed floor from being black so the relative errors aren't all about the caustic
+            description.uniformIblRadiance = float3(0.05f, 0.05f, 0.05f);
+            description.iblSunDirection = float3(0.2f, 1.0f, 0.1f);
+            description.iblSunRadiance = float3(400.0f, 400.0f, 400.0f);
+            description.iblSunAngleDegrees = SunAngleDegrees_;
+            description.backgroundIntensity = float4(1.0f, 1.0f, 1.0f, 1.0f);
+            description.subscenes.Add(&subscene);
+            description.subsceneInstances.Add().index = 0;
+            description.cameras.Add(camera);
+
+            ReturnError_(CreateProceduralSceneResource(&description, scene, textureCache, geometryCache, rtcDevice));
+
+            geometryCache->RegisterSubscenes(scene->subscenes, scene->data->subsceneNames.Count());
+            geometryCache->PreloadSubscene(subsceneName);
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        static float Luminance(float3 rgb)
+        {
+            return rgb.x * 0.299f + rgb.y * 0.587f + rgb.z * 0.114f;
+        }
+
+        //=========================================================================================================================
+        static void CalculateBlockMeans(const Framebuffer* frame, uint32 layer, float* blockMeans)
+        {
+            // -- Averaging over blocks takes the remaining per-pixel noise out of the comparison
+            uint32 blockCountX = frame->width / ValidationBlockSize_;
+            uint32 blockCountY = frame->height / ValidationBlockSize_;
+            float ooPixelCount = 1.0f / (ValidationBlockSize_ * ValidationBlockSize_);
+
+            for(uint32 blockY = 0; blockY < blockCountY; ++blockY) {
+                for(uint32 blockX = 0; blockX < blockCountX; ++blockX) {
+                    float sum = 0.0f;
+                    for(uint32 y = 0; y < ValidationBlockSize_; ++y) {
+                        for(uint32 x = 0; x < ValidationBlockSize_; ++x) {
+                            uint32 index = (blockY * ValidationBlockSize_ + y) * frame->width + blockX * ValidationBlockSize_ + x;
+                            sum += Luminance(frame->buffers[layer][index]);
+                        }
+                    }
+                    blockMeans[blockY * blockCountX + blockX] = sum * ooPixelCount;
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static Error CompareFrames(const Framebuffer* vcmFrame, const Framebuffer* referenceFrame, uint32 referenceLayer)
+        {
+            uint32 blockCount = (vcmFrame->width / ValidationBlockSize_) * (vcmFrame->height / ValidationBlockSize_);
+            float* vcmBlocks = AllocArray_(float, blockCount);
+            float* referenceBlocks = AllocArray_(float, blockCount);
+            CalculateBlockMeans(vcmFrame, 0, vcmBlocks);
+            CalculateBlockMeans(referenceFrame, referenceLayer, referenceBlocks);
+
+            float vcmMean = 0.0f;
+            float referenceMean = 0.0f;
+            float squaredError = 0.0f;
+            for(uint32 scan = 0; scan < blockCount; ++scan) {
+                vcmMean += vcmBlocks[scan];
+                referenceMean += referenceBlocks[scan];
+
+                float delta = vcmBlocks[scan] - referenceBlocks[scan];
+                squaredError += delta * delta;
+            }
+            vcmMean /= blockCount;
+            referenceMean /= blockCount;
+
+            Free_(vcmBlocks);
+            Free_(referenceBlocks);
+
+            if(referenceMean <= 0.0f) {
+                return Error_("VCM validation reference image is black");
+            }
+
+            float meanError = Math::Absf(vcmMean - referenceMean) / referenceMean;
+            float blockError = Math::Sqrtf(squaredError / blockCount) / referenceMean;
+            WriteDebugInfo_("VCM validation with %s light vertices: mean %f against %f. Mean error %f, block rms error %f",
+                            vertexFormat, vcmMean, referenceMean, meanError, blockError);
+
+            if(meanError > MeanTolerance_ || blockError > BlockTolerance_) {
+                return Error_("VCM does not converge to the path tracer. Mean error %f (limit %f), block rms error %f (limit %f)",
+                              meanError, MeanTolerance_, blockError, BlockTolerance_);
+            }
+
+            return Success_;
+        }
+
+        //=========================================================================================================================
+        Error Run(GeometryCache* geometryCache, TextureCache* textureCache, RTCDevice rtcDevice, const VCMSettings& settings)
+        {
+            SceneResource scene;
+            ReturnError_(CreateValidationScene(rtcDevice, textureCache, geometryCache, &scene));
+
+            RayCastCameraSettings camera;
+            SetupSceneCamera(&scene, 0, ValidationWidth_, ValidationHeight_, camera);
+
+            // -- Long enough paths that neither integrator loses energy the other keeps
+            VCMSettings vcmSettings = settings;
+            vcmSettings.maxPathLength = ValidationMaxPathLength_;
+
+            Framebuffer vcmFrame;
+            Error err = VCM::GenerateFrame(geometryCache, textureCache, &scene, camera, vcmSettings, &vcmFrame);
+            if(Failed_(err)) {
+                ShutdownSceneResource(&scene, textureCache);
+                return err;
+            }
+
+            Framebuffer referenceFrame;
+            PathTracer::GenerateFrame(geometryCache, textureCache, &scene, camera, ValidationPathsPerPixel_, &referenceFrame);
+
+            FrameBuffer_Save(&vcmFrame, vcmImageName);
+            FrameBuffer_Save(&referenceFrame, "VCMValidation_PathTracer");
+
+            // -- The path tracer writes its radiance to its second layer
+            err = CompareFrames(&vcmFrame, &referenceFrame, 1);
+
+            FrameBuffer_Shutdown(&referenceFrame);
+            FrameBuffer_Shutdown(&vcmFrame);
+            ShutdownSceneResource(&scene, textureCache);
+
+            return err;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+
+#include "embree3/rtcore.h"
+
+namespace Selas
+{
+    class GeometryCache;
+    class TextureCache;
+    struct VCMSettings;
+
+    namespace VCMValidation
+    {
+        // -- Renders a small procedural caustic scene, a glass ball focusing a small sun onto a diffuse floor, with VCM and with
+        // -- the unidirectional path tracer and fails if the converged images disagree. Both images are saved so a failure can
+        // -- be inspected.
+        Error Run(GeometryCache* geometryCache, TextureCache* textureCache, RTCDevice rtcDevice, const VCMSettings& settings);
+    }
+}
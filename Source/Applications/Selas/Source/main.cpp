@@ -5,7 +5,9 @@
 
 #include "PathTracer.h"
 #include "DeferredPathTracer.h"
+#include "RenderServer.h"
 #include "VCM.h"
+#include "VCMValidation.h"
 
 #include "BuildCommon/ImageBasedLightBuildProcessor.h"
 #include "BuildCommon/TextureBuildProcessor.h"
@@ -21,12 +23,21 @@
 #include "SceneLib/GeometryCache.h"
 #include "TextureLib/TextureCache.h"
 #include "TextureLib/Framebuffer.h"
+#include "TextureLib/AovImage.h"
 #include "TextureLib/TextureFiltering.h"
+#include "ThreadingLib/Thread.h"
 #include "IoLib/Environment.h"
+#include "StringLib/StringTable.h"
 #include "StringLib/FixedString.h"
+#include "StringLib/StringUtil.h"
 #include "SystemLib/Error.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/MemoryGovernor.h"
+#include "SystemLib/NumaTopology.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/SystemTime.h"
+#include "SystemLib/PerfCounters.h"
+#include "SystemLib/Profiling.h"
 #include "SystemLib/Logging.h"
 
 #include "embree3/rtcore.h"
@@ -35,9 +46,14 @@
 #include "xmmintrin.h"
 #include "pmmintrin.h"
 #include <stdio.h>
+#include <stdlib.h>
 
-#define TextureCacheSize_   3 Gb_
-#define GeometryCacheSize_ 28 Gb_
+// -- Shares of the memory governor's pool. Ray batches are sized once per render so they get a fixed reservation.
+#define GeometryCacheShare_ 0.6f
+#define TextureCacheShare_  0.1f
+#define RayBatchShare_      0.05f
+#define SamplesPerPixelX_   2
+#define SamplesPerPixelY_   2
 
 using namespace Selas;
 
@@ -79,66 +95,408 @@ static Error ValidateAssetsAreBuilt()
 }
 
 //=================================================================================================================================
-int main(int argc, char *argv[])
+static bool EmbreeMemoryMonitor(void* userPtr, ssize_t bytes, bool post)
 {
-    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
-    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+    // -- Embree's allocations are mostly BVH data and never pass through the Selas allocators. Allocations are reported with
+    // -- positive sizes before they happen and releases with negative sizes after, so each is only counted once.
+    bool allocation = bytes > 0 && post == false;
+    bool release = bytes < 0 && post == true;
+    if(allocation || release) {
+        TrackExternalAllocation(eMemoryTagBvh, (int64)bytes);
+    }
+    return true;
+}
 
-    Environment_Initialize(ProjectRootName_, argv[0]);
+//=================================================================================================================================
+static cpointer FindArgumentValue(int argc, char *argv[], cpointer name)
+{
+    for(int scan = 1; scan + 1 < argc; ++scan) {
+        if(StringUtil::EqualsIgnoreCase(argv[scan], name)) {
+            return argv[scan + 1];
+        }
+    }
 
-    TextureCache textureCache;
-    textureCache.Initialize(TextureCacheSize_);
+    return nullptr;
+}
 
-    GeometryCache geometryCache;
-    geometryCache.Initialize(GeometryCacheSize_);
+//=================================================================================================================================
+static bool FindHugePagePolicy(int argc, char *argv[], HugePagePolicy& policy)
+{
+    // -- -hugepages off|transparent|explicit
+    policy = GetHugePagePolicy();
 
-    TextureFiltering::InitializeEWAFilterWeights();
+    cpointer value = FindArgumentValue(argc, argv, "-hugepages");
+    if(value == nullptr) {
+        return true;
+    }
+
+    if(StringUtil::EqualsIgnoreCase(value, "off")) {
+        policy = eHugePagesDisabled;
+        return true;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "transparent")) {
+        policy = eHugePagesTransparent;
+        return true;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "explicit")) {
+        policy = eHugePagesExplicit;
+        return true;
+    }
+
+    printf("Unknown -hugepages value '%s'. Expected off, transparent or explicit.\n", value);
+    return false;
+}
+
+//=================================================================================================================================
+static uint64 FindMemoryLimit(int argc, char *argv[])
+{
+    // -- -memory <gigabytes>. Defaults to all physical memory.
+    cpointer value = FindArgumentValue(argc, argv, "-memory");
+    if(value == nullptr) {
+        return 0;
+    }
 
-    ExitMainOnError_(ValidateAssetsAreBuilt());
+    return (uint64)(atof(value) * (1 Gb_));
+}
 
-    RTCDevice rtcDevice = rtcNewDevice(nullptr/*"verbose=3"*/);
+//=================================================================================================================================
+enum NumaPlacement
+{
+    eNumaPlacementDefault,
+    eNumaPlacementInterleave,
+    eNumaPlacementReplicate
+};
 
+//=================================================================================================================================
+static bool FindNumaPlacement(int argc, char *argv[], NumaPlacement& placement)
+{
+    // -- -numa off|interleave|replicate. Off leaves placement to the OS's first touch policy. Interleave spreads every page
+    // -- round robin across the nodes. Replicate copies the top level and pinned subscenes' BVHs to each node and binds render
+    // -- workers round robin to the nodes, which takes precedence over -pinthreads. Off by default since every replica costs
+    // -- a copy of the pinned subscenes' BVHs; the other two are there to measure it against.
+    placement = eNumaPlacementDefault;
+
+    cpointer value = FindArgumentValue(argc, argv, "-numa");
+    if(value == nullptr || StringUtil::EqualsIgnoreCase(value, "off")) {
+        return true;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "interleave")) {
+        placement = eNumaPlacementInterleave;
+        return true;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "replicate")) {
+        placement = eNumaPlacementReplicate;
+        return true;
+    }
+
+    printf("Unknown -numa value '%s'. Expected off, interleave or replicate.\n", value);
+    return false;
+}
+
+//=================================================================================================================================
+static bool FindPinThreads(int argc, char *argv[])
+{
+    // -- -pinthreads on|off. Pins each render worker to its own core; by default the OS schedules them.
+    cpointer value = FindArgumentValue(argc, argv, "-pinthreads");
+    return value != nullptr && StringUtil::EqualsIgnoreCase(value, "on");
+}
+
+//=================================================================================================================================
+static bool FindPerfCounters(int argc, char *argv[])
+{
+    // -- -perfcounters on|off. Adds cycles, instructions and LLC and dTLB misses per render phase to the render stats.
+    cpointer value = FindArgumentValue(argc, argv, "-perfcounters");
+    return value != nullptr && StringUtil::EqualsIgnoreCase(value, "on");
+}
+
+//=================================================================================================================================
+static Selas::uint FindPreviewInterval(int argc, char *argv[])
+{
+    // -- -preview <seconds>. Off by default.
+    cpointer value = FindArgumentValue(argc, argv, "-preview");
+    if(value == nullptr) {
+        return 0;
+    }
+
+    return (Selas::uint)(atof(value) * 1000.0);
+}
+
+//=================================================================================================================================
+static Selas::uint FindRenderTileSize(int argc, char *argv[])
+{
+    // -- -tiled <pixels>. Renders and streams the image a tile at a time; off by default.
+    cpointer value = FindArgumentValue(argc, argv, "-tiled");
+    if(value == nullptr) {
+        return 0;
+    }
+
+    int tileSize = atoi(value);
+    return tileSize > 0 ? (Selas::uint)tileSize : 0;
+}
+
+//=================================================================================================================================
+enum IntegratorType
+{
+    eDeferredPathTracer,
+    eUnidirectionalPathTracer,
+    eVertexConnectionAndMerging
+};
+
+//=================================================================================================================================
+static IntegratorType FindIntegrator(int argc, char *argv[])
+{
+    // -- -integrator deferred|pt|vcm. The unidirectional path tracer is the reference for checking vcm against.
+    cpointer value = FindArgumentValue(argc, argv, "-integrator");
+    if(value == nullptr) {
+        return eDeferredPathTracer;
+    }
+
+    if(StringUtil::EqualsIgnoreCase(value, "vcm")) {
+        return eVertexConnectionAndMerging;
+    }
+    if(StringUtil::EqualsIgnoreCase(value, "pt")) {
+        return eUnidirectionalPathTracer;
+    }
+    return eDeferredPathTracer;
+}
+
+//=================================================================================================================================
+static void FindVcmSettings(int argc, char *argv[], VCMSettings& settings)
+{
+    VCM::DefaultSettings(&settings);
+
+    // -- -vcmradius <fraction of the scene radius>
+    cpointer value = FindArgumentValue(argc, argv, "-vcmradius");
+    if(value != nullptr && atof(value) > 0.0) {
+        settings.radiusFactor = (float)atof(value);
+    }
+
+    // -- -vcmseconds <seconds>
+    value = FindArgumentValue(argc, argv, "-vcmseconds");
+    if(value != nullptr && atof(value) > 0.0) {
+        settings.integrationSeconds = (float)atof(value);
+    }
+}
+
+//=================================================================================================================================
+static bool FindVcmValidation(int argc, char *argv[])
+{
+    // -- -validate vcm. Checks that vcm converges to the unidirectional path tracer on a procedural scene.
+    cpointer value = FindArgumentValue(argc, argv, "-validate");
+    return value != nullptr && StringUtil::EqualsIgnoreCase(value, "vcm");
+}
+
+//=================================================================================================================================
+static void GeometryCacheMemoryStats(void* userData, MemoryConsumerStats& stats)
+{
+    ((GeometryCache*)userData)->GetMemoryStats(stats);
+}
+
+//=================================================================================================================================
+static void GeometryCacheResize(void* userData, uint64 budget)
+{
+    ((GeometryCache*)userData)->Resize(budget);
+}
+
+//=================================================================================================================================
+static void TextureCacheMemoryStats(void* userData, MemoryConsumerStats& stats)
+{
+    ((TextureCache*)userData)->GetMemoryStats(stats);
+}
+
+//=================================================================================================================================
+static void TextureCacheResize(void* userData, uint64 budget)
+{
+    ((TextureCache*)userData)->Resize(budget);
+}
+
+//=================================================================================================================================
+static void TextureCacheTrim(void* userData)
+{
+    ((TextureCache*)userData)->Trim();
+}
+
+//=================================================================================================================================
+static Error RenderScene(int argc, char *argv[], GeometryCache* geometryCache, TextureCache* textureCache,
+                         RTCDevice rtcDevice, NumaPlacement numaPlacement)
+{
     SceneResource sceneResource;
 
     auto timer = SystemTime::Now();
-    ExitMainOnError_(ReadSceneResource(sceneName, &sceneResource));
-    InitializeSceneResource(&sceneResource, &textureCache, &geometryCache, rtcDevice);
+    ReturnError_(ReadSceneResource(sceneName, &sceneResource));
+    ReturnError_(InitializeSceneResource(&sceneResource, textureCache, geometryCache, rtcDevice));
     float elapsedMs = SystemTime::ElapsedMillisecondsF(timer);
     WriteDebugInfo_("Scene load time %fms", elapsedMs);
+    LogMemoryTagStats();
 
-    geometryCache.RegisterSubscenes(sceneResource.subscenes, sceneResource.data->subsceneNames.Count());
+    geometryCache->RegisterSubscenes(sceneResource.subscenes, sceneResource.data->subsceneNames.Count());
 
     // -- preload these so they remain always loaded.
-    geometryCache.PreloadSubscene("Scenes~island~json~isMountainA~isMountainA.json_geometry");
-    geometryCache.PreloadSubscene("Scenes~island~json~isMountainA~isMountainA.json");
-    geometryCache.PreloadSubscene("Scenes~island~json~isMountainB~isMountainB.json_geometry");
-    geometryCache.PreloadSubscene("Scenes~island~json~isMountainB~isMountainB.json");
-    geometryCache.PreloadSubscene("Scenes~island~json~isIronwoodB~isIronwoodB.json_geometry");
-    geometryCache.PreloadSubscene("Scenes~island~json~isIronwoodB~isIronwoodB.json");
-    geometryCache.PreloadSubscene("Scenes~island~json~isIronwoodA1~isIronwoodA1.json_geometry");
-    geometryCache.PreloadSubscene("Scenes~island~json~isIronwoodA1~isIronwoodA1.json");
+    geometryCache->PreloadSubscene("Scenes~island~json~isMountainA~isMountainA.json_geometry");
+    geometryCache->PreloadSubscene("Scenes~island~json~isMountainA~isMountainA.json");
+    geometryCache->PreloadSubscene("Scenes~island~json~isMountainB~isMountainB.json_geometry");
+    geometryCache->PreloadSubscene("Scenes~island~json~isMountainB~isMountainB.json");
+    geometryCache->PreloadSubscene("Scenes~island~json~isIronwoodB~isIronwoodB.json_geometry");
+    geometryCache->PreloadSubscene("Scenes~island~json~isIronwoodB~isIronwoodB.json");
+    geometryCache->PreloadSubscene("Scenes~island~json~isIronwoodA1~isIronwoodA1.json_geometry");
+    geometryCache->PreloadSubscene("Scenes~island~json~isIronwoodA1~isIronwoodA1.json");
+
+    if(numaPlacement == eNumaPlacementReplicate) {
+        timer = SystemTime::Now();
+        ReturnError_(ReplicateSceneAcrossNumaNodes(&sceneResource, geometryCache, rtcDevice));
+        WriteDebugInfo_("NUMA replication time %fms", SystemTime::ElapsedMillisecondsF(timer));
+        LogMemoryTagStats();
+    }
 
     Selas::uint width  = 1024;
     Selas::uint height = 429;
 
-    for(uint scan = 0, count = sceneResource.data->cameras.Count(); scan < count; ++scan) {
-        RayCastCameraSettings camera;
-        SetupSceneCamera(&sceneResource, scan, width, height, camera);
+    Selas::uint previewIntervalMs = FindPreviewInterval(argc, argv);
+    Selas::uint renderTileSize = FindRenderTileSize(argc, argv);
+    IntegratorType integrator = FindIntegrator(argc, argv);
 
-        timer = SystemTime::Now();
-        //PathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera, "UnidirectionalPT");
-        DeferredPathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera,
+    VCMSettings vcmSettings;
+    FindVcmSettings(argc, argv, vcmSettings);
+
+    cpointer jobDirectory = FindArgumentValue(argc, argv, "-server");
+    if(jobDirectory != nullptr) {
+        ReturnError_(RenderServer::Run(geometryCache, textureCache, &sceneResource, jobDirectory));
+    }
+    else {
+        for(Selas::uint scan = 0, count = sceneResource.data->cameras.Count(); scan < count; ++scan) {
+            RayCastCameraSettings camera;
+            SetupSceneCamera(&sceneResource, scan, width, height, camera);
+
+            timer = SystemTime::Now();
+            if(integrator == eVertexConnectionAndMerging) {
+                ReturnError_(VCM::GenerateImage(geometryCache, textureCache, &sceneResource, camera, vcmSettings,
+                                                sceneResource.data->cameras[scan].name.Ascii()));
+            }
+            else if(integrator == eUnidirectionalPathTracer) {
+                PathTracer::GenerateImage(geometryCache, textureCache, &sceneResource, camera,
                                           sceneResource.data->cameras[scan].name.Ascii());
-        //VCM::GenerateImage(&sceneResource, camera, "VCM");
-        elapsedMs = SystemTime::ElapsedMillisecondsF(timer);
-        WriteDebugInfo_("Scene render time %fms", elapsedMs);
+            }
+            else if(renderTileSize > 0) {
+                ReturnError_(DeferredPathTracer::GenerateImageTiled(geometryCache, textureCache, &sceneResource, camera,
+                                                                    SamplesPerPixelX_, SamplesPerPixelY_,
+                                                                    sceneResource.data->cameras[scan].name.Ascii(),
+                                                                    renderTileSize));
+            }
+            else {
+                DeferredPathTracer::GenerateImage(geometryCache, textureCache, &sceneResource, camera, SamplesPerPixelX_,
+                                                  SamplesPerPixelY_, sceneResource.data->cameras[scan].name.Ascii(),
+                                                  previewIntervalMs);
+            }
+            elapsedMs = SystemTime::ElapsedMillisecondsF(timer);
+            WriteDebugInfo_("Scene render time %fms", elapsedMs);
+        }
+    }
+
+    LogMemoryTagStats();
+    ShutdownSceneResource(&sceneResource, textureCache);
+
+    return Success_;
+}
+
+//=================================================================================================================================
+int main(int argc, char *argv[])
+{
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+    Environment_Initialize(ProjectRootName_, argv[0]);
+    PathStringTable_Initialize();
+
+    // -- Interleaving has to be in place before anything large is allocated or any worker is started.
+    NumaPlacement numaPlacement;
+    if(FindNumaPlacement(argc, argv, numaPlacement) == false) {
+        return -1;
+    }
+    if(numaPlacement == eNumaPlacementInterleave && InterleaveMemoryAcrossNumaNodes() == false) {
+        WriteDebugInfo_("Interleaving memory across NUMA nodes is unavailable on this machine");
     }
 
-    ShutdownSceneResource(&sceneResource, &textureCache);
+    // -- -trace <file.json> records a Chrome trace of the whole run
+    cpointer traceFilepath = FindArgumentValue(argc, argv, "-trace");
+    if(traceFilepath != nullptr) {
+        TraceProfiler_SetThreadName("Main");
+        TraceProfiler_Start();
+    }
+
+    SetWorkerThreadPinning(FindPinThreads(argc, argv));
+
+    if(FindPerfCounters(argc, argv)) {
+        if(PerfCounters_Enable() == false) {
+            WriteDebugInfo_("Hardware performance counters are unavailable on this machine");
+        }
+    }
+
+    // -- Set before anything large is allocated so the caches pick it up.
+    HugePagePolicy hugePagePolicy;
+    if(FindHugePagePolicy(argc, argv, hugePagePolicy) == false) {
+        return -1;
+    }
+    SetHugePagePolicy(hugePagePolicy);
+
+    MemoryGovernor_Initialize(FindMemoryLimit(argc, argv));
+    uint64 memoryPoolSize = MemoryGovernor_PoolSize();
+
+    TextureCache textureCache;
+    GeometryCache geometryCache;
+
+    // -- Ptex has to be given its ceiling up front so textures can't grow past a quarter of the pool.
+    uint64 textureCacheMaximum = memoryPoolSize / 4;
+    MemoryGovernor_RegisterConsumer(eMemoryTagTextures, TextureCacheShare_, 256 Mb_, textureCacheMaximum,
+                                    TextureCacheMemoryStats, TextureCacheResize, TextureCacheTrim, &textureCache);
+    MemoryGovernor_RegisterConsumer(eMemoryTagGeometry, GeometryCacheShare_, 1 Gb_, memoryPoolSize,
+                                    GeometryCacheMemoryStats, GeometryCacheResize, nullptr, &geometryCache);
+    MemoryGovernor_RegisterConsumer(eMemoryTagBatches, RayBatchShare_, 256 Mb_, 2 Gb_, nullptr, nullptr, nullptr, nullptr);
+
+    textureCache.Initialize(MemoryGovernor_Budget(eMemoryTagTextures), textureCacheMaximum);
+    geometryCache.Initialize(MemoryGovernor_Budget(eMemoryTagGeometry));
+
+    TextureFiltering::InitializeEWAFilterWeights();
+
+    bool validateVcm = FindVcmValidation(argc, argv);
+    if(validateVcm == false) {
+        ExitMainOnError_(ValidateAssetsAreBuilt());
+    }
+
+    // -- Embree manages its own BVH memory so it is told separately.
+    RTCDevice rtcDevice = rtcNewDevice(hugePagePolicy != eHugePagesDisabled ? "hugepages=1" : "hugepages=0"/*"verbose=3"*/);
+    rtcSetDeviceMemoryMonitorFunction(rtcDevice, EmbreeMemoryMonitor, nullptr);
+
+    // -- -validate vcm renders a procedural scene instead of the island so it needs neither the built assets nor the preloads
+    if(validateVcm) {
+        VCMSettings vcmSettings;
+        FindVcmSettings(argc, argv, vcmSettings);
+        ExitMainOnError_(VCMValidation::Run(&geometryCache, &textureCache, rtcDevice, vcmSettings));
+    }
+    else {
+        ExitMainOnError_(RenderScene(argc, argv, &geometryCache, &textureCache, rtcDevice, numaPlacement));
+    }
+
+    AovImage_WaitForPendingSaves();
+
+    if(traceFilepath != nullptr) {
+        TraceProfiler_Stop();
+        ExitMainOnError_(TraceProfiler_WriteChromeTrace(traceFilepath));
+    }
+
+    MemoryGovernor_LogBudgets();
+
     rtcReleaseDevice(rtcDevice);
 
+    MemoryGovernor_UnregisterConsumer(eMemoryTagGeometry);
+    MemoryGovernor_UnregisterConsumer(eMemoryTagTextures);
+    MemoryGovernor_UnregisterConsumer(eMemoryTagBatches);
+    MemoryGovernor_Shutdown();
+
     geometryCache.Shutdown();
     textureCache.Shutdown();
 
+    TraceProfiler_Shutdown();
+    PathStringTable_Shutdown();
+
     return 0;
 }
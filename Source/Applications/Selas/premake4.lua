@@ -8,6 +8,9 @@ local ExtraLibraries = { "SceneLib", "TextureLib", "GeometryLib", "Shading", "Bu
 if _ARGS[1] == "osx" then
 	ExtraDefines = { "IsOsx_=1" }
 	Platform = "osx"
+elseif _ARGS[1] == "linux" then
+	ExtraDefines = { "IsLinux_=1" }
+	Platform = "linux"
 else
 	ExtraDefines = { "IsWindows_=1" }
 	Platform = "Win64"
@@ -6,6 +6,7 @@
 
 #include "UtilityLib/MurmurHash.h"
 #include "StringLib/FixedString.h"
+#include "ContainersLib/HashValue.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
@@ -63,6 +64,18 @@ namespace Selas
         return false;
     }
 
+    //=============================================================================================================================
+    inline bool operator==(const AssetId& lhs, const AssetId& rhs)
+    {
+        return lhs.type == rhs.type && lhs.name == rhs.name;
+    }
+
+    //=============================================================================================================================
+    inline uint32 HashValue(const AssetId& id)
+    {
+        return HashCombine(id.type, id.name);
+    }
+
     //=============================================================================================================================
     void Serialize(CSerializer* serializer, ContentId& data);
     void Serialize(CSerializer* serializer, AssetId& data);
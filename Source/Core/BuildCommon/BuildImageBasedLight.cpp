@@ -168,11 +168,8 @@ namespace Selas
         ibl->missHeight = 0;
         ibl->rotationRadians = 0.0f;
         
-        float* intensities = CalculateIntensityMap(width, height, ibl->lightData);
+        BuildIblDensityFunctions(width, height, ibl->lightData, &ibl->densityfunctions);
 
-        CalculateStrataDistributionFunctions(width, height, intensities, &ibl->densityfunctions);
-
-        FreeAligned_(intensities);
         Free_(raw);
 
         return Success_;
@@ -193,8 +190,7 @@ namespace Selas
         ReturnError_(ReadIblTextureFile(context, missPath, missWidth, missHeight, missData));
 
         ibl->lightData = lightData;
-        float* intensities = CalculateIntensityMap(lightWidth, lightHeight, ibl->lightData);
-        CalculateStrataDistributionFunctions(lightWidth, lightHeight, intensities, &ibl->densityfunctions);
+        BuildIblDensityFunctions(lightWidth, lightHeight, ibl->lightData, &ibl->densityfunctions);
 
         ibl->missData = missData;
         ibl->missWidth = missWidth;
@@ -202,8 +198,14 @@ namespace Selas
         ibl->rotationRadians = 0.0f;
         ibl->exposureScale = 1.0f;
 
-        FreeAligned_(intensities);
-
         return Success_;
     }
+
+    //=============================================================================================================================
+    void BuildIblDensityFunctions(uint width, uint height, float3* hdr, IblDensityFunctions* functions)
+    {
+        float* intensities = CalculateIntensityMap(width, height, hdr);
+        CalculateStrataDistributionFunctions(width, height, intensities, functions);
+        FreeAligned_(intensities);
+    }
 }
\ No newline at end of file
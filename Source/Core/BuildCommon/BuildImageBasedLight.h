@@ -4,15 +4,20 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "MathLib/FloatStructs.h"
 #include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
 {
     struct ImageBasedLightResourceData;
+    struct IblDensityFunctions;
     struct BuildProcessorContext;
 
     Error ImportImageBasedLight(BuildProcessorContext* context, ImageBasedLightResourceData* ibl);
     Error ImportDualImageBasedLight(BuildProcessorContext* context, cpointer lightPath, cpointer missPath,
                                     ImageBasedLightResourceData* ibl);
+
+    // -- Builds the importance sampling functions for an equirectangular light. hdr is row major with width * height texels.
+    void BuildIblDensityFunctions(uint width, uint height, float3* hdr, IblDensityFunctions* functions);
 }
\ No newline at end of file
@@ -299,4 +299,21 @@ namespace Selas
 
         return Success_;
     }
+
+    //=============================================================================================================================
+    Error BuildFloat3Texture(TextureMipFilters prefilter, float3* linear, uint width, uint height, TextureResourceData* texture)
+    {
+        float3* textureData;
+        texture->dataSize = 0;
+        bool result = GenerateMipMaps<float3>(prefilter, linear, width, height, texture->mipOffsets, texture->mipWidths,
+                                              texture->mipHeights, textureData, texture->mipCount, texture->dataSize);
+        if(result == false) {
+            return Error_("Texture of %llux%llu has too many mips", width, height);
+        }
+
+        texture->texture = reinterpret_cast<uint8*>(textureData);
+        texture->format = TextureResourceData::Float3;
+
+        return Success_;
+    }
 }
@@ -21,4 +21,7 @@ namespace Selas
     };
 
     Error ImportTexture(BuildProcessorContext* context, TextureMipFilters prefilter, TextureResourceData* texture);
+
+    // -- Builds a Float3 texture and its mip chain from one row major level. The texels are allocated with AllocArray_.
+    Error BuildFloat3Texture(TextureMipFilters prefilter, float3* linear, uint width, uint height, TextureResourceData* texture);
 }
\ No newline at end of file
@@ -108,7 +108,7 @@ namespace Selas
             FixedStringSprintf(instanceObjFile, "%s%s", root.Ascii(), objFile);
             AssetFileUtils::IndependentPathSeperators(instanceObjFile);
 
-            uint meshIndex = subscene->modelNames.Add(instanceObjFile);
+            uint meshIndex = PackedStrings_Add(&subscene->modelNames, instanceObjFile.Ascii());
 
             const auto& element = objFileKV.value;
             for(const auto& instanceKV : element.GetObject()) {
@@ -250,7 +250,7 @@ namespace Selas
         ReturnError_(BakeModel(context, curveModelName.Ascii(), curveModel));
 
         Instance curveInstance;
-        curveInstance.index = subscene->modelNames.Add(curveModelName);
+        curveInstance.index = PackedStrings_Add(&subscene->modelNames, curveModelName.Ascii());
         curveInstance.localToWorld = Matrix4x4::Identity();
         curveInstance.worldToLocal = Matrix4x4::Identity();
         subscene->modelInstances.Add(curveInstance);
@@ -492,7 +492,7 @@ namespace Selas
         FilePathString geomObjFile;
         FixedStringSprintf(geomObjFile, "%s%s", root.Ascii(), document["geomObjFile"].GetString());
         AssetFileUtils::IndependentPathSeperators(geomObjFile);
-        uint rootModelIndex = elementGeometryScene->modelNames.Add(geomObjFile);
+        uint rootModelIndex = PackedStrings_Add(&elementGeometryScene->modelNames, geomObjFile.Ascii());
 
         // -- create a child scene to contain the instanced primitives
         uint primitivesSceneIndex = InvalidIndex64;
@@ -534,7 +534,7 @@ namespace Selas
                     FilePathString altGeomObjFile;
                     FixedStringSprintf(altGeomObjFile, "%s%s", root.Ascii(), instancedCopyKV.value["geomObjFile"].GetString());
                     AssetFileUtils::IndependentPathSeperators(altGeomObjFile);
-                    modelIndex = elementGeometryScene->modelNames.Add(altGeomObjFile);
+                    modelIndex = PackedStrings_Add(&elementGeometryScene->modelNames, altGeomObjFile.Ascii());
                 }
 
                 copyInstance.index = modelIndex;
@@ -643,9 +643,9 @@ namespace Selas
         for(uint scan = 0, count = allScenes.Count(); scan < count; ++scan) {
 
             SubsceneResourceData* scene = allScenes[scan];
-            for(uint scan = 0, count = scene->modelNames.Count(); scan < count; ++scan) {
-                if(!StringUtil::EndsWithIgnoreCase(scene->modelNames[scan].Ascii(), CurveModelNameSuffix_)) {
-                    context->AddProcessDependency("model", scene->modelNames[scan].Ascii());
+            for(uint scan = 0, count = PackedStrings_Count(&scene->modelNames); scan < count; ++scan) {
+                if(!StringUtil::EndsWithIgnoreCase(PackedStrings_Get(&scene->modelNames, (uint32)scan), CurveModelNameSuffix_)) {
+                    context->AddProcessDependency("model", PackedStrings_Get(&scene->modelNames, (uint32)scan));
                 }
             }
 
@@ -119,9 +119,9 @@ namespace Selas
             Hash32 hash = MurmurHash3_x86_32(instanceDesc.asset.Ascii(), StringUtil::Length(instanceDesc.asset.Ascii()));
 
             uint64 modelindex = modelHashes.Add(hash);
-            if(modelindex >= subscene.modelNames.Count()) {
+            if(modelindex >= PackedStrings_Count(&subscene.modelNames)) {
                 context->AddProcessDependency("model", instanceDesc.asset.Ascii());
-                subscene.modelNames.Add(instanceDesc.asset);
+                PackedStrings_Add(&subscene.modelNames, instanceDesc.asset.Ascii());
             }
 
             Instance& instance = subscene.modelInstances.Add();
@@ -15,9 +15,11 @@ namespace Selas
     //=============================================================================================================================
     Error BuildProcessorContext::AddFileDependency(cpointer file)
     {
-        ContentDependency dep;
+        FilePathString sanitized;
+        AssetFileUtils::SanitizeContentPath(file, sanitized);
 
-        AssetFileUtils::SanitizeContentPath(file, dep.path);
+        ContentDependency dep;
+        dep.path = InternPath(sanitized.Ascii());
 
         if(FileTime(file, &dep.timestamp) == false) {
             return Error_("Failed to find file: %s", file);
@@ -8,6 +8,8 @@
 #include "UtilityLib/MurmurHash.h"
 #include "StringLib/StringUtil.h"
 #include "ContainersLib/QueueList.h"
+#include "ContainersLib/MpmcQueue.h"
+#include "ContainersLib/ChunkedArray.h"
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/JsAssert.h"
 #include "SystemLib/MemoryAllocation.h"
@@ -19,6 +21,7 @@
 #include <tbb/task.h>
 
 #define RunMultiThreaded_ true
+#define CompletedQueueSize_ 4096
 
 namespace Selas
 {
@@ -26,6 +29,8 @@ namespace Selas
     typedef std::pair<Hash32, CBuildProcessor*> ProcessorKeyValue;
     typedef std::map<Hash32, CBuildProcessor*>::iterator ProcessorIterator;
 
+    struct BuildCoreTaskData;
+
     //=============================================================================================================================
     struct BuildCoreData
     {
@@ -36,11 +41,15 @@ namespace Selas
 
         QueueList pendingQueue;
 
-        void* mtQueuesSpinlock;
-        QueueList completedQueue;
-        QueueList failedQueue;
+        // -- Written by the tbb workers. Completed tasks are drained by the main thread every loop so they go through a lock-free
+        // -- queue; failures are only kept around until shutdown so they are appended to a chunked array.
+        MpmcQueue<BuildCoreTaskData*> completedQueue;
+        ChunkedArray<BuildCoreTaskData*> failedTasks;
 
         int64 activeTaskCount;
+        // -- Tasks that have been launched and not yet drained from completedQueue or failed. Capped at the queue's capacity so
+        // -- a finished task always has room to publish itself.
+        volatile int64 outstandingTaskCount;
     };
 
     //=============================================================================================================================
@@ -60,17 +69,18 @@ namespace Selas
 
         tbb::task* execute()
         {
+            MemoryTagScope_(eMemoryTagBuild);
+
             Error result = data->processor->Process(&data->context);
 
             if(Successful_(result)) {
-                EnterSpinLock(data->coreData->mtQueuesSpinlock);
-                QueueList_Push(&data->coreData->completedQueue, data);
-                LeaveSpinLock(data->coreData->mtQueuesSpinlock);
+                bool pushed = data->coreData->completedQueue.TryPush(data);
+                AssertMsg_(pushed, "More build tasks outstanding than the completed queue can hold");
+                Unused_(pushed);
             }
             else {
-                EnterSpinLock(data->coreData->mtQueuesSpinlock);
-                QueueList_Push(&data->coreData->failedQueue, data);
-                LeaveSpinLock(data->coreData->mtQueuesSpinlock);
+                data->coreData->failedTasks.Add(data);
+                Atomic::Decrement64(&data->coreData->outstandingTaskCount);
             }
 
             Atomic::Decrement64(&data->coreData->activeTaskCount);
@@ -82,6 +92,7 @@ namespace Selas
     static BuildCoreTaskData* AllocateTaskData(BuildCoreData* coreData)
     {
         Atomic::Increment64(&coreData->activeTaskCount);
+        Atomic::Increment64(&coreData->outstandingTaskCount);
 
         BuildCoreTaskData* taskData = QueueList_Pop<BuildCoreTaskData*>(&coreData->taskDataFreeList);
         if(taskData) {
@@ -110,13 +121,13 @@ namespace Selas
         _coreData = New_(BuildCoreData);
         _coreData->depGraph = depGraph;
         _coreData->activeTaskCount = 0;
+        _coreData->outstandingTaskCount = 0;
 
         QueueList_Initialize(&_coreData->taskDataFreeList, /*maxFreeListSize=*/64);
         QueueList_Initialize(&_coreData->pendingQueue, /*maxFreeListSize=*/64);
-        QueueList_Initialize(&_coreData->failedQueue, /*maxFreeListSize=*/0);
 
-        _coreData->mtQueuesSpinlock = CreateSpinLock();
-        QueueList_Initialize(&_coreData->completedQueue, /*maxFreeListSize=*/64);
+        _coreData->completedQueue.Initialize(CompletedQueueSize_);
+        _coreData->failedTasks.Initialize(/*chunkSize=*/64);
     }
 
     //=============================================================================================================================
@@ -134,10 +145,13 @@ namespace Selas
 
         QueueList_Shutdown(&_coreData->taskDataFreeList);
         QueueList_Shutdown(&_coreData->pendingQueue);
-        QueueList_Shutdown(&_coreData->completedQueue);
-        QueueList_Shutdown(&_coreData->failedQueue);
+        _coreData->completedQueue.Shutdown();
+
+        for(uint64 scan = 0, count = _coreData->failedTasks.Count(); scan < count; ++scan) {
+            Delete_(_coreData->failedTasks[scan]);
+        }
+        _coreData->failedTasks.Shutdown();
 
-        CloseSpinlock(_coreData->mtQueuesSpinlock);
         SafeDelete_(_coreData);
     }
 
@@ -173,6 +187,8 @@ namespace Selas
     //=============================================================================================================================
     Error CBuildCore::Execute()
     {
+        MemoryTagScope_(eMemoryTagBuild);
+
         #define MainThreadIdleBackoffCount_     10
         #define MainThreadMaxIdleTime_          2000
         #define MainThreadStartIdleTime_        200
@@ -245,20 +261,14 @@ namespace Selas
     //=============================================================================================================================
     bool CBuildCore::HasCompletedProcesses()
     {
-        EnterSpinLock(_coreData->mtQueuesSpinlock);
-        bool empty = QueueList_Empty(&_coreData->completedQueue);
-        LeaveSpinLock(_coreData->mtQueuesSpinlock);
-
-        return empty == false;
+        return _coreData->completedQueue.Empty() == false;
     }
 
     //=============================================================================================================================
     bool CBuildCore::ProcessCompletedQueue()
     {
-        EnterSpinLock(_coreData->mtQueuesSpinlock);
-        BuildCoreTaskData* jobData = QueueList_Pop<BuildCoreTaskData*>(&_coreData->completedQueue);
-        LeaveSpinLock(_coreData->mtQueuesSpinlock);
-        if(jobData == nullptr) {
+        BuildCoreTaskData* jobData;
+        if(_coreData->completedQueue.TryPop(jobData) == false) {
             return false;
         }
 
@@ -282,6 +292,7 @@ namespace Selas
         jobData->context.contentDependencies.Shutdown();
         
         QueueList_Push(&_coreData->taskDataFreeList, jobData);
+        Atomic::Decrement64(&_coreData->outstandingTaskCount);
 
         return true;
     }
@@ -289,6 +300,11 @@ namespace Selas
     //=============================================================================================================================
     bool CBuildCore::ProcessPendingQueue()
     {
+        // -- Hold pending work back until the main thread drains completed tasks.
+        if(_coreData->outstandingTaskCount >= CompletedQueueSize_) {
+            return false;
+        }
+
         BuildProcessDependencies* next = QueueList_Pop<BuildProcessDependencies*>(&_coreData->pendingQueue);
         if(next == nullptr) {
             return false;
@@ -12,17 +12,14 @@
 #include "IoLib/Serializer.h"
 #include "IoLib/SizeSerializer.h"
 #include "IoLib/BinarySerializers.h"
-
-#include <map>
+#include "ContainersLib/CHashMap.h"
 
 namespace Selas
 {
-    typedef std::map<AssetId, BuildProcessDependencies*>           DependencyMap;
-    typedef std::pair<AssetId, BuildProcessDependencies*>          DependencyKeyValue;
-    typedef std::map<AssetId, BuildProcessDependencies*>::iterator DependencyIterator;
+    typedef CHashMap<AssetId, BuildProcessDependencies*> DependencyMap;
 
     #define BuildDependencyGraphType_ "builddependencygraph"
-    #define BuildDependencyGraphVersion_ 1535140108ul
+    #define BuildDependencyGraphVersion_ 1541376000ul
 
     //=============================================================================================================================
     struct BuildGraphData
@@ -68,6 +65,16 @@ namespace Selas
         CBinaryReadSerializer* serializer = New_(CBinaryReadSerializer);
         serializer->Initialize((uint8*)fileData, fileSize);
 
+        // -- Content paths were written as handles from the process that saved the graph
+        CArray<InternedString> pathRemap;
+        Error err = PathStringTable()->Read(serializer, pathRemap);
+        if(Failed_(err)) {
+            pathRemap.Shutdown();
+            Delete_(serializer);
+            FreeAligned_(fileData);
+            return err;
+        }
+
         uint32 count = 0;
         Serialize(serializer, count);
         for(uint32 scan = 0; scan < count; ++scan) {
@@ -77,9 +84,16 @@ namespace Selas
             // -- clear these flags since they are per-execution data.
             deps->flags &= ~(eEnqueued | eAlreadyBuilt);
 
-            data->dependencyGraph.insert(DependencyKeyValue(deps->id, deps));
+            for(uint dep = 0, depCount = deps->contentDependencies.Count(); dep < depCount; ++dep) {
+                InternedString& path = deps->contentDependencies[dep].path;
+                Assert_(path.handle < pathRemap.Count());
+                path = pathRemap[path.handle];
+            }
+
+            data->dependencyGraph.Insert(deps->id, deps);
         }
 
+        pathRemap.Shutdown();
         Delete_(serializer);
         FreeAligned_(fileData);
 
@@ -89,18 +103,21 @@ namespace Selas
     //=============================================================================================================================
     static Error SaveDependencyGraph(BuildGraphData* data)
     {
-        // -- we can't use SerializeToBinary here since we don't have access to the internals of std::map to write a Serialize
-        // -- function for `DependencyMap dependencyGraph`
+        // -- we can't use SerializeToBinary here since there is no Serialize function for `DependencyMap dependencyGraph`
 
         FilePathString filepath;
         BuildGraphFilePath(filepath);
 
-        uint32 count = (uint32)data->dependencyGraph.size();
+        const DependencyMap& graph = data->dependencyGraph;
+        uint32 count = (uint32)graph.Count();
         
         CSizeSerializer* sizeSerializer = New_(CSizeSerializer);      
+        PathStringTable()->Write(sizeSerializer);
         Serialize(sizeSerializer, count);
-        for(DependencyIterator it = data->dependencyGraph.begin(); it != data->dependencyGraph.end(); ++it) {
-            Serialize(sizeSerializer, *it->second);
+        for(uint64 scan = 0, capacity = graph.Capacity(); scan < capacity; ++scan) {
+            if(graph.Occupied(scan)) {
+                Serialize(sizeSerializer, *graph.ValueAt(scan));
+            }
         }
         uint totalSize = sizeSerializer->TotalSize();
         Delete_(sizeSerializer);
@@ -110,14 +127,20 @@ namespace Selas
         CBinaryWriteSerializer* writeSerializer = New_(CBinaryWriteSerializer);
         writeSerializer->Initialize(memory, totalSize);
 
+        PathStringTable()->Write(writeSerializer);
         Serialize(writeSerializer, count);
-        for(DependencyIterator it = data->dependencyGraph.begin(); it != data->dependencyGraph.end(); ++it) {
-            Serialize(writeSerializer, *it->second);
+        for(uint64 scan = 0, capacity = graph.Capacity(); scan < capacity; ++scan) {
+            if(graph.Occupied(scan)) {
+                Serialize(writeSerializer, *graph.ValueAt(scan));
+            }
         }
         writeSerializer->SwitchToPtrWrites();
+        PathStringTable()->Write(writeSerializer);
         Serialize(writeSerializer, count);
-        for(DependencyIterator it = data->dependencyGraph.begin(); it != data->dependencyGraph.end(); ++it) {
-            Serialize(writeSerializer, *it->second);
+        for(uint64 scan = 0, capacity = graph.Capacity(); scan < capacity; ++scan) {
+            if(graph.Occupied(scan)) {
+                Serialize(writeSerializer, *graph.ValueAt(scan));
+            }
         }
 
         Directory::EnsureDirectoryExists(filepath.Ascii());
@@ -141,7 +164,8 @@ namespace Selas
     //=============================================================================================================================
     bool operator==(const ContentDependency& lhs, const ContentDependency& rhs)
     {
-        return StringUtil::Equals(lhs.path.Ascii(), rhs.path.Ascii());
+        // -- Both paths come from PathStringTable so the handles compare the strings
+        return lhs.path == rhs.path;
     }
 
     //=============================================================================================================================
@@ -156,6 +180,24 @@ namespace Selas
         return (lhs.id.type == rhs.id.type && lhs.id.name == rhs.id.name && lhs.version == rhs.version);
     }
 
+    //=============================================================================================================================
+    uint32 HashValue(const ContentDependency& dependency)
+    {
+        return HashValue(dependency.path);
+    }
+
+    //=============================================================================================================================
+    uint32 HashValue(const ProcessDependency& dependency)
+    {
+        return HashValue(dependency.id);
+    }
+
+    //=============================================================================================================================
+    uint32 HashValue(const ProcessorOutput& output)
+    {
+        return HashCombine(HashValue(output.id), HashValue(output.version));
+    }
+
     //=============================================================================================================================
     CBuildDependencyGraph::CBuildDependencyGraph()
         : _data(nullptr)
@@ -183,9 +225,13 @@ namespace Selas
     {
         ReturnError_(SaveDependencyGraph(_data));
 
-        for(DependencyIterator it = _data->dependencyGraph.begin(); it != _data->dependencyGraph.end(); ++it) {
-            Delete_(it->second);
+        DependencyMap& graph = _data->dependencyGraph;
+        for(uint64 scan = 0, capacity = graph.Capacity(); scan < capacity; ++scan) {
+            if(graph.Occupied(scan)) {
+                Delete_(graph.ValueAt(scan));
+            }
         }
+        graph.Shutdown();
         SafeDelete_(_data);
 
         return Success_;
@@ -194,12 +240,8 @@ namespace Selas
     //=============================================================================================================================
     BuildProcessDependencies* CBuildDependencyGraph::Find(AssetId id)
     {
-        auto obj = _data->dependencyGraph.find(id);
-        if(obj != _data->dependencyGraph.end()) {
-            return obj->second;
-        }
-
-        return nullptr;
+        BuildProcessDependencies** deps = _data->dependencyGraph.Find(id);
+        return deps ? *deps : nullptr;
     }
 
     //=============================================================================================================================
@@ -214,13 +256,13 @@ namespace Selas
     {
         AssetId id(source.type.Ascii(), source.name.Ascii());
 
-        Assert_(_data->dependencyGraph.find(id) == _data->dependencyGraph.end());
+        Assert_(_data->dependencyGraph.Find(id) == nullptr);
 
         BuildProcessDependencies* deps = New_(BuildProcessDependencies);
         deps->id = id;
         deps->source = source;
 
-        _data->dependencyGraph.insert(DependencyKeyValue(id, deps));
+        _data->dependencyGraph.Insert(id, deps);
 
         return deps;
     }
@@ -229,7 +271,7 @@ namespace Selas
     static bool FileUpToDate(const ContentDependency& fileDep)
     {
         FilePathString contentFilePath;
-        AssetFileUtils::ContentFilePath(fileDep.path.Ascii(), contentFilePath);
+        AssetFileUtils::ContentFilePath(PathAscii(fileDep.path), contentFilePath);
 
         FileTimestamp timestamp;
         ReturnFailure_(FileTime(contentFilePath.Ascii(), &timestamp));
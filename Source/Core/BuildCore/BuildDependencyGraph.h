@@ -6,6 +6,7 @@
 
 #include "Assets/AssetFileUtils.h"
 #include "UtilityLib/MurmurHash.h"
+#include "StringLib/StringTable.h"
 #include "StringLib/FixedString.h"
 #include "ContainersLib/CArray.h"
 #include "IoLib/FileTime.h"
@@ -19,7 +20,8 @@ namespace Selas
     //=============================================================================================================================
     struct ContentDependency
     {
-        FilePathString path;
+        // -- Interned in PathStringTable
+        InternedString path;
         FileTimestamp  timestamp;
     };
 
@@ -65,6 +67,10 @@ namespace Selas
     bool operator==(const ProcessDependency& lhs, const ProcessDependency& rhs);
     bool operator==(const ProcessorOutput& lhs, const ProcessorOutput& rhs);
 
+    uint32 HashValue(const ContentDependency& dependency);
+    uint32 HashValue(const ProcessDependency& dependency);
+    uint32 HashValue(const ProcessorOutput& output);
+
     //=============================================================================================================================
     class CBuildDependencyGraph
     {
@@ -0,0 +1,249 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ContainersLib/HashValue.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/JsAssert.h"
+
+namespace Selas
+{
+    // -- Open addressing hash map with linear probing. Key_ needs a HashValue overload and operator==. Like CArray the storage
+    // -- is raw memory so Key_ and Value_ should be plain data; pointers to heap allocated values are the expected use.
+    // -- Iterate with Capacity / Occupied / KeyAt / ValueAt. Insertion and removal invalidate pointers returned by Find.
+    template <typename Key_, typename Value_>
+    class CHashMap
+    {
+    public:
+        CHashMap(void);
+        ~CHashMap(void);
+
+        void Shutdown(void);
+        void Clear(void);
+        void Reserve(uint64 count);
+
+        inline uint64 Count(void) const { return _count; }
+
+        // -- Returns nullptr when key isn't in the map
+        Value_*       Find(const Key_& key);
+        const Value_* Find(const Key_& key) const;
+
+        // -- Returns false and leaves the existing value alone when key is already in the map
+        bool Insert(const Key_& key, const Value_& value);
+        // -- Inserts or overwrites
+        void Set(const Key_& key, const Value_& value);
+        bool Remove(const Key_& key);
+
+        inline uint64        Capacity(void) const { return _capacity; }
+        inline bool          Occupied(uint64 slot) const { return _hashes[slot] != 0; }
+        inline const Key_&   KeyAt(uint64 slot) const { return _keys[slot]; }
+        inline Value_&       ValueAt(uint64 slot) { return _values[slot]; }
+        inline const Value_& ValueAt(uint64 slot) const { return _values[slot]; }
+
+    private:
+        uint64 FindSlot(const Key_& key, uint32 hash) const;
+        void   Rehash(uint64 newCapacity);
+
+    private:
+        // -- The top bit of a stored hash is always set so zero marks an empty slot.
+        uint32* _hashes;
+        Key_*   _keys;
+        Value_* _values;
+        uint64  _count;
+        uint64  _capacity;
+    };
+
+    template<typename Key_, typename Value_>
+    CHashMap<Key_, Value_>::CHashMap(void)
+        : _hashes(nullptr)
+        , _keys(nullptr)
+        , _values(nullptr)
+        , _count(0)
+        , _capacity(0)
+    {
+    }
+
+    template<typename Key_, typename Value_>
+    CHashMap<Key_, Value_>::~CHashMap(void)
+    {
+        Shutdown();
+    }
+
+    template<typename Key_, typename Value_>
+    void CHashMap<Key_, Value_>::Shutdown(void)
+    {
+        SafeFree_(_hashes);
+        SafeFree_(_keys);
+        SafeFree_(_values);
+
+        _count = 0;
+        _capacity = 0;
+    }
+
+    template<typename Key_, typename Value_>
+    void CHashMap<Key_, Value_>::Clear(void)
+    {
+        if(_hashes) {
+            Memory::Zero(_hashes, _capacity * sizeof(uint32));
+        }
+        _count = 0;
+    }
+
+    template<typename Key_, typename Value_>
+    void CHashMap<Key_, Value_>::Reserve(uint64 count)
+    {
+        uint64 capacity = 32;
+        while(capacity < count * 2) {
+            capacity *= 2;
+        }
+
+        if(capacity > _capacity) {
+            Rehash(capacity);
+        }
+    }
+
+    template<typename Key_, typename Value_>
+    Value_* CHashMap<Key_, Value_>::Find(const Key_& key)
+    {
+        if(_count == 0) {
+            return nullptr;
+        }
+
+        uint64 slot = FindSlot(key, HashValue(key) | 0x80000000);
+        return _hashes[slot] != 0 ? &_values[slot] : nullptr;
+    }
+
+    template<typename Key_, typename Value_>
+    const Value_* CHashMap<Key_, Value_>::Find(const Key_& key) const
+    {
+        if(_count == 0) {
+            return nullptr;
+        }
+
+        uint64 slot = FindSlot(key, HashValue(key) | 0x80000000);
+        return _hashes[slot] != 0 ? &_values[slot] : nullptr;
+    }
+
+    template<typename Key_, typename Value_>
+    bool CHashMap<Key_, Value_>::Insert(const Key_& key, const Value_& value)
+    {
+        // -- Keep the table at most half full so probe sequences stay short.
+        if((_count + 1) * 2 > _capacity) {
+            Rehash(_capacity < 32 ? 32 : _capacity * 2);
+        }
+
+        uint32 hash = HashValue(key) | 0x80000000;
+        uint64 slot = FindSlot(key, hash);
+        if(_hashes[slot] != 0) {
+            return false;
+        }
+
+        _hashes[slot] = hash;
+        _keys[slot] = key;
+        _values[slot] = value;
+        ++_count;
+
+        return true;
+    }
+
+    template<typename Key_, typename Value_>
+    void CHashMap<Key_, Value_>::Set(const Key_& key, const Value_& value)
+    {
+        Value_* existing = Find(key);
+        if(existing) {
+            *existing = value;
+            return;
+        }
+
+        Insert(key, value);
+    }
+
+    template<typename Key_, typename Value_>
+    bool CHashMap<Key_, Value_>::Remove(const Key_& key)
+    {
+        if(_count == 0) {
+            return false;
+        }
+
+        uint64 mask = _capacity - 1;
+        uint64 slot = FindSlot(key, HashValue(key) | 0x80000000);
+        if(_hashes[slot] == 0) {
+            return false;
+        }
+
+        // -- Backward shift deletion: pull later entries of the probe run into the hole so no tombstones are needed.
+        uint64 hole = slot;
+        uint64 next = (hole + 1) & mask;
+        while(_hashes[next] != 0) {
+            uint64 home = _hashes[next] & mask;
+            if(((next - home) & mask) >= ((next - hole) & mask)) {
+                _hashes[hole] = _hashes[next];
+                _keys[hole] = _keys[next];
+                _values[hole] = _values[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+
+        _hashes[hole] = 0;
+        --_count;
+
+        return true;
+    }
+
+    template<typename Key_, typename Value_>
+    uint64 CHashMap<Key_, Value_>::FindSlot(const Key_& key, uint32 hash) const
+    {
+        // -- Returns the slot holding key or the empty slot it would be inserted into.
+        uint64 mask = _capacity - 1;
+        uint64 slot = hash & mask;
+        while(_hashes[slot] != 0) {
+            if(_hashes[slot] == hash && _keys[slot] == key) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    template<typename Key_, typename Value_>
+    void CHashMap<Key_, Value_>::Rehash(uint64 newCapacity)
+    {
+        Assert_((newCapacity & (newCapacity - 1)) == 0);
+
+        uint32* oldHashes = _hashes;
+        Key_*   oldKeys = _keys;
+        Value_* oldValues = _values;
+        uint64  oldCapacity = _capacity;
+
+        _hashes = AllocArray_(uint32, newCapacity);
+        _keys = AllocArray_(Key_, newCapacity);
+        _values = AllocArray_(Value_, newCapacity);
+        _capacity = newCapacity;
+        Memory::Zero(_hashes, newCapacity * sizeof(uint32));
+
+        uint64 mask = newCapacity - 1;
+        for(uint64 scan = 0; scan < oldCapacity; ++scan) {
+            if(oldHashes[scan] == 0) {
+                continue;
+            }
+
+            uint64 slot = oldHashes[scan] & mask;
+            while(_hashes[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+
+            _hashes[slot] = oldHashes[scan];
+            _keys[slot] = oldKeys[scan];
+            _values[slot] = oldValues[scan];
+        }
+
+        SafeFree_(oldHashes);
+        SafeFree_(oldKeys);
+        SafeFree_(oldValues);
+    }
+}
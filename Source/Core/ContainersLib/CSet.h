@@ -4,12 +4,15 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "ContainersLib/HashValue.h"
 #include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/Memory.h"
 #include "SystemLib/JsAssert.h"
 
 namespace Selas
 {
+    // -- Insertion ordered array of unique elements. Lookups go through an open addressing table of indices into the array so
+    // -- Type_ needs a HashValue overload as well as operator==.
     template <typename Type_>
     class CSet
     {
@@ -36,6 +39,10 @@ namespace Selas
         template<typename OtherType_>
         void   Append(const OtherType_& addend);
 
+        // -- Returns the index of element or InvalidIndex64
+        uint64 Find(const Type_& element) const;
+        bool   Contains(const Type_& element) const { return Find(element) != InvalidIndex64; }
+
         bool Remove(const Type_& item);
         void RemoveFast(uint index);
 
@@ -43,10 +50,21 @@ namespace Selas
         void ReallocateArray(uint64 newLength, uint64 newCapacity);
         void GrowArray(void);
 
+        uint64 FindSlot(const Type_& element, uint32 hash) const;
+        uint64 FindIndexSlot(uint32 hash, uint64 index) const;
+        void   EraseSlot(uint64 slot);
+        void   InsertIndex(uint64 index);
+        void   RebuildIndices(uint64 slotCount);
+
     private:
         Type_ * _data;
         uint64  _count;
         uint64  _capacity;
+
+        // -- Each slot holds the element's hash with the top bit set and its index in _data; zero marks an empty slot.
+        uint32* _slotHashes;
+        uint32* _slotIndices;
+        uint64  _slotCount;
     };
 
     template<typename Type_>
@@ -54,6 +72,9 @@ namespace Selas
         : _data(nullptr)
         , _count(0)
         , _capacity(0)
+        , _slotHashes(nullptr)
+        , _slotIndices(nullptr)
+        , _slotCount(0)
     {
     }
 
@@ -70,15 +91,22 @@ namespace Selas
             Free_(_data);
         }
 
+        SafeFree_(_slotHashes);
+        SafeFree_(_slotIndices);
+
         _data = nullptr;
         _count = 0;
         _capacity = 0;
+        _slotCount = 0;
     }
 
     template<typename Type_>
     void CSet<Type_>::Clear(void)
     {
         _count = 0;
+        if(_slotHashes) {
+            Memory::Zero(_slotHashes, _slotCount * sizeof(uint32));
+        }
     }
 
     template<typename Type_>
@@ -92,11 +120,16 @@ namespace Selas
     template<typename Type_>
     uint64 CSet<Type_>::Add(const Type_& element)
     {
-        // JSTODO - Slow...
-        for(uint64 scan = 0; scan < _count; ++scan) {
-            if(_data[scan] == element) {
-                return scan;
-            }
+        uint32 hash = HashValue(element) | 0x80000000;
+
+        // -- Keep the table at most half full so probe sequences stay short.
+        if((_count + 1) * 2 > _slotCount) {
+            RebuildIndices(_slotCount < 32 ? 32 : _slotCount * 2);
+        }
+
+        uint64 slot = FindSlot(element, hash);
+        if(_slotHashes[slot] != 0) {
+            return _slotIndices[slot];
         }
 
         if(_count == _capacity) {
@@ -105,9 +138,109 @@ namespace Selas
 
         Assert_(_count < _capacity);
         _data[_count] = element;
+
+        _slotHashes[slot] = hash;
+        _slotIndices[slot] = (uint32)_count;
+
         return _count++;
     }
 
+    template<typename Type_>
+    uint64 CSet<Type_>::Find(const Type_& element) const
+    {
+        if(_count == 0) {
+            return InvalidIndex64;
+        }
+
+        uint64 slot = FindSlot(element, HashValue(element) | 0x80000000);
+        return _slotHashes[slot] != 0 ? _slotIndices[slot] : InvalidIndex64;
+    }
+
+    template<typename Type_>
+    uint64 CSet<Type_>::FindSlot(const Type_& element, uint32 hash) const
+    {
+        // -- Returns the slot holding element or the empty slot it would be inserted into.
+        uint64 mask = _slotCount - 1;
+        uint64 slot = hash & mask;
+        while(_slotHashes[slot] != 0) {
+            if(_slotHashes[slot] == hash && _data[_slotIndices[slot]] == element) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    template<typename Type_>
+    uint64 CSet<Type_>::FindIndexSlot(uint32 hash, uint64 index) const
+    {
+        // -- Returns the slot referring to the element at index, which has to be in the table.
+        uint64 mask = _slotCount - 1;
+        uint64 slot = hash & mask;
+        while(_slotIndices[slot] != index || _slotHashes[slot] != hash) {
+            Assert_(_slotHashes[slot] != 0);
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    template<typename Type_>
+    void CSet<Type_>::EraseSlot(uint64 slot)
+    {
+        // -- Backward shift deletion: pull later entries of the probe run into the hole so no tombstones are needed.
+        uint64 mask = _slotCount - 1;
+        uint64 hole = slot;
+        uint64 next = (hole + 1) & mask;
+        while(_slotHashes[next] != 0) {
+            uint64 home = _slotHashes[next] & mask;
+            if(((next - home) & mask) >= ((next - hole) & mask)) {
+                _slotHashes[hole] = _slotHashes[next];
+                _slotIndices[hole] = _slotIndices[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+
+        _slotHashes[hole] = 0;
+    }
+
+    template<typename Type_>
+    void CSet<Type_>::InsertIndex(uint64 index)
+    {
+        uint32 hash = HashValue(_data[index]) | 0x80000000;
+
+        uint64 mask = _slotCount - 1;
+        uint64 slot = hash & mask;
+        while(_slotHashes[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        _slotHashes[slot] = hash;
+        _slotIndices[slot] = (uint32)index;
+    }
+
+    template<typename Type_>
+    void CSet<Type_>::RebuildIndices(uint64 slotCount)
+    {
+        Assert_((slotCount & (slotCount - 1)) == 0);
+
+        if(slotCount != _slotCount) {
+            SafeFree_(_slotHashes);
+            SafeFree_(_slotIndices);
+
+            _slotHashes = AllocArray_(uint32, slotCount);
+            _slotIndices = AllocArray_(uint32, slotCount);
+            _slotCount = slotCount;
+        }
+
+        Memory::Zero(_slotHashes, _slotCount * sizeof(uint32));
+        for(uint64 scan = 0; scan < _count; ++scan) {
+            InsertIndex(scan);
+        }
+    }
+
     template<typename Type_>
     template<typename OtherType_>
     void CSet<Type_>::Append(const OtherType_& addend)
@@ -125,33 +258,49 @@ namespace Selas
     template<typename Type_>
     bool CSet<Type_>::Remove(const Type_& item)
     {
-        uint64 index = 0;
-        for(; index < _count; ++index) {
-            if(_data[index] == item) {
-                break;
-            }
+        if(_count == 0) {
+            return false;
         }
 
-        if(index == _count) {
+        uint64 slot = FindSlot(item, HashValue(item) | 0x80000000);
+        if(_slotHashes[slot] == 0) {
             return false;
         }
 
-        for(; index < _count; ++index) {
-            _data[index] = _data[index + 1];
-        }
+        uint64 index = _slotIndices[slot];
+        EraseSlot(slot);
 
+        for(uint64 scan = index; scan + 1 < _count; ++scan) {
+            _data[scan] = _data[scan + 1];
+        }
         --_count;
 
+        // -- Keeping insertion order means shifting the array, so this stays linear; the indices are patched in place rather
+        // -- than rehashing every element. Use RemoveFast when order doesn't matter.
+        for(uint64 scan = 0; scan < _slotCount; ++scan) {
+            if(_slotHashes[scan] != 0 && _slotIndices[scan] > index) {
+                --_slotIndices[scan];
+            }
+        }
+
         return true;
     }
 
     template<typename Type_>
     void CSet<Type_>::RemoveFast(uint index)
     {
-        Assert_(index >= 0);
         Assert_(index < _count);
 
-        _data[index] = _data[_count - 1];
+        EraseSlot(FindIndexSlot(HashValue(_data[index]) | 0x80000000, index));
+
+        // -- The last element moves into the hole so only its slot needs to change.
+        uint64 last = _count - 1;
+        if(index != last) {
+            uint64 lastSlot = FindIndexSlot(HashValue(_data[last]) | 0x80000000, last);
+            _slotIndices[lastSlot] = (uint32)index;
+            _data[index] = _data[last];
+        }
+
         _count--;
     }
 
@@ -177,15 +326,7 @@ namespace Selas
     template<typename Type_>
     void CSet<Type_>::GrowArray(void)
     {
-        // Idea from old BHG code; seems very sensible.
-        if(_capacity < 64) {
-            ReallocateArray(_count, _capacity + 16);
-        }
-        else if(_capacity < 256) {
-            ReallocateArray(_count, _capacity + 32);
-        }
-        else {
-            ReallocateArray(_count, _capacity + 128);
-        }
+        // -- Grows geometrically so building a large set costs amortized constant time per Add.
+        ReallocateArray(_count, _capacity < 16 ? 16 : _capacity + _capacity / 2);
     }
 }
\ No newline at end of file
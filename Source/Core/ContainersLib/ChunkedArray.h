@@ -0,0 +1,227 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ThreadingLib/Thread.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/BasicTypes.h"
+
+#define MaxChunkedArrayThreads_ 64
+
+namespace Selas
+{
+    // -- Segmented array that any number of threads can append to without a lock. Elements live in fixed size chunks that are
+    // -- never moved so addresses stay valid until Shutdown and growth never copies. Add publishes an index before the element
+    // -- has been written so readers must be ordered after the producers some other way (a join, a queue hand off...).
+    template <typename Type_>
+    class ChunkedArray
+    {
+    public:
+        typedef void (*ChunkFunction)(Type_* elements, uint64 count, uint64 firstIndex, void* userData);
+
+        ChunkedArray(void);
+        ~ChunkedArray(void);
+
+        // -- chunkSize must be a power of two. Capacity is chunkSize * maxChunkCount and only the chunk table is allocated up
+        // -- front.
+        void Initialize(uint32 chunkSize = 1024, uint32 maxChunkCount = 4096);
+        void Shutdown(void);
+
+        // -- Returns the index of the new element
+        uint64 Add(const Type_& element);
+
+        inline Type_&       operator[] (uint64 index) { return ChunkPointer(index >> _chunkShift)[index & _chunkMask]; }
+        inline const Type_& operator[] (uint64 index) const { return ChunkPointer(index >> _chunkShift)[index & _chunkMask]; }
+
+        inline uint64 Count(void) const { return (uint64)_count; }
+
+        uint64 ChunkCount(void) const;
+        Type_* Chunk(uint64 chunkIndex) { return ChunkPointer(chunkIndex); }
+        uint64 ChunkLength(uint64 chunkIndex) const;
+
+        // -- Calls function once per chunk from up to threadCount threads including the calling thread. Returns once every
+        // -- chunk has been visited. Must not overlap with Add.
+        void ParallelForEachChunk(ChunkFunction function, void* userData, uint threadCount);
+
+    private:
+        struct ParallelForData
+        {
+            ChunkedArray<Type_>* array;
+            ChunkFunction function;
+            void* userData;
+            volatile int64 nextChunk;
+        };
+
+        static void ParallelForKernel(void* userData);
+
+        Type_* ChunkPointer(uint64 chunkIndex) const { return (Type_*)_chunks[chunkIndex]; }
+        Type_* AcquireChunk(uint64 chunkIndex);
+
+    private:
+        // -- Chunk pointers are stored as int64 so they can be installed with a CAS.
+        volatile int64* _chunks;
+        uint64          _maxChunkCount;
+        uint32          _chunkShift;
+        uint64          _chunkMask;
+
+        Align_(CacheLineSize_) volatile int64 _count;
+    };
+
+    template <typename Type_>
+    ChunkedArray<Type_>::ChunkedArray(void)
+        : _chunks(nullptr)
+        , _maxChunkCount(0)
+        , _chunkShift(0)
+        , _chunkMask(0)
+        , _count(0)
+    {
+    }
+
+    template <typename Type_>
+    ChunkedArray<Type_>::~ChunkedArray(void)
+    {
+        Assert_(_chunks == nullptr);
+    }
+
+    template <typename Type_>
+    void ChunkedArray<Type_>::Initialize(uint32 chunkSize, uint32 maxChunkCount)
+    {
+        Assert_(chunkSize > 0 && (chunkSize & (chunkSize - 1)) == 0);
+        Assert_(maxChunkCount > 0);
+
+        _chunkShift = 0;
+        while((1u << _chunkShift) < chunkSize) {
+            ++_chunkShift;
+        }
+        _chunkMask = chunkSize - 1;
+
+        _maxChunkCount = maxChunkCount;
+        _chunks = AllocArray_(int64, maxChunkCount);
+        Memory::Zero((void*)_chunks, maxChunkCount * sizeof(int64));
+
+        _count = 0;
+    }
+
+    template <typename Type_>
+    void ChunkedArray<Type_>::Shutdown(void)
+    {
+        if(_chunks == nullptr) {
+            return;
+        }
+
+        for(uint64 scan = 0; scan < _maxChunkCount; ++scan) {
+            Type_* chunk = ChunkPointer(scan);
+            if(chunk) {
+                FreeAligned_(chunk);
+            }
+        }
+
+        Free_((void*)_chunks);
+        _chunks = nullptr;
+        _maxChunkCount = 0;
+        _count = 0;
+    }
+
+    template <typename Type_>
+    Type_* ChunkedArray<Type_>::AcquireChunk(uint64 chunkIndex)
+    {
+        AssertMsg_(chunkIndex < _maxChunkCount, "ChunkedArray capacity exceeded");
+
+        int64 chunk = Atomic::LoadAcquire64(&_chunks[chunkIndex]);
+        if(chunk != 0) {
+            return (Type_*)chunk;
+        }
+
+        // -- Every thread that lands in a missing chunk races to install one; the losers free theirs.
+        Type_* allocated = AllocArrayAligned_(Type_, (_chunkMask + 1), CacheLineSize_);
+        if(Atomic::CompareExchange64(&_chunks[chunkIndex], (int64)allocated, 0)) {
+            return allocated;
+        }
+
+        FreeAligned_(allocated);
+        return (Type_*)Atomic::LoadAcquire64(&_chunks[chunkIndex]);
+    }
+
+    template <typename Type_>
+    uint64 ChunkedArray<Type_>::Add(const Type_& element)
+    {
+        uint64 index = (uint64)Atomic::Increment64(&_count);
+
+        Type_* chunk = AcquireChunk(index >> _chunkShift);
+        chunk[index & _chunkMask] = element;
+
+        return index;
+    }
+
+    template <typename Type_>
+    uint64 ChunkedArray<Type_>::ChunkCount(void) const
+    {
+        return ((uint64)_count + _chunkMask) >> _chunkShift;
+    }
+
+    template <typename Type_>
+    uint64 ChunkedArray<Type_>::ChunkLength(uint64 chunkIndex) const
+    {
+        uint64 first = chunkIndex << _chunkShift;
+        uint64 remaining = (uint64)_count - first;
+        return remaining < _chunkMask + 1 ? remaining : _chunkMask + 1;
+    }
+
+    template <typename Type_>
+    void ChunkedArray<Type_>::ParallelForKernel(void* userData)
+    {
+        ParallelForData* data = (ParallelForData*)userData;
+        ChunkedArray<Type_>* array = data->array;
+
+        uint64 chunkCount = array->ChunkCount();
+        while(true) {
+            uint64 chunkIndex = (uint64)Atomic::Increment64(&data->nextChunk);
+            if(chunkIndex >= chunkCount) {
+                break;
+            }
+
+            data->function(array->Chunk(chunkIndex), array->ChunkLength(chunkIndex), chunkIndex << array->_chunkShift,
+                           data->userData);
+        }
+    }
+
+    template <typename Type_>
+    void ChunkedArray<Type_>::ParallelForEachChunk(ChunkFunction function, void* userData, uint threadCount)
+    {
+        uint64 chunkCount = ChunkCount();
+        if(chunkCount == 0) {
+            return;
+        }
+
+        if(threadCount > chunkCount) {
+            threadCount = (uint)chunkCount;
+        }
+        if(threadCount > MaxChunkedArrayThreads_) {
+            threadCount = MaxChunkedArrayThreads_;
+        }
+
+        ParallelForData data;
+        data.array = this;
+        data.function = function;
+        data.userData = userData;
+        data.nextChunk = 0;
+
+        ThreadHandle threadHandles[MaxChunkedArrayThreads_];
+        for(uint scan = 1; scan < threadCount; ++scan) {
+            threadHandles[scan] = CreateThread(ParallelForKernel, &data, "ChunkedArray", NoThreadAffinity_);
+            Assert_(threadHandles[scan] != InvalidThreadHandle);
+        }
+
+        ParallelForKernel(&data);
+
+        for(uint scan = 1; scan < threadCount; ++scan) {
+            ShutdownThread(threadHandles[scan]);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Hash functions used by CSet and CHashMap. Other key types provide a HashValue overload next to their operator==. The
+    // -- containers reserve the top bit so only the low 31 bits need to be well distributed.
+
+    //=============================================================================================================================
+    inline uint32 HashValue(uint64 key)
+    {
+        // -- splitmix64 finalizer
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ull;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebull;
+        key ^= key >> 31;
+
+        return (uint32)key;
+    }
+
+    //=============================================================================================================================
+    inline uint32 HashValue(uint32 key)
+    {
+        return HashValue((uint64)key);
+    }
+
+    //=============================================================================================================================
+    inline uint32 HashValue(int32 key)
+    {
+        return HashValue((uint64)(uint32)key);
+    }
+
+    //=============================================================================================================================
+    inline uint32 HashValue(int64 key)
+    {
+        return HashValue((uint64)key);
+    }
+
+    //=============================================================================================================================
+    template <typename Type_>
+    inline uint32 HashValue(Type_* key)
+    {
+        return HashValue((uint64)key);
+    }
+
+    //=============================================================================================================================
+    inline uint32 HashCombine(uint32 lhs, uint32 rhs)
+    {
+        return HashValue(((uint64)lhs << 32) | rhs);
+    }
+}
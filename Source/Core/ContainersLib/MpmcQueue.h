@@ -0,0 +1,155 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's design). Each cell carries a sequence number
+    // -- that tells producers and consumers whether it is their turn so the only contended writes are the CAS on the ends.
+    // -- Type_ is copied in and out and should be small; pointers are the expected use.
+    template <typename Type_>
+    class MpmcQueue
+    {
+    public:
+        MpmcQueue(void);
+        ~MpmcQueue(void);
+
+        // -- capacity must be a power of two
+        void Initialize(uint32 capacity);
+        void Shutdown(void);
+
+        // -- Both return false rather than waiting when the queue is full or empty.
+        bool TryPush(const Type_& item);
+        bool TryPop(Type_& item);
+
+        // -- Only a hint while other threads are pushing or popping.
+        bool Empty(void);
+
+    private:
+        struct Cell
+        {
+            volatile int64 sequence;
+            Type_ data;
+        };
+
+        Cell* _cells;
+        int64 _mask;
+
+        Align_(CacheLineSize_) volatile int64 _enqueuePosition;
+        Align_(CacheLineSize_) volatile int64 _dequeuePosition;
+    };
+
+    template <typename Type_>
+    MpmcQueue<Type_>::MpmcQueue(void)
+        : _cells(nullptr)
+        , _mask(0)
+        , _enqueuePosition(0)
+        , _dequeuePosition(0)
+    {
+    }
+
+    template <typename Type_>
+    MpmcQueue<Type_>::~MpmcQueue(void)
+    {
+        Assert_(_cells == nullptr);
+    }
+
+    template <typename Type_>
+    void MpmcQueue<Type_>::Initialize(uint32 capacity)
+    {
+        Assert_(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+
+        _cells = AllocArrayAligned_(Cell, capacity, CacheLineSize_);
+        _mask = (int64)capacity - 1;
+        for(uint32 scan = 0; scan < capacity; ++scan) {
+            _cells[scan].sequence = (int64)scan;
+        }
+
+        _enqueuePosition = 0;
+        _dequeuePosition = 0;
+    }
+
+    template <typename Type_>
+    void MpmcQueue<Type_>::Shutdown(void)
+    {
+        AssertMsg_(Empty(), "MpmcQueue being shutdown while it still has valid entries");
+
+        SafeFreeAligned_(_cells);
+        _mask = 0;
+    }
+
+    template <typename Type_>
+    bool MpmcQueue<Type_>::TryPush(const Type_& item)
+    {
+        Cell* cell;
+        int64 position = _enqueuePosition;
+        while(true) {
+            cell = &_cells[position & _mask];
+            int64 sequence = Atomic::LoadAcquire64(&cell->sequence);
+            int64 difference = sequence - position;
+
+            if(difference == 0) {
+                if(Atomic::CompareExchange64(&_enqueuePosition, position + 1, position)) {
+                    break;
+                }
+                position = _enqueuePosition;
+            }
+            else if(difference < 0) {
+                // -- The consumer a full lap behind hasn't released this cell yet.
+                return false;
+            }
+            else {
+                position = _enqueuePosition;
+            }
+        }
+
+        cell->data = item;
+        Atomic::StoreRelease64(&cell->sequence, position + 1);
+
+        return true;
+    }
+
+    template <typename Type_>
+    bool MpmcQueue<Type_>::TryPop(Type_& item)
+    {
+        Cell* cell;
+        int64 position = _dequeuePosition;
+        while(true) {
+            cell = &_cells[position & _mask];
+            int64 sequence = Atomic::LoadAcquire64(&cell->sequence);
+            int64 difference = sequence - (position + 1);
+
+            if(difference == 0) {
+                if(Atomic::CompareExchange64(&_dequeuePosition, position + 1, position)) {
+                    break;
+                }
+                position = _dequeuePosition;
+            }
+            else if(difference < 0) {
+                return false;
+            }
+            else {
+                position = _dequeuePosition;
+            }
+        }
+
+        item = cell->data;
+        Atomic::StoreRelease64(&cell->sequence, position + _mask + 1);
+
+        return true;
+    }
+
+    template <typename Type_>
+    bool MpmcQueue<Type_>::Empty(void)
+    {
+        return _dequeuePosition >= _enqueuePosition;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Bounded Chase-Lev deque. The owning thread pushes and pops at the bottom without contention while any other thread
+    // -- can steal from the top. Only the last remaining item is ever contended. Type_ is read before the steal is confirmed so
+    // -- it must be safe to copy while the owner overwrites it; pointers and indices are the expected use.
+    template <typename Type_>
+    class WorkStealingDeque
+    {
+    public:
+        WorkStealingDeque(void);
+        ~WorkStealingDeque(void);
+
+        // -- capacity must be a power of two
+        void Initialize(uint32 capacity);
+        void Shutdown(void);
+
+        // -- Owner thread only. Push returns false when the deque is full.
+        bool Push(const Type_& item);
+        bool Pop(Type_& item);
+
+        // -- Any thread. Returns false when the deque is empty or another thread won the race for the item.
+        bool Steal(Type_& item);
+
+        // -- Only a hint while other threads are stealing.
+        bool Empty(void);
+
+    private:
+        Type_* _items;
+        int64  _mask;
+
+        Align_(CacheLineSize_) volatile int64 _top;
+        Align_(CacheLineSize_) volatile int64 _bottom;
+    };
+
+    template <typename Type_>
+    WorkStealingDeque<Type_>::WorkStealingDeque(void)
+        : _items(nullptr)
+        , _mask(0)
+        , _top(0)
+        , _bottom(0)
+    {
+    }
+
+    template <typename Type_>
+    WorkStealingDeque<Type_>::~WorkStealingDeque(void)
+    {
+        Assert_(_items == nullptr);
+    }
+
+    template <typename Type_>
+    void WorkStealingDeque<Type_>::Initialize(uint32 capacity)
+    {
+        Assert_(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+
+        _items = AllocArrayAligned_(Type_, capacity, CacheLineSize_);
+        _mask = (int64)capacity - 1;
+        _top = 0;
+        _bottom = 0;
+    }
+
+    template <typename Type_>
+    void WorkStealingDeque<Type_>::Shutdown(void)
+    {
+        AssertMsg_(Empty(), "WorkStealingDeque being shutdown while it still has valid entries");
+
+        SafeFreeAligned_(_items);
+        _mask = 0;
+    }
+
+    template <typename Type_>
+    bool WorkStealingDeque<Type_>::Push(const Type_& item)
+    {
+        int64 bottom = _bottom;
+        int64 top = Atomic::LoadAcquire64(&_top);
+        if(bottom - top > _mask) {
+            return false;
+        }
+
+        _items[bottom & _mask] = item;
+        Atomic::StoreRelease64(&_bottom, bottom + 1);
+
+        return true;
+    }
+
+    template <typename Type_>
+    bool WorkStealingDeque<Type_>::Pop(Type_& item)
+    {
+        int64 bottom = _bottom - 1;
+        _bottom = bottom;
+
+        // -- The bottom has to be visible to stealers before the top is read or both sides could take the last item.
+        Atomic::FullBarrier();
+
+        int64 top = _top;
+        if(top > bottom) {
+            _bottom = bottom + 1;
+            return false;
+        }
+
+        item = _items[bottom & _mask];
+        if(top != bottom) {
+            return true;
+        }
+
+        // -- Last item so race any stealers for it.
+        bool won = Atomic::CompareExchange64(&_top, top + 1, top);
+        _bottom = bottom + 1;
+
+        return won;
+    }
+
+    template <typename Type_>
+    bool WorkStealingDeque<Type_>::Steal(Type_& item)
+    {
+        int64 top = Atomic::LoadAcquire64(&_top);
+        Atomic::FullBarrier();
+        int64 bottom = Atomic::LoadAcquire64(&_bottom);
+
+        if(top >= bottom) {
+            return false;
+        }
+
+        item = _items[top & _mask];
+        return Atomic::CompareExchange64(&_top, top + 1, top);
+    }
+
+    template <typename Type_>
+    bool WorkStealingDeque<Type_>::Empty(void)
+    {
+        return _top >= _bottom;
+    }
+}
@@ -85,6 +85,25 @@ namespace Selas
         return result;
     }
 
+    //=============================================================================================================================
+    bool WorldToImage(const RayCastCameraSettings* __restrict camera, float3 position, float2& image)
+    {
+        float3 toPosition = position - camera->position;
+
+        float depth = Dot(toPosition, camera->cameraZ);
+        if(depth <= 0.0f) {
+            return false;
+        }
+
+        float2 clip;
+        clip.x = -Dot(toPosition, camera->cameraX) / (LengthSquared(camera->cameraX) * depth);
+        clip.y = Dot(toPosition, camera->cameraY) / (LengthSquared(camera->cameraY) * depth);
+
+        image.x = (clip.x + 1.0f) * 0.5f * camera->width;
+        image.y = (1.0f - clip.y) * 0.5f * camera->height;
+        return true;
+    }
+
     //=============================================================================================================================
     void InitializeRayCastCamera(const CameraSettings& settings, uint width, uint height, RayCastCameraSettings& camera)
     {
@@ -109,7 +128,7 @@ namespace Selas
         camera.position                  = settings.position;
         camera.znear                     = settings.znear;
         camera.zfar                      = settings.zfar;
-        camera.virtualImagePlaneDistance = widthf / (2.0f * Math::Tanf(horizontalFov));
+        camera.virtualImagePlaneDistance = widthf / (2.0f * hLength);
         camera.width                     = width;
         camera.height                    = height;
         camera.aspect                    = aspect;
@@ -55,6 +55,8 @@ namespace Selas
 
     Ray JitteredCameraRay(const RayCastCameraSettings* __restrict camera, CSampler* sampler, float viewX, float viewY);
     Ray JitteredCameraRay(const RayCastCameraSettings* __restrict camera, int32 x, int32 y, int32 s, int32 m, int32 n, int32 p);
+    // -- Inverse of the camera ray generation. Returns false for positions that are not in front of the camera.
+    bool WorldToImage(const RayCastCameraSettings* __restrict camera, float3 position, float2& image);
 
     void InitializeRayCastCamera(const CameraSettings& settings, uint width, uint height, RayCastCameraSettings& camera);
 }
\ No newline at end of file
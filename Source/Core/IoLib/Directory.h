@@ -4,11 +4,17 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "StringLib/FixedString.h"
+#include "ContainersLib/CArray.h"
+
 namespace Selas
 {
     //=============================================================================================================================
     namespace Directory
     {
         void EnsureDirectoryExists(const char* path);
+
+        // -- Appends the full paths of the files directly inside of the directory that end with the given extension.
+        void GetFiles(const char* directory, const char* extension, CArray<FilePathString>& filepaths);
     }
 }
\ No newline at end of file
@@ -2,13 +2,14 @@
 // Joe Schutte
 //=================================================================================================================================
 
-#if IsOsx_
+#if IsOsx_ || IsLinux_
 
 #include "IoLib/Directory.h"
 #include "StringLib/FixedString.h"
 #include "SystemLib/MinMax.h"
 
 #include <sys/stat.h>
+#include <dirent.h>
 
 namespace Selas
 {
@@ -55,6 +56,26 @@ namespace Selas
 
             CreateDirectory(folderName.Ascii());
         }
+
+        //=========================================================================================================================
+        void GetFiles(const char* directory, const char* extension, CArray<FilePathString>& filepaths)
+        {
+            DIR* dir = opendir(directory);
+            if(dir == nullptr) {
+                return;
+            }
+
+            while(dirent* entry = readdir(dir)) {
+                if(entry->d_type != DT_REG || StringUtil::EndsWithIgnoreCase(entry->d_name, extension) == false) {
+                    continue;
+                }
+
+                FilePathString& filepath = filepaths.Add();
+                FixedStringSprintf(filepath, "%s/%s", directory, entry->d_name);
+            }
+
+            closedir(dir);
+        }
     }
 }
 #endif
\ No newline at end of file
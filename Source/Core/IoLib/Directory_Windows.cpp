@@ -45,6 +45,30 @@ namespace Selas
 
             ::CreateDirectoryA(folderName.Ascii(), nullptr);
         }
+
+        //=========================================================================================================================
+        void GetFiles(const char* directory, const char* extension, CArray<FilePathString>& filepaths)
+        {
+            FilePathString search;
+            FixedStringSprintf(search, "%s\\*%s", directory, extension);
+
+            WIN32_FIND_DATAA findData;
+            HANDLE handle = ::FindFirstFileA(search.Ascii(), &findData);
+            if(handle == INVALID_HANDLE_VALUE) {
+                return;
+            }
+
+            do {
+                if(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    continue;
+                }
+
+                FilePathString& filepath = filepaths.Add();
+                FixedStringSprintf(filepath, "%s\\%s", directory, findData.cFileName);
+            } while(::FindNextFileA(handle, &findData));
+
+            ::FindClose(handle);
+        }
     }
 }
 #endif
\ No newline at end of file
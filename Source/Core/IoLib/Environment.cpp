@@ -22,7 +22,7 @@ namespace Selas
         FixedString64 keyDir;
         #if IsWindows_
             sprintf_s(keyDir.Ascii(), keyDir.Capacity(), "%s%c_BuildTemp", projectName, pathSep);
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             snprintf(keyDir.Ascii(), keyDir.Capacity(), "%s%c_BuildTemp", projectName, pathSep);
         #endif
 
@@ -4,6 +4,7 @@
 
 #include "IoLib/File.h"
 
+#include "SystemLib/ArenaAllocator.h"
 #include "SystemLib/JsAssert.h"
 #include "SystemLib/MemoryAllocation.h"
 
@@ -29,7 +30,7 @@ namespace Selas
 
             #if IsWindows_
                 fopen_s(&result, filepath, mode);
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 result = fopen(filepath, mode);
             #endif
 
@@ -37,7 +38,17 @@ namespace Selas
         }
 
         //=========================================================================================================================
-        Error ReadWholeFile(const char* filepath, void** __restrict fileData, uint64* __restrict fileSize)
+        static uint64 FileTell_(FILE* file)
+        {
+            #if IsWindows_
+                return (uint64)_ftelli64(file);
+            #elif IsOsx_ || IsLinux_
+                return (uint64)ftello(file);
+            #endif
+        }
+
+        //=========================================================================================================================
+        static Error ReadWholeFile_(cpointer filepath, ArenaAllocator* arena, void** fileData, uint64* fileSize)
         {
             FILE* file = OpenFile_(filepath, "rb");
             if(file == nullptr) {
@@ -45,12 +56,20 @@ namespace Selas
             }
 
             fseek(file, 0, SEEK_END);
-            *fileSize = _ftelli64(file);
+            *fileSize = FileTell_(file);
             fseek(file, 0, SEEK_SET);
 
-            *fileData = AllocAligned_(*fileSize, 16);
+            // -- Without an arena the caller owns the data and releases it with FreeAligned_
+            if(arena != nullptr) {
+                *fileData = ArenaAlloc_(arena, *fileSize, 16);
+            }
+            else {
+                *fileData = AllocAligned_(*fileSize, 16);
+            }
+
             if(*fileData == nullptr) {
-                return Error_("Failed to make allocation of size %u for file %s:", fileSize, filepath);
+                fclose(file);
+                return Error_("Failed to make allocation of size %llu for file %s:", *fileSize, filepath);
             }
 
             size_t bytesRead = fread(*fileData, 1, *fileSize, file);
@@ -62,6 +81,19 @@ namespace Selas
             return Success_;
         }
 
+        //=========================================================================================================================
+        Error ReadWholeFile(const char* filepath, void** __restrict fileData, uint64* __restrict fileSize)
+        {
+            return ReadWholeFile_(filepath, nullptr, fileData, fileSize);
+        }
+
+        //=========================================================================================================================
+        Error ReadWholeFile(cpointer filepath, ArenaAllocator* arena, void** fileData, uint64* fileSize)
+        {
+            Assert_(arena != nullptr);
+            return ReadWholeFile_(filepath, arena, fileData, fileSize);
+        }
+
         //=========================================================================================================================
         Error ReadWhileFileAsString(cpointer filepath, char** string, uint64* stringSize)
         {
@@ -71,12 +103,13 @@ namespace Selas
             }
 
             fseek(file, 0, SEEK_END);
-            uint64 fileSize = _ftelli64(file);
+            uint64 fileSize = FileTell_(file);
             fseek(file, 0, SEEK_SET);
 
             *string = (char*)AllocAligned_(fileSize + 1, 16);
             if(*string == nullptr) {
-                return Error_("Failed to make allocation of size %u for file %s:", fileSize + 1, filepath);
+                fclose(file);
+                return Error_("Failed to make allocation of size %llu for file %s:", fileSize + 1, filepath);
             }
 
             size_t bytesRead = fread(*string, 1, fileSize, file);
@@ -109,6 +142,16 @@ namespace Selas
             return Success_;
         }
 
+        //=========================================================================================================================
+        Error Delete(cpointer filepath)
+        {
+            if(remove(filepath) != 0) {
+                return Error_("Failed to delete file: %s", filepath);
+            }
+
+            return Success_;
+        }
+
         //=========================================================================================================================
         Error Size(cpointer filepath, uint64& size)
         {
@@ -118,7 +161,7 @@ namespace Selas
             }
 
             fseek(file, 0, SEEK_END);
-            size = _ftelli64(file);
+            size = FileTell_(file);
             fseek(file, 0, SEEK_SET);
 
             fclose(file);
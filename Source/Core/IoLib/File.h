@@ -9,14 +9,18 @@
 
 namespace Selas
 {
+    struct ArenaAllocator;
+
     #define MaxPath_ 512
 
     //=============================================================================================================================
     namespace File
     {
         Error ReadWholeFile(cpointer filepath, void** fileData, uint64* fileSize);
+        Error ReadWholeFile(cpointer filepath, ArenaAllocator* arena, void** fileData, uint64* fileSize);
         Error ReadWhileFileAsString(cpointer filepath, char** string, uint64* stringSize);
         Error WriteWholeFile(cpointer filepath, const void* data, uint64 size);
+        Error Delete(cpointer filepath);
 
         Error Size(cpointer filepath, uint64& size);
 
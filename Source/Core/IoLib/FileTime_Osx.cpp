@@ -2,7 +2,7 @@
 // Joe Schutte
 //=================================================================================================================================
 
-#if IsOsx_
+#if IsOsx_ || IsLinux_
 
 #include "IoLib/FileTime.h"
 #include "SystemLib/Memory.h"
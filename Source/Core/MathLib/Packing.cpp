@@ -0,0 +1,120 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/Packing.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/MinMax.h"
+
+#include <math.h>
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static float SignNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    //=============================================================================================================================
+    static uint32 PackSnorm16(float value)
+    {
+        return (uint32)Math::Floor(Clamp(value, -1.0f, 1.0f) * 32767.0f + 32767.5f);
+    }
+
+    //=============================================================================================================================
+    static float UnpackSnorm16(uint32 packed)
+    {
+        return Clamp(((float)packed - 32767.0f) * (1.0f / 32767.0f), -1.0f, 1.0f);
+    }
+
+    //=============================================================================================================================
+    uint32 Math::PackOctahedral(float3 unitVector)
+    {
+        float l1Norm = Math::Absf(unitVector.x) + Math::Absf(unitVector.y) + Math::Absf(unitVector.z);
+        float x = unitVector.x / l1Norm;
+        float y = unitVector.y / l1Norm;
+
+        // -- Fold the lower hemisphere over the diagonals
+        if(unitVector.z < 0.0f) {
+            float foldedX = (1.0f - Math::Absf(y)) * SignNotZero(x);
+            float foldedY = (1.0f - Math::Absf(x)) * SignNotZero(y);
+            x = foldedX;
+            y = foldedY;
+        }
+
+        return PackSnorm16(x) | (PackSnorm16(y) << 16);
+    }
+
+    //=============================================================================================================================
+    float3 Math::UnpackOctahedral(uint32 packed)
+    {
+        float x = UnpackSnorm16(packed & 0xFFFF);
+        float y = UnpackSnorm16(packed >> 16);
+        float z = 1.0f - Math::Absf(x) - Math::Absf(y);
+
+        if(z < 0.0f) {
+            float unfoldedX = (1.0f - Math::Absf(y)) * SignNotZero(x);
+            float unfoldedY = (1.0f - Math::Absf(x)) * SignNotZero(y);
+            x = unfoldedX;
+            y = unfoldedY;
+        }
+
+        return Normalize(float3(x, y, z));
+    }
+
+    //=============================================================================================================================
+    uint32 Math::PackRgbe(float3 color)
+    {
+        float r = Max(color.x, 0.0f);
+        float g = Max(color.y, 0.0f);
+        float b = Max(color.z, 0.0f);
+
+        float maxChannel = Max(r, Max(g, b));
+        if(maxChannel < 1e-37f) {
+            return 0;
+        }
+
+        // -- Scale so the largest channel lands in [128, 256) and step the exponent if rounding carries it to 256.
+        int32 exponent;
+        ::frexpf(maxChannel, &exponent);
+        if((uint32)(::ldexpf(maxChannel, 8 - exponent) + 0.5f) > 255) {
+            ++exponent;
+        }
+
+        if(exponent + 128 > 255) {
+            return 0xFFFFFFFF;
+        }
+
+        uint32 red   = (uint32)(::ldexpf(r, 8 - exponent) + 0.5f);
+        uint32 green = (uint32)(::ldexpf(g, 8 - exponent) + 0.5f);
+        uint32 blue  = (uint32)(::ldexpf(b, 8 - exponent) + 0.5f);
+
+        return red | (green << 8) | (blue << 16) | ((uint32)(exponent + 128) << 24);
+    }
+
+    //=============================================================================================================================
+    float3 Math::UnpackRgbe(uint32 packed)
+    {
+        uint32 exponent = packed >> 24;
+        if(exponent == 0) {
+            return float3::Zero_;
+        }
+
+        float scale = ::ldexpf(1.0f, (int32)exponent - 128 - 8);
+        return float3((float)(packed & 0xFF) * scale, (float)((packed >> 8) & 0xFF) * scale, (float)((packed >> 16) & 0xFF) * scale);
+    }
+
+    //=============================================================================================================================
+    uint16 Math::PackUnorm16(float value)
+    {
+        return (uint16)(Saturate(value) * 65535.0f + 0.5f);
+    }
+
+    //=============================================================================================================================
+    float Math::UnpackUnorm16(uint16 packed)
+    {
+        return (float)packed * (1.0f / 65535.0f);
+    }
+}
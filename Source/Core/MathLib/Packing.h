@@ -0,0 +1,27 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    namespace Math
+    {
+        // -- Unit vector folded onto an octahedron and stored as two 16 bit snorms. Worst case error is under 0.004 degrees.
+        uint32 PackOctahedral(float3 unitVector);
+        float3 UnpackOctahedral(uint32 packed);
+
+        // -- Non-negative color with 8 bit mantissas sharing an 8 bit exponent. Unlike RGB9E5 this covers the whole float range
+        // -- so values that are not normalized survive; each channel is accurate to within 0.4% of the largest channel.
+        uint32 PackRgbe(float3 color);
+        float3 UnpackRgbe(uint32 packed);
+
+        // -- [0, 1] stored as a 16 bit unorm with round to nearest
+        uint16 PackUnorm16(float value);
+        float UnpackUnorm16(uint16 packed);
+    }
+}
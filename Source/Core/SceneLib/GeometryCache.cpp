@@ -52,6 +52,9 @@ namespace Selas
     {
         loadedGeometrySize = 0;
         loadedGeometryCapacity = cacheSize;
+        pinnedGeometrySize = 0;
+        hitCount = 0;
+        missCount = 0;
         spinlock = CreateSpinLock();
         startTime = SystemTime::Now();
     }
@@ -63,6 +66,22 @@ namespace Selas
         spinlock = nullptr;
     }
 
+    //=============================================================================================================================
+    void GeometryCache::Resize(uint64 cacheSize)
+    {
+        EnterSpinLock(spinlock);
+        loadedGeometryCapacity = cacheSize > pinnedGeometrySize ? cacheSize - pinnedGeometrySize : 0;
+        LeaveSpinLock(spinlock);
+    }
+
+    //=============================================================================================================================
+    void GeometryCache::GetMemoryStats(MemoryConsumerStats& stats)
+    {
+        stats.usedBytes = loadedGeometrySize + pinnedGeometrySize;
+        stats.hitCount = hitCount;
+        stats.missCount = missCount;
+    }
+
     //=============================================================================================================================
     void GeometryCache::RegisterSubscenes(SubsceneResource** subscenes_, uint64 subsceneCount)
     {
@@ -83,6 +102,7 @@ namespace Selas
             if(StringUtil::EqualsIgnoreCase(subscenes[scan]->data->name.Ascii(), name)) {
 
                 EnsureSubsceneGeometryLoaded(subscenes[scan]);
+                subscenes[scan]->pinned = 1;
                 break;
             }
         }
@@ -92,6 +112,7 @@ namespace Selas
 
         loadedGeometryCapacity -= deltaSize;
         loadedGeometrySize -= deltaSize;
+        pinnedGeometrySize += deltaSize;
 
         Assert_(loadedGeometrySize == 0);
     }
@@ -113,6 +134,7 @@ namespace Selas
                 }
 
                 loadedGeometrySize += subsceneSizeEstimate;
+                ++missCount;
 
                 subscene->geometryLoading = 1;
                 LeaveSpinLock(spinlock);
@@ -126,6 +148,9 @@ namespace Selas
                 LeaveSpinLock(spinlock);
             }
         }
+        else {
+            Atomic::AddU64(&hitCount, 1);
+        }
 
         while(subscene->geometryLoading == 1) { }
         Assert_(subscene->geometryLoaded == 1);
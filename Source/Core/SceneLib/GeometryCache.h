@@ -5,6 +5,7 @@
 //=================================================================================================================================
 
 #include "ContainersLib/CArray.h"
+#include "SystemLib/MemoryGovernor.h"
 #include "SystemLib/SystemTime.h"
 #include "SystemLib/BasicTypes.h"
 
@@ -20,6 +21,12 @@ namespace Selas
         void* spinlock;
         volatile uint64 loadedGeometrySize;
         uint64 loadedGeometryCapacity;
+        // -- Preloaded subscenes are never unloaded so they come off the top of the budget.
+        uint64 pinnedGeometrySize;
+
+        // -- Hits are counted outside the spinlock so they are atomic; misses are only counted under it.
+        volatile uint64 hitCount;
+        uint64 missCount;
         std::chrono::high_resolution_clock::time_point startTime;
 
         CArray<SubsceneResource*> subscenes;
@@ -32,6 +39,10 @@ namespace Selas
         void Initialize(uint64 cacheSize);
         void Shutdown();
 
+        // -- Shrinking takes effect as subscenes are loaded; loaded geometry isn't evicted until then.
+        void Resize(uint64 cacheSize);
+        void GetMemoryStats(MemoryConsumerStats& stats);
+
         void RegisterSubscenes(SubsceneResource** subscenes, uint64 subsceneCount);
         void PreloadSubscene(cpointer name);
 
@@ -1,4 +1,5 @@
 
 local platform = ...
 
-loadfile(RootDirectory .. "ProjectGen\\Middlewares\\embree.lua")(platform)
\ No newline at end of file
+loadfile(RootDirectory .. "ProjectGen\\Middlewares\\embree.lua")(platform)
+loadfile(RootDirectory .. "ProjectGen\\Middlewares\\tbb.lua")(platform)
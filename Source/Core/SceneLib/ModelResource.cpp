@@ -10,6 +10,7 @@
 #include "MathLib/FloatStructs.h"
 #include "IoLib/File.h"
 #include "IoLib/BinaryStreamSerializer.h"
+#include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/BasicTypes.h"
 
 #include "embree3/rtcore.h"
@@ -233,7 +234,7 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    static Error InitializeMeshes(ModelResource* model, RTCDevice rtcDevice, RTCScene rtcScene, uint32& offset)
+    static Error InitializeMeshes(ModelResource* model, RTCDevice rtcDevice, RTCScene rtcScene, bool replica, uint32& offset)
     {
         ModelResourceData* modelData = model->data;
         ModelGeometryData* geometry = model->geometry;
@@ -282,7 +283,9 @@ namespace Selas
                 rtcSetGeometryIntersectFilterFunction(rtcGeometry, IntersectionFilter);
             }
 
-            userData.rtcGeometry = rtcGeometry;
+            if(replica == false) {
+                userData.rtcGeometry = rtcGeometry;
+            }
 
             rtcSetGeometryUserData(rtcGeometry, &userData);
             rtcCommitGeometry(rtcGeometry);
@@ -296,7 +299,7 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    static Error InitializeCurves(ModelResource* model, RTCDevice rtcDevice, RTCScene rtcScene, uint32& offset)
+    static Error InitializeCurves(ModelResource* model, RTCDevice rtcDevice, RTCScene rtcScene, bool replica, uint32& offset)
     {
         ModelResourceData* modelData = model->data;
         ModelGeometryData* geometry = model->geometry;
@@ -318,7 +321,9 @@ namespace Selas
                                        0, sizeof(float4), modelData->totalCurveVertexCount);
            
             ModelGeometryUserData& userData = model->userDatas[offset];
-            userData.rtcGeometry = rtcGeometry;
+            if(replica == false) {
+                userData.rtcGeometry = rtcGeometry;
+            }
             
             rtcSetGeometryUserData(rtcGeometry, &userData);
             rtcCommitGeometry(rtcGeometry);
@@ -393,6 +398,13 @@ namespace Selas
     //=============================================================================================================================
     uint64 ModelGeometrySize(ModelResource* model)
     {
+        if(model->residentGeometry != nullptr) {
+            const ModelGeometryData* geometry = model->residentGeometry;
+            return sizeof(ModelGeometryData) + geometry->indexSize + geometry->faceIndexSize + geometry->positionSize
+                 + geometry->normalsSize + geometry->tangentsSize + geometry->uvsSize + geometry->curveIndexSize
+                 + geometry->curveVertexSize;
+        }
+
         FilePathString filepath;
         AssetFileUtils::AssetFilePath(ModelResource::kGeometryDataType, ModelResource::kDataVersion, model->name.Ascii(),
                                       filepath);
@@ -413,6 +425,7 @@ namespace Selas
     ModelResource::ModelResource()
         : data(nullptr)
         , geometry(nullptr)
+        , residentGeometry(nullptr)
         , rtcScene(nullptr)
         , defaultMaterial(nullptr)
     {
@@ -424,6 +437,7 @@ namespace Selas
     {
         Assert_(data == nullptr);
         Assert_(geometry == nullptr);
+        Assert_(residentGeometry == nullptr);
         Assert_(rtcScene == nullptr);
     }
 
@@ -453,24 +467,47 @@ namespace Selas
     //=============================================================================================================================
     Error LoadModelGeometry(ModelResource* model, RTCDevice rtcDevice)
     {
+        MemoryTagScope_(eMemoryTagGeometry);
+
         Assert_(model->geometry == nullptr);
 
-        FilePathString filepath;
-        AssetFileUtils::AssetFilePath(ModelResource::kGeometryDataType, ModelResource::kDataVersion, model->name.Ascii(),
-                                      filepath);
+        if(model->residentGeometry != nullptr) {
+            model->geometry = model->residentGeometry;
+        }
+        else {
+            FilePathString filepath;
+            AssetFileUtils::AssetFilePath(ModelResource::kGeometryDataType, ModelResource::kDataVersion, model->name.Ascii(),
+                                          filepath);
 
-        void* fileData = nullptr;
-        uint64 fileSize = 0;
-        ReturnError_(File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize));
+            void* fileData = nullptr;
+            uint64 fileSize = 0;
+            ReturnError_(File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize));
 
-        AttachToBinary(model->geometry, (uint8*)fileData, fileSize);
+            AttachToBinary(model->geometry, (uint8*)fileData, fileSize);
+        }
 
         RTCScene rtcScene = rtcNewScene(rtcDevice);
         model->rtcScene = rtcScene;
 
         uint32 offset = 0;
-        ReturnError_(InitializeMeshes(model, rtcDevice, rtcScene, offset));
-        ReturnError_(InitializeCurves(model, rtcDevice, rtcScene, offset));
+        ReturnError_(InitializeMeshes(model, rtcDevice, rtcScene, false, offset));
+        ReturnError_(InitializeCurves(model, rtcDevice, rtcScene, false, offset));
+
+        rtcCommitScene(rtcScene);
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    Error CreateModelSceneReplica(ModelResource* model, RTCDevice rtcDevice, RTCScene& rtcScene)
+    {
+        Assert_(model->geometry != nullptr);
+
+        rtcScene = rtcNewScene(rtcDevice);
+
+        uint32 offset = 0;
+        ReturnError_(InitializeMeshes(model, rtcDevice, rtcScene, true, offset));
+        ReturnError_(InitializeCurves(model, rtcDevice, rtcScene, true, offset));
 
         rtcCommitScene(rtcScene);
 
@@ -485,7 +522,12 @@ namespace Selas
         }
         model->rtcScene = nullptr;
 
-        SafeFreeAligned_(model->geometry);
+        if(model->geometry == model->residentGeometry) {
+            model->geometry = nullptr;
+        }
+        else {
+            SafeFreeAligned_(model->geometry);
+        }
     }
 
     //=============================================================================================================================
@@ -515,6 +557,7 @@ namespace Selas
         model->userDatas.Shutdown();
 
         SafeDelete_(model->defaultMaterial);
+        SafeFreeAligned_(model->residentGeometry);
         SafeFreeAligned_(model->data);
     }
 }
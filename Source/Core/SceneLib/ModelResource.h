@@ -179,6 +179,9 @@ namespace Selas
         ModelResourceData* data;
         ModelGeometryData* geometry;
 
+        // -- When set the geometry is owned by the model for its whole lifetime rather than streamed from disk.
+        ModelGeometryData* residentGeometry;
+
         FixedString256 name;
         uint64 geometrySize;
         RTCScene rtcScene;
@@ -198,6 +201,9 @@ namespace Selas
     
     Error LoadModelGeometry(ModelResource* model, RTCDevice rtcDevice);
     void UnloadModelGeometry(ModelResource* model);
+    // -- Builds a second BVH over the loaded geometry with the same geometry ids. The vertex buffers are shared and shading
+    // -- keeps using the primary geometry handles so the replica is only used for traversal.
+    Error CreateModelSceneReplica(ModelResource* model, RTCDevice rtcDevice, RTCScene& rtcScene);
 
     Error InitializeModelResource(ModelResource* model, SubsceneResource* subscene, cpointer assetname, uint64 lightSetIndex,
                                   const CArray<Hash32>& sceneMaterialNames, const CArray<MaterialResourceData> sceneMaterials,
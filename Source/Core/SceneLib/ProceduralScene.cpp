@@ -0,0 +1,431 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SceneLib/ProceduralScene.h"
+#include "SceneLib/ImageBasedLightResource.h"
+#include "TextureLib/TextureCache.h"
+#include "UtilityLib/QuickSort.h"
+#include "StringLib/StringUtil.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "MathLib/Projection.h"
+#include "IoLib/BinaryStreamSerializer.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/BasicTypes.h"
+
+// -- Fine enough that a sun a few degrees across covers a good number of texels
+#define ProceduralIblWidth_     256
+#define ProceduralIblHeight_    128
+
+namespace Selas
+{
+    //=============================================================================================================================
+    template <typename Type_>
+    static void BakeToAttachedBinary(Type_& source, Type_*& attached)
+    {
+        uint8* data = nullptr;
+        uint dataSize = 0;
+        SerializeToBinary(source, data, dataSize);
+        AttachToBinary(attached, data, dataSize);
+    }
+
+    //=============================================================================================================================
+    static void CalculateWorldToLocal(CArray<Instance>& instances)
+    {
+        for(uint scan = 0, count = instances.Count(); scan < count; ++scan) {
+            instances[scan].worldToLocal = MatrixInverse(instances[scan].localToWorld);
+        }
+    }
+
+    //=============================================================================================================================
+    static void AppendAndOffsetIndices(const CArray<uint32>& indices, uint32 offset, CArray<uint32>& output)
+    {
+        for(uint scan = 0, count = indices.Count(); scan < count; ++scan) {
+            output.Add(indices[scan] + offset);
+        }
+    }
+
+    //=============================================================================================================================
+    static Error ValidateProceduralModel(const ProceduralModel* model)
+    {
+        if(model->meshes.Count() == 0) {
+            return Error_("Procedural model %s has no meshes", model->name.Ascii());
+        }
+
+        if(model->materialHashes.Count() != model->materials.Count()) {
+            return Error_("Procedural model %s has mismatched material names and materials", model->name.Ascii());
+        }
+
+        const ProceduralMesh* first = model->meshes[0];
+        bool hasNormals = first->normals.Count() > 0;
+        bool hasTangents = first->tangents.Count() > 0;
+        bool hasUvs = first->uvs.Count() > 0;
+
+        if((hasTangents && !hasNormals) || (hasUvs && !hasTangents)) {
+            return Error_("Procedural model %s has uvs without tangents or tangents without normals", model->name.Ascii());
+        }
+
+        for(uint scan = 0, count = model->meshes.Count(); scan < count; ++scan) {
+            const ProceduralMesh* mesh = model->meshes[scan];
+            uint64 vertexCount = mesh->positions.Count();
+
+            if(hasNormals != (mesh->normals.Count() > 0) || hasTangents != (mesh->tangents.Count() > 0)
+               || hasUvs != (mesh->uvs.Count() > 0)) {
+                return Error_("Meshes in procedural model %s must all provide the same vertex attributes", model->name.Ascii());
+            }
+
+            if((hasNormals && mesh->normals.Count() != vertexCount) || (hasTangents && mesh->tangents.Count() != vertexCount)
+               || (hasUvs && mesh->uvs.Count() != vertexCount)) {
+                return Error_("Mesh %s has vertex attribute counts that do not match its position count", mesh->name.Ascii());
+            }
+
+            if(mesh->triindices.Count() % 3 != 0 || mesh->quadindices.Count() % 4 != 0) {
+                return Error_("Mesh %s has a partial face", mesh->name.Ascii());
+            }
+
+            for(uint i = 0, indexCount = mesh->triindices.Count(); i < indexCount; ++i) {
+                if(mesh->triindices[i] >= vertexCount) {
+                    return Error_("Mesh %s has an out of range index", mesh->name.Ascii());
+                }
+            }
+            for(uint i = 0, indexCount = mesh->quadindices.Count(); i < indexCount; ++i) {
+                if(mesh->quadindices[i] >= vertexCount) {
+                    return Error_("Mesh %s has an out of range index", mesh->name.Ascii());
+                }
+            }
+        }
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    static void AddMeshMetaData(const ProceduralMesh* mesh, uint32 indicesPerFace, uint32 indexCount, uint32 indexOffset,
+                                uint32 vertexOffset, CArray<MeshMetaData>& meshes)
+    {
+        MeshMetaData& meshData = meshes.Add();
+        meshData.indexCount = indexCount;
+        meshData.indexOffset = indexOffset;
+        meshData.vertexCount = (uint32)mesh->positions.Count();
+        meshData.vertexOffset = vertexOffset;
+        meshData.materialHash = mesh->materialHash;
+        meshData.indicesPerFace = indicesPerFace;
+        meshData.nameHash = MurmurHash3_x86_32(mesh->name.Ascii(), StringUtil::Length(mesh->name.Ascii()));
+        meshData.name.Copy(mesh->name.Ascii());
+    }
+
+    //=============================================================================================================================
+    static Error BakeProceduralModel(const ProceduralModel* description, ModelResource* model)
+    {
+        ReturnError_(ValidateProceduralModel(description));
+
+        ModelResourceData data;
+        CArray<uint32> indices;
+        CArray<uint32> faceIndexCounts;
+        CArray<float3> positions;
+        CArray<float3> normals;
+        CArray<float4> tangents;
+        CArray<float2> uvs;
+
+        // -- Meshes share one set of vertex buffers per model so indices are offset to address the combined buffers.
+        uint32 vertexOffset = 0;
+        uint32 indexOffset = 0;
+        for(uint scan = 0, count = description->meshes.Count(); scan < count; ++scan) {
+            const ProceduralMesh* mesh = description->meshes[scan];
+
+            if(mesh->triindices.Count() > 0) {
+                uint32 indexCount = (uint32)mesh->triindices.Count();
+                AddMeshMetaData(mesh, 3, indexCount, indexOffset, vertexOffset, data.meshes);
+                AppendAndOffsetIndices(mesh->triindices, vertexOffset, indices);
+
+                for(uint i = 0, faceCount = indexCount / 3; i < faceCount; ++i) {
+                    faceIndexCounts.Add(3);
+                }
+                indexOffset += indexCount;
+            }
+            if(mesh->quadindices.Count() > 0) {
+                uint32 indexCount = (uint32)mesh->quadindices.Count();
+                AddMeshMetaData(mesh, 4, indexCount, indexOffset, vertexOffset, data.meshes);
+                AppendAndOffsetIndices(mesh->quadindices, vertexOffset, indices);
+
+                for(uint i = 0, faceCount = indexCount / 4; i < faceCount; ++i) {
+                    faceIndexCounts.Add(4);
+                }
+                indexOffset += indexCount;
+            }
+
+            positions.Append(mesh->positions);
+            normals.Append(mesh->normals);
+            tangents.Append(mesh->tangents);
+            uvs.Append(mesh->uvs);
+
+            vertexOffset += (uint32)mesh->positions.Count();
+        }
+
+        MakeInvalid(&data.aaBox);
+        for(uint scan = 0, count = positions.Count(); scan < count; ++scan) {
+            IncludePosition(&data.aaBox, positions[scan]);
+        }
+
+        data.totalVertexCount      = (uint32)positions.Count();
+        data.totalCurveVertexCount = 0;
+        data.curveModelName        = 0;
+        data.pad                   = 0;
+        data.indexSize             = indices.DataSize();
+        data.faceIndexSize         = faceIndexCounts.DataSize();
+        data.positionSize          = positions.DataSize();
+        data.normalsSize           = normals.DataSize();
+        data.tangentsSize          = tangents.DataSize();
+        data.uvsSize               = uvs.DataSize();
+        data.curveIndexSize        = 0;
+        data.curveVertexSize       = 0;
+        data.cameras.Append(description->cameras);
+        data.materials.Append(description->materials);
+        data.materialHashes.Append(description->materialHashes);
+        for(uint scan = 0, count = description->materials.Count(); scan < count; ++scan) {
+            if(description->materials[scan].baseColorTexture.Length() > 0) {
+                data.textureResourceNames.Add(description->materials[scan].baseColorTexture);
+            }
+        }
+
+        // -- Model materials are found with a binary search
+        QuickSortMatchingArrays(data.materialHashes.DataPointer(), data.materials.DataPointer(), data.materials.Count());
+
+        ModelGeometryData geometry;
+        geometry.indexSize       = indices.DataSize();
+        geometry.faceIndexSize   = faceIndexCounts.DataSize();
+        geometry.positionSize    = positions.DataSize();
+        geometry.normalsSize     = normals.DataSize();
+        geometry.tangentsSize    = tangents.DataSize();
+        geometry.uvsSize         = uvs.DataSize();
+        geometry.curveIndexSize  = 0;
+        geometry.curveVertexSize = 0;
+        geometry.indices         = indices.DataPointer();
+        geometry.faceIndexCounts = faceIndexCounts.DataPointer();
+        geometry.positions       = positions.DataPointer();
+        geometry.normals         = normals.DataPointer();
+        geometry.tangents        = tangents.DataPointer();
+        geometry.uvs             = uvs.DataPointer();
+        geometry.curveIndices    = nullptr;
+        geometry.curveVertices   = nullptr;
+
+        BakeToAttachedBinary(data, model->data);
+        BakeToAttachedBinary(geometry, model->residentGeometry);
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    static Error CreateProceduralSubscene(const ProceduralSubscene* description, SubsceneResource* subscene,
+                                          TextureCache* textureCache, RTCDevice rtcDevice)
+    {
+        SubsceneResourceData data;
+        data.name.Copy(description->name.Ascii());
+        data.lightSetIndex = description->lightSetIndex;
+        data.modelInstances.Append(description->modelInstances);
+        data.sceneMaterialNames.Append(description->sceneMaterialNames);
+        data.sceneMaterials.Append(description->sceneMaterials);
+        for(uint scan = 0, count = description->models.Count(); scan < count; ++scan) {
+            PackedStrings_Add(&data.modelNames, description->models[scan]->name.Ascii());
+        }
+
+        for(uint scan = 0, count = data.modelInstances.Count(); scan < count; ++scan) {
+            if(data.modelInstances[scan].index >= PackedStrings_Count(&data.modelNames)) {
+                return Error_("Procedural subscene %s has an instance of a missing model", description->name.Ascii());
+            }
+        }
+        CalculateWorldToLocal(data.modelInstances);
+
+        BakeToAttachedBinary(data, subscene->data);
+
+        uint modelCount = description->models.Count();
+        if(modelCount > 0) {
+            subscene->models = AllocArray_(ModelResource*, modelCount);
+            for(uint scan = 0; scan < modelCount; ++scan) {
+                subscene->models[scan] = New_(ModelResource);
+            }
+            for(uint scan = 0; scan < modelCount; ++scan) {
+                ReturnError_(BakeProceduralModel(description->models[scan], subscene->models[scan]));
+            }
+        }
+
+        return InitializeAttachedSubsceneResource(subscene, rtcDevice, textureCache);
+    }
+
+    //=============================================================================================================================
+    static Error RegisterProceduralTexture(const ProceduralTexture* description, TextureCache* textureCache,
+                                           TextureHandle& handle)
+    {
+        uint64 channels = (uint64)description->format + 1;
+        uint64 texelCount = (uint64)description->width * description->height * channels;
+        if(texelCount == 0 || description->texels.Count() != texelCount) {
+            return Error_("Procedural texture %s has %llu texels but expected %llu", description->name.Ascii(),
+                          description->texels.Count(), texelCount);
+        }
+
+        TextureResourceData data;
+        Memory::Zero(&data, sizeof(data));
+        data.mipCount      = 1;
+        data.dataSize      = (uint32)description->texels.DataSize();
+        data.mipWidths[0]  = description->width;
+        data.mipHeights[0] = description->height;
+        data.mipOffsets[0] = 0;
+        data.format        = description->format;
+        data.texture       = (uint8*)description->texels.DataPointer();
+
+        TextureResourceData* attached = nullptr;
+        BakeToAttachedBinary(data, attached);
+
+        Error err = textureCache->RegisterTextureResource(description->name, attached, handle);
+        if(Failed_(err)) {
+            FreeAligned_(attached);
+            return err;
+        }
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    static float IblLuminance(float3 rgb)
+    {
+        return rgb.x * 0.299f + rgb.y * 0.587f + rgb.z * 0.114f;
+    }
+
+    //=============================================================================================================================
+    static void CreateProceduralImageBasedLight(const ProceduralScene* description, ImageBasedLightResource* ibl)
+    {
+        uint width = ProceduralIblWidth_;
+        uint height = ProceduralIblHeight_;
+
+        float3 sunDirection = float3::Zero_;
+        float cosSunAngle = 1.0f;
+        bool hasSun = IblLuminance(description->iblSunRadiance) > 0.0f;
+        if(hasSun) {
+            sunDirection = Normalize(description->iblSunDirection);
+            cosSunAngle = Math::Cosf(description->iblSunAngleDegrees * Math::DegreesToRadians_);
+        }
+
+        CArray<float> marginalDensityFunction;
+        CArray<float> conditionalDensityFunctions;
+        CArray<float3> lightData;
+        marginalDensityFunction.Resize(CalculateMarginalDensityFunctionCount(width, height));
+        conditionalDensityFunctions.Resize(CalculateConditionalDensityFunctionsCount(width, height));
+        lightData.Resize(width * height);
+
+        // -- Texel centers map to directions the same way Ibl() does so the sun lands where it was asked to be. Texels are
+        // -- weighted by luminance and by the solid angle their row covers.
+        float marginalSum = 0.0f;
+        for(uint y = 0; y < height; ++y) {
+            float theta = (y + 0.5f) * Math::Pi_ / height;
+            float sinTheta = Math::Sinf(theta);
+
+            float conditionalSum = 0.0f;
+            for(uint x = 0; x < width; ++x) {
+                float phi = (x + 0.5f) * Math::TwoPi_ / width - Math::Pi_;
+                float3 direction = Math::SphericalToCartesian(theta, phi);
+
+                float3 radiance = description->uniformIblRadiance;
+                if(hasSun && Dot(direction, sunDirection) >= cosSunAngle) {
+                    radiance = radiance + description->iblSunRadiance;
+                }
+
+                lightData[y * width + x] = radiance;
+                conditionalSum += sinTheta * IblLuminance(radiance);
+                conditionalDensityFunctions[y * width + x] = conditionalSum;
+            }
+
+            if(conditionalSum > 0.0f) {
+                for(uint x = 0; x < width; ++x) {
+                    conditionalDensityFunctions[y * width + x] /= conditionalSum;
+                }
+            }
+            conditionalDensityFunctions[y * width + width - 1] = 1.0f;
+
+            marginalSum += conditionalSum;
+            marginalDensityFunction[y] = marginalSum;
+        }
+        if(marginalSum > 0.0f) {
+            for(uint y = 0; y < height; ++y) {
+                marginalDensityFunction[y] /= marginalSum;
+            }
+        }
+        marginalDensityFunction[height - 1] = 1.0f;
+
+        ImageBasedLightResourceData data;
+        data.densityfunctions.width                       = width;
+        data.densityfunctions.height                      = height;
+        data.densityfunctions.marginalDensityFunction     = marginalDensityFunction.DataPointer();
+        data.densityfunctions.conditionalDensityFunctions = conditionalDensityFunctions.DataPointer();
+        data.missWidth       = width;
+        data.missHeight      = height;
+        data.rotationRadians = 0.0f;
+        data.exposureScale   = 1.0f;
+        data.lightData       = lightData.DataPointer();
+        data.missData        = lightData.DataPointer();
+
+        BakeToAttachedBinary(data, ibl->data);
+    }
+
+    //=============================================================================================================================
+    Hash32 ProceduralMaterialHash(cpointer materialName)
+    {
+        return MurmurHash3_x86_32(materialName, StringUtil::Length(materialName), 0);
+    }
+
+    //=============================================================================================================================
+    Error CreateProceduralSceneResource(const ProceduralScene* description, SceneResource* scene, TextureCache* textureCache,
+                                        GeometryCache* geometryCache, RTCDevice rtcDevice)
+    {
+        Assert_(scene->data == nullptr);
+
+        SceneResourceData data;
+        data.name.Copy(description->name.Ascii());
+        data.iblName.Copy(description->iblName.Ascii());
+        data.backgroundIntensity = description->backgroundIntensity;
+        data.subsceneInstances.Append(description->subsceneInstances);
+        data.lights.Append(description->lights);
+        data.lightSetRanges.Append(description->lightSetRanges);
+        data.cameras.Append(description->cameras);
+        for(uint scan = 0, count = description->subscenes.Count(); scan < count; ++scan) {
+            data.subsceneNames.Add(description->subscenes[scan]->name);
+        }
+
+        for(uint scan = 0, count = data.subsceneInstances.Count(); scan < count; ++scan) {
+            if(data.subsceneInstances[scan].index >= data.subsceneNames.Count()) {
+                return Error_("Procedural scene %s has an instance of a missing subscene", description->name.Ascii());
+            }
+        }
+        CalculateWorldToLocal(data.subsceneInstances);
+
+        BakeToAttachedBinary(data, scene->data);
+
+        // -- Textures must be registered before the models are initialized so their material lookups find them
+        for(uint scan = 0, count = description->textures.Count(); scan < count; ++scan) {
+            TextureHandle handle;
+            ReturnError_(RegisterProceduralTexture(description->textures[scan], textureCache, handle));
+            scene->residentTextures.Add(handle);
+        }
+
+        uint subsceneCount = description->subscenes.Count();
+        if(subsceneCount > 0) {
+            scene->subscenes = AllocArray_(SubsceneResource*, subsceneCount);
+            for(uint scan = 0; scan < subsceneCount; ++scan) {
+                scene->subscenes[scan] = New_(SubsceneResource);
+            }
+            for(uint scan = 0; scan < subsceneCount; ++scan) {
+                ReturnError_(CreateProceduralSubscene(description->subscenes[scan], scene->subscenes[scan], textureCache,
+                                                      rtcDevice));
+            }
+        }
+
+        // -- A named ibl is read from disk by InitializeAttachedSceneResource
+        bool proceduralIbl = IblLuminance(description->uniformIblRadiance) > 0.0f
+                             || IblLuminance(description->iblSunRadiance) > 0.0f;
+        if(StringUtil::Length(description->iblName.Ascii()) == 0 && proceduralIbl) {
+            scene->iblResource = New_(ImageBasedLightResource);
+            CreateProceduralImageBasedLight(description, scene->iblResource);
+        }
+
+        return InitializeAttachedSceneResource(scene, textureCache, geometryCache, rtcDevice);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SceneLib/SceneResource.h"
+#include "SceneLib/SubsceneResource.h"
+#include "SceneLib/ModelResource.h"
+#include "TextureLib/TextureResource.h"
+#include "GeometryLib/Camera.h"
+#include "UtilityLib/MurmurHash.h"
+#include "StringLib/FixedString.h"
+#include "MathLib/FloatStructs.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+// -- Describes scenes built in memory (procedural content, tests) rather than through the asset build. The descriptions are baked
+// -- into the same resource data the build pipeline writes to disk so the usual Embree setup and cache paths are reused.
+
+namespace Selas
+{
+    class GeometryCache;
+    class TextureCache;
+
+    //=============================================================================================================================
+    struct ProceduralMesh
+    {
+        // -- Indices are relative to this mesh's vertices. Normals, tangents and uvs are optional but every mesh in a model must
+        // -- provide the same set and uvs require tangents which in turn require normals.
+        CArray<float3> positions;
+        CArray<float3> normals;
+        CArray<float4> tangents;
+        CArray<float2> uvs;
+        CArray<uint32> triindices;
+        CArray<uint32> quadindices;
+        Hash32         materialHash;
+        FixedString64  name;
+    };
+
+    //=============================================================================================================================
+    struct ProceduralModel
+    {
+        FilePathString name;
+        CArray<ProceduralMesh*> meshes;
+        CArray<Hash32> materialHashes;
+        CArray<MaterialResourceData> materials;
+        CArray<CameraSettings> cameras;
+    };
+
+    //=============================================================================================================================
+    struct ProceduralSubscene
+    {
+        FilePathString name;
+        uint64 lightSetIndex;
+        CArray<ProceduralModel*> models;
+        CArray<Instance> modelInstances;
+        CArray<Hash32> sceneMaterialNames;
+        CArray<MaterialResourceData> sceneMaterials;
+    };
+
+    //=============================================================================================================================
+    struct ProceduralTexture
+    {
+        // -- Materials reference the texture through baseColorTexture by this name. Texels are row major floats with one value
+        // -- per channel of the format.
+        FilePathString name;
+        TextureResourceData::TextureDataType format;
+        uint32 width;
+        uint32 height;
+        CArray<float> texels;
+    };
+
+    //=============================================================================================================================
+    struct ProceduralScene
+    {
+        FilePathString name;
+        FilePathString iblName;
+        // -- Lights the scene with a constant environment when there is no iblName. Zero leaves the scene without an ibl.
+        float3 uniformIblRadiance;
+        // -- Adds a small bright disc around iblSunDirection on top of that environment. Zero radiance leaves it out.
+        float3 iblSunDirection;
+        float3 iblSunRadiance;
+        float  iblSunAngleDegrees;
+        float4 backgroundIntensity;
+        CArray<ProceduralTexture*> textures;
+        CArray<ProceduralSubscene*> subscenes;
+        CArray<Instance> subsceneInstances;
+        CArray<SceneLight> lights;
+        CArray<SceneLightSetRange> lightSetRanges;
+        CArray<CameraSettings> cameras;
+    };
+
+    Hash32 ProceduralMaterialHash(cpointer materialName);
+
+    // -- The description may be freed once this returns. As with scenes read from disk the subscenes still need to be registered
+    // -- with the geometry cache and the scene is shut down through ShutdownSceneResource.
+    Error CreateProceduralSceneResource(const ProceduralScene* description, SceneResource* scene, TextureCache* textureCache,
+                                        GeometryCache* geometryCache, RTCDevice rtcDevice);
+}
@@ -10,13 +10,22 @@
 #include "MathLib/Trigonometric.h"
 #include "MathLib/FloatFuncs.h"
 #include "IoLib/BinaryStreamSerializer.h"
+#include "ThreadingLib/Thread.h"
+#include "SystemLib/NumaTopology.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
 
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
 
+#define TBB_PREVIEW_LOCAL_OBSERVER 1
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
 namespace Selas
 {
     cpointer SceneResource::kDataType = "SceneResource";
@@ -26,11 +35,20 @@ namespace Selas
     {
         GeometryCache* geometryCache;
         SubsceneResource* subscene;
+        // -- Node local BVH of a pinned subscene. When null the subscene's own BVH is streamed through the geometry cache.
+        RTCScene replicaScene;
         float4x4 worldToLocal;
         AxisAlignedBox aaBox;
         uint32 instanceID;
     };
 
+    struct SceneNumaReplica
+    {
+        RTCScene rtcScene;
+        SubsceneInstanceUserData* subsceneInstanceUserDatas;
+        SubsceneReplica* subsceneReplicas;
+    };
+
     //=============================================================================================================================
     // Serialization
     //=============================================================================================================================
@@ -94,7 +112,11 @@ namespace Selas
 
         const uint32 N = args->N;
 
-        instance->geometryCache->EnsureSubsceneGeometryLoaded(instance->subscene);
+        RTCScene subsceneScene = instance->replicaScene;
+        if(subsceneScene == nullptr) {
+            instance->geometryCache->EnsureSubsceneGeometryLoaded(instance->subscene);
+            subsceneScene = instance->subscene->rtcScene;
+        }
 
         for(uint32 scan = 0; scan < N; ++scan) {
             if(args->valid[scan] == 0)
@@ -128,7 +150,7 @@ namespace Selas
             rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
             rayhit.hit.instID[1] = RTC_INVALID_GEOMETRY_ID;
 
-            rtcIntersect1(instance->subscene->rtcScene, context, &rayhit);
+            rtcIntersect1(subsceneScene, context, &rayhit);
 
             if(rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID) {
                 RTCRayN_tfar(rays, N, scan) = rayhit.ray.tfar;
@@ -138,7 +160,9 @@ namespace Selas
             }
         }
 
-        instance->geometryCache->FinishUsingSubceneGeometry(instance->subscene);
+        if(instance->replicaScene == nullptr) {
+            instance->geometryCache->FinishUsingSubceneGeometry(instance->subscene);
+        }
     }
 
     //=============================================================================================================================
@@ -151,7 +175,12 @@ namespace Selas
 
         const uint32 N = args->N;
 
-        instance->geometryCache->EnsureSubsceneGeometryLoaded(instance->subscene);
+        RTCScene subsceneScene = instance->replicaScene;
+        if(subsceneScene == nullptr) {
+            instance->geometryCache->EnsureSubsceneGeometryLoaded(instance->subscene);
+            subsceneScene = instance->subscene->rtcScene;
+        }
+
         for(uint32 scan = 0; scan < N; ++scan) {
             if(args->valid[scan] == 0)
                 continue;
@@ -179,11 +208,14 @@ namespace Selas
             ray.tnear = RTCRayN_tnear(rays, N, scan);
             ray.tfar = RTCRayN_tfar(rays, N, scan);
 
-            rtcOccluded1(instance->subscene->rtcScene, context, &ray);
+            rtcOccluded1(subsceneScene, context, &ray);
 
             RTCRayN_tfar(rays, N, scan) = ray.tfar;
         }
-        instance->geometryCache->FinishUsingSubceneGeometry(instance->subscene);
+
+        if(instance->replicaScene == nullptr) {
+            instance->geometryCache->FinishUsingSubceneGeometry(instance->subscene);
+        }
     }
 
     //=============================================================================================================================
@@ -215,37 +247,144 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    static void SetupSceneInstances(SceneResource* scene, RTCDevice rtcDevice, GeometryCache* geometryCache)
+    // -- subsceneReplicas is only given when building a NUMA replica of the top level scene.
+    static SubsceneInstanceUserData* SetupSceneInstances(SceneResource* scene, RTCDevice rtcDevice,
+                                                         GeometryCache* geometryCache, RTCScene rtcScene,
+                                                         const SubsceneReplica* subsceneReplicas)
     {
-        if(scene->data->subsceneInstances.Count() > 0) {
-            scene->subsceneInstanceUserDatas = AllocArray_(SubsceneInstanceUserData, scene->data->subsceneInstances.Count());
+        if(scene->data->subsceneInstances.Count() == 0) {
+            return nullptr;
+        }
+
+        SubsceneInstanceUserData* userDatas = AllocArray_(SubsceneInstanceUserData, scene->data->subsceneInstances.Count());
+
+        for(uint scan = 0, count = scene->data->subsceneInstances.Count(); scan < count; ++scan) {
+
+            const Instance& instance = scene->data->subsceneInstances[scan];
+            uint sceneIdx = instance.index;
+
+            RTCGeometry geom = rtcNewGeometry(rtcDevice, RTC_GEOMETRY_TYPE_USER);
+
+            userDatas[scan].geometryCache = geometryCache;
+            userDatas[scan].worldToLocal = instance.worldToLocal;
+            userDatas[scan].subscene = scene->subscenes[sceneIdx];
+            userDatas[scan].replicaScene = subsceneReplicas ? subsceneReplicas[sceneIdx].rtcScene : nullptr;
+            userDatas[scan].instanceID = (uint32)scan;
+
+            MakeInvalid(&userDatas[scan].aaBox);
+            IncludeBox(&userDatas[scan].aaBox, scene->data->subsceneInstances[scan].localToWorld,
+                       scene->subscenes[sceneIdx]->aaBox);
+
+            rtcSetGeometryUserPrimitiveCount(geom, 1);
+            rtcSetGeometryUserData(geom, &userDatas[scan]);
+            rtcSetGeometryBoundsFunction(geom, SceneInstanceBoundsFunction, nullptr);
+            rtcSetGeometryIntersectFunction(geom, SceneInstanceIntersectFunction);
+            rtcSetGeometryOccludedFunction(geom, InstanceOccludedFunction);
+            rtcCommitGeometry(geom);
+            rtcAttachGeometry(rtcScene, geom);
+            rtcReleaseGeometry(geom);
+        }
+
+        return userDatas;
+    }
+
+    //=============================================================================================================================
+    // NUMA replication
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    // -- Binds every thread that joins the arena to the node so the BVH memory embree's builders touch lands there.
+    class NumaNodeArenaObserver : public tbb::task_scheduler_observer
+    {
+    public:
+        NumaNodeArenaObserver(tbb::task_arena& arena, uint32 node_)
+            : tbb::task_scheduler_observer(arena)
+            , node(node_)
+        {
+            observe(true);
+        }
+
+        ~NumaNodeArenaObserver()
+        {
+            observe(false);
+        }
 
-            for(uint scan = 0, count = scene->data->subsceneInstances.Count(); scan < count; ++scan) {
+        void on_scheduler_entry(bool isWorker) override
+        {
+            Unused_(isWorker);
+            BindCurrentThreadToNumaNode(node);
+        }
 
-                const Instance& instance = scene->data->subsceneInstances[scan];
-                uint sceneIdx = instance.index;
+    private:
+        uint32 node;
+    };
 
-                RTCGeometry geom = rtcNewGeometry(rtcDevice, RTC_GEOMETRY_TYPE_USER);
+    struct NumaReplicaBuildData
+    {
+        SceneResource* scene;
+        GeometryCache* geometryCache;
+        RTCDevice rtcDevice;
+        uint32 node;
+        SceneNumaReplica* replica;
+        Error error;
+    };
 
-                scene->subsceneInstanceUserDatas[scan].geometryCache = geometryCache;
-                scene->subsceneInstanceUserDatas[scan].worldToLocal = instance.worldToLocal;
-                scene->subsceneInstanceUserDatas[scan].subscene = scene->subscenes[sceneIdx];
-                scene->subsceneInstanceUserDatas[scan].instanceID = (uint32)scan;
+    //=============================================================================================================================
+    static Error BuildSceneNumaReplica(NumaReplicaBuildData* data)
+    {
+        SceneResource* scene = data->scene;
+        SceneNumaReplica* replica = data->replica;
 
-                MakeInvalid(&scene->subsceneInstanceUserDatas[scan].aaBox);
-                IncludeBox(&scene->subsceneInstanceUserDatas[scan].aaBox, scene->data->subsceneInstances[scan].localToWorld,
-                           scene->subscenes[sceneIdx]->aaBox);
+        uint subsceneCount = scene->data->subsceneNames.Count();
+        if(subsceneCount > 0) {
+            replica->subsceneReplicas = AllocArray_(SubsceneReplica, subsceneCount);
+            Memory::Zero(replica->subsceneReplicas, subsceneCount * sizeof(SubsceneReplica));
+        }
 
-                rtcSetGeometryUserPrimitiveCount(geom, 1);
-                rtcSetGeometryUserData(geom, &scene->subsceneInstanceUserDatas[scan]);
-                rtcSetGeometryBoundsFunction(geom, SceneInstanceBoundsFunction, nullptr);
-                rtcSetGeometryIntersectFunction(geom, SceneInstanceIntersectFunction);
-                rtcSetGeometryOccludedFunction(geom, InstanceOccludedFunction);
-                rtcCommitGeometry(geom);
-                rtcAttachGeometry(scene->rtcScene, geom);
-                rtcReleaseGeometry(geom);
+        for(uint scan = 0; scan < subsceneCount; ++scan) {
+            if(scene->subscenes[scan]->pinned) {
+                ReturnError_(CreateSubsceneReplica(scene->subscenes[scan], &replica->subsceneReplicas[scan]));
             }
         }
+
+        replica->rtcScene = rtcNewScene(data->rtcDevice);
+        replica->subsceneInstanceUserDatas = SetupSceneInstances(scene, data->rtcDevice, data->geometryCache,
+                                                                 replica->rtcScene, replica->subsceneReplicas);
+        rtcCommitScene(replica->rtcScene);
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    static void NumaReplicaBuildKernel(void* userData)
+    {
+        NumaReplicaBuildData* data = (NumaReplicaBuildData*)userData;
+
+        BindCurrentThreadToNumaNode(data->node);
+
+        // -- Embree builds with tbb so its commits are run in an arena whose threads are all on this node.
+        tbb::task_arena arena((int)NumaNodeCoreCount(data->node));
+        NumaNodeArenaObserver observer(arena, data->node);
+
+        arena.execute([data]() { data->error = BuildSceneNumaReplica(data); });
+    }
+
+    //=============================================================================================================================
+    static void ShutdownSceneNumaReplica(SceneResource* scene, SceneNumaReplica* replica)
+    {
+        if(replica->rtcScene != nullptr) {
+            rtcReleaseScene(replica->rtcScene);
+            replica->rtcScene = nullptr;
+        }
+
+        if(replica->subsceneReplicas != nullptr) {
+            for(uint scan = 0, count = scene->data->subsceneNames.Count(); scan < count; ++scan) {
+                ShutdownSubsceneReplica(&replica->subsceneReplicas[scan]);
+            }
+        }
+
+        SafeFree_(replica->subsceneReplicas);
+        SafeFree_(replica->subsceneInstanceUserDatas);
     }
 
     //=============================================================================================================================
@@ -254,6 +393,8 @@ namespace Selas
         , subsceneInstanceUserDatas(nullptr)
         , subscenes(nullptr)
         , iblResource(nullptr)
+        , numaReplicas(nullptr)
+        , numaReplicaCount(0)
     {
 
     }
@@ -265,6 +406,7 @@ namespace Selas
         Assert_(subsceneInstanceUserDatas == nullptr);
         Assert_(subscenes == nullptr);
         Assert_(iblResource == nullptr);
+        Assert_(numaReplicas == nullptr);
     }
 
     //=============================================================================================================================
@@ -299,6 +441,13 @@ namespace Selas
             }
         }
 
+        return InitializeAttachedSceneResource(scene, textureCache, geometryCache, rtcDevice);
+    }
+
+    //=============================================================================================================================
+    Error InitializeAttachedSceneResource(SceneResource* scene, TextureCache* textureCache, GeometryCache* geometryCache,
+                                          RTCDevice rtcDevice)
+    {
         if(StringUtil::Length(scene->data->iblName.Ascii()) > 0) {
             scene->iblResource = New_(ImageBasedLightResource);
             ReturnError_(ReadImageBasedLightResource(scene->data->iblName.Ascii(), scene->iblResource));
@@ -308,7 +457,7 @@ namespace Selas
         CreateSceneLightSets(scene);
 
         scene->rtcScene = rtcNewScene(rtcDevice);
-        SetupSceneInstances(scene, rtcDevice, geometryCache);
+        scene->subsceneInstanceUserDatas = SetupSceneInstances(scene, rtcDevice, geometryCache, scene->rtcScene, nullptr);
         rtcCommitScene(scene->rtcScene);
 
         return Success_;
@@ -317,6 +466,12 @@ namespace Selas
     //=============================================================================================================================
     void ShutdownSceneResource(SceneResource* scene, TextureCache* textureCache)
     {
+        for(uint32 scan = 0; scan < scene->numaReplicaCount; ++scan) {
+            ShutdownSceneNumaReplica(scene, &scene->numaReplicas[scan]);
+        }
+        SafeFree_(scene->numaReplicas);
+        scene->numaReplicaCount = 0;
+
         if(scene->iblResource) {
             ShutdownImageBasedLightResource(scene->iblResource);
             SafeDelete_(scene->iblResource);
@@ -327,11 +482,105 @@ namespace Selas
             Delete_(scene->subscenes[scan]);
         }
       
+        for(uint scan = 0, textureCount = scene->residentTextures.Count(); scan < textureCount; ++scan) {
+            textureCache->UnloadTexture(scene->residentTextures[scan]);
+        }
+        scene->residentTextures.Shutdown();
+
         SafeFree_(scene->subsceneInstanceUserDatas);
         SafeFree_(scene->subscenes);
         SafeFreeAligned_(scene->data);
     }
 
+    //=============================================================================================================================
+    Error ReplicateSceneAcrossNumaNodes(SceneResource* scene, GeometryCache* geometryCache, RTCDevice rtcDevice)
+    {
+        Assert_(scene->numaReplicas == nullptr);
+
+        uint32 nodeCount = NumaNodeCount();
+        if(nodeCount < 2) {
+            return Success_;
+        }
+
+        // -- The original was built by this thread so its node is assumed to already be local to it.
+        uint32 homeNode = CurrentNumaNode();
+
+        scene->numaReplicaCount = nodeCount;
+        scene->numaReplicas = AllocArray_(SceneNumaReplica, nodeCount);
+        Memory::Zero(scene->numaReplicas, nodeCount * sizeof(SceneNumaReplica));
+
+        NumaReplicaBuildData buildDatas[MaxNumaNodes_];
+        ThreadHandle threadHandles[MaxNumaNodes_];
+
+        // -- One builder per node. Each node's arena only uses that node's cores so they run side by side.
+        for(uint32 node = 0; node < nodeCount; ++node) {
+            threadHandles[node] = InvalidThreadHandle;
+            if(node == homeNode) {
+                continue;
+            }
+
+            buildDatas[node].scene = scene;
+            buildDatas[node].geometryCache = geometryCache;
+            buildDatas[node].rtcDevice = rtcDevice;
+            buildDatas[node].node = node;
+            buildDatas[node].replica = &scene->numaReplicas[node];
+
+            threadHandles[node] = CreateThread(NumaReplicaBuildKernel, &buildDatas[node], "NumaReplica", NoThreadAffinity_);
+            Assert_(threadHandles[node] != InvalidThreadHandle);
+        }
+
+        for(uint32 node = 0; node < nodeCount; ++node) {
+            if(threadHandles[node] != InvalidThreadHandle) {
+                ShutdownThread(threadHandles[node]);
+            }
+        }
+
+        for(uint32 node = 0; node < nodeCount; ++node) {
+            if(node != homeNode) {
+                ReturnError_(buildDatas[node].error);
+            }
+        }
+
+        WriteDebugInfo_("Replicated scene across %u NUMA nodes from node %u", nodeCount, homeNode);
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    RTCScene SceneRtcSceneForNode(const SceneResource* scene, uint32 node)
+    {
+        if(node < scene->numaReplicaCount && scene->numaReplicas[node].rtcScene != nullptr) {
+            return scene->numaReplicas[node].rtcScene;
+        }
+
+        return scene->rtcScene;
+    }
+
+    //=============================================================================================================================
+    RTCScene BindWorkerToSceneNumaNode(const SceneResource* scene, uint32 workerIndex, uint32& node)
+    {
+        if(scene->numaReplicaCount < 2) {
+            node = 0;
+            return scene->rtcScene;
+        }
+
+        node = workerIndex % scene->numaReplicaCount;
+        if(BindCurrentThreadToNumaNode(node) == false) {
+            // -- Use whichever copy is local to wherever the OS put the thread.
+            node = CurrentNumaNode();
+        }
+
+        return SceneRtcSceneForNode(scene, node);
+    }
+
+    //=============================================================================================================================
+    void UnbindWorkerFromSceneNumaNode(const SceneResource* scene)
+    {
+        if(scene->numaReplicaCount >= 2) {
+            UnbindCurrentThreadFromNumaNode();
+        }
+    }
+
     //=============================================================================================================================
     void SetupSceneCamera(const SceneResource* scene, uint index, uint width, uint height, RayCastCameraSettings& camera)
     {
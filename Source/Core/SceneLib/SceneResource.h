@@ -6,6 +6,7 @@
 
 #include "SceneLib/EmbreeUtils.h"
 #include "SceneLib/SubsceneResource.h"
+#include "TextureLib/TextureCache.h"
 #include "Shading/IntegratorContexts.h"
 #include "StringLib/FixedString.h"
 #include "GeometryLib/AxisAlignedBox.h"
@@ -23,6 +24,7 @@ namespace Selas
     struct SubsceneResource;
     struct ImageBasedLightResource;
     struct SubsceneInstanceUserData;
+    struct SceneNumaReplica;
 
     enum SubsceneLightType
     {
@@ -78,10 +80,15 @@ namespace Selas
         float4 boundingSphere;
 
         CArray<SceneLightSet> lightSets;
+        CArray<TextureHandle> residentTextures;
         SubsceneInstanceUserData* subsceneInstanceUserDatas;
         SubsceneResource** subscenes;
         ImageBasedLightResource* iblResource;
 
+        // -- One per NUMA node when the scene has been replicated. The node that built rtcScene has no copy of its own.
+        SceneNumaReplica* numaReplicas;
+        uint32 numaReplicaCount;
+
         SceneResource();
         ~SceneResource();
     };
@@ -90,8 +97,22 @@ namespace Selas
 
     Error ReadSceneResource(cpointer filepath, SceneResource* scene);
     Error InitializeSceneResource(SceneResource* scene, TextureCache* cache, GeometryCache* geometryCache, RTCDevice rtcDevice);
+    // -- Same as above for scenes whose subscenes have already been created and initialized rather than read from disk.
+    Error InitializeAttachedSceneResource(SceneResource* scene, TextureCache* cache, GeometryCache* geometryCache,
+                                          RTCDevice rtcDevice);
     void ShutdownSceneResource(SceneResource* scene, TextureCache* textureCache);
 
+    // -- Copies the top level BVH and every pinned subscene onto each NUMA node other than the calling thread's so threads on
+    // -- those nodes traverse local memory. Subscenes must be preloaded first. Does nothing on single node machines.
+    Error ReplicateSceneAcrossNumaNodes(SceneResource* scene, GeometryCache* geometryCache, RTCDevice rtcDevice);
+    // -- The BVH that threads running on the given node should trace against.
+    RTCScene SceneRtcSceneForNode(const SceneResource* scene, uint32 node);
+    // -- Spreads render workers round robin across the replicated nodes and binds the calling thread to its node before
+    // -- picking that node's BVH, so it can't migrate away from the copy it traces. Threads are left unbound when the scene
+    // -- hasn't been replicated. node is set to the node the worker was given.
+    RTCScene BindWorkerToSceneNumaNode(const SceneResource* scene, uint32 workerIndex, uint32& node);
+    void     UnbindWorkerFromSceneNumaNode(const SceneResource* scene);
+
     void SetupSceneCamera(const SceneResource* scene, uint index, uint width, uint height, RayCastCameraSettings& camera);
 
     void ModelDataFromRayIds(const SceneResource* scene, const int32 instIds[MaxInstanceLevelCount_], int32 geomId,
@@ -8,6 +8,8 @@
 #include "MathLib/Trigonometric.h"
 #include "MathLib/FloatFuncs.h"
 #include "IoLib/BinaryStreamSerializer.h"
+#include "SystemLib/PerfCounters.h"
+#include "SystemLib/Profiling.h"
 #include "SystemLib/BasicTypes.h"
 
 #include "embree3/rtcore.h"
@@ -16,13 +18,13 @@
 namespace Selas
 {
     cpointer SubsceneResource::kDataType = "SubsceneResource";
-    const uint64 SubsceneResource::kDataVersion = 1539129606ul;
+    const uint64 SubsceneResource::kDataVersion = 1541376000ul;
 
     //=============================================================================================================================
     static uint64 EstimateSubsceneSize(SubsceneResource* subscene)
     {
         uint64 estimate = 0;
-        for(uint scan = 0, count = subscene->data->modelNames.Count(); scan < count; ++scan) {
+        for(uint scan = 0, count = PackedStrings_Count(&subscene->data->modelNames); scan < count; ++scan) {
             estimate += subscene->models[scan]->geometrySize;
         }
 
@@ -60,20 +62,23 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    static void InitializeModelInstances(SubsceneResource* scene, RTCDevice rtcDevice)
+    // -- modelScenes overrides the models' own BVHs when building a replica
+    static void InitializeModelInstances(SubsceneResource* scene, RTCDevice rtcDevice, RTCScene rtcScene,
+                                         const RTCScene* modelScenes)
     {
         for(uint scan = 0, count = scene->data->modelInstances.Count(); scan < count; ++scan) {
             RTCGeometry instance = rtcNewGeometry(rtcDevice, RTC_GEOMETRY_TYPE_INSTANCE);
 
             uint modelIdx = scene->data->modelInstances[scan].index;
-            rtcSetGeometryInstancedScene(instance, scene->models[modelIdx]->rtcScene);
+            RTCScene modelScene = modelScenes ? modelScenes[modelIdx] : scene->models[modelIdx]->rtcScene;
+            rtcSetGeometryInstancedScene(instance, modelScene);
             rtcSetGeometryTimeStepCount(instance, 1);
 
             rtcSetGeometryTransform(instance, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
                                     (void*)&scene->data->modelInstances[scan].localToWorld);
 
             rtcCommitGeometry(instance);
-            rtcAttachGeometryByID(scene->rtcScene, instance, (int32)scan);
+            rtcAttachGeometryByID(rtcScene, instance, (int32)scan);
             rtcReleaseGeometry(instance);
         }
     }
@@ -87,6 +92,7 @@ namespace Selas
         , geometryLoaded(0)
         , geometryLoading()
         , lastAccessDt(0)
+        , pinned(0)
     {
 
     }
@@ -116,19 +122,27 @@ namespace Selas
     //=============================================================================================================================
     Error InitializeSubsceneResource(SubsceneResource* subscene, RTCDevice rtcDevice, TextureCache* cache)
     {
-        uint modelCount = subscene->data->modelNames.Count();
+        uint modelCount = PackedStrings_Count(&subscene->data->modelNames);
         if(modelCount > 0) {
             subscene->models = AllocArray_(ModelResource*, modelCount);
             for(uint scan = 0; scan < modelCount; ++scan) {
                 subscene->models[scan] = New_(ModelResource);
-                ReturnError_(ReadModelResource(subscene->data->modelNames[scan].Ascii(), subscene->models[scan]));
-
-                InitializeModelResource(subscene->models[scan], subscene, subscene->data->modelNames[scan].Ascii(),
-                                        subscene->data->lightSetIndex,
-                                        subscene->data->sceneMaterialNames, subscene->data->sceneMaterials, cache);
+                ReturnError_(ReadModelResource(PackedStrings_Get(&subscene->data->modelNames, (uint32)scan), subscene->models[scan]));
             }
         }
 
+        return InitializeAttachedSubsceneResource(subscene, rtcDevice, cache);
+    }
+
+    //=============================================================================================================================
+    Error InitializeAttachedSubsceneResource(SubsceneResource* subscene, RTCDevice rtcDevice, TextureCache* cache)
+    {
+        for(uint scan = 0, modelCount = PackedStrings_Count(&subscene->data->modelNames); scan < modelCount; ++scan) {
+            ReturnError_(InitializeModelResource(subscene->models[scan], subscene, PackedStrings_Get(&subscene->data->modelNames, (uint32)scan),
+                                                 subscene->data->lightSetIndex, subscene->data->sceneMaterialNames,
+                                                 subscene->data->sceneMaterials, cache));
+        }
+
         subscene->rtcDevice = rtcDevice;
         subscene->geometrySizeEstimate = EstimateSubsceneSize(subscene);
 
@@ -140,13 +154,16 @@ namespace Selas
     //=============================================================================================================================
     void LoadSubsceneGeometry(SubsceneResource* subscene)
     {
+        ProfileEventMarker_(0, "LoadSubsceneGeometry");
+        PerfPhaseScope_(ePerfPhaseLoading);
+
         subscene->rtcScene = rtcNewScene(subscene->rtcDevice);
 
-        for(uint scan = 0, modelCount = subscene->data->modelNames.Count(); scan < modelCount; ++scan) {
+        for(uint scan = 0, modelCount = PackedStrings_Count(&subscene->data->modelNames); scan < modelCount; ++scan) {
             LoadModelGeometry(subscene->models[scan], subscene->rtcDevice);
         }
 
-        InitializeModelInstances(subscene, subscene->rtcDevice);
+        InitializeModelInstances(subscene, subscene->rtcDevice, subscene->rtcScene, nullptr);
 
         rtcCommitScene(subscene->rtcScene);
 
@@ -157,7 +174,7 @@ namespace Selas
     //=============================================================================================================================
     void UnloadSubsceneGeometry(SubsceneResource* subscene)
     {
-        for(uint scan = 0, modelCount = subscene->data->modelNames.Count(); scan < modelCount; ++scan) {
+        for(uint scan = 0, modelCount = PackedStrings_Count(&subscene->data->modelNames); scan < modelCount; ++scan) {
             UnloadModelGeometry(subscene->models[scan]);
         }
         if(subscene->rtcScene != nullptr) {
@@ -168,12 +185,54 @@ namespace Selas
         subscene->geometryLoaded = 0;
     }
 
+    //=============================================================================================================================
+    Error CreateSubsceneReplica(SubsceneResource* subscene, SubsceneReplica* replica)
+    {
+        Assert_(subscene->geometryLoaded == 1);
+
+        uint modelCount = PackedStrings_Count(&subscene->data->modelNames);
+
+        replica->rtcScene = nullptr;
+        replica->modelCount = modelCount;
+        replica->modelScenes = modelCount > 0 ? AllocArray_(RTCScene, modelCount) : nullptr;
+        for(uint scan = 0; scan < modelCount; ++scan) {
+            replica->modelScenes[scan] = nullptr;
+        }
+
+        for(uint scan = 0; scan < modelCount; ++scan) {
+            ReturnError_(CreateModelSceneReplica(subscene->models[scan], subscene->rtcDevice, replica->modelScenes[scan]));
+        }
+
+        replica->rtcScene = rtcNewScene(subscene->rtcDevice);
+        InitializeModelInstances(subscene, subscene->rtcDevice, replica->rtcScene, replica->modelScenes);
+        rtcCommitScene(replica->rtcScene);
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    void ShutdownSubsceneReplica(SubsceneReplica* replica)
+    {
+        if(replica->rtcScene != nullptr) {
+            rtcReleaseScene(replica->rtcScene);
+            replica->rtcScene = nullptr;
+        }
+
+        for(uint scan = 0; scan < replica->modelCount; ++scan) {
+            if(replica->modelScenes[scan] != nullptr) {
+                rtcReleaseScene(replica->modelScenes[scan]);
+            }
+        }
+        SafeFree_(replica->modelScenes);
+        replica->modelCount = 0;
+    }
+
     //=============================================================================================================================
     void ShutdownSubsceneResource(SubsceneResource* subscene, TextureCache* textureCache)
     {
         UnloadSubsceneGeometry(subscene);
 
-        for(uint scan = 0, modelCount = subscene->data->modelNames.Count(); scan < modelCount; ++scan) {
+        for(uint scan = 0, modelCount = PackedStrings_Count(&subscene->data->modelNames); scan < modelCount; ++scan) {
             ShutdownModelResource(subscene->models[scan], textureCache);
             Delete_(subscene->models[scan]);
         }
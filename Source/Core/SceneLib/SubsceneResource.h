@@ -6,6 +6,7 @@
 
 #include "Shading/IntegratorContexts.h"
 #include "SceneLib/EmbreeUtils.h"
+#include "StringLib/StringTable.h"
 #include "StringLib/FixedString.h"
 #include "GeometryLib/AxisAlignedBox.h"
 #include "GeometryLib/Camera.h"
@@ -41,7 +42,7 @@ namespace Selas
     {
         FilePathString name;
         uint64 lightSetIndex;
-        CArray<FilePathString> modelNames;
+        PackedStrings modelNames;
         CArray<Instance> modelInstances;
         CArray<Hash32> sceneMaterialNames;
         CArray<MaterialResourceData> sceneMaterials;
@@ -69,17 +70,34 @@ namespace Selas
         Align_(CacheLineSize_) volatile int64 geometryLoading;
         Align_(CacheLineSize_) volatile int64 lastAccessDt;
 
+        // -- Set by GeometryCache::PreloadSubscene. Pinned geometry is never unloaded.
+        uint32 pinned;
+
         SubsceneResource();
         ~SubsceneResource();
     };
 
+    //=============================================================================================================================
+    // -- Copy of a subscene's BVHs built on another NUMA node. Geometry buffers and shading data are shared with the original.
+    struct SubsceneReplica
+    {
+        RTCScene rtcScene;
+        RTCScene* modelScenes;
+        uint modelCount;
+    };
+
     void Serialize(CSerializer* serializer, SubsceneResourceData& data);
 
     Error ReadSubsceneResource(cpointer filepath, SubsceneResource* scene);
 
     Error InitializeSubsceneResource(SubsceneResource* subscene, RTCDevice rtcDevice, TextureCache* textureCache);
+    // -- Same as above for subscenes whose models have already been attached rather than read from disk.
+    Error InitializeAttachedSubsceneResource(SubsceneResource* subscene, RTCDevice rtcDevice, TextureCache* textureCache);
     void LoadSubsceneGeometry(SubsceneResource* subscene);
     void UnloadSubsceneGeometry(SubsceneResource* subscene);
+    // -- The replica is only valid while the original geometry stays loaded so this is meant for pinned subscenes.
+    Error CreateSubsceneReplica(SubsceneResource* subscene, SubsceneReplica* replica);
+    void ShutdownSubsceneReplica(SubsceneReplica* replica);
     void ShutdownSubsceneResource(SubsceneResource* scene, TextureCache* textureCache);
 
     void ModelDataFromRayIds(const SubsceneResource* scene, int32 modelID, int32 geomId,
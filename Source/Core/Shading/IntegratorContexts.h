@@ -56,7 +56,8 @@ namespace Selas
         uint32 index            : 26;
         uint32 trackedBounces   :  3;
         uint32 diracScatterOnly :  1;
-        uint32 unused           :  2;
+        uint32 oddSample        :  1;
+        uint32 unused           :  1;
         float2 baryCoords;
     };
 
@@ -11,10 +11,15 @@
 #include "MathLib/FloatFuncs.h"
 #include "IoLib/Directory.h"
 #include "IoLib/Environment.h"
+#include "SystemLib/ArenaAllocator.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/OSThreading.h"
+#include "SystemLib/PerfCounters.h"
+#include "SystemLib/Profiling.h"
 #include "SystemLib/MinMax.h"
 
+#define ReadyBatchQueueSize_ 1024
+
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
@@ -217,6 +222,16 @@ namespace Selas
         SortRaysInternal(left, rays + count - left);
     }
 
+    //=================================================================================================================================
+    template<typename Type_>
+    static void SortRays(Type_* rays, uint count)
+    {
+        ProfileEventMarker_(0, "SortRays");
+        PerfPhaseScope_(ePerfPhaseSorting);
+
+        SortRaysInternal(rays, count);
+    }
+
     //=================================================================================================================================
     static bool operator<(const HitParameters& lhs, const HitParameters& rhs)
     {
@@ -257,6 +272,55 @@ namespace Selas
         return false;
     }
 
+    //=================================================================================================================================
+    template<typename BatchType_>
+    static void PublishReadyBatch(MpmcQueue<BatchType_*>& ready, CArray<BatchType_*>& overflow, BatchType_* batch)
+    {
+        // -- Called with the batcher lock held
+        if(ready.TryPush(batch) == false) {
+            overflow.Add(batch);
+        }
+    }
+
+    //=================================================================================================================================
+    template<typename BatchType_>
+    static bool ClaimReadyBatch(MpmcQueue<BatchType_*>& ready, CArray<BatchType_*>& overflow, void* lock, BatchType_*& batch)
+    {
+        if(ready.TryPop(batch)) {
+            return true;
+        }
+
+        // -- Check before locking to see if it's possible to claim an overflow batch.
+        if(overflow.Count() == 0) {
+            return false;
+        }
+
+        EnterSpinLock(lock);
+
+        // -- Check again to make sure another thread didn't claim it before we could enter the lock
+        bool claimed = overflow.Count() > 0;
+        if(claimed) {
+            batch = overflow[overflow.Count() - 1];
+            overflow.RemoveFast(overflow.Count() - 1);
+        }
+
+        LeaveSpinLock(lock);
+
+        return claimed;
+    }
+
+    //=================================================================================================================================
+    template<typename BatchType_>
+    static void ShutdownReadyBatches(MpmcQueue<BatchType_*>& ready, CArray<BatchType_*>& overflow)
+    {
+        // -- The batches themselves are owned by the allocation arrays
+        BatchType_* batch;
+        while(ready.TryPop(batch)) {}
+
+        ready.Shutdown();
+        overflow.Shutdown();
+    }
+
     //=================================================================================================================================
     DeferredBatch* PathTracingBatcher::AllocateRayBatch(RayBatchCategory category)
     {
@@ -293,6 +357,8 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FlushCompletedBatch(DeferredBatch* batch)
     {
+        ProfileEventMarker_(0, "FlushCompletedBatch");
+
         if(batch->batchTail == 0) {
             // -- Flush was called on a batch that hadn't been touched at all. We can safely reset this batch here.
             batch->batchHead = 0;
@@ -310,17 +376,22 @@ namespace Selas
         batch->fileHandle = INVALID_HANDLE_VALUE;
         batch->mappingHandle = INVALID_HANDLE_VALUE;
 
-        readyDeferredBatches.Add(batch);
+        PublishReadyBatch(readyDeferredBatches, overflowDeferredBatches, batch);
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::LoadBatch(DeferredBatch* batch)
+    void PathTracingBatcher::LoadBatch(DeferredBatch* batch, ArenaAllocator* arena)
     {
+        ProfileEventMarker_(0, "LoadBatch");
+        PerfPhaseScope_(ePerfPhaseLoading);
+
+        MemoryTagScope_(eMemoryTagBatches);
+
         FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
 
         void* fileData;
         uint64 fileSize;
-        Error err = File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize);
+        Error err = File::ReadWholeFile(filepath.Ascii(), arena, &fileData, &fileSize);
         Assert_(Successful_(err));
 
         DeleteFileA(filepath.Ascii());
@@ -364,6 +435,8 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FlushCompletedBatch(OcclusionBatch* batch)
     {
+        ProfileEventMarker_(0, "FlushCompletedBatch");
+
         if(batch->batchTail == 0) {
             // -- Flush was called on a batch that hadn't been touched at all. We can safely reset this batch here.
             batch->batchHead = 0;
@@ -381,17 +454,22 @@ namespace Selas
         batch->fileHandle = INVALID_HANDLE_VALUE;
         batch->mappingHandle = INVALID_HANDLE_VALUE;
 
-        readyOcclusionBatches.Add(batch);
+        PublishReadyBatch(readyOcclusionBatches, overflowOcclusionBatches, batch);
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::LoadBatch(OcclusionBatch* batch)
+    void PathTracingBatcher::LoadBatch(OcclusionBatch* batch, ArenaAllocator* arena)
     {
+        ProfileEventMarker_(0, "LoadBatch");
+        PerfPhaseScope_(ePerfPhaseLoading);
+
+        MemoryTagScope_(eMemoryTagBatches);
+
         FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
 
         void* fileData;
         uint64 fileSize;
-        Error err = File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize);
+        Error err = File::ReadWholeFile(filepath.Ascii(), arena, &fileData, &fileSize);
         Assert_(Successful_(err));
 
         DeleteFileA(filepath.Ascii());
@@ -434,6 +512,8 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FlushCompletedBatch(HitBatch* batch)
     {
+        ProfileEventMarker_(0, "FlushCompletedBatch");
+
         if(batch->batchTail == 0) {
             // -- Flush was called on a batch that hadn't been touched at all. We can safely reset this batch here.
             batch->batchHead = 0;
@@ -451,17 +531,22 @@ namespace Selas
         batch->fileHandle = INVALID_HANDLE_VALUE;
         batch->mappingHandle = INVALID_HANDLE_VALUE;
 
-        readyHitBatches.Add(batch);
+        PublishReadyBatch(readyHitBatches, overflowHitBatches, batch);
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::LoadBatch(HitBatch* batch)
+    void PathTracingBatcher::LoadBatch(HitBatch* batch, ArenaAllocator* arena)
     {
+        ProfileEventMarker_(0, "LoadBatch");
+        PerfPhaseScope_(ePerfPhaseLoading);
+
+        MemoryTagScope_(eMemoryTagBatches);
+
         FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
 
         void* fileData;
         uint64 fileSize;
-        Error err = File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize);
+        Error err = File::ReadWholeFile(filepath.Ascii(), arena, &fileData, &fileSize);
         Assert_(Successful_(err));
 
         DeleteFileA(filepath.Ascii());
@@ -494,6 +579,14 @@ namespace Selas
         hitBatchCapacity = hitBatchCapacity_;
         lock = CreateSpinLock();
 
+        deferredBatches.Initialize();
+        occlusionBatches.Initialize();
+        hitBatches.Initialize();
+
+        readyDeferredBatches.Initialize(ReadyBatchQueueSize_);
+        readyOcclusionBatches.Initialize(ReadyBatchQueueSize_);
+        readyHitBatches.Initialize(ReadyBatchQueueSize_);
+
         for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
             currentDeferred[scan] = AllocateRayBatch((RayBatchCategory)scan);
             currentOcclusion[scan] = AllocateOcclusionBatch((RayBatchCategory)scan);
@@ -505,6 +598,10 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::Shutdown()
     {
+        ShutdownReadyBatches(readyDeferredBatches, overflowDeferredBatches);
+        ShutdownReadyBatches(readyOcclusionBatches, overflowOcclusionBatches);
+        ShutdownReadyBatches(readyHitBatches, overflowHitBatches);
+
         for(uint scan = 0, count = deferredBatches.Count(); scan < count; ++scan) {
             Delete_(deferredBatches[scan]);
         }
@@ -702,39 +799,35 @@ namespace Selas
     }
 
     //=================================================================================================================================
-    bool PathTracingBatcher::GetSortedBatch(DeferredRay*& rays, uint& rayCount)
+    uint64 PathTracingBatcher::TransientBatchSize()
     {
-        // -- Check before locking to see if it's possible to claim a batch.
-        if(readyDeferredBatches.Count() == 0) {
-            return false;
-        }
-        
-        EnterSpinLock(lock);
+        uint64 raySize = rayBatchCapacity * Max<uint64>(sizeof(DeferredRay), sizeof(OcclusionRay));
+        uint64 hitSize = hitBatchCapacity * sizeof(HitParameters);
 
-        // -- Check again to make sure another thread didn't claim it before we could enter the lock
-        if(readyDeferredBatches.Count() == 0) {
-            LeaveSpinLock(lock);
+        return Max<uint64>(raySize, hitSize);
+    }
+
+    //=================================================================================================================================
+    bool PathTracingBatcher::GetSortedBatch(ArenaAllocator* arena, DeferredRay*& rays, uint& rayCount)
+    {
+        DeferredBatch* batch;
+        if(ClaimReadyBatch(readyDeferredBatches, overflowDeferredBatches, lock, batch) == false) {
             return false;
         }
 
-        DeferredBatch* batch = readyDeferredBatches[readyDeferredBatches.Count() - 1];
-        readyDeferredBatches.RemoveFast(readyDeferredBatches.Count() - 1);
-
-        LeaveSpinLock(lock);
-
-        LoadBatch(batch);
+        LoadBatch(batch, arena);
 
         rays = batch->rays;
         rayCount = (uint)batch->batchTail;
 
         if(batch->category == PositiveX || batch->category == NegativeX) {
-            SortRaysInternal((DeferredRaySortX*)rays, rayCount);
+            SortRays((DeferredRaySortX*)rays, rayCount);
         }
         else if(batch->category == PositiveY || batch->category == NegativeY) {
-            SortRaysInternal((DeferredRaySortY*)rays, rayCount);
+            SortRays((DeferredRaySortY*)rays, rayCount);
         }
         else {
-            SortRaysInternal((DeferredRaySortZ*)rays, rayCount);
+            SortRays((DeferredRaySortZ*)rays, rayCount);
         }
 
         Atomic::AddU64(&totalEntriesConsumed, rayCount);
@@ -743,45 +836,32 @@ namespace Selas
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::FreeRays(DeferredRay* rays)
+    void PathTracingBatcher::FreeRays(ArenaAllocator* arena, DeferredRay* rays)
     {
-        FreeAligned_(rays);
+        ArenaFree_(arena, rays);
     }
 
     //=================================================================================================================================
-    bool PathTracingBatcher::GetSortedBatch(OcclusionRay*& rays, uint& rayCount)
+    bool PathTracingBatcher::GetSortedBatch(ArenaAllocator* arena, OcclusionRay*& rays, uint& rayCount)
     {
-        // -- Check before locking to see if it's possible to claim a batch.
-        if(readyOcclusionBatches.Count() == 0) {
+        OcclusionBatch* batch;
+        if(ClaimReadyBatch(readyOcclusionBatches, overflowOcclusionBatches, lock, batch) == false) {
             return false;
         }
 
-        EnterSpinLock(lock);
-
-        // -- Check again to make sure another thread didn't claim it before we could enter the lock
-        if(readyOcclusionBatches.Count() == 0) {
-            LeaveSpinLock(lock);
-            return false;
-        }
-
-        OcclusionBatch* batch = readyOcclusionBatches[readyOcclusionBatches.Count() - 1];
-        readyOcclusionBatches.RemoveFast(readyOcclusionBatches.Count() - 1);
-
-        LeaveSpinLock(lock);
-
-        LoadBatch(batch);
+        LoadBatch(batch, arena);
 
         rays = batch->rays;
         rayCount = (uint)batch->batchTail;
 
         if(batch->category == PositiveX || batch->category == NegativeX) {
-            SortRaysInternal((OcclusionRaySortX*)rays, rayCount);
+            SortRays((OcclusionRaySortX*)rays, rayCount);
         }
         else if(batch->category == PositiveY || batch->category == NegativeY) {
-            SortRaysInternal((OcclusionRaySortY*)rays, rayCount);
+            SortRays((OcclusionRaySortY*)rays, rayCount);
         }
         else {
-            SortRaysInternal((OcclusionRaySortZ*)rays, rayCount);
+            SortRays((OcclusionRaySortZ*)rays, rayCount);
         }
 
         Atomic::AddU64(&totalEntriesConsumed, rayCount);
@@ -790,38 +870,29 @@ namespace Selas
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::FreeRays(OcclusionRay* rays)
+    void PathTracingBatcher::FreeRays(ArenaAllocator* arena, OcclusionRay* rays)
     {
-        FreeAligned_(rays);
+        ArenaFree_(arena, rays);
     }
 
     //=================================================================================================================================
-    bool PathTracingBatcher::GetSortedHits(HitParameters*& hits, uint& hitCount)
+    bool PathTracingBatcher::GetSortedHits(ArenaAllocator* arena, HitParameters*& hits, uint& hitCount)
     {
-        // -- Check before locking to see if it's possible to claim a batch.
-        if(readyHitBatches.Count() == 0) {
+        HitBatch* batch;
+        if(ClaimReadyBatch(readyHitBatches, overflowHitBatches, lock, batch) == false) {
             return false;
         }
 
-        EnterSpinLock(lock);
-
-        // -- Check again to make sure another thread didn't claim it before we could enter the lock
-        if(readyHitBatches.Count() == 0) {
-            LeaveSpinLock(lock);
-            return false;
-        }
-
-        HitBatch* batch = readyHitBatches[readyHitBatches.Count() - 1];
-        readyHitBatches.RemoveFast(readyHitBatches.Count() - 1);
-
-        LeaveSpinLock(lock);
-
-        LoadBatch(batch);
+        LoadBatch(batch, arena);
 
         hits = batch->hits;
         hitCount = (uint)batch->batchTail;
 
-        QuickSort(hits, hitCount);
+        {
+            ProfileEventMarker_(0, "SortHits");
+            PerfPhaseScope_(ePerfPhaseSorting);
+            QuickSort(hits, hitCount);
+        }
 
         Atomic::AddU64(&totalEntriesConsumed, hitCount);
 
@@ -829,9 +900,9 @@ namespace Selas
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::FreeHits(HitParameters* hits)
+    void PathTracingBatcher::FreeHits(ArenaAllocator* arena, HitParameters* hits)
     {
-        FreeAligned_(hits);
+        ArenaFree_(arena, hits);
     }
 
     //=================================================================================================================================
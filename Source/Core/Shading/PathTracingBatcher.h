@@ -6,12 +6,15 @@
 
 #include "Shading/IntegratorContexts.h"
 #include "GeometryLib/Ray.h"
+#include "ContainersLib/MpmcQueue.h"
+#include "ContainersLib/ChunkedArray.h"
 #include "ContainersLib/CArray.h"
 #include "MathLib/FloatStructs.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
 {
+    struct ArenaAllocator;
     struct DeferredBatch;
     struct OcclusionBatch;
     struct HitBatch;
@@ -26,7 +29,8 @@ namespace Selas
         uint32 index            : 26;
         uint32 trackedBounces   : 3;
         uint32 diracScatterOnly : 1;
-        uint32 unused           : 2;
+        uint32 oddSample        : 1;
+        uint32 unused           : 1;
 
         float  error;
     };
@@ -36,7 +40,8 @@ namespace Selas
         Ray ray;
         float distance;
         float3 value;
-        uint32 index;
+        uint32 index            : 31;
+        uint32 oddSample        : 1;
     };
 
     enum RayBatchCategory
@@ -60,12 +65,19 @@ namespace Selas
         Align_(64) OcclusionBatch* currentOcclusion[RayBatchCategoryCount];
         Align_(64) HitBatch* currentHits;
 
-        CArray<DeferredBatch*>  deferredBatches;
-        CArray<DeferredBatch*>  readyDeferredBatches;
-        CArray<OcclusionBatch*> occlusionBatches;
-        CArray<OcclusionBatch*> readyOcclusionBatches;
-        CArray<HitBatch*>       hitBatches;
-        CArray<HitBatch*>       readyHitBatches;
+        // -- Every batch ever allocated so they can be deleted on shutdown. Appended to without the lock.
+        ChunkedArray<DeferredBatch*>  deferredBatches;
+        ChunkedArray<OcclusionBatch*> occlusionBatches;
+        ChunkedArray<HitBatch*>       hitBatches;
+
+        // -- Completed batches are claimed without taking the lock. The overflow arrays are only touched under the lock and only
+        // -- used if a queue fills up.
+        MpmcQueue<DeferredBatch*>  readyDeferredBatches;
+        MpmcQueue<OcclusionBatch*> readyOcclusionBatches;
+        MpmcQueue<HitBatch*>       readyHitBatches;
+        CArray<DeferredBatch*>     overflowDeferredBatches;
+        CArray<OcclusionBatch*>    overflowOcclusionBatches;
+        CArray<HitBatch*>          overflowHitBatches;
 
         int64 rayBatchCapacity;
         int64 hitBatchCapacity;
@@ -75,15 +87,15 @@ namespace Selas
 
         DeferredBatch* AllocateRayBatch(RayBatchCategory category);
         void FlushCompletedBatch(DeferredBatch* batch);
-        void LoadBatch(DeferredBatch* batch);
+        void LoadBatch(DeferredBatch* batch, ArenaAllocator* arena);
 
         OcclusionBatch* AllocateOcclusionBatch(RayBatchCategory category);
         void FlushCompletedBatch(OcclusionBatch* batch);
-        void LoadBatch(OcclusionBatch* batch);
+        void LoadBatch(OcclusionBatch* batch, ArenaAllocator* arena);
 
         HitBatch* AllocateHitBatch();
         void FlushCompletedBatch(HitBatch* batch);
-        void LoadBatch(HitBatch* batch);
+        void LoadBatch(HitBatch* batch, ArenaAllocator* arena);
 
     public:
 
@@ -99,14 +111,17 @@ namespace Selas
 
         void Flush();
 
-        bool GetSortedBatch(DeferredRay*& rays, uint& rayCount);
-        void FreeRays(DeferredRay* rays);
+        // -- Batches are loaded into the calling thread's arena. The arena can be reset once the batch has been freed.
+        uint64 TransientBatchSize();
+
+        bool GetSortedBatch(ArenaAllocator* arena, DeferredRay*& rays, uint& rayCount);
+        void FreeRays(ArenaAllocator* arena, DeferredRay* rays);
 
-        bool GetSortedBatch(OcclusionRay*& rays, uint& rayCount);
-        void FreeRays(OcclusionRay* rays);
+        bool GetSortedBatch(ArenaAllocator* arena, OcclusionRay*& rays, uint& rayCount);
+        void FreeRays(ArenaAllocator* arena, OcclusionRay* rays);
 
-        bool GetSortedHits(HitParameters*& rays, uint& hitCount);
-        void FreeHits(HitParameters* hits);
+        bool GetSortedHits(ArenaAllocator* arena, HitParameters*& rays, uint& hitCount);
+        void FreeHits(ArenaAllocator* arena, HitParameters* hits);
 
         bool Empty();
     };
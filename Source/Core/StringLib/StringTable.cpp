@@ -0,0 +1,245 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "StringLib/StringTable.h"
+#include "StringLib/StringUtil.h"
+#include "StringLib/FixedString.h"
+#include "UtilityLib/MurmurHash.h"
+#include "IoLib/Serializer.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/JsAssert.h"
+
+#define StringTablePageSize_        64 Kb_
+#define StringTableChunkSize_       4096
+#define StringTableMaxChunkCount_   16384
+
+namespace Selas
+{
+    static CStringTable* pathStringTable = nullptr;
+
+    //=============================================================================================================================
+    bool operator==(const StringTableKey& lhs, const StringTableKey& rhs)
+    {
+        return lhs.hash == rhs.hash && StringUtil::Equals(lhs.ascii, rhs.ascii);
+    }
+
+    //=============================================================================================================================
+    CStringTable::CStringTable()
+        : page(nullptr)
+        , pageUsed(0)
+        , storageSize(0)
+    {
+        spinlock = CreateSpinLock();
+        strings.Initialize(StringTableChunkSize_, StringTableMaxChunkCount_);
+
+        // -- Handle 0
+        strings.Add("");
+    }
+
+    //=============================================================================================================================
+    CStringTable::~CStringTable()
+    {
+        for(uint scan = 0, count = pages.Count(); scan < count; ++scan) {
+            Free_(pages[scan]);
+        }
+        pages.Shutdown();
+
+        lookup.Shutdown();
+        strings.Shutdown();
+        CloseSpinlock(spinlock);
+    }
+
+    //=============================================================================================================================
+    char* CStringTable::AllocateCharacters(uint64 size)
+    {
+        // -- Anything too big to share a page gets its own.
+        if(size > StringTablePageSize_ / 4) {
+            char* characters = AllocArray_(char, size);
+            pages.Add(characters);
+            storageSize += size;
+            return characters;
+        }
+
+        if(page == nullptr || pageUsed + size > StringTablePageSize_) {
+            page = AllocArray_(char, StringTablePageSize_);
+            pages.Add(page);
+            pageUsed = 0;
+            storageSize += StringTablePageSize_;
+        }
+
+        char* characters = page + pageUsed;
+        pageUsed += size;
+        return characters;
+    }
+
+    //=============================================================================================================================
+    InternedString CStringTable::Intern(cpointer ascii)
+    {
+        InternedString result;
+        if(ascii == nullptr || ascii[0] == '\0') {
+            return result;
+        }
+
+        int32 length = StringUtil::Length(ascii);
+
+        StringTableKey key;
+        key.ascii = ascii;
+        key.hash = MurmurHash3_x86_32(ascii, length);
+
+        EnterSpinLock(spinlock);
+
+        uint32* existing = lookup.Find(key);
+        if(existing) {
+            result.handle = *existing;
+        }
+        else {
+            char* characters = AllocateCharacters(length + 1);
+            Memory::Copy(characters, ascii, length + 1);
+
+            key.ascii = characters;
+            result.handle = (uint32)strings.Add(characters);
+            lookup.Insert(key, result.handle);
+        }
+
+        LeaveSpinLock(spinlock);
+
+        return result;
+    }
+
+    //=============================================================================================================================
+    cpointer CStringTable::Ascii(InternedString string) const
+    {
+        Assert_(string.handle < strings.Count());
+        return strings[string.handle];
+    }
+
+    //=============================================================================================================================
+    uint32 CStringTable::Count() const
+    {
+        return (uint32)strings.Count();
+    }
+
+    //=============================================================================================================================
+    uint64 CStringTable::StorageSize() const
+    {
+        return storageSize;
+    }
+
+    //=============================================================================================================================
+    void CStringTable::Write(CSerializer* serializer)
+    {
+        uint32 count = Count();
+        Serialize(serializer, count);
+
+        for(uint32 scan = 1; scan < count; ++scan) {
+            cpointer ascii = strings[scan];
+            uint32 length = (uint32)StringUtil::Length(ascii);
+
+            Serialize(serializer, length);
+            serializer->Serialize((void*)ascii, length);
+        }
+    }
+
+    //=============================================================================================================================
+    Error CStringTable::Read(CSerializer* serializer, CArray<InternedString>& remap)
+    {
+        uint32 count = 0;
+        Serialize(serializer, count);
+
+        remap.Resize(count);
+        if(count == 0) {
+            return Success_;
+        }
+        remap[0] = InternedString();
+
+        FilePathString ascii;
+        for(uint32 scan = 1; scan < count; ++scan) {
+            uint32 length = 0;
+            Serialize(serializer, length);
+            if(length >= ascii.Capacity()) {
+                return Error_("String %u of %u is %u characters; the limit is %u", scan, count, length, (uint32)ascii.Capacity() - 1);
+            }
+
+            serializer->Serialize(ascii.Ascii(), length);
+            ascii.Ascii()[length] = '\0';
+
+            remap[scan] = Intern(ascii.Ascii());
+        }
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    void PathStringTable_Initialize()
+    {
+        Assert_(pathStringTable == nullptr);
+        pathStringTable = New_(CStringTable);
+    }
+
+    //=============================================================================================================================
+    void PathStringTable_Shutdown()
+    {
+        SafeDelete_(pathStringTable);
+    }
+
+    //=============================================================================================================================
+    CStringTable* PathStringTable()
+    {
+        AssertMsg_(pathStringTable != nullptr, "PathStringTable_Initialize has not been called");
+        return pathStringTable;
+    }
+
+    //=============================================================================================================================
+    InternedString InternPath(cpointer path)
+    {
+        return PathStringTable()->Intern(path);
+    }
+
+    //=============================================================================================================================
+    cpointer PathAscii(InternedString path)
+    {
+        return PathStringTable()->Ascii(path);
+    }
+
+    //=============================================================================================================================
+    uint32 PackedStrings_Add(PackedStrings* strings, cpointer ascii)
+    {
+        uint32 length = (uint32)StringUtil::Length(ascii);
+        uint32 offset = (uint32)strings->characters.Count();
+
+        strings->characters.Resize(offset + length + 1);
+        Memory::Copy(strings->characters.DataPointer() + offset, ascii, length + 1);
+
+        return (uint32)strings->offsets.Add(offset);
+    }
+
+    //=============================================================================================================================
+    cpointer PackedStrings_Get(const PackedStrings* strings, uint32 index)
+    {
+        Assert_(index < strings->offsets.Count());
+        return strings->characters.DataPointer() + strings->offsets[index];
+    }
+
+    //=============================================================================================================================
+    uint32 PackedStrings_Count(const PackedStrings* strings)
+    {
+        return (uint32)strings->offsets.Count();
+    }
+
+    //=============================================================================================================================
+    void PackedStrings_Shutdown(PackedStrings* strings)
+    {
+        strings->offsets.Shutdown();
+        strings->characters.Shutdown();
+    }
+
+    //=============================================================================================================================
+    void Serialize(CSerializer* serializer, PackedStrings& data)
+    {
+        Serialize(serializer, data.offsets);
+        Serialize(serializer, data.characters);
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ContainersLib/CHashMap.h"
+#include "ContainersLib/ChunkedArray.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    class CSerializer;
+
+    //=============================================================================================================================
+    // -- Handle to a string stored once in a CStringTable. Two handles from the same table are equal exactly when their strings
+    // -- are. Handle 0 is always the empty string.
+    struct InternedString
+    {
+        InternedString() : handle(0) { }
+
+        bool Empty() const { return handle == 0; }
+
+        uint32 handle;
+    };
+
+    inline bool operator==(const InternedString& lhs, const InternedString& rhs) { return lhs.handle == rhs.handle; }
+    inline bool operator!=(const InternedString& lhs, const InternedString& rhs) { return lhs.handle != rhs.handle; }
+    inline uint32 HashValue(const InternedString& string) { return HashValue(string.handle); }
+
+    //=============================================================================================================================
+    struct StringTableKey
+    {
+        cpointer ascii;
+        uint32   hash;
+    };
+
+    bool operator==(const StringTableKey& lhs, const StringTableKey& rhs);
+    inline uint32 HashValue(const StringTableKey& key) { return key.hash; }
+
+    //=============================================================================================================================
+    // -- Deduplicated string storage. Strings are copied into large pages and never move so Ascii doesn't need the lock that
+    // -- Intern takes.
+    class CStringTable
+    {
+    public:
+        CStringTable();
+        ~CStringTable();
+
+        InternedString Intern(cpointer ascii);
+        cpointer       Ascii(InternedString string) const;
+
+        // -- Including the empty string
+        uint32 Count() const;
+        uint64 StorageSize() const;
+
+        // -- Handles are only meaningful in the process that created them. Write stores every string in handle order and Read
+        // -- interns them again, filling remap with the new handle for each old one. Strings longer than a FilePathString fail
+        // -- the read.
+        void  Write(CSerializer* serializer);
+        Error Read(CSerializer* serializer, CArray<InternedString>& remap);
+
+    private:
+        char* AllocateCharacters(uint64 size);
+
+    private:
+        void* spinlock;
+
+        CHashMap<StringTableKey, uint32> lookup;
+        ChunkedArray<cpointer>           strings;
+
+        CArray<char*> pages;
+        char*         page;
+        uint64        pageUsed;
+        uint64        storageSize;
+    };
+
+    //=============================================================================================================================
+    // -- Shared table for content and asset paths. Anything keyed by path should intern through this so handles compare
+    // -- across systems. It is created and destroyed explicitly so it never outlives the allocator at exit.
+    void           PathStringTable_Initialize();
+    void           PathStringTable_Shutdown();
+    CStringTable*  PathStringTable();
+    InternedString InternPath(cpointer path);
+    cpointer       PathAscii(InternedString path);
+
+    //=============================================================================================================================
+    // -- Strings packed end to end for serialized resources where handles can't be stored. Each string only takes its own
+    // -- length rather than a whole FilePathString.
+    struct PackedStrings
+    {
+        CArray<uint32> offsets;
+        CArray<char>   characters;
+    };
+
+    uint32   PackedStrings_Add(PackedStrings* strings, cpointer ascii);
+    cpointer PackedStrings_Get(const PackedStrings* strings, uint32 index);
+    uint32   PackedStrings_Count(const PackedStrings* strings);
+    void     PackedStrings_Shutdown(PackedStrings* strings);
+
+    void Serialize(CSerializer* serializer, PackedStrings& data);
+}
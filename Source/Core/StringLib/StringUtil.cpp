@@ -135,7 +135,7 @@ namespace Selas
         {
             #if IsWindows_
             return _strnicmp(lhs, rhs, compareLength);
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 return strncmp(lhs, rhs, compareLength);
             #endif
         }
@@ -157,7 +157,7 @@ namespace Selas
         {
             #if IsWindows_
             return (_stricmp(lhs, rhs) == 0);
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 return (strcmp(lhs, rhs) == 0);
             #endif
         }
@@ -177,7 +177,7 @@ namespace Selas
 
             #if IsWindows_
                 return _stricmp(lhs + startIndex, rhs) == 0;
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 return strcmp(lhs + startIndex, rhs) == 0;
             #endif
         }
@@ -187,7 +187,7 @@ namespace Selas
         {
             #if IsWindows_
             strcpy_s(destString, destMaxLength, sourceString);
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 strncpy(destString, sourceString, destMaxLength);
             #endif
         }
@@ -199,7 +199,7 @@ namespace Selas
 
             #if IsWindows_
                 strncpy_s(destString, destMaxLength, sourceString, copyLength);
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 strncpy(destString, sourceString, copyLength);
             #endif
 
@@ -281,7 +281,7 @@ namespace Selas
             if(GetFullPathNameA(src, (DWORD)maxLength, dst, nullptr) == 0) {
                 return false;
             }
-            #elif IsOsx_
+            #elif IsOsx_ || IsLinux_
                 if(realpath(src, dst) == 0) {
                     return false;
                 }
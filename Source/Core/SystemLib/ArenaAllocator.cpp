@@ -0,0 +1,88 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/ArenaAllocator.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/MinMax.h"
+
+#define ArenaBaseAlignment_ 4096
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static bool ArenaOwns(ArenaAllocator* arena, void* address)
+    {
+        uint8* bytes = (uint8*)address;
+        return bytes >= arena->memory && bytes < arena->memory + arena->capacity;
+    }
+
+    //=============================================================================================================================
+    void ArenaAllocator_Initialize(ArenaAllocator* arena, uint64 capacity)
+    {
+        arena->memory = capacity > 0 ? AllocArrayAligned_(uint8, capacity, ArenaBaseAlignment_) : nullptr;
+        arena->capacity = capacity;
+        arena->offset = 0;
+        arena->highWaterMark = 0;
+        arena->fallbackCount = 0;
+        arena->outstandingFallbacks = 0;
+        arena->allocationTime = std::chrono::duration<float, std::micro>::zero();
+    }
+
+    //=============================================================================================================================
+    void ArenaAllocator_Shutdown(ArenaAllocator* arena)
+    {
+        AssertMsg_(arena->outstandingFallbacks == 0, "Arena shut down with outstanding heap fallback allocations");
+
+        SafeFreeAligned_(arena->memory);
+        arena->capacity = 0;
+        arena->offset = 0;
+    }
+
+    //=============================================================================================================================
+    void* ArenaAllocator_Alloc(ArenaAllocator* arena, uint64 size, uint64 alignment, const char* name, const char* file,
+                               int line)
+    {
+        CScopedTimeAccumulator<std::micro> timer(&arena->allocationTime);
+
+        Assert_(alignment > 0 && (alignment & (alignment - 1)) == 0);
+        Assert_(alignment <= ArenaBaseAlignment_);
+
+        uint64 start = (arena->offset + alignment - 1) & ~(alignment - 1);
+        if(start + size <= arena->capacity) {
+            arena->offset = start + size;
+            arena->highWaterMark = Max<uint64>(arena->highWaterMark, arena->offset);
+            return arena->memory + start;
+        }
+
+        ProfileEventMarker_(0, "ArenaAllocator heap fallback");
+
+        ++arena->fallbackCount;
+        ++arena->outstandingFallbacks;
+        return SelasAlignedMalloc(size, alignment, name, file, line);
+    }
+
+    //=============================================================================================================================
+    void ArenaAllocator_Free(ArenaAllocator* arena, void* address)
+    {
+        if(address == nullptr || ArenaOwns(arena, address)) {
+            // -- Arena memory is only released by a reset.
+            return;
+        }
+
+        CScopedTimeAccumulator<std::micro> timer(&arena->allocationTime);
+
+        Assert_(arena->outstandingFallbacks > 0);
+        --arena->outstandingFallbacks;
+        SelasAlignedFree(address);
+    }
+
+    //=============================================================================================================================
+    void ArenaAllocator_Reset(ArenaAllocator* arena)
+    {
+        arena->offset = 0;
+    }
+}
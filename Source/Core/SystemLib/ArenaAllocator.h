@@ -0,0 +1,37 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+#include <chrono>
+
+namespace Selas
+{
+    // -- Linear allocator for transient data owned by a single thread. Allocations are bumped out of one block and released all
+    // -- at once by a reset at batch boundaries. Requests that do not fit fall back to the global heap.
+    struct ArenaAllocator
+    {
+        uint8* memory;
+        uint64 capacity;
+        uint64 offset;
+        uint64 highWaterMark;
+
+        uint64 fallbackCount;
+        uint64 outstandingFallbacks;
+
+        std::chrono::duration<float, std::micro> allocationTime;
+    };
+
+    #define ArenaAlloc_(Arena_, AllocSize_, Alignment_)    Selas::ArenaAllocator_Alloc(Arena_, AllocSize_, Alignment_, __FUNCTION__, __FILE__, __LINE__)
+    #define ArenaFree_(Arena_, Var_)                       Selas::ArenaAllocator_Free(Arena_, Var_)
+
+    void  ArenaAllocator_Initialize(ArenaAllocator* arena, uint64 capacity);
+    void  ArenaAllocator_Shutdown(ArenaAllocator* arena);
+    void* ArenaAllocator_Alloc(ArenaAllocator* arena, uint64 size, uint64 alignment, const char* name, const char* file,
+                               int line);
+    void  ArenaAllocator_Free(ArenaAllocator* arena, void* address);
+    void  ArenaAllocator_Reset(ArenaAllocator* arena);
+}
@@ -24,5 +24,11 @@ namespace Selas
 
         bool CompareExchange32(volatile int32* dest, int32 exchange_with, int32 compare_to);
         bool CompareExchange64(volatile int64* dest, int64 exchange_with, int64 compare_to);
+
+        // -- Ordering for lock-free containers. volatile only orders volatile accesses against each other so publishing plain
+        // -- data needs these.
+        int64 LoadAcquire64(volatile int64* source);
+        void  StoreRelease64(volatile int64* dest, int64 value);
+        void  FullBarrier();
     }
 }
\ No newline at end of file
@@ -1,4 +1,4 @@
-#if IsOsx_
+#if IsOsx_ || IsLinux_
 
 //=================================================================================================================================
 // Joe Schutte 
@@ -78,6 +78,24 @@ namespace Selas
     {
         return __sync_bool_compare_and_swap (destination, compareTo, exchangeWith);
     }
+
+    //=============================================================================================================================
+    int64 Atomic::LoadAcquire64(volatile int64* source)
+    {
+        return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+    }
+
+    //=============================================================================================================================
+    void Atomic::StoreRelease64(volatile int64* destination, int64 value)
+    {
+        __atomic_store_n(destination, value, __ATOMIC_RELEASE);
+    }
+
+    //=============================================================================================================================
+    void Atomic::FullBarrier()
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
 }
 
 #endif
\ No newline at end of file
@@ -104,6 +104,28 @@ namespace Selas
                                                                compareTo);
         return initialValue == compareTo;
     }
+
+    //=============================================================================================================================
+    int64 Atomic::LoadAcquire64(volatile int64* source)
+    {
+        // -- x64 loads already have acquire semantics so only the compiler needs fencing.
+        int64 value = *source;
+        _ReadWriteBarrier();
+        return value;
+    }
+
+    //=============================================================================================================================
+    void Atomic::StoreRelease64(volatile int64* destination, int64 value)
+    {
+        _ReadWriteBarrier();
+        *destination = value;
+    }
+
+    //=============================================================================================================================
+    void Atomic::FullBarrier()
+    {
+        MemoryBarrier();
+    }
 }
 
 #endif
\ No newline at end of file
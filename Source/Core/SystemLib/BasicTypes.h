@@ -16,10 +16,15 @@ typedef unsigned long long uint64;
 
 typedef const char*        cpointer;
 
+// -- The premake platform normally defines this. Code after this include still sees Linux when a build did not.
+#if !defined(IsWindows_) && !defined(IsOsx_) && !defined(IsLinux_) && defined(__linux__)
+	#define IsLinux_ 1
+#endif
+
 #if IsWindows_
 	#define ForceInline_    __forceinline
 	#define Align_(x)       __declspec(align(x))
-#elif IsOsx_
+#elif IsOsx_ || IsLinux_
 	#define ForceInline_ 	inline
 	#define Align_(x)       __attribute__ ((aligned(x)))
 #endif
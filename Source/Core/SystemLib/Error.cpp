@@ -9,7 +9,7 @@
     // -- for DebugBreak
     #define WIN32_LEAN_AND_MEAN
     #include <windows.h>
-#elif IsOsx_
+#elif IsOsx_ || IsLinux_
     #include <stdarg.h>
 #endif
 
@@ -47,7 +47,7 @@ namespace Selas
 
         #if IsWindows_
             uint32 errorStrLength = _vscprintf(message, varg) + 1;
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             uint32 errorStrLength = vsnprintf(NULL, 0, message, varg) + 1;
         #endif
 
@@ -57,7 +57,7 @@ namespace Selas
 
         #if IsWindows_
             vsnprintf_s(errorMessage, errorStrLength, _TRUNCATE, message, varg);
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             vsnprintf(errorMessage, errorStrLength, message, varg);
         #endif
 
@@ -66,13 +66,13 @@ namespace Selas
         #if IsWindows_
             OutputDebugStringA(errorMessage);
             OutputDebugStringA("\n");
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             printf("%s\n", errorMessage);
         #endif
 
         #if IsWindows_
             DebugBreak();
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             __builtin_trap();
         #endif
     }
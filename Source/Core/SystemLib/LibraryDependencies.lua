@@ -2,4 +2,8 @@
 local platform = ...
 
 loadfile(RootDirectory .. "ProjectGen\\Middlewares\\winpixruntime.lua")(platform)
-loadfile(RootDirectory .. "ProjectGen\\Middlewares\\tbb.lua")(platform)
\ No newline at end of file
+loadfile(RootDirectory .. "ProjectGen\\Middlewares\\tbb.lua")(platform)
+
+if platform == "linux" then
+    table.insert(middlewareLibraries, "pthread")
+end
\ No newline at end of file
@@ -8,7 +8,7 @@
     // -- for DebugBreak
     #define WIN32_LEAN_AND_MEAN
     #include <windows.h>
-#elif IsOsx_
+#elif IsOsx_ || IsLinux_
     #include <stdarg.h>
 #endif
 
@@ -29,7 +29,7 @@ namespace Selas
 
         #if IsWindows_
             vsnprintf_s(localstr, MaxMessageLength_, _TRUNCATE, message, varg);
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             vsnprintf(localstr, MaxMessageLength_, message, varg);
         #endif
 
@@ -38,7 +38,7 @@ namespace Selas
         #if IsWindows_
             OutputDebugStringA(localstr);
             OutputDebugStringA("\n");
-        #elif IsOsx_
+        #elif IsOsx_ || IsLinux_
             printf("%s\n", localstr);
         #endif
     }
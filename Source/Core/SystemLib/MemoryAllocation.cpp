@@ -6,258 +6,580 @@
 
 #include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/Logging.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/Memory.h"
 #include "SystemLib/JsAssert.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <map>
 #include <memory>
 
 #if IsWindows_
 #include <windows.h>
+#elif IsLinux_
+#include <sys/mman.h>
 #endif
 
 // -- allocation tracking
 #define EnableManualAllocationTracking_ Debug_ && 1
-#define AllocationTrackingIncrement_    4096
+#define AllocationTrackingShardCount_   64
+#define AllocationHeaderSize_           16
+#define HugePageSize_                   2 Mb_
+#define HugePageThreshold_              2 Mb_
+#define DefaultHugePagePolicy_          eHugePagesDisabled
 #define EnableVerboseLogging_           IsWindows_ && 0
 // #define BreakOnAllocation_              61
 
 namespace Selas
 {
+    //=============================================================================================================================
+    // Tagged budgets
+    //=============================================================================================================================
+
+    // -- Stored immediately in front of every address handed out so frees know the size and tag without a lookup.
+    struct AllocationHeader
+    {
+        uint64 size;
+        uint32 offset;
+        uint16 tag;
+        uint16 flags;
+    };
+
+    enum AllocationFlags
+    {
+        eAllocationMapped = 1 << 0
+    };
+    static_assert(sizeof(AllocationHeader) == AllocationHeaderSize_, "Allocation header size changed");
+
+    struct MemoryTagCounters
+    {
+        Align_(CacheLineSize_) volatile int64 liveBytes;
+        volatile int64 highWaterBytes;
+        volatile int64 allocationCount;
+    };
+
+    static MemoryTagCounters memoryTagCounters[eMemoryTagCount];
+    static thread_local MemoryTag threadMemoryTag = eMemoryTagGeneral;
+    static HugePagePolicy hugePagePolicy = DefaultHugePagePolicy_;
+
+    static cpointer memoryTagNames[eMemoryTagCount] = {
+        "General",
+        "Geometry",
+        "Textures",
+        "Batches",
+        "BVH",
+        "Build"
+    };
+
+    //=============================================================================================================================
+    static void AddToMemoryTag(uint32 tag, int64 bytes, int64 count)
+    {
+        MemoryTagCounters& counters = memoryTagCounters[tag];
+
+        int64 live = Atomic::Add64(&counters.liveBytes, bytes) + bytes;
+        if(count != 0) {
+            Atomic::Add64(&counters.allocationCount, count);
+        }
+
+        int64 highWater = counters.highWaterBytes;
+        while(live > highWater) {
+            if(Atomic::CompareExchange64(&counters.highWaterBytes, live, highWater)) {
+                break;
+            }
+            highWater = counters.highWaterBytes;
+        }
+    }
+
+    //=============================================================================================================================
+    ScopedMemoryTag::ScopedMemoryTag(MemoryTag tag)
+    {
+        previous = SetThreadMemoryTag(tag);
+    }
+
+    //=============================================================================================================================
+    ScopedMemoryTag::~ScopedMemoryTag()
+    {
+        SetThreadMemoryTag(previous);
+    }
+
+    //=============================================================================================================================
+    MemoryTag SetThreadMemoryTag(MemoryTag tag)
+    {
+        MemoryTag previous = threadMemoryTag;
+        threadMemoryTag = tag;
+        return previous;
+    }
+
+    //=============================================================================================================================
+    cpointer MemoryTagName(MemoryTag tag)
+    {
+        Assert_(tag < eMemoryTagCount);
+        return memoryTagNames[tag];
+    }
+
+    //=============================================================================================================================
+    void GetMemoryTagStats(MemoryTag tag, MemoryTagStats& stats)
+    {
+        Assert_(tag < eMemoryTagCount);
+
+        stats.liveBytes       = memoryTagCounters[tag].liveBytes;
+        stats.highWaterBytes  = memoryTagCounters[tag].highWaterBytes;
+        stats.allocationCount = memoryTagCounters[tag].allocationCount;
+    }
+
+    //=============================================================================================================================
+    void LogMemoryTagStats()
+    {
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            MemoryTagStats stats;
+            GetMemoryTagStats((MemoryTag)scan, stats);
+
+            WriteDebugInfo_("Memory (%s): %.2fMB live in %lld allocations - %.2fMB high water", memoryTagNames[scan],
+                            stats.liveBytes / (1024.0f * 1024.0f), stats.allocationCount,
+                            stats.highWaterBytes / (1024.0f * 1024.0f));
+        }
+    }
+
+    //=============================================================================================================================
+    void TrackExternalAllocation(MemoryTag tag, int64 bytes)
+    {
+        Assert_(tag < eMemoryTagCount);
+        AddToMemoryTag(tag, bytes, bytes < 0 ? -1 : 1);
+    }
+
+    //=============================================================================================================================
+    // Huge pages
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    void SetHugePagePolicy(HugePagePolicy policy)
+    {
+        hugePagePolicy = policy;
+    }
+
+    //=============================================================================================================================
+    HugePagePolicy GetHugePagePolicy()
+    {
+        return hugePagePolicy;
+    }
+
+    //=============================================================================================================================
+    static uint64 MappedBlockSize(uint64 blockSize)
+    {
+        return (blockSize + HugePageSize_ - 1) & ~((uint64)HugePageSize_ - 1);
+    }
+
+    //=============================================================================================================================
+    static bool UseMappedBlock(uint64 blockSize)
+    {
+        if(blockSize < HugePageThreshold_) {
+            return false;
+        }
+
+        #if IsWindows_
+            // -- Windows has no transparent huge pages; large pages also require the SeLockMemoryPrivilege.
+            return hugePagePolicy == eHugePagesExplicit;
+        #elif IsLinux_
+            return hugePagePolicy != eHugePagesDisabled;
+        #else
+            return false;
+        #endif
+    }
+
+    //=============================================================================================================================
+    static void* MapLargeBlock(uint64 blockSize)
+    {
+        if(UseMappedBlock(blockSize) == false) {
+            return nullptr;
+        }
+
+        uint64 mappedSize = MappedBlockSize(blockSize);
+
+        #if IsWindows_
+            SIZE_T largePageSize = GetLargePageMinimum();
+            if(largePageSize == 0 || mappedSize % largePageSize != 0) {
+                return nullptr;
+            }
+            return VirtualAlloc(nullptr, mappedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        #elif IsLinux_
+            if(hugePagePolicy == eHugePagesExplicit) {
+                void* block = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if(block != MAP_FAILED) {
+                    return block;
+                }
+            }
+
+            // -- mmap only guarantees page alignment and the kernel will only back huge page aligned ranges with huge pages, so
+            // -- an extra huge page is mapped and the ends are trimmed to leave an aligned range.
+            uint64 reservedSize = mappedSize + HugePageSize_;
+            void* reserved = mmap(nullptr, reservedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(reserved == MAP_FAILED) {
+                return nullptr;
+            }
+
+            uint64 reservedAddress = (uint64)reserved;
+            uint64 blockAddress = (reservedAddress + HugePageSize_ - 1) & ~((uint64)HugePageSize_ - 1);
+            uint64 leadingSize = blockAddress - reservedAddress;
+            uint64 trailingSize = reservedSize - leadingSize - mappedSize;
+
+            if(leadingSize > 0) {
+                munmap(reserved, leadingSize);
+            }
+            if(trailingSize > 0) {
+                munmap((void*)(blockAddress + mappedSize), trailingSize);
+            }
+
+            void* block = (void*)blockAddress;
+            madvise(block, mappedSize, MADV_HUGEPAGE);
+            return block;
+        #else
+            return nullptr;
+        #endif
+    }
+
+    //=============================================================================================================================
+    static void UnmapLargeBlock(void* block, uint64 blockSize)
+    {
+        #if IsWindows_
+            Unused_(blockSize);
+            VirtualFree(block, 0, MEM_RELEASE);
+        #elif IsLinux_
+            munmap(block, MappedBlockSize(blockSize));
+        #else
+            Unused_(block);
+            Unused_(blockSize);
+            Assert_(false);
+        #endif
+    }
+
+    //=============================================================================================================================
+    // Debug allocation tracking
+    //=============================================================================================================================
 
     #if EnableManualAllocationTracking_
     struct Allocation
     {
-        void*       address;
         const char* name;
         const char* file;
         int         line;
+        uint32      tag;
         uint64      index;
         uint64      size;
     };
 
+    // -- Allocations are sharded by address rather than by thread since they are frequently released on another thread.
+    struct AllocationShard
+    {
+        uint8 spinLock[CacheLineSize_];
+        std::map<void*, Allocation> allocations;
+    };
+
     class CAllocationTracking
     {
     private:
-        uint64 index;
-        uint   size;
-        uint   used;
-        Allocation* allocations;
-        std::map<void*, uint> allocSearch;
+        volatile int64 index;
+        AllocationShard shards[AllocationTrackingShardCount_];
 
-        uint8  spinLock[CacheLineSize_];
-
-        uint64 allocatedMemory;
+        AllocationShard& Shard(void* address);
 
     public:
         CAllocationTracking();
         ~CAllocationTracking();
 
-        void AddAllocation(void* address, uint64 allocationSize, const char* name, const char* file, int line);
+        void AddAllocation(void* address, uint64 allocationSize, uint32 tag, const char* name, const char* file, int line);
         void RemoveAllocation(void* address);
     };
 
     //=============================================================================================================================
     CAllocationTracking::CAllocationTracking()
     {
-        size = AllocationTrackingIncrement_;
-        used = 0;
-        allocations = new Allocation[size];
         index = 0;
 
-        allocatedMemory = 0;
-
-        CreateSpinLock(spinLock);
+        for(uint scan = 0; scan < AllocationTrackingShardCount_; ++scan) {
+            CreateSpinLock(shards[scan].spinLock);
+        }
     }
 
     //=============================================================================================================================
     CAllocationTracking::~CAllocationTracking()
     {
-        #if IsWindows_
-            char logstring[2048];
-        
-            for(uint scan = 0; scan < used; ++scan) {
+        uint64 leakCount = 0;
+
+        for(uint scan = 0; scan < AllocationTrackingShardCount_; ++scan) {
+            leakCount += shards[scan].allocations.size();
+
+            #if IsWindows_
+                char logstring[2048];
+
                 // -- log each leaked allocation
-                if(allocations[scan].name != nullptr) {
-                    sprintf_s(logstring, 2048, "Index (%llu) - Name (%s) - Memory leak (%llu bytes) on line (%d) of file: %s\n",
-                              allocations[scan].index, allocations[scan].name, allocations[scan].size, allocations[scan].line,
-                              allocations[scan].file);
-                }
-                else {
-                    sprintf_s(logstring, 2048, "Index (%llu) - Memory leak (%llu bytes) on line (%d) of file: %s\n",
-                              allocations[scan].index, allocations[scan].size, allocations[scan].line, allocations[scan].file);
+                for(auto& leak : shards[scan].allocations) {
+                    const Allocation& allocation = leak.second;
+                    if(allocation.name != nullptr) {
+                        sprintf_s(logstring, 2048, "Index (%llu) - Name (%s) - Memory leak (%llu bytes) on line (%d) of file: %s\n",
+                                  allocation.index, allocation.name, allocation.size, allocation.line, allocation.file);
+                    }
+                    else {
+                        sprintf_s(logstring, 2048, "Index (%llu) - Memory leak (%llu bytes) on line (%d) of file: %s\n",
+                                  allocation.index, allocation.size, allocation.line, allocation.file);
+                    }
+
+                    OutputDebugStringA(logstring);
                 }
+            #endif
+        }
 
-                OutputDebugStringA(logstring);
-            }
-        #endif
-
-        AssertMsg_(used == 0, "Some memory allocations were not released properly");
-        delete[] allocations;
+        AssertMsg_(leakCount == 0, "Some memory allocations were not released properly");
     }
 
     //=============================================================================================================================
-    void CAllocationTracking::AddAllocation(void* address, uint64 allocationSize, const char* name, const char* file, int line)
+    AllocationShard& CAllocationTracking::Shard(void* address)
     {
-        EnterSpinLock(spinLock);
-
-        if(used == size) {
-            size += AllocationTrackingIncrement_;
+        // -- Low bits are mostly alignment so mix in the higher ones before choosing a shard.
+        uint64 key = (uint64)address >> 4;
+        key ^= key >> 17;
 
-            Allocation* newarray = new Allocation[size];
-            Memory::Copy(newarray, allocations, used * sizeof(Allocation));
+        return shards[key % AllocationTrackingShardCount_];
+    }
 
-            delete[] allocations;
-            allocations = newarray;
-        }
+    //=============================================================================================================================
+    void CAllocationTracking::AddAllocation(void* address, uint64 allocationSize, uint32 tag, const char* name, const char* file,
+                                            int line)
+    {
+        Allocation allocation;
+        allocation.name = name;
+        allocation.file = file;
+        allocation.line = line;
+        allocation.tag = tag;
+        allocation.index = (uint64)Atomic::Increment64(&index);
+        allocation.size = allocationSize;
 
         #ifdef BreakOnAllocation_
-            if(BreakOnAllocation_ == index) {
+            if(BreakOnAllocation_ == allocation.index) {
                 DebugBreak();
             }
         #endif
 
-        allocSearch.insert(std::pair<void*, uint>(address, used));
+        AllocationShard& shard = Shard(address);
 
-        allocations[used].address = address;
-        allocations[used].name = name;
-        allocations[used].file = file;
-        allocations[used].line = line;
-        allocations[used].index = index++;
-        allocations[used].size = allocationSize;
-        ++used;
-
-        allocatedMemory += allocationSize;
+        EnterSpinLock(shard.spinLock);
+        shard.allocations.insert(std::pair<void*, Allocation>(address, allocation));
+        LeaveSpinLock(shard.spinLock);
 
         #if EnableVerboseLogging_
             char logstring[2048];
-            sprintf_s(logstring, 2048, "Allocation (%llu): %s - Total Allocated %llu\n", allocationSize, name, allocatedMemory);
+            sprintf_s(logstring, 2048, "Allocation (%llu): %s - %s\n", allocationSize, name, memoryTagNames[tag]);
             OutputDebugString(logstring);
         #endif
-
-        LeaveSpinLock(spinLock);
     }
 
     //=============================================================================================================================
     void CAllocationTracking::RemoveAllocation(void* address)
     {
-        EnterSpinLock(spinLock);
+        AllocationShard& shard = Shard(address);
+
+        EnterSpinLock(shard.spinLock);
 
-        auto obj = allocSearch.find(address);
-        if(obj == allocSearch.end()) {
+        auto obj = shard.allocations.find(address);
+        if(obj == shard.allocations.end()) {
             AssertMsg_(false, "Unknown memory address released");
         }
         else {
-            uint index = obj->second;
-            allocSearch.erase(obj);
-
-            allocatedMemory -= allocations[index].size;
-
             #if EnableVerboseLogging_
                 char logstring[2048];
-                sprintf_s(logstring, 2048, "Free (%llu): %s - Total Allocated %llu\n", allocations[scan].size,
-                          allocations[scan].name, allocatedMemory);
+                sprintf_s(logstring, 2048, "Free (%llu): %s - %s\n", obj->second.size, obj->second.name,
+                          memoryTagNames[obj->second.tag]);
                 OutputDebugString(logstring);
             #endif
 
-            if(used > 1 && index != used - 1) {
-                auto& modifiedObj = allocSearch.find(allocations[used - 1].address);
-                Assert_(modifiedObj != allocSearch.end());
-
-                allocations[index].address = allocations[used - 1].address;
-                allocations[index].name = allocations[used - 1].name;
-                allocations[index].file = allocations[used - 1].file;
-                allocations[index].line = allocations[used - 1].line;
-                allocations[index].index = allocations[used - 1].index;
-                allocations[index].size = allocations[used - 1].size;
-
-                modifiedObj->second = index;
-            }
-
-            --used;
+            shard.allocations.erase(obj);
         }
 
-        LeaveSpinLock(spinLock);
+        LeaveSpinLock(shard.spinLock);
     }
 
     CAllocationTracking tracker;
     #endif
 
     //=============================================================================================================================
-    void* SelasAlignedMalloc(uint size, uint alignment, const char* name, const char* file, int line)
+    // Allocation functions
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static AllocationHeader* GetAllocationHeader(void* address)
     {
-        #if IsWindows_
-            void* address = _aligned_malloc(size, alignment);
-        #elif IsOsx_
-            void* address = nullptr;
-            if(posix_memalign(&address, alignment, size) != 0) {
-                return nullptr;
-            }
-        #endif
+        return (AllocationHeader*)((uint8*)address - AllocationHeaderSize_);
+    }
+
+    //=============================================================================================================================
+    static void* AttachAllocationHeader(void* block, uint32 offset, uint64 size, uint32 tag, uint32 flags, const char* name,
+                                        const char* file, int line)
+    {
+        if(block == nullptr) {
+            return nullptr;
+        }
+
+        void* address = (uint8*)block + offset;
+
+        AllocationHeader* header = GetAllocationHeader(address);
+        header->size = size;
+        header->offset = offset;
+        header->tag = (uint16)tag;
+        header->flags = (uint16)flags;
+
+        AddToMemoryTag(tag, (int64)size, 1);
 
         #if EnableManualAllocationTracking_
-            tracker.AddAllocation(address, size, name, file, line);
+            tracker.AddAllocation(address, size, tag, name, file, line);
+        #else
+            Unused_(name);
+            Unused_(file);
+            Unused_(line);
         #endif
 
         return address;
     }
 
     //=============================================================================================================================
-    void* SelasMalloc(uint size, const char* name, const char* file, int line)
+    static void* DetachAllocationHeader(void* address)
     {
-        void* address = malloc(size);
+        AllocationHeader* header = GetAllocationHeader(address);
+
+        AddToMemoryTag(header->tag, -(int64)header->size, -1);
 
         #if EnableManualAllocationTracking_
-            tracker.AddAllocation(address, size, name, file, line);
+            tracker.RemoveAllocation(address);
         #endif
 
-        return address;
+        return (uint8*)address - header->offset;
     }
 
     //=============================================================================================================================
-    void* SelasRealloc(void* address, uint size, const char* name, const char* file, int line)
+    static bool ReleaseMappedAllocation(void* address)
     {
-        #if EnableManualAllocationTracking_
-            if(address)
-                tracker.RemoveAllocation(address);
-        #endif
+        AllocationHeader* header = GetAllocationHeader(address);
+        if((header->flags & eAllocationMapped) == 0) {
+            return false;
+        }
 
-        address = realloc(address, size);
+        uint64 blockSize = header->size + header->offset;
+        void* block = DetachAllocationHeader(address);
+        UnmapLargeBlock(block, blockSize);
 
-        #if EnableManualAllocationTracking_
-            tracker.AddAllocation(address, size, name, file, line);
+        return true;
+    }
+
+    //=============================================================================================================================
+    static void* TryMappedAllocation(uint64 size, uint32 offset, const char* name, const char* file, int line)
+    {
+        void* block = MapLargeBlock(size + offset);
+        return AttachAllocationHeader(block, offset, size, threadMemoryTag, eAllocationMapped, name, file, line);
+    }
+
+    //=============================================================================================================================
+    void* SelasAlignedMalloc(uint size, uint alignment, const char* name, const char* file, int line)
+    {
+        // -- The header needs to fit in front of the address so the block is offset by at least a full header.
+        uint32 offset = (uint32)(alignment > AllocationHeaderSize_ ? alignment : AllocationHeaderSize_);
+
+        // -- Mapped blocks are at least page aligned
+        if(alignment <= 4096) {
+            void* address = TryMappedAllocation(size, offset, name, file, line);
+            if(address != nullptr) {
+                return address;
+            }
+        }
+
+        #if IsWindows_
+            void* block = _aligned_malloc(size + offset, offset);
+        #elif IsOsx_ || IsLinux_
+            void* block = nullptr;
+            if(posix_memalign(&block, offset, size + offset) != 0) {
+                return nullptr;
+            }
         #endif
 
-        return address;
+        return AttachAllocationHeader(block, offset, size, threadMemoryTag, 0, name, file, line);
+    }
+
+    //=============================================================================================================================
+    void* SelasMalloc(uint size, const char* name, const char* file, int line)
+    {
+        void* address = TryMappedAllocation(size, AllocationHeaderSize_, name, file, line);
+        if(address != nullptr) {
+            return address;
+        }
+
+        void* block = malloc(size + AllocationHeaderSize_);
+        return AttachAllocationHeader(block, AllocationHeaderSize_, size, threadMemoryTag, 0, name, file, line);
+    }
+
+    //=============================================================================================================================
+    void* SelasRealloc(void* address, uint size, const char* name, const char* file, int line)
+    {
+        if(address == nullptr) {
+            return SelasMalloc(size, name, file, line);
+        }
+
+        AllocationHeader* header = GetAllocationHeader(address);
+        Assert_(header->offset == AllocationHeaderSize_);
+
+        if((header->flags & eAllocationMapped) || UseMappedBlock(size + AllocationHeaderSize_)) {
+            // -- Moving between the heap and mapped memory so this can't be done in place.
+            MemoryTag previousTag = SetThreadMemoryTag((MemoryTag)header->tag);
+            void* resized = SelasMalloc(size, name, file, line);
+            SetThreadMemoryTag(previousTag);
+
+            if(resized != nullptr) {
+                Memory::Copy(resized, address, header->size < size ? header->size : size);
+                SelasFree(address);
+            }
+            return resized;
+        }
+
+        // -- The block is untracked before realloc runs since another thread may be handed the old address once it succeeds.
+        uint32 tag = header->tag;
+        uint64 previousSize = header->size;
+        void* block = DetachAllocationHeader(address);
+
+        void* resizedBlock = realloc(block, size + AllocationHeaderSize_);
+        if(resizedBlock == nullptr) {
+            // -- realloc leaves the original block alive when it fails so it has to be tracked again.
+            AttachAllocationHeader(block, AllocationHeaderSize_, previousSize, tag, 0, name, file, line);
+            return nullptr;
+        }
+
+        return AttachAllocationHeader(resizedBlock, AllocationHeaderSize_, size, tag, 0, name, file, line);
     }
 
     //=============================================================================================================================
     void SelasAlignedFree(void* address)
     {
-        #if EnableManualAllocationTracking_
-        if(address)
-            tracker.RemoveAllocation(address);
-        #endif
+        if(address == nullptr || ReleaseMappedAllocation(address)) {
+            return;
+        }
+
+        void* block = DetachAllocationHeader(address);
 
         #if IsWindows_
-            _aligned_free(address);
-        #elif IsOsx_
+            _aligned_free(block);
+        #elif IsOsx_ || IsLinux_
             // -- posix_memalign just pairs with free.
-            free(address);
+            free(block);
         #endif
     }
 
     //=============================================================================================================================
     void SelasFree(void* address)
     {
-        #if EnableManualAllocationTracking_
-        if(address)
-            tracker.RemoveAllocation(address);
-        #endif
+        if(address == nullptr || ReleaseMappedAllocation(address)) {
+            return;
+        }
 
-        free(address);
+        void* block = DetachAllocationHeader(address);
+        free(block);
     }
 }
 
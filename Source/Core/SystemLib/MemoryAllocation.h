@@ -28,6 +28,62 @@ namespace Selas
     #define FreeAligned_(Var_)                             Selas::SelasAlignedFree(Var_)
     #define SafeFreeAligned_(Var_)                         if(Var_) { Selas::SelasAlignedFree(Var_); Var_ = nullptr; }
 
+    // -- Every allocation is attributed to the calling thread's current memory tag. Live totals and high water marks are kept
+    // -- per tag in all builds so budgets can be reported from release renders.
+    enum MemoryTag
+    {
+        eMemoryTagGeneral,
+        eMemoryTagGeometry,
+        eMemoryTagTextures,
+        eMemoryTagBatches,
+        eMemoryTagBvh,
+        eMemoryTagBuild,
+
+        eMemoryTagCount
+    };
+
+    struct MemoryTagStats
+    {
+        int64 liveBytes;
+        int64 highWaterBytes;
+        int64 allocationCount;
+    };
+
+    class ScopedMemoryTag
+    {
+    private:
+        MemoryTag previous;
+
+    public:
+        ScopedMemoryTag(MemoryTag tag);
+        ~ScopedMemoryTag();
+    };
+
+    #define MemoryTagScope_(Tag_)                          Selas::ScopedMemoryTag __memoryTagScope(Tag_)
+
+    MemoryTag SetThreadMemoryTag(MemoryTag tag);
+    cpointer  MemoryTagName(MemoryTag tag);
+    void      GetMemoryTagStats(MemoryTag tag, MemoryTagStats& stats);
+    void      LogMemoryTagStats();
+
+    // -- For memory allocated by middleware (e.g. Embree's BVH) that does not go through the functions below. Negative byte
+    // -- counts record a release.
+    void      TrackExternalAllocation(MemoryTag tag, int64 bytes);
+
+    // -- Large allocations are random access heavy (geometry, BVH, textures) so they can be mapped directly from the OS and
+    // -- backed by huge pages to reduce TLB misses. This is opt in; by default everything comes from the heap.
+    enum HugePagePolicy
+    {
+        eHugePagesDisabled,
+        // -- Advise the OS to back large allocations with transparent huge pages.
+        eHugePagesTransparent,
+        // -- Request explicitly reserved huge pages and fall back to transparent huge pages when none are available.
+        eHugePagesExplicit
+    };
+
+    void           SetHugePagePolicy(HugePagePolicy policy);
+    HugePagePolicy GetHugePagePolicy();
+
     extern void* SelasAlignedMalloc(uint size, uint alignment, const char* name, const char* file, int line);
     extern void* SelasMalloc(uint size, const char* name, const char* file, int line);
     extern void* SelasRealloc(void* address, uint size, const char* name, const char* file, int line);
@@ -0,0 +1,388 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/MemoryGovernor.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/JsAssert.h"
+
+#if IsWindows_
+#include <windows.h>
+#elif IsOsx_
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
+
+// -- Held back for allocations no consumer owns (scene data, BVH, framebuffers...)
+#define UntrackedReserveFraction_   0.2f
+#define UpdateIntervalMs_           250
+// -- Budget moves in steps of this fraction of the pool so one noisy interval can't swing it far.
+#define RebalanceStepDivisor_       32
+#define FullUsageFraction_          0.9f
+#define IdleUsageFraction_          0.5f
+#define MinimumMissRate_            0.001f
+
+namespace Selas
+{
+    struct MemoryConsumer
+    {
+        bool   registered;
+        uint64 initialBudget;
+        uint64 budget;
+        uint64 minimumBytes;
+        uint64 maximumBytes;
+
+        MemoryConsumerQuery  query;
+        MemoryConsumerResize resize;
+        MemoryConsumerTrim   trim;
+        void*                userData;
+
+        MemoryConsumerStats previous;
+        MemoryConsumerStats current;
+        float               missRate;
+    };
+
+    struct MemoryGovernorData
+    {
+        void*  spinlock;
+        uint64 poolSize;
+
+        std::chrono::high_resolution_clock::time_point startTime;
+        volatile int64 nextUpdateMs;
+
+        MemoryConsumer consumers[eMemoryTagCount];
+    };
+
+    static MemoryGovernorData governor;
+
+    //=============================================================================================================================
+    static float ToMb(uint64 bytes)
+    {
+        return bytes / (1024.0f * 1024.0f);
+    }
+
+    //=============================================================================================================================
+    static uint64 AssignedBudget()
+    {
+        uint64 assigned = 0;
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            if(governor.consumers[scan].registered) {
+                assigned += governor.consumers[scan].budget;
+            }
+        }
+
+        return assigned;
+    }
+
+    //=============================================================================================================================
+    static void SetConsumerBudget(MemoryTag tag, uint64 budget)
+    {
+        MemoryConsumer& consumer = governor.consumers[tag];
+        consumer.budget = budget;
+        if(consumer.resize) {
+            consumer.resize(consumer.userData, budget);
+        }
+    }
+
+    //=============================================================================================================================
+    static void SampleConsumers()
+    {
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            MemoryConsumer& consumer = governor.consumers[scan];
+            if(consumer.registered == false || consumer.query == nullptr) {
+                continue;
+            }
+
+            consumer.previous = consumer.current;
+            consumer.query(consumer.userData, consumer.current);
+
+            uint64 hits = consumer.current.hitCount - consumer.previous.hitCount;
+            uint64 misses = consumer.current.missCount - consumer.previous.missCount;
+            consumer.missRate = (hits + misses) > 0 ? (float)misses / (float)(hits + misses) : 0.0f;
+        }
+    }
+
+    //=============================================================================================================================
+    static void TrimConsumers()
+    {
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            MemoryConsumer& consumer = governor.consumers[scan];
+            if(consumer.registered && consumer.trim) {
+                consumer.trim(consumer.userData);
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void ReturnIdleBudget(uint64 step)
+    {
+        // -- Anything a consumer borrowed and isn't using goes back to the pool.
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            MemoryConsumer& consumer = governor.consumers[scan];
+            if(consumer.registered == false || consumer.query == nullptr) {
+                continue;
+            }
+
+            if(consumer.budget > consumer.initialBudget && consumer.current.usedBytes < consumer.budget * IdleUsageFraction_) {
+                uint64 amount = consumer.budget - consumer.initialBudget;
+                amount = amount < step ? amount : step;
+
+                SetConsumerBudget((MemoryTag)scan, consumer.budget - amount);
+                WriteDebugInfo_("MemoryGovernor: %s returned %.2fMB (%.2fMB used of %.2fMB)", MemoryTagName((MemoryTag)scan),
+                                ToMb(amount), ToMb(consumer.current.usedBytes), ToMb(consumer.budget));
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void Rebalance()
+    {
+        uint64 step = governor.poolSize / RebalanceStepDivisor_;
+
+        ReturnIdleBudget(step);
+
+        // -- The consumer that is full and missing the most gets the next step of budget.
+        int32 receiverIndex = -1;
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            MemoryConsumer& consumer = governor.consumers[scan];
+            if(consumer.registered == false || consumer.query == nullptr || consumer.budget >= consumer.maximumBytes) {
+                continue;
+            }
+
+            bool full = consumer.current.usedBytes >= consumer.budget * FullUsageFraction_;
+            if(full && consumer.missRate > MinimumMissRate_) {
+                if(receiverIndex == -1 || consumer.missRate > governor.consumers[receiverIndex].missRate) {
+                    receiverIndex = (int32)scan;
+                }
+            }
+        }
+
+        if(receiverIndex == -1) {
+            return;
+        }
+
+        MemoryConsumer& receiver = governor.consumers[receiverIndex];
+        uint64 amount = receiver.maximumBytes - receiver.budget;
+        amount = amount < step ? amount : step;
+
+        uint64 assigned = AssignedBudget();
+        uint64 available = governor.poolSize > assigned ? governor.poolSize - assigned : 0;
+        if(available >= amount) {
+            SetConsumerBudget((MemoryTag)receiverIndex, receiver.budget + amount);
+            WriteDebugInfo_("MemoryGovernor: %s borrowed %.2fMB from the free pool (miss rate %f)",
+                            MemoryTagName((MemoryTag)receiverIndex), ToMb(amount), receiver.missRate);
+            return;
+        }
+
+        // -- Otherwise take it from the consumer that would miss it least.
+        int32 donorIndex = -1;
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            MemoryConsumer& consumer = governor.consumers[scan];
+            if(consumer.registered == false || consumer.query == nullptr || (int32)scan == receiverIndex) {
+                continue;
+            }
+
+            if(consumer.budget < consumer.minimumBytes + amount || consumer.missRate * 2.0f > receiver.missRate) {
+                continue;
+            }
+
+            if(donorIndex == -1 || consumer.missRate < governor.consumers[donorIndex].missRate) {
+                donorIndex = (int32)scan;
+            }
+        }
+
+        if(donorIndex == -1) {
+            return;
+        }
+
+        MemoryConsumer& donor = governor.consumers[donorIndex];
+
+        // -- Shrink before growing so the two never overlap.
+        SetConsumerBudget((MemoryTag)donorIndex, donor.budget - amount);
+        SetConsumerBudget((MemoryTag)receiverIndex, receiver.budget + amount);
+
+        WriteDebugInfo_("MemoryGovernor: moved %.2fMB from %s (miss rate %f) to %s (miss rate %f)", ToMb(amount),
+                        MemoryTagName((MemoryTag)donorIndex), donor.missRate, MemoryTagName((MemoryTag)receiverIndex),
+                        receiver.missRate);
+    }
+
+    //=============================================================================================================================
+    uint64 PhysicalMemorySize()
+    {
+        #if IsWindows_
+            MEMORYSTATUSEX status;
+            status.dwLength = sizeof(status);
+            if(GlobalMemoryStatusEx(&status)) {
+                return status.ullTotalPhys;
+            }
+            return 0;
+        #elif IsOsx_
+            uint64 size = 0;
+            size_t length = sizeof(size);
+            int names[2] = { CTL_HW, HW_MEMSIZE };
+            if(sysctl(names, 2, &size, &length, nullptr, 0) == 0) {
+                return size;
+            }
+            return 0;
+        #else
+            long pages = sysconf(_SC_PHYS_PAGES);
+            long pageSize = sysconf(_SC_PAGE_SIZE);
+            if(pages <= 0 || pageSize <= 0) {
+                return 0;
+            }
+            return (uint64)pages * (uint64)pageSize;
+        #endif
+    }
+
+    //=============================================================================================================================
+    void MemoryGovernor_Initialize(uint64 totalBytes)
+    {
+        if(totalBytes == 0) {
+            totalBytes = PhysicalMemorySize();
+            AssertMsg_(totalBytes != 0, "Failed to query physical memory size");
+        }
+
+        governor.spinlock = CreateSpinLock();
+        governor.poolSize = (uint64)(totalBytes * (1.0f - UntrackedReserveFraction_));
+        governor.startTime = SystemTime::Now();
+        governor.nextUpdateMs = UpdateIntervalMs_;
+
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            governor.consumers[scan] = MemoryConsumer();
+        }
+
+        WriteDebugInfo_("MemoryGovernor: %.2fMB total - %.2fMB pool", ToMb(totalBytes), ToMb(governor.poolSize));
+    }
+
+    //=============================================================================================================================
+    void MemoryGovernor_Shutdown()
+    {
+        if(governor.spinlock) {
+            CloseSpinlock(governor.spinlock);
+            governor.spinlock = nullptr;
+        }
+    }
+
+    //=============================================================================================================================
+    void MemoryGovernor_RegisterConsumer(MemoryTag tag, float share, uint64 minimumBytes, uint64 maximumBytes,
+                                         MemoryConsumerQuery query, MemoryConsumerResize resize, MemoryConsumerTrim trim,
+                                         void* userData)
+    {
+        Assert_(tag < eMemoryTagCount);
+        Assert_(governor.spinlock != nullptr);
+
+        EnterSpinLock(governor.spinlock);
+
+        MemoryConsumer& consumer = governor.consumers[tag];
+        Assert_(consumer.registered == false);
+
+        uint64 assigned = AssignedBudget();
+        uint64 unassigned = governor.poolSize > assigned ? governor.poolSize - assigned : 0;
+        if(minimumBytes > unassigned) {
+            WriteDebugInfo_("MemoryGovernor: %s minimum of %.2fMB clamped to the %.2fMB left in the pool",
+                            MemoryTagName(tag), ToMb(minimumBytes), ToMb(unassigned));
+            minimumBytes = unassigned;
+        }
+
+        uint64 budget = (uint64)(governor.poolSize * share);
+        budget = budget < minimumBytes ? minimumBytes : budget;
+        budget = budget > maximumBytes ? maximumBytes : budget;
+        budget = budget > unassigned ? unassigned : budget;
+
+        consumer.registered    = true;
+        consumer.initialBudget = budget;
+        consumer.budget        = budget;
+        consumer.minimumBytes  = minimumBytes;
+        consumer.maximumBytes  = maximumBytes;
+        consumer.query         = query;
+        consumer.resize        = resize;
+        consumer.trim          = trim;
+        consumer.userData      = userData;
+        consumer.missRate      = 0.0f;
+        consumer.previous      = MemoryConsumerStats();
+        consumer.current       = MemoryConsumerStats();
+
+        AssertMsg_(AssignedBudget() <= governor.poolSize, "Memory consumers were given more than the whole pool");
+
+        LeaveSpinLock(governor.spinlock);
+    }
+
+    //=============================================================================================================================
+    void MemoryGovernor_UnregisterConsumer(MemoryTag tag)
+    {
+        Assert_(tag < eMemoryTagCount);
+
+        EnterSpinLock(governor.spinlock);
+        governor.consumers[tag] = MemoryConsumer();
+        LeaveSpinLock(governor.spinlock);
+    }
+
+    //=============================================================================================================================
+    uint64 MemoryGovernor_PoolSize()
+    {
+        return governor.poolSize;
+    }
+
+    //=============================================================================================================================
+    uint64 MemoryGovernor_Budget(MemoryTag tag)
+    {
+        Assert_(tag < eMemoryTagCount);
+        return governor.consumers[tag].budget;
+    }
+
+    //=============================================================================================================================
+    void MemoryGovernor_Update()
+    {
+        if(governor.spinlock == nullptr) {
+            return;
+        }
+
+        int64 nowMs = (int64)SystemTime::ElapsedMillisecondsF(governor.startTime);
+        int64 nextUpdateMs = Atomic::LoadAcquire64(&governor.nextUpdateMs);
+        if(nowMs < nextUpdateMs) {
+            return;
+        }
+
+        // -- Whichever thread wins the exchange does the update; everyone else goes back to work.
+        if(Atomic::CompareExchange64(&governor.nextUpdateMs, nowMs + UpdateIntervalMs_, nextUpdateMs) == false) {
+            return;
+        }
+
+        if(TryEnterSpinLock(governor.spinlock) == false) {
+            return;
+        }
+
+        SampleConsumers();
+        Rebalance();
+        TrimConsumers();
+
+        LeaveSpinLock(governor.spinlock);
+    }
+
+    //=============================================================================================================================
+    void MemoryGovernor_LogBudgets()
+    {
+        EnterSpinLock(governor.spinlock);
+
+        for(uint scan = 0; scan < eMemoryTagCount; ++scan) {
+            const MemoryConsumer& consumer = governor.consumers[scan];
+            if(consumer.registered == false) {
+                continue;
+            }
+
+            WriteDebugInfo_("MemoryGovernor (%s): %.2fMB budget (%.2fMB initial) - %.2fMB used - miss rate %f",
+                            MemoryTagName((MemoryTag)scan), ToMb(consumer.budget), ToMb(consumer.initialBudget),
+                            ToMb(consumer.current.usedBytes), consumer.missRate);
+        }
+
+        uint64 assigned = AssignedBudget();
+        WriteDebugInfo_("MemoryGovernor: %.2fMB of %.2fMB assigned", ToMb(assigned), ToMb(governor.poolSize));
+
+        LeaveSpinLock(governor.spinlock);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Splits a single memory pool between the caches so they can't be sized independently into an out of memory. Each
+    // -- consumer is keyed by its memory tag and starts with a share of the pool. Consumers that report stats take part in
+    // -- rebalancing: a consumer that is full and missing borrows from free budget or from the consumer with the lowest miss
+    // -- rate, and budget it stops using is returned to the pool. Consumers without stats keep a fixed reservation.
+
+    struct MemoryConsumerStats
+    {
+        uint64 usedBytes;
+        // -- Running totals. They only need to be roughly right since they just feed the heuristics.
+        uint64 hitCount;
+        uint64 missCount;
+    };
+
+    typedef void (*MemoryConsumerQuery)(void* userData, MemoryConsumerStats& stats);
+    // -- Called when the consumer's budget changes. Consumers should shrink to the new budget on their own schedule.
+    typedef void (*MemoryConsumerResize)(void* userData, uint64 budget);
+    // -- Called on every update after rebalancing so a consumer over its budget can release a little more of it. Queries are
+    // -- expected to be free of side effects so this is where any eviction belongs.
+    typedef void (*MemoryConsumerTrim)(void* userData);
+
+    // -- totalBytes of 0 uses the machine's physical memory. A fraction of it is held back for untracked allocations.
+    void   MemoryGovernor_Initialize(uint64 totalBytes);
+    void   MemoryGovernor_Shutdown();
+
+    // -- The consumer isn't queried until the next update so it can be registered before it is initialized with its budget.
+    // -- The minimum is clamped to whatever the pool has left so a small pool gives later consumers less rather than asserting.
+    void   MemoryGovernor_RegisterConsumer(MemoryTag tag, float share, uint64 minimumBytes, uint64 maximumBytes,
+                                           MemoryConsumerQuery query, MemoryConsumerResize resize, MemoryConsumerTrim trim,
+                                           void* userData);
+    void   MemoryGovernor_UnregisterConsumer(MemoryTag tag);
+
+    uint64 MemoryGovernor_PoolSize();
+    uint64 MemoryGovernor_Budget(MemoryTag tag);
+
+    // -- Cheap enough to call from render loops. It is rate limited and only one thread does the work.
+    void   MemoryGovernor_Update();
+    void   MemoryGovernor_LogBudgets();
+
+    uint64 PhysicalMemorySize();
+}
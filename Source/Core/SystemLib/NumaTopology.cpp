@@ -0,0 +1,274 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/NumaTopology.h"
+#include "SystemLib/JsAssert.h"
+
+#if IsWindows_
+#include <windows.h>
+#elif IsLinux_
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// -- From numaif.h, which is only installed with libnuma
+#define MemoryPolicyInterleave_ 3
+#endif
+
+namespace Selas
+{
+    #if IsWindows_
+        // -- Only the first processor group is considered, which matches the 64 core limit of CreateThread's affinity.
+        struct NumaTopology
+        {
+            uint32 nodeCount;
+            ULONGLONG processMask;
+            ULONGLONG nodeMasks[MaxNumaNodes_];
+        };
+
+        //=========================================================================================================================
+        static void QueryNumaTopology(NumaTopology& topology)
+        {
+            topology.nodeCount = 0;
+
+            DWORD_PTR processMask = 0;
+            DWORD_PTR systemMask = 0;
+            if(GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) == 0 || processMask == 0) {
+                processMask = ~(DWORD_PTR)0;
+            }
+            topology.processMask = processMask;
+
+            ULONG highestNode = 0;
+            if(GetNumaHighestNodeNumber(&highestNode)) {
+                for(ULONG node = 0; node <= highestNode && topology.nodeCount < MaxNumaNodes_; ++node) {
+                    ULONGLONG mask = 0;
+                    if(GetNumaNodeProcessorMask((UCHAR)node, &mask) && (mask & topology.processMask) != 0) {
+                        topology.nodeMasks[topology.nodeCount++] = mask & topology.processMask;
+                    }
+                }
+            }
+
+            if(topology.nodeCount == 0) {
+                topology.nodeMasks[0] = topology.processMask;
+                topology.nodeCount = 1;
+            }
+        }
+    #elif IsLinux_
+        struct NumaTopology
+        {
+            uint32 nodeCount;
+            uint32 osNodes[MaxNumaNodes_];
+            cpu_set_t processCores;
+            cpu_set_t nodeCores[MaxNumaNodes_];
+        };
+
+        //=========================================================================================================================
+        static bool ReadNodeCoreList(uint32 osNode, cpu_set_t& cores)
+        {
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", osNode);
+
+            FILE* file = fopen(path, "r");
+            if(file == nullptr) {
+                return false;
+            }
+
+            char line[4096];
+            bool read = fgets(line, sizeof(line), file) != nullptr;
+            fclose(file);
+            if(read == false) {
+                return false;
+            }
+
+            // -- Formatted as comma separated ranges, e.g. "0-13,28-41"
+            CPU_ZERO(&cores);
+            char* cursor = line;
+            while(*cursor >= '0' && *cursor <= '9') {
+                long first = strtol(cursor, &cursor, 10);
+                long last = first;
+                if(*cursor == '-') {
+                    last = strtol(cursor + 1, &cursor, 10);
+                }
+                for(long core = first; core <= last && core < CPU_SETSIZE; ++core) {
+                    CPU_SET(core, &cores);
+                }
+                if(*cursor == ',') {
+                    ++cursor;
+                }
+            }
+
+            return CPU_COUNT(&cores) > 0;
+        }
+
+        //=========================================================================================================================
+        static void QueryNumaTopology(NumaTopology& topology)
+        {
+            topology.nodeCount = 0;
+
+            if(sched_getaffinity(0, sizeof(cpu_set_t), &topology.processCores) != 0) {
+                CPU_ZERO(&topology.processCores);
+                for(int core = 0; core < CPU_SETSIZE; ++core) {
+                    CPU_SET(core, &topology.processCores);
+                }
+            }
+
+            // -- OS node ids can have gaps (offline or memory-only nodes) so only nodes with cores are kept.
+            for(uint32 osNode = 0; osNode < 1024 && topology.nodeCount < MaxNumaNodes_; ++osNode) {
+                cpu_set_t& cores = topology.nodeCores[topology.nodeCount];
+                if(ReadNodeCoreList(osNode, cores)) {
+                    CPU_AND(&cores, &cores, &topology.processCores);
+                    if(CPU_COUNT(&cores) > 0) {
+                        topology.osNodes[topology.nodeCount] = osNode;
+                        ++topology.nodeCount;
+                    }
+                }
+            }
+
+            if(topology.nodeCount == 0) {
+                topology.nodeCores[0] = topology.processCores;
+                topology.osNodes[0] = 0;
+                topology.nodeCount = 1;
+            }
+        }
+    #else
+        // -- OSX doesn't expose NUMA placement.
+        struct NumaTopology
+        {
+            uint32 nodeCount;
+        };
+
+        //=========================================================================================================================
+        static void QueryNumaTopology(NumaTopology& topology)
+        {
+            topology.nodeCount = 1;
+        }
+    #endif
+
+    //=============================================================================================================================
+    static const NumaTopology& Topology()
+    {
+        struct TopologyInitializer
+        {
+            TopologyInitializer() { QueryNumaTopology(topology); }
+            NumaTopology topology;
+        };
+
+        static TopologyInitializer initializer;
+        return initializer.topology;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeCount()
+    {
+        return Topology().nodeCount;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeOfCore(uint32 coreIndex)
+    {
+        const NumaTopology& topology = Topology();
+
+        for(uint32 node = 0; node < topology.nodeCount; ++node) {
+            #if IsWindows_
+                if(coreIndex < 64 && (topology.nodeMasks[node] & ((ULONGLONG)1 << coreIndex))) {
+                    return node;
+                }
+            #elif IsLinux_
+                if(coreIndex < CPU_SETSIZE && CPU_ISSET(coreIndex, &topology.nodeCores[node])) {
+                    return node;
+                }
+            #else
+                Unused_(coreIndex);
+            #endif
+        }
+
+        return 0;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeCoreCount(uint32 node)
+    {
+        const NumaTopology& topology = Topology();
+        Assert_(node < topology.nodeCount);
+
+        #if IsWindows_
+            uint32 count = 0;
+            for(ULONGLONG mask = topology.nodeMasks[node]; mask != 0; mask &= mask - 1) {
+                ++count;
+            }
+            return count;
+        #elif IsLinux_
+            return (uint32)CPU_COUNT(&topology.nodeCores[node]);
+        #else
+            Unused_(node);
+            return 0;
+        #endif
+    }
+
+    //=============================================================================================================================
+    uint32 CurrentNumaNode()
+    {
+        #if IsWindows_
+            return NumaNodeOfCore((uint32)GetCurrentProcessorNumber());
+        #elif IsLinux_
+            int core = sched_getcpu();
+            return core < 0 ? 0 : NumaNodeOfCore((uint32)core);
+        #else
+            return 0;
+        #endif
+    }
+
+    //=============================================================================================================================
+    bool BindCurrentThreadToNumaNode(uint32 node)
+    {
+        const NumaTopology& topology = Topology();
+        if(node >= topology.nodeCount) {
+            return false;
+        }
+
+        #if IsWindows_
+            return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)topology.nodeMasks[node]) != 0;
+        #elif IsLinux_
+            return sched_setaffinity(0, sizeof(cpu_set_t), &topology.nodeCores[node]) == 0;
+        #else
+            return true;
+        #endif
+    }
+
+    //=============================================================================================================================
+    bool UnbindCurrentThreadFromNumaNode()
+    {
+        const NumaTopology& topology = Topology();
+
+        #if IsWindows_
+            return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)topology.processMask) != 0;
+        #elif IsLinux_
+            return sched_setaffinity(0, sizeof(cpu_set_t), &topology.processCores) == 0;
+        #else
+            Unused_(topology);
+            return true;
+        #endif
+    }
+
+    //=============================================================================================================================
+    bool InterleaveMemoryAcrossNumaNodes()
+    {
+        #if IsLinux_
+            const NumaTopology& topology = Topology();
+
+            unsigned long nodeMask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+            for(uint32 node = 0; node < topology.nodeCount; ++node) {
+                uint32 osNode = topology.osNodes[node];
+                nodeMask[osNode / (8 * sizeof(unsigned long))] |= 1UL << (osNode % (8 * sizeof(unsigned long)));
+            }
+
+            return syscall(SYS_set_mempolicy, MemoryPolicyInterleave_, nodeMask, 1024) == 0;
+        #else
+            // -- Windows only offers a preferred node per allocation and OSX doesn't expose NUMA placement.
+            return false;
+        #endif
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+#define MaxNumaNodes_ 16
+
+namespace Selas
+{
+    // -- Nodes are numbered densely from 0. Machines without NUMA, and platforms that don't expose it, report a single node
+    // -- that holds every core. Only cores the process was allowed to run on when the topology was first queried are counted
+    // -- and nodes left without any are skipped.
+    uint32 NumaNodeCount();
+    uint32 NumaNodeOfCore(uint32 coreIndex);
+    uint32 NumaNodeCoreCount(uint32 node);
+    uint32 CurrentNumaNode();
+
+    // -- Restricts the calling thread to the node's cores. Memory the thread first touches afterwards is placed on that node
+    // -- under the default OS policy.
+    bool   BindCurrentThreadToNumaNode(uint32 node);
+    // -- Lets the calling thread run on any of the process's cores again.
+    bool   UnbindCurrentThreadFromNumaNode();
+
+    // -- Spreads pages the calling thread allocates from now on round robin across every node. Threads it creates afterwards
+    // -- inherit the policy so it should be called before any workers are started. Returns false where it isn't supported.
+    bool   InterleaveMemoryAcrossNumaNodes();
+}
@@ -26,6 +26,7 @@ namespace Selas
     bool     WaitForSemaphore(void* semaphore, uint32 milliseconds);
 
     // Spinlocks
+    // -- On Linux these spin briefly and then park the thread on a futex so oversubscribed workers stop burning cores.
     void*    CreateSpinLock(void);
     void     CreateSpinLock(uint8 spin[CacheLineSize_]);
     void     CloseSpinlock(void* spinlock);
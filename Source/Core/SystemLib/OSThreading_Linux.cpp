@@ -0,0 +1,199 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#if IsLinux_
+
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/Memory.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <xmmintrin.h>
+
+// -- Spin this many times before parking on the futex. Most batcher and cache locks are held for a handful of instructions so
+// -- the owner usually releases before the spin runs out.
+#define SpinCountBeforePark_    1024
+#define InfiniteWait_           0xFFFFFFFF
+
+namespace Selas
+{
+    // -- Lock states
+    enum
+    {
+        eLockFree      = 0,
+        eLockHeld      = 1,
+        eLockContended = 2
+    };
+
+    struct FutexSemaphore
+    {
+        volatile int32 count;
+        volatile int32 waiters;
+    };
+
+    //=============================================================================================================================
+    // Futex
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static int32 FutexWait(volatile int32* address, int32 expected, const timespec* timeout)
+    {
+        return (int32)syscall(SYS_futex, (int32*)address, FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+    }
+
+    //=============================================================================================================================
+    static void FutexWake(volatile int32* address, int32 count)
+    {
+        syscall(SYS_futex, (int32*)address, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    //=============================================================================================================================
+    static uint64 MonotonicNanoseconds()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64)now.tv_sec * 1000000000ull + (uint64)now.tv_nsec;
+    }
+
+    //=============================================================================================================================
+    // Semaphore
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    void* CreateOSSemaphore(uint32 initialCount, uint32 maxCount)
+    {
+        Unused_(maxCount);
+
+        FutexSemaphore* semaphore = AllocArrayAligned_(FutexSemaphore, 1, CacheLineSize_);
+        semaphore->count = (int32)initialCount;
+        semaphore->waiters = 0;
+
+        return semaphore;
+    }
+
+    //=============================================================================================================================
+    void CloseOSSemaphore(void* semaphore)
+    {
+        FreeAligned_(semaphore);
+    }
+
+    //=============================================================================================================================
+    void PostSemaphore(void* semaphore, uint32 count)
+    {
+        FutexSemaphore* futexSemaphore = (FutexSemaphore*)semaphore;
+
+        Atomic::Add32(&futexSemaphore->count, (int32)count);
+        if(futexSemaphore->waiters > 0) {
+            FutexWake(&futexSemaphore->count, (int32)count);
+        }
+    }
+
+    //=============================================================================================================================
+    bool WaitForSemaphore(void* semaphore, uint32 milliseconds)
+    {
+        FutexSemaphore* futexSemaphore = (FutexSemaphore*)semaphore;
+
+        uint64 deadline = MonotonicNanoseconds() + (uint64)milliseconds * 1000000ull;
+
+        while(true) {
+            int32 count = futexSemaphore->count;
+            if(count > 0) {
+                if(Atomic::CompareExchange32(&futexSemaphore->count, count - 1, count)) {
+                    return true;
+                }
+                continue;
+            }
+
+            timespec timeout;
+            timespec* timeoutPtr = nullptr;
+            if(milliseconds != InfiniteWait_) {
+                uint64 now = MonotonicNanoseconds();
+                if(now >= deadline) {
+                    return false;
+                }
+
+                uint64 remaining = deadline - now;
+                timeout.tv_sec = (time_t)(remaining / 1000000000ull);
+                timeout.tv_nsec = (long)(remaining % 1000000000ull);
+                timeoutPtr = &timeout;
+            }
+
+            // -- A post between the count check and the wait changes the count so the futex returns immediately.
+            Atomic::Increment32(&futexSemaphore->waiters);
+            FutexWait(&futexSemaphore->count, 0, timeoutPtr);
+            Atomic::Decrement32(&futexSemaphore->waiters);
+        }
+    }
+
+    //=============================================================================================================================
+    // Spinlocks
+    //=============================================================================================================================
+    void* CreateSpinLock(void)
+    {
+        uint8* spinlock = AllocArrayAligned_(uint8, CacheLineSize_, CacheLineSize_);
+        Memory::Zero(spinlock, CacheLineSize_);
+
+        return (void*)spinlock;
+    }
+
+    //=============================================================================================================================
+    void CreateSpinLock(uint8 spin[CacheLineSize_])
+    {
+        Memory::Zero(spin, CacheLineSize_);
+    }
+
+    //=============================================================================================================================
+    void CloseSpinlock(void* spinlock)
+    {
+        FreeAligned_(spinlock);
+    }
+
+    //=============================================================================================================================
+    bool TryEnterSpinLock(void* spinlock)
+    {
+        volatile int32* state = (volatile int32*)spinlock;
+        return Atomic::CompareExchange32(state, eLockHeld, eLockFree);
+    }
+
+    //=============================================================================================================================
+    void EnterSpinLock(void* spinlock)
+    {
+        volatile int32* state = (volatile int32*)spinlock;
+
+        for(uint scan = 0; scan < SpinCountBeforePark_; ++scan) {
+            if(*state == eLockFree && Atomic::CompareExchange32(state, eLockHeld, eLockFree)) {
+                return;
+            }
+            _mm_pause();
+        }
+
+        // -- Taking the lock in the contended state means the matching leave may do an unnecessary wake. That is much cheaper
+        // -- than losing track of a parked thread.
+        while(__atomic_exchange_n(state, (int32)eLockContended, __ATOMIC_ACQUIRE) != eLockFree) {
+            FutexWait(state, eLockContended, nullptr);
+        }
+    }
+
+    //=============================================================================================================================
+    void LeaveSpinLock(void* spinlock)
+    {
+        volatile int32* state = (volatile int32*)spinlock;
+        if(__atomic_exchange_n(state, (int32)eLockFree, __ATOMIC_RELEASE) == eLockContended) {
+            FutexWake(state, 1);
+        }
+    }
+
+    //=============================================================================================================================
+    void Sleep(uint sleepTimeMs)
+    {
+        usleep((useconds_t)(sleepTimeMs * 1000));
+    }
+}
+
+#endif
@@ -0,0 +1,386 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/PerfCounters.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/Logging.h"
+
+#include <stdio.h>
+
+#if IsLinux_
+    #include <linux/perf_event.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <x86intrin.h>
+#endif
+
+namespace Selas
+{
+    static volatile int64 perfCountersEnabled = 0;
+    static bool perfCounterAvailable[ePerfCounterCount];
+
+    static cpointer perfPhaseNames[ePerfPhaseCount] = {
+        "Other",
+        "Traversal",
+        "Shading",
+        "Sorting",
+        "Loading"
+    };
+
+    #if IsLinux_
+        struct PerfCounterFile
+        {
+            int32 fd;
+            perf_event_mmap_page* page;
+        };
+
+        struct PerfThreadState
+        {
+            bool opened;
+            bool available;
+            PerfPhase phase;
+            int32 leaderFd;
+            PerfCounterFile counters[ePerfCounterCount];
+            uint64 last[ePerfCounterCount];
+            uint64 totals[ePerfPhaseCount][ePerfCounterCount];
+
+            ~PerfThreadState();
+        };
+
+        static thread_local PerfThreadState perfThreadState;
+
+        //=========================================================================================================================
+        PerfThreadState::~PerfThreadState()
+        {
+            if(opened == false) {
+                return;
+            }
+
+            for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                if(counters[scan].page != nullptr) {
+                    munmap(counters[scan].page, (size_t)sysconf(_SC_PAGESIZE));
+                }
+                if(counters[scan].fd >= 0) {
+                    close(counters[scan].fd);
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static void CounterAttributes(PerfCounter counter, perf_event_attr& attributes)
+        {
+            Memory::Zero(&attributes, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            // -- User space only so the default perf_event_paranoid setting of 2 is enough
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            if(counter == ePerfCounterCycles) {
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+            }
+            else if(counter == ePerfCounterInstructions) {
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+            }
+            else if(counter == ePerfCounterLlcMisses) {
+                attributes.type = PERF_TYPE_HW_CACHE;
+                attributes.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            }
+            else {
+                attributes.type = PERF_TYPE_HW_CACHE;
+                attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            }
+        }
+
+        //=========================================================================================================================
+        static bool ReadCounterRdpmc(const PerfCounterFile& counter, uint64& value)
+        {
+            // -- The seqlock protocol from perf_event.h. index is 0 while the counter isn't on the PMU, e.g. when it has been
+            // -- multiplexed out, in which case the caller falls back to asking the kernel.
+            perf_event_mmap_page* page = counter.page;
+            if(page == nullptr || page->cap_user_rdpmc == 0) {
+                return false;
+            }
+
+            while(true) {
+                uint32 sequence = page->lock;
+                __asm__ volatile("" ::: "memory");
+
+                uint32 index = page->index;
+                int64 offset = page->offset;
+                uint32 width = page->pmc_width;
+                if(index == 0) {
+                    return false;
+                }
+
+                int64 pmc = (int64)(__rdpmc((int32)index - 1) << (64 - width)) >> (64 - width);
+
+                __asm__ volatile("" ::: "memory");
+                if(page->lock == sequence) {
+                    value = (uint64)(offset + pmc);
+                    return true;
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static bool ReadCounters(const PerfThreadState& state, uint64 values[ePerfCounterCount])
+        {
+            bool rdpmcFailed = false;
+            for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                values[scan] = 0;
+                if(state.counters[scan].fd >= 0 && ReadCounterRdpmc(state.counters[scan], values[scan]) == false) {
+                    rdpmcFailed = true;
+                    break;
+                }
+            }
+
+            if(rdpmcFailed == false) {
+                return true;
+            }
+
+            // -- A single read of the group leader returns every open counter in the order they were opened.
+            uint64 group[1 + ePerfCounterCount];
+            ssize_t size = read(state.leaderFd, group, sizeof(group));
+            if(size < (ssize_t)sizeof(uint64)) {
+                return false;
+            }
+
+            uint64 next = 0;
+            for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                values[scan] = 0;
+                if(state.counters[scan].fd >= 0 && next < group[0]) {
+                    values[scan] = group[1 + next];
+                    ++next;
+                }
+            }
+
+            return true;
+        }
+
+        //=========================================================================================================================
+        static void OpenThreadCounters(PerfThreadState& state)
+        {
+            state.opened = true;
+            state.available = false;
+            state.phase = ePerfPhaseOther;
+            Memory::Zero(state.totals, sizeof(state.totals));
+
+            // -- The counters share a group so they are scheduled onto the PMU together and can be read with one call. The first
+            // -- one that opens leads.
+            int32 leader = -1;
+            size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+            for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                PerfCounterFile& counter = state.counters[scan];
+                counter.page = nullptr;
+
+                perf_event_attr attributes;
+                CounterAttributes((PerfCounter)scan, attributes);
+                attributes.read_format = PERF_FORMAT_GROUP;
+                counter.fd = (int32)syscall(__NR_perf_event_open, &attributes, 0, -1, leader, 0);
+                if(counter.fd < 0) {
+                    continue;
+                }
+
+                if(leader < 0) {
+                    leader = counter.fd;
+                }
+                state.available = true;
+
+                void* page = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, counter.fd, 0);
+                if(page != MAP_FAILED) {
+                    counter.page = (perf_event_mmap_page*)page;
+                }
+            }
+
+            state.leaderFd = leader;
+
+            // -- Counters that can't be read can't be diffed either
+            if(state.available && ReadCounters(state, state.last) == false) {
+                state.available = false;
+            }
+        }
+
+        //=========================================================================================================================
+        static void SwitchPhase(PerfPhase phase)
+        {
+            PerfThreadState& state = perfThreadState;
+            if(state.opened == false) {
+                OpenThreadCounters(state);
+            }
+            if(state.available == false) {
+                return;
+            }
+
+            // -- A failed read leaves last as it was so the counts are given to whichever phase is current at the next read
+            uint64 values[ePerfCounterCount];
+            if(ReadCounters(state, values)) {
+                for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                    state.totals[state.phase][scan] += values[scan] - state.last[scan];
+                    state.last[scan] = values[scan];
+                }
+            }
+            state.phase = phase;
+        }
+
+        //=========================================================================================================================
+        static PerfPhase CurrentPhase()
+        {
+            return perfThreadState.phase;
+        }
+    #else
+        //=========================================================================================================================
+        static void SwitchPhase(PerfPhase phase)
+        {
+            Unused_(phase);
+        }
+
+        //=========================================================================================================================
+        static PerfPhase CurrentPhase()
+        {
+            return ePerfPhaseOther;
+        }
+    #endif
+
+    //=============================================================================================================================
+    ScopedPerfPhase::ScopedPerfPhase(PerfPhase phase)
+        : previous(ePerfPhaseOther)
+        , active(perfCountersEnabled != 0)
+    {
+        if(active) {
+            previous = CurrentPhase();
+            SwitchPhase(phase);
+        }
+    }
+
+    //=============================================================================================================================
+    ScopedPerfPhase::~ScopedPerfPhase()
+    {
+        if(active) {
+            SwitchPhase(previous);
+        }
+    }
+
+    //=============================================================================================================================
+    bool PerfCounters_Enable()
+    {
+        #if IsLinux_
+            // -- Open on the calling thread first to find out which counters this machine has.
+            PerfThreadState& state = perfThreadState;
+            if(state.opened == false) {
+                OpenThreadCounters(state);
+            }
+
+            for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                perfCounterAvailable[scan] = state.counters[scan].fd >= 0;
+            }
+
+            if(state.available) {
+                Atomic::StoreRelease64(&perfCountersEnabled, 1);
+            }
+            return state.available;
+        #else
+            return false;
+        #endif
+    }
+
+    //=============================================================================================================================
+    bool PerfCounters_Enabled()
+    {
+        return perfCountersEnabled != 0;
+    }
+
+    //=============================================================================================================================
+    void PerfCounters_ResetThread()
+    {
+        #if IsLinux_
+            PerfThreadState& state = perfThreadState;
+            if(perfCountersEnabled == 0 || state.opened == false || state.available == false) {
+                return;
+            }
+
+            SwitchPhase(state.phase);
+            Memory::Zero(state.totals, sizeof(state.totals));
+        #endif
+    }
+
+    //=============================================================================================================================
+    void PerfCounters_HarvestThread(PerfPhaseCounters* counters)
+    {
+        #if IsLinux_
+            PerfThreadState& state = perfThreadState;
+            if(perfCountersEnabled == 0 || state.opened == false || state.available == false) {
+                return;
+            }
+
+            // -- Bring the current phase up to date before handing the totals over
+            SwitchPhase(state.phase);
+
+            for(uint phase = 0; phase < ePerfPhaseCount; ++phase) {
+                for(uint scan = 0; scan < ePerfCounterCount; ++scan) {
+                    counters->counts[phase][scan] += state.totals[phase][scan];
+                }
+            }
+            Memory::Zero(state.totals, sizeof(state.totals));
+        #else
+            Unused_(counters);
+        #endif
+    }
+
+    //=============================================================================================================================
+    void PerfCounters_Clear(PerfPhaseCounters* counters)
+    {
+        Memory::Zero(counters, sizeof(PerfPhaseCounters));
+    }
+
+    //=============================================================================================================================
+    static void FormatMisses(char* buffer, uint32 bufferSize, uint64 misses, float kiloInstructions, PerfCounter counter)
+    {
+        if(perfCounterAvailable[counter] == false) {
+            snprintf(buffer, bufferSize, "n/a");
+            return;
+        }
+
+        // -- Per thousand instructions so phases of different lengths can be compared
+        float mpki = kiloInstructions > 0.0f ? misses / kiloInstructions : 0.0f;
+        snprintf(buffer, bufferSize, "%.2fM (%.2f MPKI)", misses / 1e6f, mpki);
+    }
+
+    //=============================================================================================================================
+    void PerfCounters_Log(const PerfPhaseCounters& counters)
+    {
+        if(perfCountersEnabled == 0) {
+            return;
+        }
+
+        for(uint phase = 0; phase < ePerfPhaseCount; ++phase) {
+            const uint64* counts = counters.counts[phase];
+
+            uint64 cycles = counts[ePerfCounterCycles];
+            uint64 instructions = counts[ePerfCounterInstructions];
+            float ipc = cycles > 0 ? (float)instructions / cycles : 0.0f;
+
+            char llcMisses[64];
+            char dtlbMisses[64];
+            FormatMisses(llcMisses, sizeof(llcMisses), counts[ePerfCounterLlcMisses], instructions / 1000.0f,
+                         ePerfCounterLlcMisses);
+            FormatMisses(dtlbMisses, sizeof(dtlbMisses), counts[ePerfCounterDtlbMisses], instructions / 1000.0f,
+                         ePerfCounterDtlbMisses);
+
+            WriteDebugInfo_("Perf (%s): %.1fM cycles - %.1fM instructions - IPC %.2f - LLC misses %s - dTLB misses %s",
+                            perfPhaseNames[phase], cycles / 1e6f, instructions / 1e6f, ipc, llcMisses, dtlbMisses);
+        }
+    }
+
+    //=============================================================================================================================
+    cpointer PerfPhaseName(PerfPhase phase)
+    {
+        return perfPhaseNames[phase];
+    }
+}
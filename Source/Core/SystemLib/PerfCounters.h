@@ -0,0 +1,65 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    enum PerfCounter
+    {
+        ePerfCounterCycles,
+        ePerfCounterInstructions,
+        ePerfCounterLlcMisses,
+        ePerfCounterDtlbMisses,
+
+        ePerfCounterCount
+    };
+
+    // -- Counts are attributed to the innermost phase scope on the calling thread, so a subscene loaded in the middle of
+    // -- traversal is counted as loading and not as traversal. Anything outside of a scope is counted as other.
+    enum PerfPhase
+    {
+        ePerfPhaseOther,
+        ePerfPhaseTraversal,
+        ePerfPhaseShading,
+        ePerfPhaseSorting,
+        ePerfPhaseLoading,
+
+        ePerfPhaseCount
+    };
+
+    struct PerfPhaseCounters
+    {
+        uint64 counts[ePerfPhaseCount][ePerfCounterCount];
+    };
+
+    class ScopedPerfPhase
+    {
+    private:
+        PerfPhase previous;
+        bool active;
+
+    public:
+        ScopedPerfPhase(PerfPhase phase);
+        ~ScopedPerfPhase();
+    };
+
+    #define PerfPhaseScope_(Phase_)                        Selas::ScopedPerfPhase __perfPhaseScope(Phase_)
+
+    // -- Counters are off by default and a phase scope costs a single load and branch until they're enabled. Once enabled
+    // -- each thread opens its counters with perf_event_open on its first scope and reads them with rdpmc where the kernel
+    // -- allows it. Returns false if none of the counters could be opened, e.g. on platforms other than Linux, on virtual
+    // -- machines without a PMU or when perf_event_paranoid is above 2.
+    bool     PerfCounters_Enable();
+    bool     PerfCounters_Enabled();
+    // -- Drops the calling thread's counts so far, e.g. at the start of a render on a thread that did other work before it.
+    void     PerfCounters_ResetThread();
+    // -- Adds the calling thread's counts to counters and resets them.
+    void     PerfCounters_HarvestThread(PerfPhaseCounters* counters);
+    void     PerfCounters_Clear(PerfPhaseCounters* counters);
+    void     PerfCounters_Log(const PerfPhaseCounters& counters);
+    cpointer PerfPhaseName(PerfPhase phase);
+}
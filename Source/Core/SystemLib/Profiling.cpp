@@ -3,6 +3,11 @@
 //=================================================================================================================================
 
 #include "SystemLib/Profiling.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
 
 #if USE_PIX
     #define WIN32_LEAN_AND_MEAN
@@ -10,21 +15,249 @@
     #include <WinPixEventRuntime/pix3.h>
 #endif
 
+#include <stdio.h>
+#include <string.h>
+
+#define MaxTraceThreads_        256
+// -- 1.5MB per thread; must be a power of two
+#define TraceEventsPerThread_   (64 * 1024)
+#define MaxTraceThreadName_     32
+
 namespace Selas
 {
-#if USE_PIX
+    struct TraceEvent
+    {
+        const char* name;
+        uint64 beginNs;
+        uint64 endNs;
+    };
+
+    struct TraceThreadBuffer
+    {
+        TraceEvent* events;
+        volatile int64 writeCount;
+        // -- Recording the events belong to. A buffer left over from an earlier recording is reset by its owner.
+        volatile int64 epoch;
+        volatile int64 inUse;
+        char name[MaxTraceThreadName_];
+    };
+
+    struct TraceThreadSlot
+    {
+        TraceThreadBuffer* buffer;
+        char name[MaxTraceThreadName_];
+
+        ~TraceThreadSlot();
+    };
+
+    static TraceThreadBuffer traceBuffers[MaxTraceThreads_];
+    static volatile int64 traceBufferCount = 0;
+    static volatile int64 traceBufferLock = 0;
+    static volatile int64 traceRecording = 0;
+    static volatile int64 traceEpoch = 0;
+    static std::chrono::high_resolution_clock::time_point traceStartTime;
+    static thread_local TraceThreadSlot traceThreadSlot;
+
+    //=============================================================================================================================
+    TraceThreadSlot::~TraceThreadSlot()
+    {
+        if(buffer != nullptr) {
+            Atomic::StoreRelease64(&buffer->inUse, 0);
+        }
+    }
+
+    //=============================================================================================================================
+    static uint64 TraceTimestampNs()
+    {
+        auto elapsed = SystemTime::Now() - traceStartTime;
+        return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+    //=============================================================================================================================
+    static TraceThreadBuffer* AcquireTraceBuffer()
+    {
+        while(Atomic::CompareExchange64(&traceBufferLock, 1, 0) == false) {
+        }
+
+        // -- Prefer a buffer left behind by a thread that exited over growing the list
+        TraceThreadBuffer* buffer = nullptr;
+        for(int64 scan = 0; scan < traceBufferCount; ++scan) {
+            if(Atomic::LoadAcquire64(&traceBuffers[scan].inUse) == 0) {
+                buffer = &traceBuffers[scan];
+                break;
+            }
+        }
+
+        if(buffer == nullptr && traceBufferCount < MaxTraceThreads_) {
+            buffer = &traceBuffers[traceBufferCount];
+            buffer->events = AllocArray_(TraceEvent, TraceEventsPerThread_);
+            buffer->writeCount = 0;
+            buffer->epoch = Atomic::LoadAcquire64(&traceEpoch);
+            Atomic::StoreRelease64(&traceBufferCount, traceBufferCount + 1);
+        }
+
+        if(buffer != nullptr) {
+            buffer->inUse = 1;
+            if(traceThreadSlot.name[0] != '\0') {
+                Memory::Copy(buffer->name, traceThreadSlot.name, MaxTraceThreadName_);
+            }
+            else {
+                snprintf(buffer->name, MaxTraceThreadName_, "Thread %d", (int32)(buffer - traceBuffers));
+            }
+        }
+
+        Atomic::StoreRelease64(&traceBufferLock, 0);
+        return buffer;
+    }
+
     //=============================================================================================================================
-    ScopedProfileEvent::ScopedProfileEvent(uint64 color, const char* name)
+    ScopedProfileEvent::ScopedProfileEvent(uint64 color, const char* name_)
+        : name(name_)
+        , beginNs(InvalidIndex64)
+        , epoch(0)
     {
-        PIXBeginEvent(color, name);
+        #if USE_PIX
+            PIXBeginEvent(color, name_);
+        #else
+            Unused_(color);
+        #endif
+
+        if(traceRecording) {
+            epoch = Atomic::LoadAcquire64(&traceEpoch);
+            beginNs = TraceTimestampNs();
+        }
     }
 
     //=============================================================================================================================
     ScopedProfileEvent::~ScopedProfileEvent()
     {
-        PIXEndEvent();
+        #if USE_PIX
+            PIXEndEvent();
+        #endif
+
+        if(beginNs == InvalidIndex64) {
+            return;
+        }
+
+        // -- The profiler was started again while this event was open so its begin time is from the previous recording
+        int64 currentEpoch = Atomic::LoadAcquire64(&traceEpoch);
+        if(epoch != currentEpoch) {
+            return;
+        }
+
+        TraceThreadBuffer* buffer = traceThreadSlot.buffer;
+        if(buffer == nullptr) {
+            buffer = AcquireTraceBuffer();
+            if(buffer == nullptr) {
+                return;
+            }
+            traceThreadSlot.buffer = buffer;
+        }
+
+        // -- Released by TraceProfiler_Shutdown
+        if(buffer->events == nullptr) {
+            return;
+        }
+
+        // -- Only the owning thread writes so the count is published with a plain store. That includes resetting the count for
+        // -- a new recording; the epoch is published after the count so a reader that sees the new epoch sees the reset.
+        int64 writeCount = buffer->epoch == currentEpoch ? buffer->writeCount : 0;
+        TraceEvent& event = buffer->events[writeCount & (TraceEventsPerThread_ - 1)];
+        event.name = name;
+        event.beginNs = beginNs;
+        event.endNs = TraceTimestampNs();
+        Atomic::StoreRelease64(&buffer->writeCount, writeCount + 1);
+        Atomic::StoreRelease64(&buffer->epoch, currentEpoch);
+    }
+
+    //=============================================================================================================================
+    void TraceProfiler_Start()
+    {
+        // -- Buffers may still be written by their threads so they aren't reset here. Moving to a new epoch drops their events
+        // -- from the trace until each owner resets its buffer on its next write.
+        traceStartTime = SystemTime::Now();
+        Atomic::Increment64(&traceEpoch);
+        Atomic::StoreRelease64(&traceRecording, 1);
     }
-#else
 
-#endif
+    //=============================================================================================================================
+    void TraceProfiler_Stop()
+    {
+        Atomic::StoreRelease64(&traceRecording, 0);
+    }
+
+    //=============================================================================================================================
+    void TraceProfiler_SetThreadName(cpointer name)
+    {
+        strncpy(traceThreadSlot.name, name, MaxTraceThreadName_ - 1);
+        traceThreadSlot.name[MaxTraceThreadName_ - 1] = '\0';
+
+        if(traceThreadSlot.buffer != nullptr) {
+            Memory::Copy(traceThreadSlot.buffer->name, traceThreadSlot.name, MaxTraceThreadName_);
+        }
+    }
+
+    //=============================================================================================================================
+    Error TraceProfiler_WriteChromeTrace(cpointer filepath)
+    {
+        FILE* file = fopen(filepath, "w");
+        if(file == nullptr) {
+            return Error_("Failed to open trace file %s", filepath);
+        }
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"%s\"}}", ProjectRootName_);
+
+        int64 epoch = Atomic::LoadAcquire64(&traceEpoch);
+        int64 bufferCount = Atomic::LoadAcquire64(&traceBufferCount);
+        for(int64 bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex) {
+            const TraceThreadBuffer& buffer = traceBuffers[bufferIndex];
+
+            // -- Nothing recorded since the last start
+            if(Atomic::LoadAcquire64((volatile int64*)&buffer.epoch) != epoch) {
+                continue;
+            }
+
+            int64 writeCount = Atomic::LoadAcquire64((volatile int64*)&buffer.writeCount);
+            if(writeCount == 0) {
+                continue;
+            }
+
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lld,\"args\":{\"name\":\"%s\"}}",
+                    (long long)bufferIndex, buffer.name);
+
+            // -- Once the ring has wrapped only the newest events are still around
+            int64 first = Max<int64>(writeCount - TraceEventsPerThread_, 0);
+            for(int64 scan = first; scan < writeCount; ++scan) {
+                const TraceEvent& event = buffer.events[scan & (TraceEventsPerThread_ - 1)];
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lld,\"ts\":%.3f,\"dur\":%.3f}", event.name,
+                        (long long)bufferIndex, event.beginNs / 1000.0, (event.endNs - event.beginNs) / 1000.0);
+            }
+        }
+
+        fprintf(file, "\n]}\n");
+
+        bool writeFailed = ferror(file) != 0;
+        fclose(file);
+        if(writeFailed) {
+            return Error_("Failed to write trace file %s", filepath);
+        }
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    void TraceProfiler_Shutdown()
+    {
+        TraceProfiler_Stop();
+
+        // -- Threads still holding a buffer keep pointing at it so it stays listed with its events released; the profiler
+        // -- can't be started again after this.
+        int64 bufferCount = Atomic::LoadAcquire64(&traceBufferCount);
+        for(int64 scan = 0; scan < bufferCount; ++scan) {
+            Free_(traceBuffers[scan].events);
+            traceBuffers[scan].events = nullptr;
+            traceBuffers[scan].writeCount = 0;
+        }
+    }
 }
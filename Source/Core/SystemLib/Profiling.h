@@ -4,21 +4,44 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 
+// -- Set to 0 to compile the markers out entirely
+#define EnableProfileEvents_ 1
+
 namespace Selas
 {
-    #if USE_PIX
-        class ScopedProfileEvent
-        {
-        public:
-            ScopedProfileEvent(uint64 color, const char* name);
-            ~ScopedProfileEvent();
-        };
+    // -- Markers are always sent to PIX when it is linked in. Independently of that every thread records its markers into its
+    // -- own ring buffer while the trace profiler is started; when it is stopped a marker costs a single load and branch.
+    class ScopedProfileEvent
+    {
+    public:
+        // -- name must outlive the trace, in practice a string literal, and is written out without escaping.
+        ScopedProfileEvent(uint64 color, const char* name);
+        ~ScopedProfileEvent();
+
+    private:
+        const char* name;
+        uint64 beginNs;
+        int64 epoch;
+    };
 
+    #if EnableProfileEvents_
         #define ProfileEventMarker_(color, name) ScopedProfileEvent __profileEventMarker(color, name)
     #else
         #define ProfileEventMarker_(color, name)
     #endif
-    
-}
\ No newline at end of file
+
+    // -- Each thread keeps only its most recent events once its ring buffer wraps. Threads that exit hand their buffer, events
+    // -- included, to the next thread that records so short lived threads don't grow the trace without bound.
+    // -- Starting again drops the previous recording. Threads may keep recording while it is started or stopped.
+    void  TraceProfiler_Start();
+    void  TraceProfiler_Stop();
+    // -- Labels the calling thread's lane in the trace. Threads created through ThreadingLib are labeled with their name.
+    void  TraceProfiler_SetThreadName(cpointer name);
+    // -- Writes the recorded events in the Chrome trace event format, viewable in chrome://tracing or Perfetto. Call once the
+    // -- recording threads are finished; events still being written are not waited on.
+    Error TraceProfiler_WriteChromeTrace(cpointer filepath);
+    void  TraceProfiler_Shutdown();
+}
@@ -0,0 +1,245 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/AovDenoiser.h"
+#include "TextureLib/AovImage.h"
+#include "ThreadingLib/Thread.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/JsAssert.h"
+
+#define DefaultDenoiserThreadCount_ 16
+#define MaxDenoiserThreadCount_     64
+#define MinDemodulationAlbedo_      0.001f
+#define DenoiserEpsilon_            1e-4f
+
+namespace Selas
+{
+    struct DenoiserData
+    {
+        const AovImage*     image;
+        AovDenoiserSettings settings;
+        float3*             output;
+
+        // -- Per pixel inputs prepared once up front
+        float3*             color;
+        float3*             variance;
+        float3*             demodulation;
+        float3*             normal;
+
+        volatile int64      nextRow;
+    };
+
+    //=============================================================================================================================
+    void AovDenoiser_DefaultSettings(AovDenoiserSettings& settings)
+    {
+        settings.radius        = 6;
+        settings.patchRadius   = 1;
+        settings.colorStrength = 0.45f;
+        settings.normalSigma   = 0.3f;
+        settings.albedoSigma   = 0.1f;
+        settings.depthSigma    = 0.05f;
+        settings.threadCount   = DefaultDenoiserThreadCount_;
+    }
+
+    //=============================================================================================================================
+    static float3 Reciprocal(float3 value)
+    {
+        return float3(1.0f / value.x, 1.0f / value.y, 1.0f / value.z);
+    }
+
+    //=============================================================================================================================
+    static float3 DemodulationFactor(float3 albedo)
+    {
+        // -- Texture detail lives in the albedo so only the lighting is filtered. Black albedo channels are left alone.
+        return float3(albedo.x > MinDemodulationAlbedo_ ? albedo.x : 1.0f,
+                      albedo.y > MinDemodulationAlbedo_ ? albedo.y : 1.0f,
+                      albedo.z > MinDemodulationAlbedo_ ? albedo.z : 1.0f);
+    }
+
+    //=============================================================================================================================
+    static void PrepareInputs(DenoiserData* data)
+    {
+        const AovImage* image = data->image;
+        int32 width = (int32)image->width;
+        int32 height = (int32)image->height;
+
+        float3* rawVariance = AllocArray_(float3, (width * height));
+        for(int32 scan = 0, count = width * height; scan < count; ++scan) {
+            float3 factor = DemodulationFactor(image->albedo[scan]);
+            float3 normal = image->normal[scan];
+            float length = Length(normal);
+
+            data->demodulation[scan] = factor;
+            data->color[scan] = image->beauty[scan] * Reciprocal(factor);
+            data->normal[scan] = length > 0.0f ? normal * (1.0f / length) : float3::Zero_;
+            rawVariance[scan] = image->variance[scan] * Reciprocal(factor * factor);
+        }
+
+        // -- The two half buffer estimate is itself noisy so it is box filtered before it is trusted.
+        for(int32 y = 0; y < height; ++y) {
+            for(int32 x = 0; x < width; ++x) {
+                float3 sum = float3::Zero_;
+                float count = 0.0f;
+                for(int32 dy = Max(y - 1, 0); dy <= Min(y + 1, height - 1); ++dy) {
+                    for(int32 dx = Max(x - 1, 0); dx <= Min(x + 1, width - 1); ++dx) {
+                        sum += rawVariance[dy * width + dx];
+                        count += 1.0f;
+                    }
+                }
+                data->variance[y * width + x] = sum * (1.0f / count);
+            }
+        }
+
+        Free_(rawVariance);
+    }
+
+    //=============================================================================================================================
+    static float PatchDistance(const DenoiserData* data, int32 px, int32 py, int32 qx, int32 qy)
+    {
+        int32 width = (int32)data->image->width;
+        int32 height = (int32)data->image->height;
+        int32 patchRadius = (int32)data->settings.patchRadius;
+        float k2 = data->settings.colorStrength * data->settings.colorStrength;
+
+        float distance = 0.0f;
+        float count = 0.0f;
+        for(int32 oy = -patchRadius; oy <= patchRadius; ++oy) {
+            int32 pOffsetY = Clamp(py + oy, 0, height - 1) * width;
+            int32 qOffsetY = Clamp(qy + oy, 0, height - 1) * width;
+            for(int32 ox = -patchRadius; ox <= patchRadius; ++ox) {
+                int32 p = pOffsetY + Clamp(px + ox, 0, width - 1);
+                int32 q = qOffsetY + Clamp(qx + ox, 0, width - 1);
+
+                float3 up = data->color[p];
+                float3 uq = data->color[q];
+                float3 vp = data->variance[p];
+                float3 vq = data->variance[q];
+
+                // -- Squared difference with the expected noise contribution removed, normalized by the noise level.
+                float3 difference = (up - uq) * (up - uq);
+                float3 expected = vp + float3(Min(vp.x, vq.x), Min(vp.y, vq.y), Min(vp.z, vq.z));
+                float3 normalization = float3(DenoiserEpsilon_, DenoiserEpsilon_, DenoiserEpsilon_) + k2 * (vp + vq);
+                float3 channel = (difference - expected) * Reciprocal(normalization);
+
+                distance += channel.x + channel.y + channel.z;
+                count += 3.0f;
+            }
+        }
+
+        return Max(distance / count, 0.0f);
+    }
+
+    //=============================================================================================================================
+    static float FeatureWeight(const DenoiserData* data, int32 p, int32 q)
+    {
+        const AovImage* image = data->image;
+        const AovDenoiserSettings& settings = data->settings;
+
+        float3 normalDelta = data->normal[p] - data->normal[q];
+        float3 albedoDelta = image->albedo[p] - image->albedo[q];
+
+        float depthP = image->depth[p];
+        float depthQ = image->depth[q];
+        float depthDelta = Math::Absf(depthP - depthQ) / (settings.depthSigma * Max(depthP, depthQ) + DenoiserEpsilon_);
+
+        float exponent = Dot(normalDelta, normalDelta) / (2.0f * settings.normalSigma * settings.normalSigma)
+                       + Dot(albedoDelta, albedoDelta) / (2.0f * settings.albedoSigma * settings.albedoSigma)
+                       + depthDelta;
+        return Math::Expf(-exponent);
+    }
+
+    //=============================================================================================================================
+    static void FilterRow(DenoiserData* data, int32 y)
+    {
+        const AovImage* image = data->image;
+        int32 width = (int32)image->width;
+        int32 height = (int32)image->height;
+        int32 radius = (int32)data->settings.radius;
+
+        for(int32 x = 0; x < width; ++x) {
+            int32 p = y * width + x;
+            if(image->sampleCount[p] <= 0.0f) {
+                data->output[p] = image->beauty[p];
+                continue;
+            }
+
+            float3 sum = float3::Zero_;
+            float weightSum = 0.0f;
+
+            for(int32 qy = Max(y - radius, 0), endY = Min(y + radius, height - 1); qy <= endY; ++qy) {
+                for(int32 qx = Max(x - radius, 0), endX = Min(x + radius, width - 1); qx <= endX; ++qx) {
+                    int32 q = qy * width + qx;
+                    if(image->sampleCount[q] <= 0.0f) {
+                        continue;
+                    }
+
+                    float weight = 1.0f;
+                    if(q != p) {
+                        weight = Math::Expf(-PatchDistance(data, x, y, qx, qy)) * FeatureWeight(data, p, q);
+                    }
+
+                    sum += weight * data->color[q];
+                    weightSum += weight;
+                }
+            }
+
+            data->output[p] = (sum * (1.0f / weightSum)) * data->demodulation[p];
+        }
+    }
+
+    //=============================================================================================================================
+    static void DenoiserKernel(void* userData)
+    {
+        DenoiserData* data = (DenoiserData*)userData;
+        int64 height = (int64)data->image->height;
+
+        while(true) {
+            int64 y = Atomic::Increment64(&data->nextRow);
+            if(y >= height) {
+                break;
+            }
+            FilterRow(data, (int32)y);
+        }
+    }
+
+    //=============================================================================================================================
+    void AovDenoiser_Filter(const AovImage* image, const AovDenoiserSettings& settings, float3* output)
+    {
+        uint32 pixelCount = image->width * image->height;
+
+        DenoiserData data;
+        data.image        = image;
+        data.settings     = settings;
+        data.output       = output;
+        data.color        = AllocArray_(float3, pixelCount);
+        data.variance     = AllocArray_(float3, pixelCount);
+        data.demodulation = AllocArray_(float3, pixelCount);
+        data.normal       = AllocArray_(float3, pixelCount);
+        data.nextRow      = 0;
+
+        PrepareInputs(&data);
+
+        uint32 threadCount = Clamp<uint32>(settings.threadCount, 1, MaxDenoiserThreadCount_);
+
+        ThreadHandle threadHandles[MaxDenoiserThreadCount_];
+        for(uint32 scan = 1; scan < threadCount; ++scan) {
+            threadHandles[scan] = CreateThread(DenoiserKernel, &data, "Denoiser", NoThreadAffinity_);
+        }
+
+        DenoiserKernel(&data);
+
+        for(uint32 scan = 1; scan < threadCount; ++scan) {
+            ShutdownThread(threadHandles[scan]);
+        }
+
+        Free_(data.normal);
+        Free_(data.demodulation);
+        Free_(data.variance);
+        Free_(data.color);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    struct AovImage;
+
+    struct AovDenoiserSettings
+    {
+        // -- Half size of the search window in pixels
+        uint32 radius;
+        // -- Half size of the non-local means patch compared around each pixel; 0 gives a per pixel joint bilateral.
+        uint32 patchRadius;
+        // -- Scales how many standard deviations two colors can differ by and still be treated as the same
+        float  colorStrength;
+        // -- Feature edge stopping widths. Depth is relative to the center pixel's depth.
+        float  normalSigma;
+        float  albedoSigma;
+        float  depthSigma;
+        uint32 threadCount;
+    };
+
+    void AovDenoiser_DefaultSettings(AovDenoiserSettings& settings);
+
+    // -- Non-local means on the albedo demodulated beauty using the variance layer, weighted by the albedo, normal and depth
+    // -- layers so edges and texture survive. Works on any resolved image so it can run on progressive previews as well as
+    // -- the final frame. output holds width * height pixels.
+    void AovDenoiser_Filter(const AovImage* image, const AovDenoiserSettings& settings, float3* output);
+}
@@ -0,0 +1,369 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/AovImage.h"
+#include "TextureLib/Framebuffer.h"
+#include "TextureLib/AovDenoiser.h"
+#include "ThreadingLib/Thread.h"
+#include "StringLib/FixedString.h"
+#include "StringLib/StringUtil.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "IoLib/Environment.h"
+#include "IoLib/Directory.h"
+#include "IoLib/File.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/JsAssert.h"
+
+#include <stdio.h>
+
+namespace Selas
+{
+    struct AovSaveJob
+    {
+        AovImage image;
+        ExrPixelType type;
+        bool denoise;
+        AovDenoiserSettings denoiseSettings;
+        FilePathString filepath;
+
+        ThreadHandle thread;
+        volatile int64 finished;
+    };
+
+    struct PendingAovSaves
+    {
+        PendingAovSaves() { spinlock = CreateSpinLock(); }
+        ~PendingAovSaves() { jobs.Shutdown(); CloseSpinlock(spinlock); }
+
+        void* spinlock;
+        CArray<AovSaveJob*> jobs;
+    };
+
+    //=============================================================================================================================
+    static PendingAovSaves& PendingSaves()
+    {
+        static PendingAovSaves pending;
+        return pending;
+    }
+
+    //=============================================================================================================================
+    void AovImage_Resolve(const Framebuffer* frame, AovImage* image)
+    {
+        Assert_(frame->layerCount == eAovLayerCount);
+
+        uint32 pixelCount = frame->width * frame->height;
+
+        image->width       = frame->width;
+        image->height      = frame->height;
+        image->beauty      = AllocArray_(float3, pixelCount);
+        image->albedo      = AllocArray_(float3, pixelCount);
+        image->normal      = AllocArray_(float3, pixelCount);
+        image->variance    = AllocArray_(float3, pixelCount);
+        image->depth       = AllocArray_(float, pixelCount);
+        image->sampleCount = AllocArray_(float, pixelCount);
+        image->denoised    = nullptr;
+
+        for(uint32 scan = 0; scan < pixelCount; ++scan) {
+            float sampleCount = frame->buffers[eAovLayerSampleCount][scan].x;
+            float oddCount = Math::Floor(0.5f * sampleCount);
+            float evenCount = sampleCount - oddCount;
+
+            float3 beauty = frame->buffers[eAovLayerBeauty][scan];
+            float3 beautyOdd = frame->buffers[eAovLayerBeautyOdd][scan];
+            float3 depth = frame->buffers[eAovLayerDepth][scan];
+
+            float sampleScale = sampleCount > 0.0f ? 1.0f / sampleCount : 0.0f;
+            image->beauty[scan] = beauty * sampleScale;
+            image->albedo[scan] = frame->buffers[eAovLayerAlbedo][scan] * sampleScale;
+            image->normal[scan] = frame->buffers[eAovLayerNormal][scan] * sampleScale;
+            image->depth[scan] = depth.y > 0.0f ? depth.x / depth.y : 0.0f;
+            image->sampleCount[scan] = sampleCount;
+
+            // -- The two halves are independent estimates of the same pixel so the variance of their mean is about a
+            // -- quarter of their squared difference.
+            if(oddCount > 0.0f) {
+                float3 difference = (beauty - beautyOdd) * (1.0f / evenCount) - beautyOdd * (1.0f / oddCount);
+                image->variance[scan] = 0.25f * difference * difference;
+            }
+            else {
+                image->variance[scan] = float3::Zero_;
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    void AovImage_Shutdown(AovImage* image)
+    {
+        SafeFree_(image->beauty);
+        SafeFree_(image->albedo);
+        SafeFree_(image->normal);
+        SafeFree_(image->variance);
+        SafeFree_(image->depth);
+        SafeFree_(image->sampleCount);
+        SafeFree_(image->denoised);
+    }
+
+    //=============================================================================================================================
+    void AovImage_Denoise(AovImage* image, const AovDenoiserSettings& settings)
+    {
+        if(image->denoised == nullptr) {
+            image->denoised = AllocArray_(float3, (image->width * image->height));
+        }
+        AovDenoiser_Filter(image, settings, image->denoised);
+    }
+
+    //=============================================================================================================================
+    static uint32 AddRgbChannels(ExrChannel* channels, uint32 channelCount, cpointer layer, const float3* data)
+    {
+        static const cpointer components[] = { "R", "G", "B" };
+
+        for(uint32 scan = 0; scan < 3; ++scan) {
+            ExrChannel& channel = channels[channelCount++];
+            if(layer == nullptr) {
+                channel.name.Copy(components[scan]);
+            }
+            else {
+                FixedStringSprintf(channel.name, "%s.%s", layer, components[scan]);
+            }
+            channel.data = &data->x + scan;
+            channel.stride = sizeof(float3) / sizeof(float);
+        }
+
+        return channelCount;
+    }
+
+    //=============================================================================================================================
+    static uint32 AddScalarChannel(ExrChannel* channels, uint32 channelCount, cpointer name, const float* data)
+    {
+        ExrChannel& channel = channels[channelCount++];
+        channel.name.Copy(name);
+        channel.data = data;
+        channel.stride = 1;
+
+        return channelCount;
+    }
+
+    //=============================================================================================================================
+    uint32 AovImage_ExrChannels(const AovImage* image, ExrChannel* channels)
+    {
+        // -- Beauty is the default layer so viewers show it first.
+        uint32 channelCount = 0;
+        channelCount = AddRgbChannels(channels, channelCount, nullptr, image->beauty);
+        channelCount = AddRgbChannels(channels, channelCount, "albedo", image->albedo);
+        channelCount = AddRgbChannels(channels, channelCount, "normal", image->normal);
+        channelCount = AddRgbChannels(channels, channelCount, "variance", image->variance);
+        channelCount = AddScalarChannel(channels, channelCount, "depth.Z", image->depth);
+        channelCount = AddScalarChannel(channels, channelCount, "sampleCount.Y", image->sampleCount);
+        if(image->denoised != nullptr) {
+            channelCount = AddRgbChannels(channels, channelCount, "denoised", image->denoised);
+        }
+
+        Assert_(channelCount <= AovImageMaxExrChannels_);
+        return channelCount;
+    }
+
+    //=============================================================================================================================
+    static void OutputPath(cpointer name, cpointer extension, FilePathString& filepath)
+    {
+        FixedString128 root = Environment_Root();
+        uint8 pathsep = StringUtil::PathSeperator();
+
+        FilePathString dirpath;
+        FixedStringSprintf(dirpath, "%s_Images%c", root.Ascii(), pathsep);
+        Directory::EnsureDirectoryExists(dirpath.Ascii());
+
+        FixedStringSprintf(filepath, "%s%s%s", dirpath.Ascii(), name, extension);
+    }
+
+    //=============================================================================================================================
+    static void ReplaceFile(cpointer temporaryPath, cpointer filepath)
+    {
+        if(File::Exists(filepath)) {
+            File::Delete(filepath);
+        }
+        if(rename(temporaryPath, filepath) != 0) {
+            WriteDebugInfo_("Failed to rename %s to %s", temporaryPath, filepath);
+        }
+    }
+
+    //=============================================================================================================================
+    static void AovSaveThread(void* userData)
+    {
+        AovSaveJob* job = (AovSaveJob*)userData;
+        AovImage* image = &job->image;
+
+        if(job->denoise) {
+            AovImage_Denoise(image, job->denoiseSettings);
+        }
+
+        ExrChannel channels[AovImageMaxExrChannels_];
+        uint32 channelCount = AovImage_ExrChannels(image, channels);
+
+        // -- Written under a temporary name and renamed so anything polling for the output never sees a partial file.
+        FilePathString temporaryPath;
+        FixedStringSprintf(temporaryPath, "%s.tmp", job->filepath.Ascii());
+
+        Error err = ExrImage_Write(temporaryPath.Ascii(), image->width, image->height, job->type, channels, channelCount);
+        if(Failed_(err)) {
+            WriteDebugInfo_("Failed to write %s: %s", temporaryPath.Ascii(), err.Message());
+        }
+        else {
+            ReplaceFile(temporaryPath.Ascii(), job->filepath.Ascii());
+        }
+
+        AovImage_Shutdown(image);
+
+        // -- The job and its thread handle are released by whoever joins it.
+        Atomic::StoreRelease64(&job->finished, 1);
+    }
+
+    //=============================================================================================================================
+    static void JoinSave(AovSaveJob* job)
+    {
+        ShutdownThread(job->thread);
+        Delete_(job);
+    }
+
+    //=============================================================================================================================
+    static void JoinFinishedSaves(PendingAovSaves& pending)
+    {
+        for(uint scan = pending.jobs.Count(); scan > 0; --scan) {
+            AovSaveJob* job = pending.jobs[scan - 1];
+            if(Atomic::LoadAcquire64(&job->finished)) {
+                JoinSave(job);
+                pending.jobs.RemoveFast(scan - 1);
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    void AovImage_SaveExrAsync(AovImage* image, cpointer name, ExrPixelType type,
+                               const AovDenoiserSettings* denoiseSettings)
+    {
+        AovSaveJob* job = New_(AovSaveJob);
+        job->image = *image;
+        job->type = type;
+        job->denoise = denoiseSettings != nullptr;
+        if(denoiseSettings != nullptr) {
+            job->denoiseSettings = *denoiseSettings;
+        }
+        OutputPath(name, ".exr", job->filepath);
+        job->finished = 0;
+
+        image->beauty = nullptr;
+        image->albedo = nullptr;
+        image->normal = nullptr;
+        image->variance = nullptr;
+        image->depth = nullptr;
+        image->sampleCount = nullptr;
+        image->denoised = nullptr;
+
+        // -- Saves that have already completed are joined here so a long running process such as the render server does not
+        // -- accumulate a thread handle per image until shutdown.
+        PendingAovSaves& pending = PendingSaves();
+        EnterSpinLock(pending.spinlock);
+        JoinFinishedSaves(pending);
+        job->thread = CreateThread(AovSaveThread, job, "AovSave", NoThreadAffinity_);
+        pending.jobs.Add(job);
+        LeaveSpinLock(pending.spinlock);
+    }
+
+    //=============================================================================================================================
+    void AovImage_WaitForPendingSaves()
+    {
+        PendingAovSaves& pending = PendingSaves();
+
+        EnterSpinLock(pending.spinlock);
+        for(uint scan = 0, count = pending.jobs.Count(); scan < count; ++scan) {
+            JoinSave(pending.jobs[scan]);
+        }
+        pending.jobs.Clear();
+        LeaveSpinLock(pending.spinlock);
+    }
+
+    //=============================================================================================================================
+    static void AovTileWriteThread(void* userData)
+    {
+        AovTiledExr* output = (AovTiledExr*)userData;
+
+        ExrChannel channels[AovImageMaxExrChannels_];
+        AovImage_ExrChannels(&output->pendingTile, channels);
+
+        output->pendingError = ExrTiledWriter_WriteTile(&output->writer, output->pendingTileX, output->pendingTileY, channels);
+        AovImage_Shutdown(&output->pendingTile);
+    }
+
+    //=============================================================================================================================
+    static Error WaitForPendingTile(AovTiledExr* output)
+    {
+        if(output->pendingThread != InvalidThreadHandle) {
+            ShutdownThread(output->pendingThread);
+            output->pendingThread = InvalidThreadHandle;
+        }
+
+        return output->pendingError;
+    }
+
+    //=============================================================================================================================
+    Error AovTiledExr_Open(AovTiledExr* output, cpointer name, uint32 width, uint32 height, uint32 tileSize,
+                           ExrPixelType type)
+    {
+        OutputPath(name, ".exr", output->filepath);
+        FixedStringSprintf(output->temporaryPath, "%s.tmp", output->filepath.Ascii());
+
+        output->pendingThread = InvalidThreadHandle;
+        output->pendingError = Success_;
+
+        // -- Only the names matter when opening
+        AovImage layout = {};
+        ExrChannel channels[AovImageMaxExrChannels_];
+        uint32 channelCount = AovImage_ExrChannels(&layout, channels);
+
+        return ExrTiledWriter_Open(&output->writer, output->temporaryPath.Ascii(), width, height, tileSize, type, channels,
+                                   channelCount);
+    }
+
+    //=============================================================================================================================
+    Error AovTiledExr_WriteTileAsync(AovTiledExr* output, AovImage* tile, uint32 tileX, uint32 tileY)
+    {
+        Assert_(tile->denoised == nullptr);
+
+        Error err = WaitForPendingTile(output);
+        if(Failed_(err)) {
+            AovImage_Shutdown(tile);
+            return err;
+        }
+
+        output->pendingTile = *tile;
+        output->pendingTileX = tileX;
+        output->pendingTileY = tileY;
+        output->pendingThread = CreateThread(AovTileWriteThread, output, "AovTileWrite", NoThreadAffinity_);
+
+        tile->beauty = nullptr;
+        tile->albedo = nullptr;
+        tile->normal = nullptr;
+        tile->variance = nullptr;
+        tile->depth = nullptr;
+        tile->sampleCount = nullptr;
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    Error AovTiledExr_Close(AovTiledExr* output)
+    {
+        Error pendingErr = WaitForPendingTile(output);
+        Error closeErr = ExrTiledWriter_Close(&output->writer);
+        ReturnError_(pendingErr);
+        ReturnError_(closeErr);
+
+        ReplaceFile(output->temporaryPath.Ascii(), output->filepath.Ascii());
+        return Success_;
+    }
+}
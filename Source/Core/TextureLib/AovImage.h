@@ -0,0 +1,88 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/ExrImage.h"
+#include "ThreadingLib/Thread.h"
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    struct Framebuffer;
+    struct AovDenoiserSettings;
+
+    // -- Framebuffer layer layout the integrators accumulate into for AovImage_Resolve.
+    enum AovFramebufferLayer
+    {
+        // -- Every sample's radiance, and separately only the odd samples' so the two halves give a variance estimate.
+        eAovLayerBeauty,
+        eAovLayerBeautyOdd,
+        // -- Written once per camera sample at the primary hit
+        eAovLayerAlbedo,
+        eAovLayerNormal,
+        // -- x: summed primary hit distance, y: primary hit count
+        eAovLayerDepth,
+        // -- x: camera samples
+        eAovLayerSampleCount,
+
+        eAovLayerCount
+    };
+
+    // -- Per pixel values resolved from the accumulated layers. Variance is the estimated variance of the beauty pixel mean.
+    // -- denoised stays null unless a denoiser pass fills it.
+    struct AovImage
+    {
+        uint32  width;
+        uint32  height;
+        float3* beauty;
+        float3* albedo;
+        float3* normal;
+        float3* variance;
+        float*  depth;
+        float*  sampleCount;
+        float3* denoised;
+    };
+
+    void AovImage_Resolve(const Framebuffer* frame, AovImage* image);
+    void AovImage_Shutdown(AovImage* image);
+
+    void AovImage_Denoise(AovImage* image, const AovDenoiserSettings& settings);
+
+    // -- Fills channels, which must hold AovImageMaxExrChannels_, with every layer the image has and returns the count.
+    #define AovImageMaxExrChannels_ 17
+    uint32 AovImage_ExrChannels(const AovImage* image, ExrChannel* channels);
+
+    // -- Takes ownership of the image and writes it as a single multilayer EXR in the _Images directory on a background
+    // -- thread. The file appears under its final name only once it is complete. When denoiseSettings is given the denoiser
+    // -- also runs on that thread and its result is written as the denoised layer.
+    void AovImage_SaveExrAsync(AovImage* image, cpointer name, ExrPixelType type,
+                               const AovDenoiserSettings* denoiseSettings = nullptr);
+    // -- Blocks until every save started so far has been written.
+    void AovImage_WaitForPendingSaves();
+
+    //=============================================================================================================================
+    // -- Streams tiles of an image rendered a tile at a time into one tiled EXR. The previous tile is written on a background
+    // -- thread while the next renders so at most two tiles are held at once.
+    struct AovTiledExr
+    {
+        ExrTiledWriter writer;
+        FilePathString filepath;
+        FilePathString temporaryPath;
+
+        ThreadHandle   pendingThread;
+        AovImage       pendingTile;
+        uint32         pendingTileX;
+        uint32         pendingTileY;
+        Error          pendingError;
+    };
+
+    Error AovTiledExr_Open(AovTiledExr* output, cpointer name, uint32 width, uint32 height, uint32 tileSize,
+                           ExrPixelType type);
+    // -- Takes ownership of tile, which must not have a denoised layer so every tile has the same channels.
+    Error AovTiledExr_WriteTileAsync(AovTiledExr* output, AovImage* tile, uint32 tileX, uint32 tileY);
+    Error AovTiledExr_Close(AovTiledExr* output);
+}
@@ -0,0 +1,355 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/ExrImage.h"
+#include "StringLib/StringUtil.h"
+#include "IoLib/File.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/JsAssert.h"
+
+#include <stdio.h>
+
+#define ExrMagicNumber_     20000630
+#define ExrVersion_         2
+#define ExrSingleTileFlag_  0x200
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static uint16 FloatToHalf(float value)
+    {
+        uint32 bits;
+        Memory::Copy(&bits, &value, sizeof(bits));
+
+        uint32 sign = (bits >> 16) & 0x8000;
+        uint32 absBits = bits & 0x7FFFFFFF;
+
+        // -- Inf and NaN; NaNs keep a mantissa bit so they stay NaN
+        if(absBits >= 0x7F800000) {
+            return (uint16)(sign | 0x7C00 | (absBits > 0x7F800000 ? 0x0200 : 0));
+        }
+
+        // -- Anything that rounds past 65504 overflows to inf
+        if(absBits >= 0x477FF000) {
+            return (uint16)(sign | 0x7C00);
+        }
+
+        // -- Below the smallest normal half the value becomes a denormal, rounded to nearest even
+        if(absBits < 0x38800000) {
+            if(absBits < 0x33000000) {
+                return (uint16)sign;
+            }
+
+            uint32 exponent = absBits >> 23;
+            uint32 mantissa = (absBits & 0x007FFFFF) | 0x00800000;
+            uint32 shift = 126 - exponent;
+
+            uint32 halfMantissa = mantissa >> shift;
+            uint32 remainder = mantissa & ((1u << shift) - 1);
+            uint32 halfway = 1u << (shift - 1);
+            if(remainder > halfway || (remainder == halfway && (halfMantissa & 1))) {
+                ++halfMantissa;
+            }
+            return (uint16)(sign | halfMantissa);
+        }
+
+        // -- Rebias the exponent from 127 to 15 and round the mantissa to nearest even
+        uint32 rounded = absBits + 0x0FFF + ((absBits >> 13) & 1);
+        return (uint16)(sign | ((rounded - 0x38000000) >> 13));
+    }
+
+    //=============================================================================================================================
+    static void AppendBytes(CArray<uint8>& buffer, const void* data, uint64 size)
+    {
+        uint64 offset = buffer.Count();
+        buffer.Resize(offset + size);
+        Memory::Copy(buffer.DataPointer() + offset, data, size);
+    }
+
+    //=============================================================================================================================
+    template <typename Type_>
+    static void AppendValue(CArray<uint8>& buffer, Type_ value)
+    {
+        AppendBytes(buffer, &value, sizeof(value));
+    }
+
+    //=============================================================================================================================
+    static void AppendString(CArray<uint8>& buffer, cpointer ascii)
+    {
+        AppendBytes(buffer, ascii, StringUtil::Length(ascii) + 1);
+    }
+
+    //=============================================================================================================================
+    static void AppendAttribute(CArray<uint8>& buffer, cpointer name, cpointer type, int32 size)
+    {
+        AppendString(buffer, name);
+        AppendString(buffer, type);
+        AppendValue<int32>(buffer, size);
+    }
+
+    //=============================================================================================================================
+    static void SortChannels(const ExrChannel* channels, uint32 channelCount, uint32* order)
+    {
+        // -- Channels are stored alphabetically in both the header and every chunk.
+        for(uint32 scan = 0; scan < channelCount; ++scan) {
+            uint32 index = scan;
+            while(index > 0 && StringUtil::Compare(channels[order[index - 1]].name.Ascii(), channels[scan].name.Ascii()) > 0) {
+                order[index] = order[index - 1];
+                --index;
+            }
+            order[index] = scan;
+        }
+    }
+
+    //=============================================================================================================================
+    static void EncodeSamples(uint8* destination, const float* source, uint32 count, uint32 stride, ExrPixelType type)
+    {
+        if(type == eExrPixelHalf) {
+            uint16* halves = (uint16*)destination;
+            for(uint32 scan = 0; scan < count; ++scan) {
+                halves[scan] = FloatToHalf(source[scan * stride]);
+            }
+        }
+        else {
+            float* floats = (float*)destination;
+            for(uint32 scan = 0; scan < count; ++scan) {
+                floats[scan] = source[scan * stride];
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static uint64 SampleSize(ExrPixelType type)
+    {
+        return (type == eExrPixelHalf) ? sizeof(uint16) : sizeof(float);
+    }
+
+    //=============================================================================================================================
+    static void WriteHeader(CArray<uint8>& header, uint32 width, uint32 height, uint32 tileSize, ExrPixelType type,
+                            const ExrChannel* channels, const uint32* order, uint32 channelCount)
+    {
+        AppendValue<int32>(header, ExrMagicNumber_);
+        AppendValue<int32>(header, tileSize > 0 ? (ExrVersion_ | ExrSingleTileFlag_) : ExrVersion_);
+
+        int32 channelListSize = 1;
+        for(uint32 scan = 0; scan < channelCount; ++scan) {
+            channelListSize += StringUtil::Length(channels[order[scan]].name.Ascii()) + 1 + 16;
+        }
+
+        AppendAttribute(header, "channels", "chlist", channelListSize);
+        for(uint32 scan = 0; scan < channelCount; ++scan) {
+            AppendString(header, channels[order[scan]].name.Ascii());
+            AppendValue<int32>(header, (int32)type);
+            // -- pLinear and three reserved bytes
+            AppendValue<uint32>(header, 0);
+            // -- x and y sampling
+            AppendValue<int32>(header, 1);
+            AppendValue<int32>(header, 1);
+        }
+        AppendValue<uint8>(header, 0);
+
+        // -- NO_COMPRESSION
+        AppendAttribute(header, "compression", "compression", 1);
+        AppendValue<uint8>(header, 0);
+
+        int32 window[4] = { 0, 0, (int32)width - 1, (int32)height - 1 };
+        AppendAttribute(header, "dataWindow", "box2i", sizeof(window));
+        AppendBytes(header, window, sizeof(window));
+        AppendAttribute(header, "displayWindow", "box2i", sizeof(window));
+        AppendBytes(header, window, sizeof(window));
+
+        // -- INCREASING_Y for scanlines. Tiles are stored in whatever order they finish so they use RANDOM_Y.
+        AppendAttribute(header, "lineOrder", "lineOrder", 1);
+        AppendValue<uint8>(header, tileSize > 0 ? 2 : 0);
+
+        AppendAttribute(header, "pixelAspectRatio", "float", sizeof(float));
+        AppendValue<float>(header, 1.0f);
+
+        float center[2] = { 0.0f, 0.0f };
+        AppendAttribute(header, "screenWindowCenter", "v2f", sizeof(center));
+        AppendBytes(header, center, sizeof(center));
+
+        AppendAttribute(header, "screenWindowWidth", "float", sizeof(float));
+        AppendValue<float>(header, 1.0f);
+
+        if(tileSize > 0) {
+            // -- ONE_LEVEL, ROUND_DOWN
+            AppendAttribute(header, "tiles", "tiledesc", 2 * sizeof(uint32) + 1);
+            AppendValue<uint32>(header, tileSize);
+            AppendValue<uint32>(header, tileSize);
+            AppendValue<uint8>(header, 0);
+        }
+
+        AppendValue<uint8>(header, 0);
+    }
+
+    //=============================================================================================================================
+    Error ExrImage_Write(cpointer filepath, uint32 width, uint32 height, ExrPixelType type, const ExrChannel* channels,
+                         uint32 channelCount)
+    {
+        if(width == 0 || height == 0 || channelCount == 0 || channelCount > ExrMaxChannels_) {
+            return Error_("Invalid EXR image dimensions or channel count for %s", filepath);
+        }
+
+        uint32 order[ExrMaxChannels_];
+        SortChannels(channels, channelCount, order);
+
+        CArray<uint8> header;
+        WriteHeader(header, width, height, 0, type, channels, order, channelCount);
+
+        uint64 sampleSize = SampleSize(type);
+        uint64 lineDataSize = width * channelCount * sampleSize;
+        uint64 lineChunkSize = 2 * sizeof(int32) + lineDataSize;
+        uint64 offsetTableSize = height * sizeof(uint64);
+        uint64 fileSize = header.Count() + offsetTableSize + height * lineChunkSize;
+
+        uint8* file = AllocArray_(uint8, fileSize);
+        Memory::Copy(file, header.DataPointer(), header.Count());
+
+        uint64* offsetTable = (uint64*)(file + header.Count());
+        uint8* chunks = file + header.Count() + offsetTableSize;
+
+        for(uint32 y = 0; y < height; ++y) {
+            uint8* chunk = chunks + y * lineChunkSize;
+            offsetTable[y] = (uint64)(chunk - file);
+
+            int32 chunkHeader[2] = { (int32)y, (int32)lineDataSize };
+            Memory::Copy(chunk, chunkHeader, sizeof(chunkHeader));
+
+            uint8* line = chunk + sizeof(chunkHeader);
+            for(uint32 scan = 0; scan < channelCount; ++scan) {
+                const ExrChannel& channel = channels[order[scan]];
+                const float* source = channel.data + (uint64)y * width * channel.stride;
+
+                EncodeSamples(line, source, width, channel.stride, type);
+                line += width * sampleSize;
+            }
+        }
+
+        Error err = File::WriteWholeFile(filepath, file, fileSize);
+        Free_(file);
+        header.Shutdown();
+
+        return err;
+    }
+
+    //=============================================================================================================================
+    static Error WriteFileBytes(ExrTiledWriter* writer, const void* data, uint64 size)
+    {
+        if(fwrite(data, 1, size, (FILE*)writer->file) != size) {
+            return Error_("Failed writing %llu bytes to EXR file", size);
+        }
+        writer->fileSize += size;
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    Error ExrTiledWriter_Open(ExrTiledWriter* writer, cpointer filepath, uint32 width, uint32 height, uint32 tileSize,
+                              ExrPixelType type, const ExrChannel* channels, uint32 channelCount)
+    {
+        if(width == 0 || height == 0 || tileSize == 0 || channelCount == 0 || channelCount > ExrMaxChannels_) {
+            return Error_("Invalid EXR image dimensions or channel count for %s", filepath);
+        }
+
+        writer->file = fopen(filepath, "wb");
+        if(writer->file == nullptr) {
+            return Error_("Failed to open %s for writing", filepath);
+        }
+
+        writer->width        = width;
+        writer->height       = height;
+        writer->tileSize     = tileSize;
+        writer->tileCountX   = (width + tileSize - 1) / tileSize;
+        writer->tileCountY   = (height + tileSize - 1) / tileSize;
+        writer->type         = type;
+        writer->channelCount = channelCount;
+        writer->fileSize     = 0;
+        SortChannels(channels, channelCount, writer->order);
+
+        uint32 tileCount = writer->tileCountX * writer->tileCountY;
+        writer->tileOffsets = AllocArray_(uint64, tileCount);
+        Memory::Zero(writer->tileOffsets, tileCount * sizeof(uint64));
+
+        uint64 tileDataSize = (uint64)tileSize * tileSize * channelCount * SampleSize(type);
+        writer->tileBuffer = AllocArray_(uint8, (5 * sizeof(int32) + tileDataSize));
+
+        CArray<uint8> header;
+        WriteHeader(header, width, height, tileSize, type, channels, writer->order, channelCount);
+
+        Error err = WriteFileBytes(writer, header.DataPointer(), header.Count());
+        header.Shutdown();
+        ReturnError_(err);
+
+        // -- Placeholder offset table that Close fills in
+        writer->tableOffset = writer->fileSize;
+        return WriteFileBytes(writer, writer->tileOffsets, tileCount * sizeof(uint64));
+    }
+
+    //=============================================================================================================================
+    Error ExrTiledWriter_WriteTile(ExrTiledWriter* writer, uint32 tileX, uint32 tileY, const ExrChannel* channels)
+    {
+        Assert_(tileX < writer->tileCountX && tileY < writer->tileCountY);
+
+        uint32 startX = tileX * writer->tileSize;
+        uint32 startY = tileY * writer->tileSize;
+        uint32 tileWidth = Min<uint32>(writer->tileSize, writer->width - startX);
+        uint32 tileHeight = Min<uint32>(writer->tileSize, writer->height - startY);
+
+        uint64 sampleSize = SampleSize(writer->type);
+        int32 dataSize = (int32)(tileWidth * tileHeight * writer->channelCount * sampleSize);
+
+        // -- Tile coordinates, level 0 in x and y, then the pixel data size
+        int32 chunkHeader[5] = { (int32)tileX, (int32)tileY, 0, 0, dataSize };
+        Memory::Copy(writer->tileBuffer, chunkHeader, sizeof(chunkHeader));
+
+        uint8* cursor = writer->tileBuffer + sizeof(chunkHeader);
+        for(uint32 y = 0; y < tileHeight; ++y) {
+            for(uint32 scan = 0; scan < writer->channelCount; ++scan) {
+                const ExrChannel& channel = channels[writer->order[scan]];
+                const float* source = channel.data + (uint64)y * tileWidth * channel.stride;
+
+                EncodeSamples(cursor, source, tileWidth, channel.stride, writer->type);
+                cursor += tileWidth * sampleSize;
+            }
+        }
+
+        writer->tileOffsets[tileY * writer->tileCountX + tileX] = writer->fileSize;
+        return WriteFileBytes(writer, writer->tileBuffer, sizeof(chunkHeader) + dataSize);
+    }
+
+    //=============================================================================================================================
+    Error ExrTiledWriter_Close(ExrTiledWriter* writer)
+    {
+        Error err = Success_;
+
+        uint32 tileCount = writer->tileCountX * writer->tileCountY;
+        for(uint32 scan = 0; scan < tileCount; ++scan) {
+            if(writer->tileOffsets[scan] == 0) {
+                err = Error_("EXR tile %u was never written", scan);
+                break;
+            }
+        }
+
+        if(Successful_(err)) {
+            // -- The table sits right after the header so it is always within fseek's range.
+            if(fseek((FILE*)writer->file, (long)writer->tableOffset, SEEK_SET) != 0
+               || fwrite(writer->tileOffsets, sizeof(uint64), tileCount, (FILE*)writer->file) != tileCount) {
+                err = Error_("Failed writing the EXR tile offset table");
+            }
+        }
+
+        if(fclose((FILE*)writer->file) != 0 && Successful_(err)) {
+            err = Error_("Failed closing EXR file");
+        }
+        writer->file = nullptr;
+
+        Free_(writer->tileBuffer);
+        Free_(writer->tileOffsets);
+
+        return err;
+    }
+}
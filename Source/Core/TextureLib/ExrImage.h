@@ -0,0 +1,63 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "StringLib/FixedString.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+#define ExrMaxChannels_ 64
+
+namespace Selas
+{
+    // -- Values match the OpenEXR pixel type enumeration.
+    enum ExrPixelType
+    {
+        eExrPixelHalf  = 1,
+        eExrPixelFloat = 2
+    };
+
+    // -- Layers are expressed with OpenEXR's dotted channel names, e.g. "albedo.R". Channels without a layer prefix such as
+    // -- "R" are the default layer that viewers show first.
+    struct ExrChannel
+    {
+        FixedString32 name;
+        const float*  data;
+        // -- Floats between consecutive pixels so channels can be read straight out of interleaved buffers.
+        uint32        stride;
+    };
+
+    // -- Writes an uncompressed scanline OpenEXR file. Channels can be given in any order; they are sorted by name as the
+    // -- format requires.
+    Error ExrImage_Write(cpointer filepath, uint32 width, uint32 height, ExrPixelType type, const ExrChannel* channels,
+                         uint32 channelCount);
+
+    // -- Streams an uncompressed single level tiled OpenEXR file one tile at a time so the whole image never has to be in
+    // -- memory. Tiles can be written in any order; the offset table is filled in by Close.
+    struct ExrTiledWriter
+    {
+        void*         file;
+        uint32        width;
+        uint32        height;
+        uint32        tileSize;
+        uint32        tileCountX;
+        uint32        tileCountY;
+        ExrPixelType  type;
+        uint32        channelCount;
+        uint32        order[ExrMaxChannels_];
+        uint64        tableOffset;
+        uint64        fileSize;
+        uint64*       tileOffsets;
+        uint8*        tileBuffer;
+    };
+
+    // -- Only the channel names are used here; the data pointers are ignored.
+    Error ExrTiledWriter_Open(ExrTiledWriter* writer, cpointer filepath, uint32 width, uint32 height, uint32 tileSize,
+                              ExrPixelType type, const ExrChannel* channels, uint32 channelCount);
+    // -- channels must be in the same order as they were given to Open. Each covers just the tile, which is clipped to the
+    // -- image at the right and bottom edges, with rows packed at the clipped tile width.
+    Error ExrTiledWriter_WriteTile(ExrTiledWriter* writer, uint32 tileX, uint32 tileY, const ExrChannel* channels);
+    Error ExrTiledWriter_Close(ExrTiledWriter* writer);
+}
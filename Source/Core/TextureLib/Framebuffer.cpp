@@ -9,20 +9,29 @@
 #include "MathLib/FloatFuncs.h"
 #include "IoLib/Environment.h"
 #include "IoLib/Directory.h"
+#include "ThreadingLib/Thread.h"
 #include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/JsAssert.h"
 
 namespace Selas
 {
     //=============================================================================================================================
     void FrameBuffer_Initialize(Framebuffer* frame, uint32 width, uint32 height, uint32 layerCount)
     {
-        CreateSpinLock(frame->spinlock);
-
         frame->width = width;
         frame->height = height;
         frame->layerCount = layerCount;
-        
+        frame->tileCountX = (width + FramebufferTileSize_ - 1) / FramebufferTileSize_;
+        frame->tileCountY = (height + FramebufferTileSize_ - 1) / FramebufferTileSize_;
+
+        frame->writerCount = 0;
+        frame->writerTiles = AllocArray_(float3**, FramebufferMaxWriters_);
+        Memory::Zero(frame->writerTiles, sizeof(float3**) * FramebufferMaxWriters_);
+
         frame->buffers = AllocArray_(float3*, layerCount);
         for(uint scan = 0; scan < layerCount; ++scan) {
             frame->buffers[scan] = AllocArrayAligned_(float3, width * height, 16);
@@ -30,9 +39,30 @@ namespace Selas
         }
     }
 
+    //=============================================================================================================================
+    static void ReleaseWriterTiles(Framebuffer* frame)
+    {
+        uint32 tileCount = frame->tileCountX * frame->tileCountY;
+        for(uint32 slot = 0; slot < (uint32)frame->writerCount; ++slot) {
+            float3** tiles = frame->writerTiles[slot];
+            for(uint32 tile = 0; tile < tileCount; ++tile) {
+                if(tiles[tile] != nullptr) {
+                    FreeAligned_(tiles[tile]);
+                }
+            }
+            Free_(tiles);
+            frame->writerTiles[slot] = nullptr;
+        }
+
+        frame->writerCount = 0;
+    }
+
     //=============================================================================================================================
     void FrameBuffer_Shutdown(Framebuffer* frame)
     {
+        ReleaseWriterTiles(frame);
+        Free_(frame->writerTiles);
+
         for(uint scan = 0; scan < frame->layerCount; ++scan) {
             FreeAligned_(frame->buffers[scan]);
         }
@@ -70,83 +100,193 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    void FramebufferWriter_Initialize(FramebufferWriter* writer, Framebuffer* frame, uint32 capacity, uint32 softCapacity)
+    static void AddTile(const Framebuffer* frame, float3* const* buffers, uint32 tile, const float3* samples)
     {
-        writer->count = 0;
-        writer->capacity = capacity;
-        writer->softCapacity = softCapacity;
-        writer->framebuffer = frame;
+        uint32 startX = (tile % frame->tileCountX) * FramebufferTileSize_;
+        uint32 startY = (tile / frame->tileCountX) * FramebufferTileSize_;
+        uint32 endX = Min<uint32>(startX + FramebufferTileSize_, frame->width);
+        uint32 endY = Min<uint32>(startY + FramebufferTileSize_, frame->height);
 
-        writer->sampleIndices = AllocArrayAligned_(uint32, capacity, 16);
-        writer->samples = AllocArrayAligned_(float3, frame->layerCount * capacity, 16);
+        uint32 layerCount = frame->layerCount;
+        for(uint32 layer = 0; layer < layerCount; ++layer) {
+            for(uint32 y = startY; y < endY; ++y) {
+                const float3* row = samples + (y - startY) * FramebufferTileSize_ * layerCount + layer;
+                float3* frameRow = buffers[layer] + y * frame->width;
+                for(uint32 x = startX; x < endX; ++x) {
+                    frameRow[x] += row[(x - startX) * layerCount];
+                }
+            }
+        }
     }
 
     //=============================================================================================================================
-    static void FlushInternal(FramebufferWriter* __restrict writer)
+    struct ReduceData
     {
-        Assert_(*writer->framebuffer->spinlock == 1);
+        Framebuffer* frame;
+        volatile int64 nextTile;
+    };
 
-        uint layerCount = writer->framebuffer->layerCount;
+    //=============================================================================================================================
+    static void ReduceKernel(void* userData)
+    {
+        ReduceData* data = (ReduceData*)userData;
+        Framebuffer* frame = data->frame;
+        int64 tileCount = (int64)(frame->tileCountX * frame->tileCountY);
+        uint32 writerCount = (uint32)frame->writerCount;
 
-        Framebuffer* frame = writer->framebuffer;
-        for(uint scan = 0, count = writer->count; scan < count; ++scan) {
-            uint32 index = writer->sampleIndices[scan];
+        // -- Whoever takes a tile owns it in the frame and in every writer so no locks are needed.
+        while(true) {
+            int64 tile = Atomic::Increment64(&data->nextTile);
+            if(tile >= tileCount) {
+                break;
+            }
 
-            for(uint layer = 0; layer < layerCount; ++layer) {
-                frame->buffers[layer][index] += writer->samples[layerCount * scan + layer];
+            for(uint32 slot = 0; slot < writerCount; ++slot) {
+                float3* samples = frame->writerTiles[slot][tile];
+                if(samples != nullptr) {
+                    AddTile(frame, frame->buffers, (uint32)tile, samples);
+                    FreeAligned_(samples);
+                    frame->writerTiles[slot][tile] = nullptr;
+                }
             }
         }
-        
-        writer->count = 0;
     }
 
     //=============================================================================================================================
-    void FramebufferWriter_Write(FramebufferWriter* __restrict writer, float3* samples, uint32 layerCount, uint32 x, uint32 y)
+    void FrameBuffer_Reduce(Framebuffer* frame, uint32 threadCount)
     {
-        uint32 index = writer->framebuffer->width * y + x;
-        FramebufferWriter_Write(writer, samples, layerCount, index);
+        ProfileEventMarker_(0, "FramebufferReduce");
+
+        ReduceData data;
+        data.frame = frame;
+        data.nextTile = 0;
+
+        threadCount = Clamp<uint32>(threadCount, 1, FramebufferMaxWriters_);
+
+        ThreadHandle threadHandles[FramebufferMaxWriters_];
+        for(uint32 scan = 1; scan < threadCount; ++scan) {
+            threadHandles[scan] = CreateThread(ReduceKernel, &data, "FramebufferReduce", NoThreadAffinity_);
+        }
+
+        ReduceKernel(&data);
+
+        for(uint32 scan = 1; scan < threadCount; ++scan) {
+            ShutdownThread(threadHandles[scan]);
+        }
+
+        ReleaseWriterTiles(frame);
     }
 
     //=============================================================================================================================
-    void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 index)
+    void FrameBuffer_Snapshot(const Framebuffer* frame, Framebuffer* snapshot)
     {
-        if(writer->count == writer->capacity) {
-            FramebufferWriter_Flush(writer);
+        FrameBuffer_Initialize(snapshot, frame->width, frame->height, frame->layerCount);
+        for(uint32 layer = 0; layer < frame->layerCount; ++layer) {
+            Memory::Copy(snapshot->buffers[layer], frame->buffers[layer], sizeof(float3) * frame->width * frame->height);
         }
 
-        Assert_(layerCount == writer->framebuffer->layerCount);
+        // -- Writers publish their tables and tiles only once they are zeroed so anything non-null here is safe to read.
+        uint32 tileCount = frame->tileCountX * frame->tileCountY;
+        uint32 writerCount = Min<uint32>((uint32)frame->writerCount, FramebufferMaxWriters_);
+        for(uint32 slot = 0; slot < writerCount; ++slot) {
+            float3** tiles = frame->writerTiles[slot];
+            if(tiles == nullptr) {
+                continue;
+            }
 
-        writer->sampleIndices[writer->count] = index;
-        for(uint layer = 0; layer < layerCount; ++layer) {
-            writer->samples[layerCount * writer->count + layer] = samples[layer];
+            for(uint32 tile = 0; tile < tileCount; ++tile) {
+                const float3* samples = tiles[tile];
+                if(samples != nullptr) {
+                    AddTile(frame, snapshot->buffers, tile, samples);
+                }
+            }
         }
-        
-        ++writer->count;
+    }
 
-        if(writer->count > writer->softCapacity) {
-            bool locked = TryEnterSpinLock(writer->framebuffer->spinlock);
-            if(!locked) {
-                return;
-            }
+    //=============================================================================================================================
+    void FramebufferWriter_Initialize(FramebufferWriter* writer, Framebuffer* frame)
+    {
+        uint32 tileCount = frame->tileCountX * frame->tileCountY;
+
+        int64 slot = Atomic::Increment64(&frame->writerCount);
+        Assert_(slot < FramebufferMaxWriters_);
+
+        writer->framebuffer = frame;
+        writer->privateTileCount = 0;
+        writer->tiles = AllocArray_(float3*, tileCount);
+        Memory::Zero(writer->tiles, sizeof(float3*) * tileCount);
+
+        Atomic::FullBarrier();
+        frame->writerTiles[slot] = writer->tiles;
+    }
+
+    //=============================================================================================================================
+    static float3* PrivateTile(FramebufferWriter* __restrict writer, uint32 tile)
+    {
+        float3* samples = writer->tiles[tile];
+        if(samples == nullptr) {
+            uint32 layerCount = writer->framebuffer->layerCount;
+            samples = AllocArrayAligned_(float3, (layerCount * FramebufferTilePixels_), 16);
+            Memory::Zero(samples, sizeof(float3) * layerCount * FramebufferTilePixels_);
 
-            FlushInternal(writer);
-            LeaveSpinLock(writer->framebuffer->spinlock);
+            Atomic::FullBarrier();
+            writer->tiles[tile] = samples;
+            ++writer->privateTileCount;
         }
+
+        return samples;
+    }
+
+    //=============================================================================================================================
+    static uint32 PixelTile(const Framebuffer* frame, uint32 x, uint32 y)
+    {
+        return (y / FramebufferTileSize_) * frame->tileCountX + (x / FramebufferTileSize_);
     }
 
     //=============================================================================================================================
-    void FramebufferWriter_Flush(FramebufferWriter* writer)
+    static uint32 TilePixel(uint32 x, uint32 y)
     {
-        EnterSpinLock(writer->framebuffer->spinlock);
-        FlushInternal(writer);
-        LeaveSpinLock(writer->framebuffer->spinlock);
+        return (y % FramebufferTileSize_) * FramebufferTileSize_ + (x % FramebufferTileSize_);
+    }
+
+    //=============================================================================================================================
+    void FramebufferWriter_Write(FramebufferWriter* __restrict writer, float3* samples, uint32 layerCount, uint32 x, uint32 y)
+    {
+        Assert_(layerCount == writer->framebuffer->layerCount);
+
+        float3* pixel = PrivateTile(writer, PixelTile(writer->framebuffer, x, y)) + TilePixel(x, y) * layerCount;
+        for(uint32 layer = 0; layer < layerCount; ++layer) {
+            pixel[layer] += samples[layer];
+        }
+    }
+
+    //=============================================================================================================================
+    void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 index)
+    {
+        uint32 width = writer->framebuffer->width;
+        uint32 y = index / width;
+        uint32 x = index - y * width;
+        FramebufferWriter_Write(writer, samples, layerCount, x, y);
+    }
+
+    //=============================================================================================================================
+    void FramebufferWriter_WriteLayer(FramebufferWriter* __restrict writer, float3 sample, uint32 layer, uint32 index)
+    {
+        Assert_(layer < writer->framebuffer->layerCount);
+
+        uint32 width = writer->framebuffer->width;
+        uint32 y = index / width;
+        uint32 x = index - y * width;
+
+        float3* tile = PrivateTile(writer, PixelTile(writer->framebuffer, x, y));
+        tile[TilePixel(x, y) * writer->framebuffer->layerCount + layer] += sample;
     }
 
     //=============================================================================================================================
     void FramebufferWriter_Shutdown(FramebufferWriter* writer)
     {
-        FramebufferWriter_Flush(writer);
-        FreeAligned_(writer->samples);
-        FreeAligned_(writer->sampleIndices);
+        // -- The private tiles belong to the frame from here on and are added in by FrameBuffer_Reduce.
+        writer->tiles = nullptr;
+        writer->framebuffer = nullptr;
     }
 }
\ No newline at end of file
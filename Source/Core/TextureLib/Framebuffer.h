@@ -11,39 +11,50 @@
 
 namespace Selas
 {
-    #define DefaultFrameWriterCapacity_     4096
-    #define DefaultFrameWriterSoftCapacity_ 3840
+    #define FramebufferTileSize_            16
+    #define FramebufferTilePixels_          (FramebufferTileSize_ * FramebufferTileSize_)
+    #define FramebufferMaxWriters_          64
 
     struct Framebuffer
     {
         uint32  width;
         uint32  height;
         uint32  layerCount;
+        uint32  tileCountX;
+        uint32  tileCountY;
         float3** buffers;
-        uint8 spinlock[CacheLineSize_];
+
+        // -- Every writer opened on the frame claims a slot and keeps its private tile table there. Nothing reaches buffers
+        // -- until FrameBuffer_Reduce adds the private tiles in once the writers are done.
+        volatile int64 writerCount;
+        float3*** writerTiles;
     };
 
+    // -- Each writer accumulates into private copies of the tiles it writes to without taking any lock. A tile is allocated
+    // -- the first time the writer touches it and keeps the layers of each pixel side by side so a write touches one line.
     struct FramebufferWriter
     {
-        uint32  count;
-        uint32  capacity;
-        uint32  softCapacity;
-        uint32  pad;
-        uint32* sampleIndices;
-        float3* samples;
         Framebuffer* framebuffer;
+        // -- Per frame tile; the writer's private copy or null
+        float3** tiles;
+        uint64  privateTileCount;
     };
 
     void FrameBuffer_Initialize(Framebuffer* frame, uint32 width, uint32 height, uint32 layerCount);
     void FrameBuffer_Shutdown(Framebuffer* frame);
     void FrameBuffer_Save(Framebuffer* frame, cpointer name);
     void FrameBuffer_Scale(Framebuffer* frame, float value);
+    // -- Adds every writer's private tiles into the frame and releases them. Call once all writers on the frame are shut down.
+    // -- The tiles are shared out between threadCount threads, the calling thread included.
+    void FrameBuffer_Reduce(Framebuffer* frame, uint32 threadCount);
+    // -- Initializes snapshot with a copy of the frame with the private tiles added in. Writers may still be running so a
+    // -- pixel can be caught half way through a write; only meant for previews.
+    void FrameBuffer_Snapshot(const Framebuffer* frame, Framebuffer* snapshot);
 
-    void FramebufferWriter_Initialize(FramebufferWriter* writer, Framebuffer* frame,
-                                      uint32 capacity = DefaultFrameWriterCapacity_,
-                                      uint32 softCapacity = DefaultFrameWriterSoftCapacity_);
+    void FramebufferWriter_Initialize(FramebufferWriter* writer, Framebuffer* frame);
     void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 x, uint32 y);
     void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 index);
-    void FramebufferWriter_Flush(FramebufferWriter* writer);
+    // -- Adds to a single layer for contributions that only touch some of them.
+    void FramebufferWriter_WriteLayer(FramebufferWriter* writer, float3 sample, uint32 layer, uint32 index);
     void FramebufferWriter_Shutdown(FramebufferWriter* writer);
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/FramebufferPreview.h"
+#include "TextureLib/Framebuffer.h"
+#include "TextureLib/AovImage.h"
+#include "TextureLib/StbImage.h"
+#include "StringLib/StringUtil.h"
+#include "MathLib/ColorSpace.h"
+#include "MathLib/FloatFuncs.h"
+#include "IoLib/Environment.h"
+#include "IoLib/Directory.h"
+#include "IoLib/File.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Logging.h"
+
+#include <stdio.h>
+
+// -- Upper bound on how long Stop waits for the preview thread to notice
+#define PreviewPollIntervalMs_ 100
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static uint32 ToneMapPixel(float3 radiance, float exposure)
+    {
+        // -- Reinhard per channel then the sRGB curve
+        float3 exposed = radiance * exposure;
+        float3 mapped = float3(exposed.x / (1.0f + exposed.x), exposed.y / (1.0f + exposed.y), exposed.z / (1.0f + exposed.z));
+        float3 srgb = Math::LinearToSrgbPrecise(mapped);
+
+        uint32 r = (uint32)(Saturate(srgb.x) * 255.0f + 0.5f);
+        uint32 g = (uint32)(Saturate(srgb.y) * 255.0f + 0.5f);
+        uint32 b = (uint32)(Saturate(srgb.z) * 255.0f + 0.5f);
+        return r | (g << 8) | (b << 16) | (0xFFu << 24);
+    }
+
+    //=============================================================================================================================
+    static void WritePreview(FramebufferPreview* preview)
+    {
+        Framebuffer snapshot;
+        FrameBuffer_Snapshot(preview->frame, &snapshot);
+
+        AovImage image;
+        AovImage_Resolve(&snapshot, &image);
+        FrameBuffer_Shutdown(&snapshot);
+
+        if(preview->denoise) {
+            AovImage_Denoise(&image, preview->denoiseSettings);
+        }
+
+        const float3* radiance = image.denoised != nullptr ? image.denoised : image.beauty;
+
+        uint32 pixelCount = image.width * image.height;
+        uint32* pixels = AllocArray_(uint32, pixelCount);
+        for(uint32 scan = 0; scan < pixelCount; ++scan) {
+            pixels[scan] = ToneMapPixel(radiance[scan], preview->exposure);
+        }
+
+        // -- Replaced through a rename so viewers polling the file never load a partial image.
+        FilePathString temporaryPath;
+        FixedStringSprintf(temporaryPath, "%s.tmp", preview->filepath.Ascii());
+
+        Error err = StbImageWrite(temporaryPath.Ascii(), image.width, image.height, 4, PNG, pixels);
+        if(Failed_(err)) {
+            WriteDebugInfo_("Failed to write preview %s: %s", temporaryPath.Ascii(), err.Message());
+        }
+        else {
+            if(File::Exists(preview->filepath.Ascii())) {
+                File::Delete(preview->filepath.Ascii());
+            }
+            rename(temporaryPath.Ascii(), preview->filepath.Ascii());
+            ++preview->writtenCount;
+        }
+
+        Free_(pixels);
+        AovImage_Shutdown(&image);
+    }
+
+    //=============================================================================================================================
+    static void FramebufferPreviewThread(void* userData)
+    {
+        FramebufferPreview* preview = (FramebufferPreview*)userData;
+
+        auto lastWrite = SystemTime::Now();
+        while(preview->stop == 0) {
+            float elapsedMs = SystemTime::ElapsedMillisecondsF(lastWrite);
+            if(elapsedMs < (float)preview->intervalMs) {
+                Sleep(Min<uint>(PreviewPollIntervalMs_, (uint)((float)preview->intervalMs - elapsedMs) + 1));
+                continue;
+            }
+
+            WritePreview(preview);
+            lastWrite = SystemTime::Now();
+        }
+    }
+
+    //=============================================================================================================================
+    void FramebufferPreview_Start(FramebufferPreview* preview, const Framebuffer* frame, cpointer name, uint32 intervalMs,
+                                  float exposure, const AovDenoiserSettings* denoiseSettings)
+    {
+        FixedString128 root = Environment_Root();
+        uint8 pathsep = StringUtil::PathSeperator();
+
+        FilePathString dirpath;
+        FixedStringSprintf(dirpath, "%s_Images%c", root.Ascii(), pathsep);
+        Directory::EnsureDirectoryExists(dirpath.Ascii());
+
+        preview->frame = frame;
+        FixedStringSprintf(preview->filepath, "%s%s_preview.png", dirpath.Ascii(), name);
+        preview->intervalMs = intervalMs;
+        preview->exposure = exposure;
+        preview->denoise = denoiseSettings != nullptr;
+        if(denoiseSettings != nullptr) {
+            preview->denoiseSettings = *denoiseSettings;
+        }
+        preview->stop = 0;
+        preview->writtenCount = 0;
+        preview->thread = CreateThread(FramebufferPreviewThread, preview, "FramebufferPreview", NoThreadAffinity_);
+    }
+
+    //=============================================================================================================================
+    void FramebufferPreview_Stop(FramebufferPreview* preview)
+    {
+        preview->stop = 1;
+        ShutdownThread(preview->thread);
+        preview->thread = InvalidThreadHandle;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/AovDenoiser.h"
+#include "StringLib/FixedString.h"
+#include "ThreadingLib/Thread.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    struct Framebuffer;
+
+    // -- Periodically writes a tone mapped PNG of a framebuffer laid out with the AovFramebufferLayer layers while it is being
+    // -- rendered. Each preview sums the frame and every writer's private tiles into a snapshot while the writers keep going,
+    // -- so a pixel can be caught half way through a write; that is fine for a preview and keeps the workers from ever
+    // -- waiting on it.
+    struct FramebufferPreview
+    {
+        const Framebuffer*  frame;
+        FilePathString      filepath;
+        uint32              intervalMs;
+        float               exposure;
+        bool                denoise;
+        AovDenoiserSettings denoiseSettings;
+        volatile int64      stop;
+        uint32              writtenCount;
+        ThreadHandle        thread;
+    };
+
+    // -- denoiseSettings may be null to write the raw beauty.
+    void FramebufferPreview_Start(FramebufferPreview* preview, const Framebuffer* frame, cpointer name, uint32 intervalMs,
+                                  float exposure, const AovDenoiserSettings* denoiseSettings);
+    void FramebufferPreview_Stop(FramebufferPreview* preview);
+}
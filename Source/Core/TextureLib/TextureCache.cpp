@@ -4,20 +4,31 @@
 
 #include "TextureLib/TextureCache.h"
 #include "TextureLib/TextureFiltering.h"
+#include "StringLib/StringTable.h"
 #include "SystemLib/JsAssert.h"
 #include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/PerfCounters.h"
+#include "SystemLib/Profiling.h"
 #include "SystemLib/Atomic.h"
 
 #include <map>
 
+// -- Purging a file drops every block Ptex has loaded for it so the budget is enforced a few files per governor update.
+#define TrimFilesPerUpdate_ 4
+
 namespace Selas
 {
     struct TextureMapEntry
     {
         volatile int64 usageRefCount;
         uint32 loadRefCount;     
-        FilePathString ptexFilePath;
+        InternedString ptexFilePath;
         TextureResource resource;
+
+        // -- Fetch count when the Ptex file was last fetched. Orders files for trimming.
+        volatile int64 lastFetch;
+        // -- Cleared when the file is purged so the next fetch knows Ptex has to read it again.
+        volatile int32 ptexResident;
     };
 
     typedef std::map<Hash32, TextureMapEntry*>           TextureResourceMap;
@@ -28,6 +39,11 @@ namespace Selas
     {
         TextureResourceMap map;
         uint64 capacity;
+        uint64 maximumCapacity;
+
+        // -- Both in Ptex fetches. A fetch is a miss when the file was never opened or has been purged since it was last used.
+        volatile int64 ptexFetchCount;
+        volatile int64 ptexMissCount;
 
         Ptex::PtexCache* ptexCache;
     };
@@ -46,13 +62,18 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    void TextureCache::Initialize(uint64 cacheSize)
+    void TextureCache::Initialize(uint64 cacheSize, uint64 maximumSize)
     {
+        Assert_(cacheSize <= maximumSize);
+
         uint32 maxFiles = 128;
 
         cacheData = New_(TextureCacheData);
         cacheData->capacity = cacheSize;
-        cacheData->ptexCache = Ptex::PtexCache::create(maxFiles, cacheSize, true, nullptr, nullptr);
+        cacheData->maximumCapacity = maximumSize;
+        cacheData->ptexFetchCount = 0;
+        cacheData->ptexMissCount = 0;
+        cacheData->ptexCache = Ptex::PtexCache::create(maxFiles, maximumSize, true, nullptr, nullptr);
     }
 
     //=============================================================================================================================
@@ -64,9 +85,68 @@ namespace Selas
         SafeDelete_(cacheData);
     }
 
+    //=============================================================================================================================
+    void TextureCache::Resize(uint64 cacheSize)
+    {
+        cacheData->capacity = cacheSize < cacheData->maximumCapacity ? cacheSize : cacheData->maximumCapacity;
+    }
+
+    //=============================================================================================================================
+    void TextureCache::GetMemoryStats(MemoryConsumerStats& stats)
+    {
+        Ptex::PtexCache::Stats ptexStats;
+        cacheData->ptexCache->getStats(ptexStats);
+
+        // -- Misses are read first so a fetch counted between the two loads can't make them larger than the total.
+        int64 misses = Atomic::LoadAcquire64(&cacheData->ptexMissCount);
+        int64 fetches = Atomic::LoadAcquire64(&cacheData->ptexFetchCount);
+
+        stats.usedBytes = ptexStats.memUsed;
+        stats.missCount = (uint64)misses;
+        stats.hitCount = (uint64)(fetches - misses);
+    }
+
+    //=============================================================================================================================
+    void TextureCache::Trim()
+    {
+        // -- Ptex can only be capped when it is created so a lower budget is enforced by purging the least recently fetched
+        // -- files. Textures in use stay valid until they are released.
+        for(uint pass = 0; pass < TrimFilesPerUpdate_; ++pass) {
+            Ptex::PtexCache::Stats ptexStats;
+            cacheData->ptexCache->getStats(ptexStats);
+            if(ptexStats.memUsed <= cacheData->capacity) {
+                return;
+            }
+
+            TextureMapEntry* oldest = nullptr;
+            for(TextureResourceIterator it = cacheData->map.begin(); it != cacheData->map.end(); ++it) {
+                TextureMapEntry* entry = it->second;
+                if(entry->ptexFilePath.Empty() || entry->ptexResident == 0) {
+                    continue;
+                }
+
+                if(oldest == nullptr || entry->lastFetch < oldest->lastFetch) {
+                    oldest = entry;
+                }
+            }
+
+            if(oldest == nullptr) {
+                return;
+            }
+
+            oldest->ptexResident = 0;
+            cacheData->ptexCache->purge(PathAscii(oldest->ptexFilePath));
+        }
+    }
+
     //=============================================================================================================================
     Error TextureCache::LoadTextureResource(const FilePathString& textureName, TextureHandle& handle)
     {
+        ProfileEventMarker_(0, "LoadTextureResource");
+        PerfPhaseScope_(ePerfPhaseLoading);
+
+        MemoryTagScope_(eMemoryTagTextures);
+
         if(textureName.Length() == 0) {
             handle = TextureHandle();
             return Success_;
@@ -87,7 +167,7 @@ namespace Selas
             return err;
         }
 
-        entry->ptexFilePath.Clear();
+        entry->ptexFilePath = InternedString();
         entry->loadRefCount = 1;
         entry->usageRefCount = 0;
         cacheData->map.insert(TextureResourceKeyValue(handle.hash, entry));
@@ -98,6 +178,9 @@ namespace Selas
     //=============================================================================================================================
     Error TextureCache::LoadTexturePtex(const FilePathString& filepath, TextureHandle& handle)
     {
+        ProfileEventMarker_(0, "LoadTexturePtex");
+        PerfPhaseScope_(ePerfPhaseLoading);
+
         if(filepath.Length() == 0) {
             handle = TextureHandle();
             return Success_;
@@ -116,15 +199,43 @@ namespace Selas
         }
 
         TextureMapEntry* entry = New_(TextureMapEntry);
-        entry->ptexFilePath.Copy(filepath.Ascii());
+        entry->ptexFilePath = InternPath(filepath.Ascii());
         entry->loadRefCount = 1;
         entry->usageRefCount = 0;
+        entry->lastFetch = 0;
+        entry->ptexResident = 0;
 
         cacheData->map.insert(TextureResourceKeyValue(handle.hash, entry));
 
         return Success_;
     }
 
+    //=============================================================================================================================
+    Error TextureCache::RegisterTextureResource(const FilePathString& textureName, TextureResourceData* data,
+                                                TextureHandle& handle)
+    {
+        if(textureName.Length() == 0) {
+            return Error_("Registered textures require a name");
+        }
+
+        handle.hash = MurmurHash3_x86_32(textureName.Ascii(), StringUtil::Length(textureName.Ascii()));
+
+        auto obj = cacheData->map.find(handle.hash);
+        if(obj != cacheData->map.end()) {
+            handle = TextureHandle();
+            return Error_("Texture %s is already loaded", textureName.Ascii());
+        }
+
+        TextureMapEntry* entry = New_(TextureMapEntry);
+        entry->resource.data = data;
+        entry->ptexFilePath = InternedString();
+        entry->loadRefCount = 1;
+        entry->usageRefCount = 0;
+        cacheData->map.insert(TextureResourceKeyValue(handle.hash, entry));
+
+        return Success_;
+    }
+
     //=============================================================================================================================
     void TextureCache::UnloadTexture(TextureHandle handle)
     {
@@ -177,8 +288,14 @@ namespace Selas
             return nullptr;
         }
 
+        TextureMapEntry* entry = obj->second;
+        entry->lastFetch = Atomic::Increment64(&cacheData->ptexFetchCount);
+        if(entry->ptexResident == 0 && Atomic::CompareExchange32(&entry->ptexResident, 1, 0)) {
+            Atomic::Increment64(&cacheData->ptexMissCount);
+        }
+
         Ptex::String error;
-        Ptex::PtexTexture* texture = cacheData->ptexCache->get(obj->second->ptexFilePath.Ascii(), error);
+        Ptex::PtexTexture* texture = cacheData->ptexCache->get(PathAscii(entry->ptexFilePath), error);
         Assert_(texture != nullptr);
 
         return texture;
@@ -7,6 +7,7 @@
 #include "TextureLib/TextureResource.h"
 #include "UtilityLib/MurmurHash.h"
 #include "StringLib/FixedString.h"
+#include "SystemLib/MemoryGovernor.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4996)
@@ -40,11 +41,20 @@ namespace Selas
          TextureCache();
         ~TextureCache();
 
-        void Initialize(uint64 cacheSize);
+        // -- The Ptex cache is created once with maximumSize so cacheSize can be raised up to it later with Resize.
+        void Initialize(uint64 cacheSize, uint64 maximumSize);
         void Shutdown();
 
+        // -- Ptex memory over the new size is released by later calls to Trim.
+        void Resize(uint64 cacheSize);
+        void GetMemoryStats(MemoryConsumerStats& stats);
+        // -- Purges a few of the least recently fetched Ptex files when the cache is over its size. Call it periodically.
+        void Trim();
+
         Error LoadTextureResource(const FilePathString& textureName, TextureHandle& handle);
         Error LoadTexturePtex(const FilePathString& filepath, TextureHandle& handle);
+        // -- Takes ownership of texture data that was attached in memory. Later loads by the same name share it.
+        Error RegisterTextureResource(const FilePathString& textureName, TextureResourceData* data, TextureHandle& handle);
         void UnloadTexture(TextureHandle handle);
 
         const TextureResource* FetchTexture(TextureHandle handle);
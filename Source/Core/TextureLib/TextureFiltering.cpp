@@ -7,6 +7,8 @@
 
 namespace Selas
 {
+    float EWAFilterLut[EwaLutSize];
+
     //=============================================================================================================================
     namespace TextureFiltering
     {
@@ -16,7 +16,8 @@
 namespace Selas
 {
     const uint EwaLutSize = 128;
-    static float EWAFilterLut[EwaLutSize];
+    // -- Filled by InitializeEWAFilterWeights
+    extern float EWAFilterLut[EwaLutSize];
         
     struct TextureResourceData;
 
@@ -4,6 +4,8 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "SystemLib/BasicTypes.h"
+
 namespace Selas
 {
 
@@ -17,7 +19,18 @@ namespace Selas
     // Thread
     //=============================================================================================================================
     #define InvalidThreadHandle 0
+    #define NoThreadAffinity_   -1
 
     ThreadHandle CreateThread(ThreadFunction function, void* userData);
+    // -- name shows up in debuggers and profilers where the platform supports it. coreIndex pins the thread to a single logical
+    // -- core; pass NoThreadAffinity_ to let the OS schedule it. Out of range core indices are ignored.
+    ThreadHandle CreateThread(ThreadFunction function, void* userData, cpointer name, int32 coreIndex);
     void         ShutdownThread(ThreadHandle threadHandle);
-}
\ No newline at end of file
+
+    // -- Pinning workers to cores is opt in. Enabling it snapshots the cores the process may run on, ordered so every physical
+    // -- core is used once before any SMT siblings. Call it before any thread narrows its own affinity.
+    void         SetWorkerThreadPinning(bool enabled);
+    // -- The core for the given worker, wrapping when there are more workers than cores, or NoThreadAffinity_ when pinning is
+    // -- disabled.
+    int32        WorkerThreadCore(uint32 workerIndex);
+}
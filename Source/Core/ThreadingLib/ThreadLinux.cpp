@@ -2,28 +2,55 @@
 // Joe Schutte
 //=================================================================================================================================
 
-#if IsOsx_
+#if IsOsx_ || IsLinux_
 
 #include "ThreadingLib/Thread.h"
+#include "StringLib/FixedString.h"
+#include "StringLib/StringUtil.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Profiling.h"
 #include "SystemLib/JsAssert.h"
 
 #include <pthread.h>
+#include <unistd.h>
+
+#define MaxWorkerThreadCores_ 1024
+#if IsLinux_
+#include <sched.h>
+#include <stdio.h>
+#endif
 
 namespace Selas
 {
+    static bool   workerThreadPinning = false;
+    static int32  workerThreadCores[MaxWorkerThreadCores_];
+    static uint32 workerThreadCoreCount = 0;
+
     struct ThreadData
     {
         pthread_t threadid;
         ThreadFunction function;
         void* userData;
+        FixedString32 name;
     };
 
     //=============================================================================================================================
     void* ThreadTrampoline(void* userData)
     {
         ThreadData* threadData = (ThreadData*)userData;
+
+        // -- Both platforms only allow naming from the thread itself. Linux also caps names at 15 characters.
+        if(threadData->name.Length() > 0) {
+            TraceProfiler_SetThreadName(threadData->name.Ascii());
+            #if IsLinux_
+                threadData->name.Ascii()[15] = '\0';
+                pthread_setname_np(pthread_self(), threadData->name.Ascii());
+            #elif IsOsx_
+                pthread_setname_np(threadData->name.Ascii());
+            #endif
+        }
+
         threadData->function(threadData->userData);
 
         return nullptr;
@@ -31,12 +58,39 @@ namespace Selas
 
     //=============================================================================================================================
     ThreadHandle CreateThread(ThreadFunction function, void* userData)
+    {
+        return CreateThread(function, userData, nullptr, NoThreadAffinity_);
+    }
+
+    //=============================================================================================================================
+    ThreadHandle CreateThread(ThreadFunction function, void* userData, cpointer name, int32 coreIndex)
     {
         ThreadData* threadData = AllocArray_(ThreadData, 1);
         threadData->function = function;
         threadData->userData = userData;
+        threadData->name.Clear();
+        if(name != nullptr) {
+            StringUtil::Copy(threadData->name.Ascii(), (int32)threadData->name.Capacity(), name);
+        }
+
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+
+        #if IsLinux_
+            if(coreIndex >= 0 && coreIndex < sysconf(_SC_NPROCESSORS_ONLN)) {
+                cpu_set_t cpuSet;
+                CPU_ZERO(&cpuSet);
+                CPU_SET(coreIndex, &cpuSet);
+                pthread_attr_setaffinity_np(&attributes, sizeof(cpuSet), &cpuSet);
+            }
+        #else
+            // -- OSX only exposes affinity tags rather than hard affinity so the hint is ignored.
+            Unused_(coreIndex);
+        #endif
+
+        int32 result = pthread_create(&threadData->threadid, &attributes, ThreadTrampoline, threadData);
+        pthread_attr_destroy(&attributes);
 
-        int32 result = pthread_create(&threadData->threadid, nullptr, ThreadTrampoline, threadData);
         if(result != 0) {
             Free_(threadData);
             return InvalidThreadHandle;
@@ -45,6 +99,72 @@ namespace Selas
         return (void*)threadData;
     }
 
+    #if IsLinux_
+    //=============================================================================================================================
+    static bool IsFirstSmtSibling(int32 core)
+    {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", core);
+
+        FILE* file = fopen(path, "r");
+        if(file == nullptr) {
+            return true;
+        }
+
+        // -- Formatted like "3,35" or "2-3" so the first number is the lowest sibling.
+        int32 firstSibling = core;
+        if(fscanf(file, "%d", &firstSibling) != 1) {
+            firstSibling = core;
+        }
+        fclose(file);
+
+        return firstSibling == core;
+    }
+    #endif
+
+    //=============================================================================================================================
+    void SetWorkerThreadPinning(bool enabled)
+    {
+        workerThreadPinning = false;
+        workerThreadCoreCount = 0;
+
+        #if IsLinux_
+            if(enabled == false) {
+                return;
+            }
+
+            // -- Honours taskset and cgroup cpusets rather than assuming every online core is available.
+            cpu_set_t allowed;
+            if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+                return;
+            }
+
+            for(uint32 pass = 0; pass < 2; ++pass) {
+                bool firstSiblings = (pass == 0);
+                for(int32 core = 0; core < CPU_SETSIZE && workerThreadCoreCount < MaxWorkerThreadCores_; ++core) {
+                    if(CPU_ISSET(core, &allowed) && IsFirstSmtSibling(core) == firstSiblings) {
+                        workerThreadCores[workerThreadCoreCount++] = core;
+                    }
+                }
+            }
+
+            workerThreadPinning = workerThreadCoreCount > 0;
+        #else
+            // -- OSX only exposes affinity tags rather than hard affinity so workers are never pinned.
+            Unused_(enabled);
+        #endif
+    }
+
+    //=============================================================================================================================
+    int32 WorkerThreadCore(uint32 workerIndex)
+    {
+        if(workerThreadPinning == false) {
+            return NoThreadAffinity_;
+        }
+
+        return workerThreadCores[workerIndex % workerThreadCoreCount];
+    }
+
     //=============================================================================================================================
     void ShutdownThread(ThreadHandle threadHandle)
     {
@@ -56,4 +176,4 @@ namespace Selas
     }
 }
 
-#endif
\ No newline at end of file
+#endif
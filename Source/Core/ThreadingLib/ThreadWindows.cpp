@@ -5,12 +5,42 @@
 #if IsWindows_
 
 #include "ThreadingLib/Thread.h"
+#include "StringLib/FixedString.h"
+#include "StringLib/StringUtil.h"
+#include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/BasicTypes.h"
+#include "SystemLib/Profiling.h"
 
 #include <Windows.h>
 
 namespace Selas
 {
+    static bool   workerThreadPinning = false;
+    static int32  workerThreadCores[64];
+    static uint32 workerThreadCoreCount = 0;
+
+    struct ThreadData
+    {
+        ThreadFunction function;
+        void* userData;
+        FixedString32 name;
+    };
+
+    //=============================================================================================================================
+    static DWORD WINAPI ThreadTrampoline(void* userData)
+    {
+        // -- The handle returned to the caller is the raw thread handle so the thread frees its own data
+        ThreadData threadData = *(ThreadData*)userData;
+        Free_(userData);
+
+        // -- The trace profiler only lets a thread name itself
+        TraceProfiler_SetThreadName(threadData.name.Ascii());
+
+        threadData.function(threadData.userData);
+
+        return 0;
+    }
+
     //=============================================================================================================================
     ThreadHandle CreateThread(ThreadFunction function, void* userData)
     {
@@ -19,6 +49,98 @@ namespace Selas
                               /*out thread_id*/nullptr);
     }
 
+    //=============================================================================================================================
+    ThreadHandle CreateThread(ThreadFunction function, void* userData, cpointer name, int32 coreIndex)
+    {
+        // -- Thread descriptions need a newer SDK than this project targets so the name only labels the trace profiler lane.
+        ThreadHandle handle = InvalidThreadHandle;
+        if(name != nullptr && StringUtil::Length(name) > 0) {
+            ThreadData* threadData = AllocArray_(ThreadData, 1);
+            threadData->function = function;
+            threadData->userData = userData;
+            StringUtil::Copy(threadData->name.Ascii(), (int32)threadData->name.Capacity(), name);
+
+            handle = ::CreateThread(nullptr, 0, ThreadTrampoline, threadData, 0, nullptr);
+            if(handle == InvalidThreadHandle) {
+                Free_(threadData);
+            }
+        }
+        else {
+            handle = CreateThread(function, userData);
+        }
+
+        if(handle != InvalidThreadHandle && coreIndex >= 0 && coreIndex < 64) {
+            SetThreadAffinityMask((HANDLE)handle, (DWORD_PTR)1 << coreIndex);
+        }
+
+        return handle;
+    }
+
+    //=============================================================================================================================
+    static DWORD_PTR FirstSmtSiblingMask()
+    {
+        DWORD bufferSize = 0;
+        GetLogicalProcessorInformation(nullptr, &bufferSize);
+        if(bufferSize == 0) {
+            return ~(DWORD_PTR)0;
+        }
+
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)Alloc_(bufferSize);
+        DWORD_PTR mask = 0;
+        if(GetLogicalProcessorInformation(info, &bufferSize)) {
+            for(uint scan = 0, count = bufferSize / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); scan < count; ++scan) {
+                if(info[scan].Relationship == RelationProcessorCore) {
+                    // -- Lowest set bit of each physical core's mask
+                    DWORD_PTR coreMask = info[scan].ProcessorMask;
+                    mask |= coreMask & (~coreMask + 1);
+                }
+            }
+        }
+        Free_(info);
+
+        return mask != 0 ? mask : ~(DWORD_PTR)0;
+    }
+
+    //=============================================================================================================================
+    void SetWorkerThreadPinning(bool enabled)
+    {
+        workerThreadPinning = false;
+        workerThreadCoreCount = 0;
+
+        if(enabled == false) {
+            return;
+        }
+
+        // -- Honours the process affinity mask (e.g. from start /affinity or a job object) rather than every core.
+        DWORD_PTR processMask = 0;
+        DWORD_PTR systemMask = 0;
+        if(GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) == 0) {
+            return;
+        }
+
+        DWORD_PTR firstSiblings = FirstSmtSiblingMask();
+        DWORD_PTR passMasks[2] = { processMask & firstSiblings, processMask & ~firstSiblings };
+        for(uint pass = 0; pass < 2; ++pass) {
+            for(int32 core = 0; core < 64; ++core) {
+                if(passMasks[pass] & ((DWORD_PTR)1 << core)) {
+                    workerThreadCores[workerThreadCoreCount++] = core;
+                }
+            }
+        }
+
+        workerThreadPinning = workerThreadCoreCount > 0;
+    }
+
+    //=============================================================================================================================
+    int32 WorkerThreadCore(uint32 workerIndex)
+    {
+        if(workerThreadPinning == false) {
+            return NoThreadAffinity_;
+        }
+
+        return workerThreadCores[workerIndex % workerThreadCoreCount];
+    }
+
     //=============================================================================================================================
     void ShutdownThread(ThreadHandle threadHandle)
     {
@@ -0,0 +1,182 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "UtilityLib/RadixSort.h"
+#include "ThreadingLib/Thread.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/JsAssert.h"
+
+#include <xmmintrin.h>
+
+#define RadixBits_              8
+#define RadixBucketCount_       (1 << RadixBits_)
+#define RadixMask_              (RadixBucketCount_ - 1)
+#define MaxRadixSortThreads_    32
+// -- Below this each pass is cheaper than waking threads for it.
+#define MinParallelCount_       (64 * 1024)
+
+namespace Selas
+{
+    //=============================================================================================================================
+    template <typename Key_>
+    struct RadixSortData
+    {
+        Key_*   keys[2];
+        uint32* values[2];
+        uint    count;
+        uint    threadCount;
+
+        volatile int64 threadCounter;
+        volatile int64 barrierCount;
+        volatile int64 barrierGeneration;
+
+        Align_(CacheLineSize_) uint32 histograms[MaxRadixSortThreads_][RadixBucketCount_];
+    };
+
+    //=============================================================================================================================
+    template <typename Key_>
+    static void RadixSortBarrier(RadixSortData<Key_>* data)
+    {
+        if(data->threadCount == 1) {
+            return;
+        }
+
+        int64 generation = Atomic::LoadAcquire64(&data->barrierGeneration);
+        if(Atomic::Increment64(&data->barrierCount) + 1 == (int64)data->threadCount) {
+            data->barrierCount = 0;
+            Atomic::Increment64(&data->barrierGeneration);
+            return;
+        }
+
+        while(Atomic::LoadAcquire64(&data->barrierGeneration) == generation) {
+            _mm_pause();
+        }
+    }
+
+    //=============================================================================================================================
+    template <typename Key_>
+    static void RadixSortKernel(void* userData)
+    {
+        RadixSortData<Key_>* data = (RadixSortData<Key_>*)userData;
+
+        uint threadIndex = (uint)Atomic::Increment64(&data->threadCounter);
+        uint begin = data->count * threadIndex / data->threadCount;
+        uint end = data->count * (threadIndex + 1) / data->threadCount;
+
+        uint32* histogram = data->histograms[threadIndex];
+        uint32 offsets[RadixBucketCount_];
+
+        uint source = 0;
+        for(uint shift = 0; shift < sizeof(Key_) * 8; shift += RadixBits_) {
+            const Key_* sourceKeys = data->keys[source];
+            Key_* destKeys = data->keys[1 - source];
+            const uint32* sourceValues = data->values[source];
+            uint32* destValues = data->values[1 - source];
+
+            Memory::Zero(histogram, sizeof(uint32) * RadixBucketCount_);
+            for(uint scan = begin; scan < end; ++scan) {
+                ++histogram[(sourceKeys[scan] >> shift) & RadixMask_];
+            }
+
+            RadixSortBarrier(data);
+
+            // -- Each thread writes its chunk after every earlier digit and after earlier threads' entries for the same digit.
+            bool trivialPass = false;
+            uint32 digitStart = 0;
+            for(uint digit = 0; digit < RadixBucketCount_; ++digit) {
+                uint32 digitTotal = 0;
+                for(uint thread = 0; thread < data->threadCount; ++thread) {
+                    if(thread == threadIndex) {
+                        offsets[digit] = digitStart + digitTotal;
+                    }
+                    digitTotal += data->histograms[thread][digit];
+                }
+
+                trivialPass |= (digitTotal == data->count);
+                digitStart += digitTotal;
+            }
+
+            // -- Every key shares this digit so the pass wouldn't move anything.
+            if(trivialPass == false) {
+                for(uint scan = begin; scan < end; ++scan) {
+                    uint32 dest = offsets[(sourceKeys[scan] >> shift) & RadixMask_]++;
+                    destKeys[dest] = sourceKeys[scan];
+                    if(sourceValues) {
+                        destValues[dest] = sourceValues[scan];
+                    }
+                }
+                source = 1 - source;
+            }
+
+            RadixSortBarrier(data);
+        }
+
+        if(source == 1) {
+            Memory::Copy(data->keys[0] + begin, data->keys[1] + begin, (end - begin) * sizeof(Key_));
+            if(data->values[0]) {
+                Memory::Copy(data->values[0] + begin, data->values[1] + begin, (end - begin) * sizeof(uint32));
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    template <typename Key_>
+    static void RadixSortInternal(Key_* keys, uint32* values, uint count, uint threadCount)
+    {
+        ProfileEventMarker_(0, "RadixSort");
+
+        if(count < 2) {
+            return;
+        }
+
+        threadCount = Clamp<uint>(threadCount, 1, MaxRadixSortThreads_);
+        if(count < MinParallelCount_) {
+            threadCount = 1;
+        }
+
+        RadixSortData<Key_>* data = AllocArrayAligned_(RadixSortData<Key_>, 1, CacheLineSize_);
+        data->keys[0] = keys;
+        data->keys[1] = AllocArrayAligned_(Key_, count, CacheLineSize_);
+        data->values[0] = values;
+        data->values[1] = values ? AllocArrayAligned_(uint32, count, CacheLineSize_) : nullptr;
+        data->count = count;
+        data->threadCount = threadCount;
+        data->threadCounter = 0;
+        data->barrierCount = 0;
+        data->barrierGeneration = 0;
+
+        ThreadHandle threadHandles[MaxRadixSortThreads_];
+        for(uint scan = 1; scan < threadCount; ++scan) {
+            threadHandles[scan] = CreateThread(RadixSortKernel<Key_>, data, "RadixSort", NoThreadAffinity_);
+            Assert_(threadHandles[scan] != InvalidThreadHandle);
+        }
+
+        RadixSortKernel<Key_>(data);
+
+        for(uint scan = 1; scan < threadCount; ++scan) {
+            ShutdownThread(threadHandles[scan]);
+        }
+
+        SafeFreeAligned_(data->values[1]);
+        FreeAligned_(data->keys[1]);
+        FreeAligned_(data);
+    }
+
+    //=============================================================================================================================
+    void RadixSort(uint32* keys, uint32* values, uint count, uint threadCount)
+    {
+        RadixSortInternal(keys, values, count, threadCount);
+    }
+
+    //=============================================================================================================================
+    void RadixSort(uint64* keys, uint32* values, uint count, uint threadCount)
+    {
+        RadixSortInternal(keys, values, count, threadCount);
+    }
+}
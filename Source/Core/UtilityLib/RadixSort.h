@@ -0,0 +1,30 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Stable LSD radix sort of keys in ascending order. values is optional and is reordered to match the keys; it is expected
+    // -- to hold indices into a payload array. Up to threadCount threads are used including the calling thread; small inputs are
+    // -- sorted on the calling thread alone.
+    void RadixSort(uint32* keys, uint32* values, uint count, uint threadCount);
+    void RadixSort(uint64* keys, uint32* values, uint count, uint threadCount);
+
+    // -- Maps a float to a uint32 that sorts in the same order.
+    inline uint32 RadixSortableFloat(float value)
+    {
+        union
+        {
+            float f;
+            uint32 u;
+        } bits;
+        bits.f = value;
+
+        uint32 mask = (bits.u & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+        return bits.u ^ mask;
+    }
+}